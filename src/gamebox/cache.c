@@ -0,0 +1,548 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2006-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glk.h>
+
+#include "protos.h"
+
+
+/*
+ * A compiled catalog is a snapshot of the games and groups built from
+ * parsing a catalog file, written alongside it with a ".cache" suffix.  It
+ * holds a header, an array of game records, an array of group records, an
+ * array of group content node ids, and a string table, all in native byte
+ * order, and is read back with a single mmap().  Strings are stored already
+ * converted from UTF-8, so loading needs neither libxml2 nor the ini reader.
+ * The cache is used only if it records the current size and modification
+ * time of its catalog, and is itself no older, and if it was built with the
+ * current iFiction download base, from which game locations are formed;
+ * otherwise the catalog is parsed and the cache rewritten.  Failure to
+ * write a cache, for example to a read-only catalog directory, is silently
+ * ignored.
+ */
+static const char CACHE_MAGIC[8] = "GBXCAT02";
+static const char *const CACHE_SUFFIX = ".cache";
+static const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+static const uint32_t CACHE_NO_STRING = 0xffffffff;
+
+typedef struct {
+  char magic[8];
+  uint32_t byte_order;
+  uint32_t game_count;
+  uint32_t group_count;
+  uint32_t node_count;
+  uint32_t strings_size;
+  uint32_t download_hash;
+  int64_t source_size;
+  int64_t source_mtime;
+  int64_t source_mtime_nsec;
+} cache_header_t;
+
+/* Game record fields, in the order passed to gameset_add_game(). */
+enum { CACHE_GAME_FIELDS = 12 };
+typedef struct {
+  uint32_t strings[CACHE_GAME_FIELDS];
+} cache_game_t;
+
+/* Group records, with a range of the node ids array for group contents. */
+typedef struct {
+  uint32_t about;
+  uint32_t title;
+  uint32_t description;
+  uint32_t first_node;
+  uint32_t node_count;
+} cache_group_t;
+
+/* String table under construction while writing a cache. */
+typedef struct {
+  char *data;
+  uint32_t size;
+  uint32_t allocation;
+} cache_strings_t;
+
+
+/*
+ * cache_get_filename()
+ *
+ * Return the malloc'ed name of the compiled cache for a catalog file.
+ */
+static char *
+cache_get_filename (const char *meta_file)
+{
+  char *filename;
+
+  filename = memory_malloc (strlen (meta_file) + strlen (CACHE_SUFFIX) + 1);
+  strcpy (filename, meta_file);
+  strcat (filename, CACHE_SUFFIX);
+
+  return filename;
+}
+
+
+/*
+ * cache_get_download_hash()
+ *
+ * Return a hash of the current iFiction download base url.
+ */
+static uint32_t
+cache_get_download_hash (void)
+{
+  char *download;
+  uint32_t download_hash;
+
+  download = xml_get_babel_download ();
+  download_hash = hash (download);
+  memory_free (download);
+
+  return download_hash;
+}
+
+
+/*
+ * cache_get_string()
+ *
+ * Return the string at an offset into the string table of a mapped cache,
+ * or NULL for no string.  The caller must already have checked that the
+ * offset lies in the table, and that the table ends with a NUL.
+ */
+static const char *
+cache_get_string (const char *strings, uint32_t offset)
+{
+  return offset == CACHE_NO_STRING ? NULL : strings + offset;
+}
+
+
+/*
+ * cache_is_valid()
+ *
+ * Check a mapped cache image for consistency with itself and with the
+ * status of its catalog file, and return TRUE if it may be loaded.
+ */
+static int
+cache_is_valid (const unsigned char *image, size_t size,
+                const struct stat *source, const struct stat *cache)
+{
+  const cache_header_t *header;
+  const cache_game_t *games;
+  const cache_group_t *groups;
+  const uint32_t *nodes;
+  const char *strings;
+  uint64_t expected;
+  uint32_t index_, field;
+
+  header = (const cache_header_t *) image;
+  if (size < sizeof (*header)
+      || memcmp (header->magic, CACHE_MAGIC, sizeof (CACHE_MAGIC)) != 0
+      || header->byte_order != CACHE_BYTE_ORDER)
+    return FALSE;
+
+  /*
+   * Reject the cache if the catalog has changed since it was written, or if
+   * game locations would now be formed from a different download base.
+   */
+  if (header->source_size != (int64_t) source->st_size
+      || header->source_mtime != (int64_t) source->st_mtim.tv_sec
+      || header->source_mtime_nsec != (int64_t) source->st_mtim.tv_nsec
+      || cache->st_mtime < source->st_mtime
+      || header->download_hash != cache_get_download_hash ())
+    return FALSE;
+
+  expected = sizeof (*header)
+             + (uint64_t) header->game_count * sizeof (*games)
+             + (uint64_t) header->group_count * sizeof (*groups)
+             + (uint64_t) header->node_count * sizeof (*nodes)
+             + header->strings_size;
+  if (expected != size || header->strings_size == 0)
+    return FALSE;
+
+  games = (const cache_game_t *) (header + 1);
+  groups = (const cache_group_t *) (games + header->game_count);
+  nodes = (const uint32_t *) (groups + header->group_count);
+  strings = (const char *) (nodes + header->node_count);
+  if (strings[header->strings_size - 1] != '\0')
+    return FALSE;
+
+  /* Check string offsets and group content ranges; loading checks node ids. */
+  for (index_ = 0; index_ < header->game_count; index_++)
+    {
+      for (field = 0; field < CACHE_GAME_FIELDS; field++)
+        {
+          uint32_t offset;
+
+          offset = games[index_].strings[field];
+          if (offset != CACHE_NO_STRING && offset >= header->strings_size)
+            return FALSE;
+        }
+
+      /* About (location) and title are mandatory. */
+      if (games[index_].strings[0] == CACHE_NO_STRING
+          || games[index_].strings[10] == CACHE_NO_STRING)
+        return FALSE;
+    }
+
+  for (index_ = 0; index_ < header->group_count; index_++)
+    {
+      const cache_group_t *group;
+
+      group = groups + index_;
+      if (group->about >= header->strings_size
+          || group->title >= header->strings_size
+          || (group->description != CACHE_NO_STRING
+              && group->description >= header->strings_size)
+          || group->first_node > header->node_count
+          || group->node_count > header->node_count - group->first_node)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+/*
+ * cache_load_catalog()
+ *
+ * Build the games and groups sets from the compiled cache of a catalog file.
+ * Returns TRUE if loaded, FALSE if there is no usable cache, in which case
+ * the games and groups sets are left empty.
+ */
+int
+cache_load_catalog (const char *meta_file)
+{
+  struct stat source, cache;
+  const cache_header_t *header;
+  const cache_game_t *games;
+  const cache_group_t *groups;
+  const uint32_t *nodes;
+  const char *strings;
+  char *filename;
+  void *image;
+  uint32_t index_, node;
+  glui32 first_group_id;
+  int fd, status;
+  assert (gameset_is_empty () && gamegroup_is_empty ());
+
+  if (stat (meta_file, &source) == -1)
+    return FALSE;
+
+  filename = cache_get_filename (meta_file);
+  fd = open (filename, O_RDONLY);
+  memory_free (filename);
+  if (fd == -1)
+    return FALSE;
+
+  if (fstat (fd, &cache) == -1 || !S_ISREG (cache.st_mode)
+      || cache.st_size < (off_t) sizeof (*header))
+    {
+      close (fd);
+      return FALSE;
+    }
+
+  image = mmap (NULL, cache.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (image == MAP_FAILED)
+    return FALSE;
+
+  if (!cache_is_valid (image, cache.st_size, &source, &cache))
+    {
+      munmap (image, cache.st_size);
+      return FALSE;
+    }
+
+  header = image;
+  games = (const cache_game_t *) (header + 1);
+  groups = (const cache_group_t *) (games + header->game_count);
+  nodes = (const uint32_t *) (groups + header->group_count);
+  strings = (const char *) (nodes + header->node_count);
+
+  /* Add games and groups in id order, so that node ids resolve to them. */
+  for (index_ = 0; index_ < header->game_count; index_++)
+    {
+      const uint32_t *fields;
+
+      fields = games[index_].strings;
+      gameset_add_game (cache_get_string (strings, fields[0]),
+                        cache_get_string (strings, fields[1]),
+                        cache_get_string (strings, fields[2]),
+                        cache_get_string (strings, fields[3]),
+                        cache_get_string (strings, fields[4]),
+                        cache_get_string (strings, fields[5]),
+                        cache_get_string (strings, fields[6]),
+                        cache_get_string (strings, fields[7]),
+                        cache_get_string (strings, fields[8]),
+                        cache_get_string (strings, fields[9]),
+                        cache_get_string (strings, fields[10]),
+                        cache_get_string (strings, fields[11]));
+    }
+
+  first_group_id = 0;
+  for (index_ = 0; index_ < header->group_count; index_++)
+    {
+      groupref_t group;
+
+      group = gamegroup_add_group (cache_get_string (strings,
+                                                     groups[index_].about),
+                                   cache_get_string (strings,
+                                                     groups[index_].title),
+                                   cache_get_string (strings,
+                                                groups[index_].description));
+      if (index_ == 0)
+        first_group_id = gamegroup_get_group_id (group);
+    }
+
+  status = TRUE;
+  for (index_ = 0; status && index_ < header->group_count; index_++)
+    {
+      groupref_t group;
+
+      group = gamegroup_id_to_group (first_group_id + index_);
+      for (node = groups[index_].first_node;
+           node < groups[index_].first_node + groups[index_].node_count;
+           node++)
+        {
+          if (!gamegroup_add_id_to_group (group, nodes[node]))
+            {
+              status = FALSE;
+              break;
+            }
+        }
+    }
+
+  munmap (image, cache.st_size);
+
+  if (!status)
+    {
+      gameset_erase ();
+      gamegroup_erase ();
+    }
+
+  return status;
+}
+
+
+/*
+ * cache_add_string()
+ *
+ * Append a string to the string table under construction, returning its
+ * offset, or CACHE_NO_STRING for NULL.
+ */
+static uint32_t
+cache_add_string (cache_strings_t *table, const char *string)
+{
+  uint32_t offset, length;
+
+  if (!string)
+    return CACHE_NO_STRING;
+
+  length = strlen (string) + 1;
+  if (table->size + length > table->allocation)
+    {
+      while (table->size + length > table->allocation)
+        table->allocation = table->allocation == 0
+                            ? 4096 : table->allocation << 1;
+
+      table->data = memory_realloc (table->data, table->allocation);
+    }
+
+  offset = table->size;
+  memcpy (table->data + offset, string, length);
+  table->size += length;
+
+  return offset;
+}
+
+
+/*
+ * cache_save_catalog()
+ *
+ * Write the games and groups sets built from a catalog file into its
+ * compiled cache.  The cache is written to a temporary file and renamed
+ * into place, so that a concurrent or interrupted writer never leaves a
+ * partial cache for a reader.
+ */
+void
+cache_save_catalog (const char *meta_file)
+{
+  struct stat source;
+  cache_header_t header;
+  cache_strings_t table;
+  vectorref_t games, groups, nodes;
+  gameref_t game;
+  groupref_t group;
+  glui32 game_count, group_count, first_group_id, id;
+  char *filename, *temporary;
+  FILE *stream;
+  int fd, status;
+
+  if (stat (meta_file, &source) == -1)
+    return;
+
+  memset (&table, 0, sizeof (table));
+  games = vector_create (sizeof (cache_game_t));
+  groups = vector_create (sizeof (cache_group_t));
+  nodes = vector_create (sizeof (uint32_t));
+
+  /* Games have ids from zero, groups contiguous ids from the oldest. */
+  game_count = 0;
+  for (game = gameset_iterate (NULL); game; game = gameset_iterate (game))
+    game_count++;
+
+  group_count = 0;
+  first_group_id = 0;
+  for (group = gamegroup_iterate (NULL); group;
+       group = gamegroup_iterate (group))
+    {
+      first_group_id = gamegroup_get_group_id (group);
+      group_count++;
+    }
+
+  for (id = 0; id < game_count; id++)
+    {
+      const char *about, *author, *byline, *description, *genre,
+                 *headline, *length, *publisher, *release_date,
+                 *title, *version;
+      cache_game_t record;
+
+      game = gameset_id_to_game (id);
+      gameset_get_game (game, &about, &author, &byline, &description,
+                        &genre, &headline, &length, &publisher,
+                        &release_date, &title, &version);
+
+      record.strings[0] = cache_add_string (&table, about);
+      record.strings[1] = cache_add_string (&table,
+                                            gameset_get_game_ifid (game));
+      record.strings[2] = cache_add_string (&table, author);
+      record.strings[3] = cache_add_string (&table, byline);
+      record.strings[4] = cache_add_string (&table, description);
+      record.strings[5] = cache_add_string (&table, genre);
+      record.strings[6] = cache_add_string (&table, headline);
+      record.strings[7] = cache_add_string (&table, length);
+      record.strings[8] = cache_add_string (&table, publisher);
+      record.strings[9] = cache_add_string (&table, release_date);
+      record.strings[10] = cache_add_string (&table, title);
+      record.strings[11] = cache_add_string (&table, version);
+      vector_append (games, &record);
+    }
+
+  for (id = 0; id < group_count; id++)
+    {
+      const char *about, *title, *description;
+      cache_group_t record;
+      noderef_t node;
+
+      group = gamegroup_id_to_group (first_group_id + id);
+      gamegroup_get_group (group, &about, &title, &description);
+
+      record.about = cache_add_string (&table, about);
+      record.title = cache_add_string (&table, title);
+      record.description = cache_add_string (&table, description);
+      record.first_node = vector_get_length (nodes);
+
+      for (node = gamegroup_iterate_group (group, NULL);
+           node; node = gamegroup_iterate_group (group, node))
+        {
+          uint32_t node_id;
+
+          if (gamegroup_is_node_game (node))
+            node_id = gameset_get_game_id (gamegroup_get_node_game (node));
+          else
+            node_id = gamegroup_get_group_id (gamegroup_get_node_group (node));
+          vector_append (nodes, &node_id);
+        }
+
+      record.node_count = vector_get_length (nodes) - record.first_node;
+      vector_append (groups, &record);
+    }
+
+  /* The string table always holds at least a terminating NUL. */
+  cache_add_string (&table, "");
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, CACHE_MAGIC, sizeof (CACHE_MAGIC));
+  header.byte_order = CACHE_BYTE_ORDER;
+  header.game_count = game_count;
+  header.group_count = group_count;
+  header.node_count = vector_get_length (nodes);
+  header.strings_size = table.size;
+  header.download_hash = cache_get_download_hash ();
+  header.source_size = source.st_size;
+  header.source_mtime = source.st_mtim.tv_sec;
+  header.source_mtime_nsec = source.st_mtim.tv_nsec;
+
+  filename = cache_get_filename (meta_file);
+  temporary = memory_malloc (strlen (filename) + 8);
+  sprintf (temporary, "%s.XXXXXX", filename);
+
+  status = FALSE;
+  stream = NULL;
+  fd = mkstemp (temporary);
+  if (fd != -1)
+    {
+      stream = fdopen (fd, "wb");
+      if (!stream)
+        close (fd);
+    }
+
+  if (stream)
+    {
+      status = fwrite (&header, sizeof (header), 1, stream) == 1;
+      if (status && game_count > 0)
+        status = fwrite (vector_get_address (games, 0),
+                         sizeof (cache_game_t), game_count, stream)
+                 == game_count;
+      if (status && group_count > 0)
+        status = fwrite (vector_get_address (groups, 0),
+                         sizeof (cache_group_t), group_count, stream)
+                 == group_count;
+      if (status && header.node_count > 0)
+        status = fwrite (vector_get_address (nodes, 0),
+                         sizeof (uint32_t), header.node_count, stream)
+                 == header.node_count;
+      if (status)
+        status = fwrite (table.data, 1, table.size, stream) == table.size;
+
+      status = (fclose (stream) == 0) && status;
+      if (status)
+        {
+          chmod (temporary, 0644);
+          status = rename (temporary, filename) == 0;
+        }
+
+      if (!status)
+        unlink (temporary);
+    }
+
+  memory_free (temporary);
+  memory_free (filename);
+  memory_free (table.data);
+  vector_destroy (games);
+  vector_destroy (groups);
+  vector_destroy (nodes);
+}
@@ -0,0 +1,139 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2006-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "protos.h"
+
+
+/*
+ * Catalog strings are held in ISO 8859-1, so sort keys fold its accented
+ * letters to their unaccented lower case forms, and its ligatures and other
+ * special letters to their usual transliterations, so that "Émile" sorts
+ * with "Emile" rather than after "Zork".  Entries are for characters 0xc0
+ * to 0xff; NULL entries, the multiplication and division signs, are kept
+ * as themselves.
+ */
+static const unsigned char COLLATE_LATIN1_BASE = 0xc0;
+static const char *const COLLATE_LATIN1_FOLDS[64] = {
+  "a", "a", "a", "a", "a", "a", "ae", "c",
+  "e", "e", "e", "e", "i", "i", "i", "i",
+  "d", "n", "o", "o", "o", "o", "o", NULL,
+  "o", "u", "u", "u", "u", "y", "th", "ss",
+  "a", "a", "a", "a", "a", "a", "ae", "c",
+  "e", "e", "e", "e", "i", "i", "i", "i",
+  "d", "n", "o", "o", "o", "o", "o", NULL,
+  "o", "u", "u", "u", "u", "y", "th", "y"
+};
+
+/* Leading articles ignored when sorting titles. */
+static const char *const COLLATE_ARTICLES[] = { "the ", "an ", "a ", NULL };
+
+
+/*
+ * collate_is_alnum()
+ *
+ * Return TRUE if an ISO 8859-1 character is a letter or digit.
+ */
+static int
+collate_is_alnum (unsigned char character)
+{
+  return (character < 0x80 && isalnum (character))
+         || (character >= COLLATE_LATIN1_BASE && character != 0xd7
+             && character != 0xf7);
+}
+
+
+/*
+ * collate_create_key()
+ *
+ * Return a malloc'ed sort key for an ISO 8859-1 string, or NULL if the
+ * string is NULL.  Keys are case and accent folded, with leading punctuation
+ * and spaces removed and internal white space collapsed to single spaces, so
+ * that plain strcmp() orders them.  For titles, a leading "The", "An", or
+ * "A" is also removed, unless it is all the title has.
+ */
+char *
+collate_create_key (const char *string, int is_title)
+{
+  const unsigned char *source;
+  char *key, *cursor;
+  int is_space, article;
+
+  if (!string)
+    return NULL;
+
+  /* Each character folds to at most two. */
+  key = memory_malloc (2 * strlen (string) + 1);
+  cursor = key;
+
+  for (source = (const unsigned char *) string;
+       *source && !collate_is_alnum (*source); source++)
+    ;
+
+  is_space = FALSE;
+  for (; *source; source++)
+    {
+      if (isspace (*source))
+        {
+          is_space = TRUE;
+          continue;
+        }
+
+      if (is_space)
+        {
+          *cursor++ = ' ';
+          is_space = FALSE;
+        }
+
+      if (*source >= COLLATE_LATIN1_BASE
+          && COLLATE_LATIN1_FOLDS[*source - COLLATE_LATIN1_BASE])
+        {
+          const char *fold;
+
+          fold = COLLATE_LATIN1_FOLDS[*source - COLLATE_LATIN1_BASE];
+          while (*fold)
+            *cursor++ = *fold++;
+        }
+      else
+        *cursor++ = *source < 0x80 ? tolower (*source) : *source;
+    }
+  *cursor = '\0';
+
+  if (is_title)
+    {
+      for (article = 0; COLLATE_ARTICLES[article]; article++)
+        {
+          size_t length;
+
+          length = strlen (COLLATE_ARTICLES[article]);
+          if (strncmp (key, COLLATE_ARTICLES[article], length) == 0
+              && key[length] != '\0')
+            {
+              memmove (key, key + length, strlen (key + length) + 1);
+              break;
+            }
+        }
+    }
+
+  return key;
+}
@@ -0,0 +1,1089 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2006-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "protos.h"
+
+
+/*
+ * Cataloging a directory walks its tree on the main thread, and hands files
+ * in batches to a pool of worker threads for identification.  Files are
+ * opened and closed only on the main thread, since IFP's interception of
+ * open() and close() for plugins is not thread-safe; workers only pread()
+ * the descriptors they are given.  Games are added to the game set as each
+ * batch completes, and each directory holding games becomes a group.
+ *
+ * What was learned about each file is cached in the top directory, keyed by
+ * device and inode, and checked against size and modification time, so that
+ * rescans open only files that are new or changed.  The cache is discarded
+ * whenever the set of interpreters changes.
+ */
+enum {
+  DIR_MAX_DEPTH = 16,
+  DIR_BATCH_SIZE = 64,
+  DIR_MAX_WORKERS = 8
+};
+static const char *const DIR_CACHE_NAME = ".gamebox.cache";
+static const char *const DIR_CACHE_MAGIC = "GAMEBOX_DIRCACHE_1";
+static const char *const DIR_SIDECAR_EXTENSION = ".iFiction";
+
+/* Game properties held for each cached file, in gameset_add_game order. */
+enum {
+  DIR_IFID, DIR_AUTHOR, DIR_BYLINE, DIR_DESCRIPTION, DIR_GENRE,
+  DIR_HEADLINE, DIR_LENGTH, DIR_PUBLISHER, DIR_RELEASE_DATE, DIR_TITLE,
+  DIR_VERSION, DIR_FIELD_COUNT
+};
+
+/* Cached file record; engine is NULL for files that are not games. */
+typedef struct {
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  time_t mtime;
+  long mtime_nsec;
+  time_t sidecar_mtime;
+  int is_seen;
+  char *engine;
+  char *fields[DIR_FIELD_COUNT];
+} dir_record_t;
+
+/*
+ * Records are held in a vector, indexed by an open addressed hash table on
+ * device and inode, whose slots hold record index plus one, zero if empty.
+ */
+static vectorref_t dir_records = NULL;
+static int *dir_record_table = NULL;
+static int dir_record_table_size = 0;
+static glui32 dir_signature = 0;
+static int dir_is_parsed = FALSE;
+
+/* Identification job for one file, and the pool's shared state. */
+typedef struct {
+  char *path;
+  struct stat status;
+  time_t sidecar_mtime;
+  int fd;
+  int is_game;
+  const char *engine_name;
+  char *ifid, *title, *author, *metadata;
+  int metadata_length;
+} dir_job_t;
+
+typedef struct {
+  dir_job_t *jobs;
+  int count;
+  int next;
+} dir_pool_t;
+
+
+/*
+ * dir_join()
+ *
+ * Return a malloc'ed path formed from a directory and a name within it.
+ */
+static char *
+dir_join (const char *directory, const char *name)
+{
+  char *path;
+  size_t length;
+
+  length = strlen (directory);
+  path = memory_malloc (length + strlen (name) + 2);
+  strcpy (path, directory);
+  if (length == 0 || directory[length - 1] != '/')
+    strcat (path, "/");
+  strcat (path, name);
+
+  return path;
+}
+
+
+/*
+ * dir_get_sidecar()
+ * dir_get_sidecar_mtime()
+ *
+ * Return a malloc'ed path for the iFiction file that may sit alongside a
+ * game, the game's path with its extension replaced by ".iFiction", and
+ * return that file's modification time, or zero if there is no such file.
+ */
+static char *
+dir_get_sidecar (const char *path)
+{
+  const char *extension, *slash;
+  char *sidecar;
+  size_t length;
+
+  extension = strrchr (path, '.');
+  slash = strrchr (path, '/');
+  length = extension && (!slash || extension > slash)
+           ? (size_t) (extension - path) : strlen (path);
+
+  sidecar = memory_malloc (length + strlen (DIR_SIDECAR_EXTENSION) + 1);
+  memcpy (sidecar, path, length);
+  strcpy (sidecar + length, DIR_SIDECAR_EXTENSION);
+
+  return sidecar;
+}
+
+static time_t
+dir_get_sidecar_mtime (const char *path)
+{
+  struct stat status;
+  char *sidecar;
+  time_t mtime;
+
+  sidecar = dir_get_sidecar (path);
+  mtime = stat (sidecar, &status) == 0 && S_ISREG (status.st_mode)
+          ? status.st_mtime : 0;
+  memory_free (sidecar);
+
+  return mtime;
+}
+
+
+/*
+ * dir_is_sidecar()
+ *
+ * Return TRUE if a file name is that of an iFiction file.
+ */
+static int
+dir_is_sidecar (const char *name)
+{
+  const char *extension;
+
+  extension = strrchr (name, '.');
+  return extension && strcasecmp (extension, DIR_SIDECAR_EXTENSION) == 0;
+}
+
+
+/*
+ * dir_create_title()
+ *
+ * Return a malloc'ed title for a game with no metadata, made from its file
+ * name without extension, and with underscores shown as spaces.
+ */
+static char *
+dir_create_title (const char *path)
+{
+  const char *name, *extension;
+  char *title, *cursor;
+  size_t length;
+
+  name = strrchr (path, '/');
+  name = name ? name + 1 : path;
+
+  extension = strrchr (name, '.');
+  length = extension && extension > name
+           ? (size_t) (extension - name) : strlen (name);
+
+  title = memory_malloc (length + 1);
+  memcpy (title, name, length);
+  title[length] = '\0';
+
+  for (cursor = title; *cursor; cursor++)
+    {
+      if (*cursor == '_')
+        *cursor = ' ';
+    }
+
+  return title;
+}
+
+
+/*
+ * dir_compute_signature()
+ *
+ * Return a digest of the interpreters discovered, their versions and the
+ * patterns they accept, so that a change in interpreters can invalidate
+ * cached identifications.
+ */
+static glui32
+dir_compute_signature (void)
+{
+  terpref_t terp;
+  glui32 signature;
+
+  signature = 0;
+  for (terp = terps_iterate (NULL); terp; terp = terps_iterate (terp))
+    {
+      int version, acceptor_offset, acceptor_length, index_;
+      const char *build_timestamp, *engine_type, *engine_name,
+                 *engine_version, *blorb_pattern, *acceptor_pattern,
+                 *author_name, *author_email, *engine_home_url,
+                 *builder_name, *builder_email, *engine_description,
+                 *engine_copyright;
+      const char *strings[5];
+
+      terps_get_interpreter (terp, &version, &build_timestamp, &engine_type,
+                             &engine_name, &engine_version, &blorb_pattern,
+                             &acceptor_offset, &acceptor_length,
+                             &acceptor_pattern, &author_name, &author_email,
+                             &engine_home_url, &builder_name, &builder_email,
+                             &engine_description, &engine_copyright);
+
+      strings[0] = engine_type;
+      strings[1] = engine_name;
+      strings[2] = engine_version;
+      strings[3] = blorb_pattern;
+      strings[4] = acceptor_pattern;
+      for (index_ = 0; index_ < 5; index_++)
+        signature = signature * 31 + hash (strings[index_]
+                                           ? strings[index_] : "");
+
+      signature = signature * 31 + acceptor_offset;
+      signature = signature * 31 + acceptor_length;
+    }
+
+  return signature;
+}
+
+
+/*
+ * dir_record_hash()
+ * dir_record_find()
+ * dir_record_insert()
+ *
+ * Find a cached file record by device and inode, and add a new record.
+ */
+static unsigned long
+dir_record_hash (dev_t device, ino_t inode)
+{
+  unsigned long long key;
+
+  key = (unsigned long long) inode * 0x9e3779b97f4a7c15ULL
+        ^ (unsigned long long) device;
+  return (unsigned long) (key ^ (key >> 32));
+}
+
+static dir_record_t *
+dir_record_find (dev_t device, ino_t inode)
+{
+  unsigned long slot;
+
+  if (dir_record_table_size == 0)
+    return NULL;
+
+  for (slot = dir_record_hash (device, inode) & (dir_record_table_size - 1);
+       dir_record_table[slot] != 0;
+       slot = (slot + 1) & (dir_record_table_size - 1))
+    {
+      dir_record_t *record;
+
+      vector_get (dir_records, dir_record_table[slot] - 1, &record);
+      if (record->device == device && record->inode == inode)
+        return record;
+    }
+
+  return NULL;
+}
+
+static void
+dir_record_insert (dir_record_t *record)
+{
+  unsigned long slot;
+  int count;
+
+  if (!dir_records)
+    dir_records = vector_create (sizeof (record));
+  count = vector_append (dir_records, &record) + 1;
+
+  /* Keep the table at most half full, rebuilding it when growing. */
+  if (2 * count > dir_record_table_size)
+    {
+      int index_;
+
+      memory_free (dir_record_table);
+      dir_record_table_size = dir_record_table_size > 0
+                              ? 2 * dir_record_table_size : 256;
+      dir_record_table = memory_malloc (dir_record_table_size
+                                        * sizeof (*dir_record_table));
+      memset (dir_record_table, 0,
+              dir_record_table_size * sizeof (*dir_record_table));
+
+      for (index_ = 0; index_ < count; index_++)
+        {
+          dir_record_t *entry;
+
+          vector_get (dir_records, index_, &entry);
+          for (slot = dir_record_hash (entry->device, entry->inode)
+                      & (dir_record_table_size - 1);
+               dir_record_table[slot] != 0;
+               slot = (slot + 1) & (dir_record_table_size - 1))
+            ;
+          dir_record_table[slot] = index_ + 1;
+        }
+      return;
+    }
+
+  for (slot = dir_record_hash (record->device, record->inode)
+              & (dir_record_table_size - 1);
+       dir_record_table[slot] != 0;
+       slot = (slot + 1) & (dir_record_table_size - 1))
+    ;
+  dir_record_table[slot] = count;
+}
+
+
+/*
+ * dir_record_clear()
+ * dir_free_records()
+ *
+ * Free the strings of a record, and free all records.
+ */
+static void
+dir_record_clear (dir_record_t *record)
+{
+  int field;
+
+  memory_free (record->engine);
+  record->engine = NULL;
+
+  for (field = 0; field < DIR_FIELD_COUNT; field++)
+    {
+      memory_free (record->fields[field]);
+      record->fields[field] = NULL;
+    }
+}
+
+static void
+dir_free_records (void)
+{
+  if (dir_records)
+    {
+      int index_;
+
+      for (index_ = 0; index_ < vector_get_length (dir_records); index_++)
+        {
+          dir_record_t *record;
+
+          vector_get (dir_records, index_, &record);
+          dir_record_clear (record);
+          memory_free (record);
+        }
+
+      vector_destroy (dir_records);
+      dir_records = NULL;
+    }
+
+  memory_free (dir_record_table);
+  dir_record_table = NULL;
+  dir_record_table_size = 0;
+}
+
+
+/*
+ * dir_record_is_current()
+ *
+ * Return TRUE if a record still describes a file and its iFiction file.
+ */
+static int
+dir_record_is_current (const dir_record_t *record,
+                       const struct stat *status, time_t sidecar_mtime)
+{
+  return record->size == status->st_size
+         && record->mtime == status->st_mtim.tv_sec
+         && record->mtime_nsec == status->st_mtim.tv_nsec
+         && record->sidecar_mtime == sidecar_mtime;
+}
+
+
+/*
+ * dir_write_field()
+ * dir_read_field()
+ *
+ * Write a cache field with tabs, newlines, and backslashes escaped, empty
+ * for NULL, and unescape one in place, returning a malloc'ed copy, or NULL
+ * if the field is empty.
+ */
+static void
+dir_write_field (FILE *stream, const char *field)
+{
+  const char *cursor;
+
+  fputc ('\t', stream);
+  for (cursor = field ? field : ""; *cursor; cursor++)
+    {
+      switch (*cursor)
+        {
+        case '\\':
+          fputs ("\\\\", stream);
+          break;
+        case '\t':
+          fputs ("\\t", stream);
+          break;
+        case '\n':
+          fputs ("\\n", stream);
+          break;
+        default:
+          fputc (*cursor, stream);
+          break;
+        }
+    }
+}
+
+static char *
+dir_read_field (char *field)
+{
+  char *source, *destination;
+
+  if (field[0] == '\0')
+    return NULL;
+
+  for (source = destination = field; *source; source++)
+    {
+      if (*source == '\\' && source[1] != '\0')
+        {
+          source++;
+          *destination++ = *source == 't' ? '\t'
+                           : (*source == 'n' ? '\n' : *source);
+        }
+      else
+        *destination++ = *source;
+    }
+  *destination = '\0';
+
+  return memory_strdup (field);
+}
+
+
+/*
+ * dir_load_cache()
+ *
+ * Read cached file records from the given cache file, if it exists and was
+ * written with the current interpreters.  Malformed lines are ignored.
+ */
+static void
+dir_load_cache (const char *cache_file)
+{
+  enum { IDENTITY_COLUMNS = 6, COLUMNS = IDENTITY_COLUMNS + 1
+                                         + DIR_FIELD_COUNT };
+  FILE *stream;
+  char *line, magic[32];
+  size_t allocation;
+  unsigned long signature;
+
+  stream = fopen (cache_file, "r");
+  if (!stream)
+    return;
+
+  if (fscanf (stream, "%31s %lx\n", magic, &signature) != 2
+      || strcmp (magic, DIR_CACHE_MAGIC) != 0
+      || (glui32) signature != dir_signature)
+    {
+      fclose (stream);
+      return;
+    }
+
+  line = NULL;
+  allocation = 0;
+  while (getline (&line, &allocation, stream) != -1)
+    {
+      char *columns[COLUMNS], *cursor;
+      dir_record_t *record;
+      int column, field;
+
+      cursor = line;
+      cursor[strcspn (cursor, "\n")] = '\0';
+      for (column = 0; column < COLUMNS && cursor; column++)
+        {
+          columns[column] = cursor;
+          cursor = strchr (cursor, '\t');
+          if (cursor)
+            *cursor++ = '\0';
+        }
+      if (column < COLUMNS || cursor)
+        continue;
+
+      record = memory_malloc (sizeof (*record));
+      record->device = strtoull (columns[0], NULL, 10);
+      record->inode = strtoull (columns[1], NULL, 10);
+      record->size = strtoll (columns[2], NULL, 10);
+      record->mtime = strtoll (columns[3], NULL, 10);
+      record->mtime_nsec = strtol (columns[4], NULL, 10);
+      record->sidecar_mtime = strtoll (columns[5], NULL, 10);
+      record->is_seen = FALSE;
+
+      record->engine = dir_read_field (columns[IDENTITY_COLUMNS]);
+      for (field = 0; field < DIR_FIELD_COUNT; field++)
+        {
+          record->fields[field] =
+              dir_read_field (columns[IDENTITY_COLUMNS + 1 + field]);
+        }
+
+      if (dir_record_find (record->device, record->inode))
+        {
+          dir_record_clear (record);
+          memory_free (record);
+        }
+      else
+        dir_record_insert (record);
+    }
+
+  free (line);
+  fclose (stream);
+}
+
+
+/*
+ * dir_save_cache()
+ *
+ * Write the records for files seen in this catalog to the cache file,
+ * through a temporary file renamed into place.  Failure to write is not an
+ * error; the directory may simply not be writable.
+ */
+static void
+dir_save_cache (const char *cache_file)
+{
+  char *temporary;
+  FILE *stream;
+  int fd, status, index_;
+
+  temporary = memory_malloc (strlen (cache_file) + 8);
+  sprintf (temporary, "%s.XXXXXX", cache_file);
+
+  stream = NULL;
+  fd = mkstemp (temporary);
+  if (fd != -1)
+    {
+      stream = fdopen (fd, "w");
+      if (!stream)
+        {
+          close (fd);
+          unlink (temporary);
+        }
+    }
+
+  if (stream)
+    {
+      fprintf (stream, "%s %08lx\n",
+               DIR_CACHE_MAGIC, (unsigned long) dir_signature);
+
+      for (index_ = 0; dir_records
+                       && index_ < vector_get_length (dir_records); index_++)
+        {
+          dir_record_t *record;
+          int field;
+
+          vector_get (dir_records, index_, &record);
+          if (!record->is_seen)
+            continue;
+
+          fprintf (stream, "%llu\t%llu\t%lld\t%lld\t%ld\t%lld",
+                   (unsigned long long) record->device,
+                   (unsigned long long) record->inode,
+                   (long long) record->size, (long long) record->mtime,
+                   record->mtime_nsec, (long long) record->sidecar_mtime);
+
+          dir_write_field (stream, record->engine);
+          for (field = 0; field < DIR_FIELD_COUNT; field++)
+            dir_write_field (stream, record->fields[field]);
+          fputc ('\n', stream);
+        }
+
+      status = !ferror (stream);
+      status = (fclose (stream) == 0) && status;
+      if (status)
+        {
+          chmod (temporary, 0644);
+          status = rename (temporary, cache_file) == 0;
+        }
+
+      if (!status)
+        unlink (temporary);
+    }
+
+  memory_free (temporary);
+}
+
+
+/*
+ * dir_add_record_game()
+ *
+ * Add a game to the game set from a cached record, unless a game with this
+ * location is already known.
+ */
+static void
+dir_add_record_game (const char *location, const dir_record_t *record)
+{
+  char *const *fields;
+
+  if (gameset_find_game (location))
+    return;
+
+  fields = record->fields;
+  gameset_add_game (location, fields[DIR_IFID], fields[DIR_AUTHOR],
+                    fields[DIR_BYLINE], fields[DIR_DESCRIPTION],
+                    fields[DIR_GENRE], fields[DIR_HEADLINE],
+                    fields[DIR_LENGTH], fields[DIR_PUBLISHER],
+                    fields[DIR_RELEASE_DATE], fields[DIR_TITLE],
+                    fields[DIR_VERSION]);
+}
+
+
+/*
+ * dir_add_identified_game()
+ *
+ * Add a newly identified game to the game set.  Properties come from any
+ * iFiction metadata inside a Blorb file or alongside the game, otherwise
+ * from what identification found in the story itself, with the file name
+ * standing in for a missing title.
+ */
+static void
+dir_add_identified_game (const dir_job_t *job)
+{
+  const char *location;
+  int is_added;
+
+  location = job->path;
+  if (gameset_find_game (location))
+    return;
+
+  is_added = FALSE;
+  if (job->metadata)
+    is_added = xml_parse_story_buffer (job->metadata,
+                                       job->metadata_length, location);
+
+  if (!is_added && job->sidecar_mtime != 0)
+    {
+      char *sidecar;
+
+      sidecar = dir_get_sidecar (location);
+      is_added = xml_parse_story_file (sidecar, location);
+      memory_free (sidecar);
+    }
+
+  if (!is_added)
+    {
+      char *title, *author;
+
+      title = job->title
+              ? utf_utf8_to_iso8859 ((const unsigned char *) job->title)
+              : dir_create_title (location);
+      author = job->author
+               ? utf_utf8_to_iso8859 ((const unsigned char *) job->author)
+               : NULL;
+
+      gameset_add_game (location, job->ifid, author, NULL, NULL, NULL, NULL,
+                        NULL, NULL, NULL, title, NULL);
+
+      memory_free (title);
+      memory_free (author);
+    }
+}
+
+
+/*
+ * dir_update_record()
+ *
+ * Record what is now known about a file identified, taking game properties
+ * back from the game set so that a later rescan needs no identification.
+ */
+static void
+dir_update_record (const dir_job_t *job)
+{
+  dir_record_t *record;
+
+  record = dir_record_find (job->status.st_dev, job->status.st_ino);
+  if (record)
+    dir_record_clear (record);
+  else
+    {
+      record = memory_malloc (sizeof (*record));
+      memset (record, 0, sizeof (*record));
+      record->device = job->status.st_dev;
+      record->inode = job->status.st_ino;
+      dir_record_insert (record);
+    }
+
+  record->size = job->status.st_size;
+  record->mtime = job->status.st_mtim.tv_sec;
+  record->mtime_nsec = job->status.st_mtim.tv_nsec;
+  record->sidecar_mtime = job->sidecar_mtime;
+  record->is_seen = TRUE;
+
+  if (job->is_game)
+    {
+      gameref_t game;
+
+      game = gameset_find_game (job->path);
+      if (game)
+        {
+          const char *about, *values[DIR_FIELD_COUNT];
+          int field;
+
+          gameset_get_game (game, &about, values + DIR_AUTHOR,
+                            values + DIR_BYLINE, values + DIR_DESCRIPTION,
+                            values + DIR_GENRE, values + DIR_HEADLINE,
+                            values + DIR_LENGTH, values + DIR_PUBLISHER,
+                            values + DIR_RELEASE_DATE, values + DIR_TITLE,
+                            values + DIR_VERSION);
+          values[DIR_IFID] = gameset_get_game_ifid (game);
+
+          record->engine = memory_strdup (job->engine_name);
+          for (field = 0; field < DIR_FIELD_COUNT; field++)
+            record->fields[field] = memory_strdup (values[field]);
+        }
+    }
+}
+
+
+/*
+ * dir_identify_worker()
+ * dir_identify_files()
+ *
+ * Identify a batch of opened files in parallel.  The calling thread works
+ * alongside the pool, and on a single processor does all the work.
+ */
+static void *
+dir_identify_worker (void *argument)
+{
+  dir_pool_t *pool;
+  int index_;
+
+  pool = argument;
+  for (index_ = __atomic_fetch_add (&pool->next, 1, __ATOMIC_RELAXED);
+       index_ < pool->count;
+       index_ = __atomic_fetch_add (&pool->next, 1, __ATOMIC_RELAXED))
+    {
+      dir_job_t *job;
+
+      job = pool->jobs + index_;
+      if (job->fd != -1)
+        job->is_game = identify_file (job->fd, job->status.st_size,
+                                      &job->engine_name, &job->ifid,
+                                      &job->title, &job->author,
+                                      &job->metadata, &job->metadata_length);
+    }
+
+  return NULL;
+}
+
+static void
+dir_identify_files (dir_job_t *jobs, int count)
+{
+  dir_pool_t pool;
+  pthread_t workers[DIR_MAX_WORKERS];
+  long processors;
+  int worker_count, started, index_;
+
+  pool.jobs = jobs;
+  pool.count = count;
+  pool.next = 0;
+
+  processors = sysconf (_SC_NPROCESSORS_ONLN);
+  worker_count = processors > DIR_MAX_WORKERS
+                 ? DIR_MAX_WORKERS : (processors > 0 ? processors : 1);
+  if (worker_count > count)
+    worker_count = count;
+
+  started = 0;
+  for (index_ = 1; index_ < worker_count; index_++)
+    {
+      if (pthread_create (workers + started, NULL,
+                          dir_identify_worker, &pool) == 0)
+        started++;
+    }
+
+  dir_identify_worker (&pool);
+
+  for (index_ = 0; index_ < started; index_++)
+    pthread_join (workers[index_], NULL);
+}
+
+
+/*
+ * dir_run_batch()
+ *
+ * Open a batch of files, identify them, close them, and add the games found
+ * to the game set, noting their locations for the directory's group.
+ */
+static void
+dir_run_batch (dir_job_t *jobs, int count,
+               vectorref_t locations, int dump_document)
+{
+  int index_;
+
+  for (index_ = 0; index_ < count; index_++)
+    jobs[index_].fd = open (jobs[index_].path, O_RDONLY | O_CLOEXEC);
+
+  dir_identify_files (jobs, count);
+
+  for (index_ = 0; index_ < count; index_++)
+    {
+      dir_job_t *job;
+
+      job = jobs + index_;
+      if (job->fd != -1)
+        {
+          close (job->fd);
+
+          if (job->is_game)
+            {
+              dir_add_identified_game (job);
+              if (dump_document)
+                fprintf (stderr, "%s: %s\n", job->engine_name, job->path);
+            }
+          dir_update_record (job);
+        }
+
+      /* The group takes ownership of game paths. */
+      if (job->fd != -1 && job->is_game)
+        vector_append (locations, &job->path);
+      else
+        memory_free (job->path);
+
+      memory_free (job->ifid);
+      memory_free (job->title);
+      memory_free (job->author);
+      memory_free (job->metadata);
+    }
+}
+
+
+/*
+ * dir_filter_entry()
+ *
+ * Filter for directory entries, skipping hidden files, among them "." and
+ * "..", and the catalog cache.
+ */
+static int
+dir_filter_entry (const struct dirent *entry)
+{
+  return entry->d_name[0] != '.';
+}
+
+
+/*
+ * dir_catalog_directory()
+ *
+ * Catalog the games in a directory, and recursively in its subdirectories,
+ * returning a group holding the games and the groups of subdirectories, or
+ * NULL if none of these hold games.  Files with a current cache record are
+ * added directly; others are identified in batches.  Symbolic links to files
+ * are followed, but links to directories are not, to avoid loops.
+ */
+static groupref_t
+dir_catalog_directory (const char *directory, int depth, int dump_document)
+{
+  struct dirent **entries;
+  vectorref_t locations, subdirectories, children;
+  dir_job_t *jobs;
+  groupref_t group;
+  int count, job_count, index_;
+
+  count = scandir (directory, &entries, dir_filter_entry, alphasort);
+  if (count < 0)
+    return NULL;
+
+  locations = vector_create (sizeof (char *));
+  subdirectories = vector_create (sizeof (char *));
+  jobs = memory_malloc (DIR_BATCH_SIZE * sizeof (*jobs));
+  job_count = 0;
+
+  for (index_ = 0; index_ < count; index_++)
+    {
+      struct stat status;
+      dir_record_t *record;
+      time_t sidecar_mtime;
+      dir_job_t *job;
+      char *path;
+
+      path = dir_join (directory, entries[index_]->d_name);
+      if (lstat (path, &status) == -1
+          || (S_ISLNK (status.st_mode)
+              && (stat (path, &status) == -1 || S_ISDIR (status.st_mode))))
+        {
+          memory_free (path);
+          continue;
+        }
+
+      if (S_ISDIR (status.st_mode) && depth < DIR_MAX_DEPTH)
+        {
+          vector_append (subdirectories, &path);
+          continue;
+        }
+
+      if (!S_ISREG (status.st_mode)
+          || dir_is_sidecar (entries[index_]->d_name))
+        {
+          memory_free (path);
+          continue;
+        }
+
+      /* Use the cached record if current, otherwise queue for a batch. */
+      sidecar_mtime = dir_get_sidecar_mtime (path);
+      record = dir_record_find (status.st_dev, status.st_ino);
+      if (record && dir_record_is_current (record, &status, sidecar_mtime))
+        {
+          record->is_seen = TRUE;
+          if (record->engine)
+            {
+              dir_add_record_game (path, record);
+              if (dump_document)
+                fprintf (stderr, "%s: %s (cached)\n", record->engine, path);
+              vector_append (locations, &path);
+            }
+          else
+            memory_free (path);
+          continue;
+        }
+
+      job = jobs + job_count++;
+      memset (job, 0, sizeof (*job));
+      job->path = path;
+      job->status = status;
+      job->sidecar_mtime = sidecar_mtime;
+      job->fd = -1;
+
+      if (job_count == DIR_BATCH_SIZE)
+        {
+          dir_run_batch (jobs, job_count, locations, dump_document);
+          job_count = 0;
+        }
+    }
+
+  if (job_count > 0)
+    dir_run_batch (jobs, job_count, locations, dump_document);
+  memory_free (jobs);
+
+  for (index_ = 0; index_ < count; index_++)
+    free (entries[index_]);
+  free (entries);
+
+  /* Catalog subdirectories, keeping the groups of those that hold games. */
+  children = vector_create (sizeof (groupref_t));
+  for (index_ = 0; index_ < vector_get_length (subdirectories); index_++)
+    {
+      groupref_t child;
+      char *path;
+
+      vector_get (subdirectories, index_, &path);
+      child = dir_catalog_directory (path, depth + 1, dump_document);
+      if (child)
+        vector_append (children, &child);
+      memory_free (path);
+    }
+  vector_destroy (subdirectories);
+
+  /* Group this directory's games and subdirectory groups, if any. */
+  group = NULL;
+  if (vector_get_length (locations) > 0 || vector_get_length (children) > 0)
+    {
+      const char *title;
+
+      title = strrchr (directory, '/');
+      title = title && title[1] != '\0' ? title + 1 : directory;
+      group = gamegroup_add_group (directory, title, NULL);
+
+      for (index_ = 0; index_ < vector_get_length (locations); index_++)
+        {
+          char *location;
+
+          vector_get (locations, index_, &location);
+          gamegroup_add_game_to_group (group, location);
+        }
+
+      for (index_ = 0; index_ < vector_get_length (children); index_++)
+        {
+          groupref_t child;
+          const char *about, *child_title, *description;
+
+          vector_get (children, index_, &child);
+          gamegroup_get_group (child, &about, &child_title, &description);
+          gamegroup_add_group_to_group (group, about);
+        }
+    }
+
+  for (index_ = 0; index_ < vector_get_length (locations); index_++)
+    {
+      char *location;
+
+      vector_get (locations, index_, &location);
+      memory_free (location);
+    }
+  vector_destroy (locations);
+  vector_destroy (children);
+
+  return group;
+}
+
+
+/*
+ * dir_parse_directory()
+ *
+ * Catalog the games found in a directory tree into the game set, grouped
+ * by directory.  Interpreters are discovered first if not already known,
+ * since identification depends on them.  Returns FALSE if the directory
+ * can't be read.
+ */
+int
+dir_parse_directory (const char *directory, int dump_document)
+{
+  struct stat status;
+  char *cache_file;
+  assert (directory);
+
+  if (stat (directory, &status) == -1 || !S_ISDIR (status.st_mode))
+    return FALSE;
+
+  if (terps_is_empty ())
+    terps_discover ();
+
+  identify_prepare ();
+  dir_signature = dir_compute_signature ();
+
+  cache_file = dir_join (directory, DIR_CACHE_NAME);
+  dir_load_cache (cache_file);
+
+  dir_catalog_directory (directory, 0, dump_document);
+
+  dir_save_cache (cache_file);
+  memory_free (cache_file);
+
+  dir_free_records ();
+  identify_release ();
+
+  dir_is_parsed = TRUE;
+  return TRUE;
+}
+
+
+/*
+ * dir_is_cataloged()
+ *
+ * Return TRUE if a directory has been cataloged.  Directory contents may
+ * change at any time, so such catalogs are not compiled into a cache.
+ */
+int
+dir_is_cataloged (void)
+{
+  return dir_is_parsed;
+}
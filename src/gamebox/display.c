@@ -43,15 +43,20 @@ enum { DISPLAY_ACTION_NULL = -1,
        DISPLAY_INFO_FULL = -8, DISPLAY_INFO_BRIEF = -9,
        DISPLAY_SELECT_GAMES = -10, DISPLAY_SELECT_INTERPRETERS = -11,
        DISPLAY_SELECT_ABOUT = -12,
-       DISPLAY_PRIOR_PAGE = -13, DISPLAY_NEXT_PAGE = -14 };
+       DISPLAY_PRIOR_PAGE = -13, DISPLAY_NEXT_PAGE = -14,
+       DISPLAY_SELECT_SEARCH = -15 };
 
 /* States for display modes and sorting.*/
-enum { PAGE_GAMES, PAGE_INTERPRETERS, PAGE_ABOUT };
+enum { PAGE_GAMES, PAGE_SEARCH, PAGE_INTERPRETERS, PAGE_ABOUT };
 static int display_selected = PAGE_GAMES;
 static int display_games_sort_by = DISPLAY_SORT_BY_TITLE;
 static int display_games_full_brief = DISPLAY_INFO_FULL;
 static int display_interpreters_full_brief = DISPLAY_INFO_FULL;
 
+/* Current search query, edited on the search page. */
+enum { DISPLAY_SEARCH_LENGTH = 64 };
+static char display_search_query[DISPLAY_SEARCH_LENGTH] = "";
+
 /*
  * This module uses a vector to map game/group ids to sequence numbers for
  * menus and hyperlinks.  The mapped value is the vector index as returned
@@ -131,19 +136,19 @@ display_button (int hyperlink, const char *legend, int is_active)
 
   if (strlen (legend) > 1)
     {
-      glk_put_char ('[');
-      glk_set_hyperlink (is_active ? (glui32) hyperlink : 0);
-      glk_c_put_string (legend);
-      glk_set_hyperlink (0);
-      glk_put_char (']');
+      render_put_char ('[');
+      render_set_hyperlink (is_active ? (glui32) hyperlink : 0);
+      render_put_string (legend);
+      render_set_hyperlink (0);
+      render_put_char (']');
     }
   else
     {
-      glk_set_hyperlink (is_active ? (glui32) hyperlink : 0);
-      glk_put_char ('[');
-      glk_c_put_string (legend);
-      glk_put_char (']');
-      glk_set_hyperlink (0);
+      render_set_hyperlink (is_active ? (glui32) hyperlink : 0);
+      render_put_char ('[');
+      render_put_string (legend);
+      render_put_char (']');
+      render_set_hyperlink (0);
     }
 }
 
@@ -181,6 +186,13 @@ display_toolbar (int is_endpoint)
       brief_active = !(full_brief == DISPLAY_INFO_BRIEF);
       break;
 
+    case PAGE_SEARCH:
+      full_brief = display_games_full_brief;
+
+      full_active = !(full_brief == DISPLAY_INFO_FULL);
+      brief_active = !(full_brief == DISPLAY_INFO_BRIEF);
+      break;
+
     case PAGE_INTERPRETERS:
       full_brief = display_interpreters_full_brief;
 
@@ -195,23 +207,25 @@ display_toolbar (int is_endpoint)
   display_button (DISPLAY_ACTION_BACK, "<<", back_active);
   display_button (DISPLAY_ACTION_GOTO, "GoTo", TRUE);
 
-  glk_c_put_string ("  Sort by: ");
+  render_put_string ("  Sort by: ");
   display_button (DISPLAY_SORT_BY_TITLE, "Title", by_title_active);
   display_button (DISPLAY_SORT_BY_AUTHOR, "Author", by_author_active);
   display_button (DISPLAY_SORT_BY_GENRE, "Genre", by_genre_active);
 
-  glk_c_put_string ("  Detail: ");
+  render_put_string ("  Detail: ");
   display_button (DISPLAY_INFO_FULL, "Full", full_active);
   display_button (DISPLAY_INFO_BRIEF, "Brief", brief_active);
 
-  glk_c_put_string ("  ");
+  render_put_string ("  ");
   display_button (DISPLAY_SELECT_GAMES, "Games",
                   !(display_selected == PAGE_GAMES));
+  display_button (DISPLAY_SELECT_SEARCH, "Search",
+                  !(display_selected == PAGE_SEARCH));
   display_button (DISPLAY_SELECT_INTERPRETERS, "Interpreters",
                   !(display_selected == PAGE_INTERPRETERS));
   display_button (DISPLAY_SELECT_ABOUT, "About",
                   !(display_selected == PAGE_ABOUT));
-  glk_put_char ('\n');
+  render_put_char ('\n');
 }
 
 
@@ -275,6 +289,10 @@ display_status (int is_endpoint)
       status_is_endpoint = is_endpoint;
       break;
 
+    case PAGE_SEARCH:
+      glk_c_put_string (" | Search page");
+      break;
+
     case PAGE_INTERPRETERS:
       glk_c_put_string (" | Interpreters page");
 
@@ -307,16 +325,36 @@ display_handle_redraw (void)
 }
 
 
+/*
+ * Key for pages kept for replay by the render module.  It holds everything
+ * that can change a page's content, and only what applies to the selected
+ * page, so that, for example, the interpreters page is kept only once
+ * however the games are sorted.  Window width is not part of the key, as
+ * text buffer windows wrap text themselves.
+ */
+typedef struct {
+  int selected;
+  groupref_t group;
+  int page_number;
+  int sort_by;
+  int full_brief;
+  int has_hyperlinks;
+  int is_endpoint;
+} display_page_key_t;
+
+
 /*
  * display_page()
  *
  * Rebuild the complete window set display to show whatever page is currently
- * selected.
+ * selected.  Pages other than search results are replayed from the render
+ * cache when shown before with the same settings.
  */
 static void
 display_page (const groupref_t group, int page_increment, int is_endpoint)
 {
-  int has_hyperlinks;
+  display_page_key_t key;
+  int has_hyperlinks, page_number;
   assert (group);
 
   has_hyperlinks = glk_gestalt (gestalt_Hyperlinks, 0)
@@ -327,38 +365,125 @@ display_page (const groupref_t group, int page_increment, int is_endpoint)
   else
     display_map = vector_create (sizeof (glui32));
 
+  if (!has_hyperlinks)
+    display_status (is_endpoint);
+
+  page_number = 0;
+  if (display_selected == PAGE_GAMES)
+    page_number = gamepage_turn_page (group, page_increment);
+
+  /* Zero the key first, so that any structure padding compares equal. */
+  memset (&key, 0, sizeof (key));
+  key.selected = display_selected;
+  key.has_hyperlinks = has_hyperlinks;
+  switch (display_selected)
+    {
+    case PAGE_GAMES:
+      key.group = group;
+      key.page_number = page_number;
+      key.sort_by = display_games_sort_by;
+      key.full_brief = display_games_full_brief;
+      key.is_endpoint = is_endpoint;
+      break;
+
+    case PAGE_INTERPRETERS:
+      key.full_brief = display_interpreters_full_brief;
+      break;
+    }
+
+  if (display_selected != PAGE_SEARCH
+      && render_replay (&key, sizeof (key), display_map))
+    return;
+
+  render_begin ();
+
   if (has_hyperlinks)
     display_toolbar (is_endpoint);
-  else
-    display_status (is_endpoint);
 
   switch (display_selected)
     {
     case PAGE_GAMES:
-      glk_set_style (style_Header);
-      glk_c_put_string ("\n\n        Gamebox - Games\n\n");
-      glk_set_style (style_Normal);
+      render_set_style (style_Header);
+      render_put_string ("\n\n        Gamebox - Games\n\n");
+      render_set_style (style_Normal);
 
       gamepage_display (group, display_map,
-                        has_hyperlinks, page_increment, is_endpoint);
+                        has_hyperlinks, page_number, is_endpoint);
+      break;
+
+    case PAGE_SEARCH:
+      render_set_style (style_Header);
+      render_put_string ("\n\n        Gamebox - Search\n\n");
+      render_set_style (style_Normal);
+
+      gamepage_display_search (display_search_query, display_map,
+                               has_hyperlinks, page_increment);
       break;
 
     case PAGE_INTERPRETERS:
-      glk_set_style (style_Header);
-      glk_c_put_string ("\n\n        Gamebox - Interpreters\n\n");
-      glk_set_style (style_Normal);
+      render_set_style (style_Header);
+      render_put_string ("\n\n        Gamebox - Interpreters\n\n");
+      render_set_style (style_Normal);
 
       terppage_display ();
       break;
 
     case PAGE_ABOUT:
-      glk_set_style (style_Header);
-      glk_c_put_string ("\n\n        Gamebox - About\n\n");
-      glk_set_style (style_Normal);
+      render_set_style (style_Header);
+      render_put_string ("\n\n        Gamebox - About\n\n");
+      render_set_style (style_Normal);
 
       aboutpage_display (has_hyperlinks);
       break;
     }
+
+  if (display_selected == PAGE_SEARCH)
+    render_end (NULL, 0, display_map);
+  else
+    render_end (&key, sizeof (key), display_map);
+}
+
+
+/*
+ * display_edit_search_query()
+ *
+ * Apply a keypress on the search page to the search query.  Printable
+ * characters extend the query, Delete removes its last character, and
+ * Escape leaves for the Games page.  Returns TRUE if the keypress was
+ * used, FALSE if it should be handled as an accelerator.
+ */
+static int
+display_edit_search_query (glui32 keycode)
+{
+  size_t length;
+
+  length = strlen (display_search_query);
+
+  if (keycode == keycode_Delete)
+    {
+      if (length > 0)
+        display_search_query[length - 1] = '\0';
+      return TRUE;
+    }
+
+  if (keycode == keycode_Escape)
+    {
+      display_selected = PAGE_GAMES;
+      return TRUE;
+    }
+
+  if ((keycode >= ' ' && keycode <= '~')
+      || (keycode >= 0xa0 && keycode <= 0xff))
+    {
+      if (length < sizeof (display_search_query) - 1)
+        {
+          display_search_query[length] = (char) keycode;
+          display_search_query[length + 1] = '\0';
+        }
+      return TRUE;
+    }
+
+  return FALSE;
 }
 
 
@@ -387,6 +512,13 @@ display_get_user_action_hyperlinks (void)
       glk_select (&event);
       if (event.type == evtype_CharInput)
         {
+          if (display_selected == PAGE_SEARCH
+              && display_edit_search_query (event.val1))
+            {
+              glk_cancel_hyperlink_event (main_window);
+              break;
+            }
+
           switch (event.val1)
             {
             case 'q': case 'Q': case keycode_Escape:
@@ -424,7 +556,7 @@ display_get_user_action_hyperlinks (void)
             case 'f': case 'F': case keycode_Func4:
               switch (display_selected)
                 {
-                case PAGE_GAMES:
+                case PAGE_GAMES: case PAGE_SEARCH:
                   display_games_full_brief = DISPLAY_INFO_FULL;
                   break;
 
@@ -437,7 +569,7 @@ display_get_user_action_hyperlinks (void)
             case 's': case 'S': case keycode_Func5:
               switch (display_selected)
                 {
-                case PAGE_GAMES:
+                case PAGE_GAMES: case PAGE_SEARCH:
                   display_games_full_brief = DISPLAY_INFO_BRIEF;
                   break;
 
@@ -451,6 +583,10 @@ display_get_user_action_hyperlinks (void)
               display_selected = PAGE_GAMES;
               break;
 
+            case '/': case keycode_Func10:
+              display_selected = PAGE_SEARCH;
+              break;
+
             case 'i': case 'I': case keycode_Func3:
               display_selected = PAGE_INTERPRETERS;
               break;
@@ -463,6 +599,10 @@ display_get_user_action_hyperlinks (void)
               switch (display_selected)
                 {
                 case PAGE_GAMES:
+                  display_selected = PAGE_SEARCH;
+                  break;
+
+                case PAGE_SEARCH:
                   display_selected = PAGE_INTERPRETERS;
                   break;
 
@@ -502,7 +642,8 @@ display_get_user_action_hyperlinks (void)
 
             case DISPLAY_INFO_FULL:
             case DISPLAY_INFO_BRIEF:
-              if (display_selected == PAGE_GAMES)
+              if (display_selected == PAGE_GAMES
+                  || display_selected == PAGE_SEARCH)
                 display_games_full_brief = event.val1;
               else
                 display_interpreters_full_brief = event.val1;
@@ -512,6 +653,10 @@ display_get_user_action_hyperlinks (void)
               display_selected = PAGE_GAMES;
               break;
 
+            case DISPLAY_SELECT_SEARCH:
+              display_selected = PAGE_SEARCH;
+              break;
+
             case DISPLAY_SELECT_INTERPRETERS:
               display_selected = PAGE_INTERPRETERS;
               break;
@@ -527,6 +672,8 @@ display_get_user_action_hyperlinks (void)
           glk_cancel_char_event (main_window);
           break;
         }
+      else if (event.type == evtype_Timer)
+        prefetch_handle_timer ();
     }
   while (TRUE);
 
@@ -556,6 +703,8 @@ display_get_user_action_no_hyperlinks (void)
 
       if (display_selected == PAGE_GAMES)
         prompt = "Choose a game or category, or enter 'h' for help: ";
+      else if (display_selected == PAGE_SEARCH)
+        prompt = "Choose a game, '/' and words to search, or 'h' for help: ";
       else
         prompt = "Enter a command, or 'h' for help: ";
 
@@ -622,7 +771,7 @@ display_get_user_action_no_hyperlinks (void)
         case 'f':
           switch (display_selected)
             {
-            case PAGE_GAMES:
+            case PAGE_GAMES: case PAGE_SEARCH:
               display_games_full_brief = DISPLAY_INFO_FULL;
               break;
 
@@ -639,7 +788,7 @@ display_get_user_action_no_hyperlinks (void)
         case 's':
           switch (display_selected)
             {
-            case PAGE_GAMES:
+            case PAGE_GAMES: case PAGE_SEARCH:
               display_games_full_brief = DISPLAY_INFO_BRIEF;
               break;
 
@@ -657,6 +806,13 @@ display_get_user_action_no_hyperlinks (void)
           display_selected = PAGE_GAMES;
           break;
 
+        case '/':
+          strncpy (display_search_query, buffer + 1,
+                   sizeof (display_search_query) - 1);
+          display_search_query[sizeof (display_search_query) - 1] = '\0';
+          display_selected = PAGE_SEARCH;
+          break;
+
         case 'i':
           display_selected = PAGE_INTERPRETERS;
           break;
@@ -669,6 +825,10 @@ display_get_user_action_no_hyperlinks (void)
           switch (display_selected)
             {
             case PAGE_GAMES:
+              display_selected = PAGE_SEARCH;
+              break;
+
+            case PAGE_SEARCH:
               display_selected = PAGE_INTERPRETERS;
               break;
 
@@ -683,7 +843,7 @@ display_get_user_action_no_hyperlinks (void)
           break;
         }
 
-      if (strchr ("qubo-+jktaefsgih?n", first))
+      if (strchr ("qubo-+jktaefsg/ih?n", first))
         {
           buffer[0] = '\0';
           return user_action;
@@ -715,12 +875,18 @@ static glui32
 display_get_user_action (void)
 {
   int has_hyperlinks;
+  glui32 user_action;
 
   has_hyperlinks = glk_gestalt (gestalt_Hyperlinks, 0)
     && glk_gestalt (gestalt_HyperlinkInput, glk_window_get_type (main_window));
 
-  return has_hyperlinks ? display_get_user_action_hyperlinks ()
-                        : display_get_user_action_no_hyperlinks ();
+  /* Prefetch likely games on timer events while waiting for the user. */
+  prefetch_start_timer ();
+  user_action = has_hyperlinks ? display_get_user_action_hyperlinks ()
+                               : display_get_user_action_no_hyperlinks ();
+  prefetch_stop_timer ();
+
+  return user_action;
 }
 
 
@@ -747,6 +913,7 @@ display_attempt_game_run (const char *location)
                             strerror (url_errno));
       return;
     }
+  prefetch_note_played (location);
 
   /* Find, and if found, run a plugin for this location. */
   plugin = ifp_manager_locate_plugin_url (url);
@@ -826,6 +993,7 @@ display_main_loop (void)
                        : user_action == (glui32) DISPLAY_NEXT_PAGE ? 1: 0,
       is_endpoint = vector_get_length (groups) == 0;
       display_page (current_group, page_increment, is_endpoint);
+      prefetch_set_page (display_map);
 
       /* Get user input, and handle any special action values. */
       user_action = display_get_user_action ();
@@ -875,9 +1043,11 @@ display_main_loop (void)
   /*
    * Clean up and return.  Here we need to take care to unload any and all
    * loaded plugins in our loader instance, to avoid the system's runtime
-   * linker reference counts becoming skewed.
+   * linker reference counts becoming skewed.  Also cancel any prefetch
+   * download, before our URL resolver's SIGIO handler is reset.
    */
   ifp_loader_forget_all_plugins ();
+  prefetch_erase ();
 
   vector_destroy (groups);
   if (display_map)
@@ -82,7 +82,13 @@ override_startup_code (int argc, char *argv[])
   else
     return FALSE;
 
-  /* Parse according to the header read in. */
+  /*
+   * Use the compiled cache if it is up to date, otherwise parse according to
+   * the header read in, and refresh the cache from the result.
+   */
+  if (!debug_dump && cache_load_catalog (meta_file))
+    return TRUE;
+
   if (memcmp (header, "<?xml", 5) == 0)
     parse_status = xml_parse_file (meta_file, debug_dump);
 
@@ -100,6 +106,8 @@ override_startup_code (int argc, char *argv[])
       return FALSE;
     }
 
+  if (!dir_is_cataloged ())
+    cache_save_catalog (meta_file);
   return TRUE;
 }
 
@@ -118,8 +126,12 @@ override_startup_code (int argc, char *argv[])
 static void
 override_main (void)
 {
-  /* Discover interpreters, then run the main dialog loop. */
-  terps_discover ();
+  /*
+   * Discover interpreters, unless already done to catalog a directory, then
+   * run the main dialog loop.
+   */
+  if (terps_is_empty ())
+    terps_discover ();
   display_main_loop ();
 
   /* Reset SIGIO handlers if changed by our local URL resolver. */
@@ -129,6 +141,8 @@ override_main (void)
    * Free allocated memory for tidiness, even though IFP will garbage collect
    * if we don't bother.
    */
+  render_erase ();
+  gamepage_erase ();
   gameset_erase ();
   gamegroup_erase ();
   terps_erase ();
@@ -56,7 +56,9 @@ struct group_s {
                          /* iFiction: (not available, unused) */
 
   vectorref_t contents;  /* Contained games/groups, growable, ordered */
+  char *title_key;       /* Title sort key, built on first request */
 
+  glui32 memberships;    /* Count of groups containing this group */
   glui32 digest;
   glui32 id;
   groupref_t next;
@@ -68,6 +70,14 @@ static groupref_t groups_head = NULL;
 /* Vector of groups in existence, for fast lookup by group id. */
 static vectorref_t groups_vector = NULL;
 
+/*
+ * Counts of groups containing each game, indexed by game id, and the count
+ * of games for which space is allocated.  Games not yet in any group may
+ * lie beyond the allocation.
+ */
+static glui32 *game_memberships = NULL;
+static glui32 game_memberships_length = 0;
+
 /*
  * Designated groups root node, either the top level grouping, or something
  * constructed out of top level tree fragments.
@@ -101,6 +111,8 @@ gamegroup_add_group (const char *about,
   group->description = memory_strdup (description);
 
   group->contents = vector_create (sizeof (node_t));
+  group->title_key = NULL;
+  group->memberships = 0;
 
   if (!groups_vector)
     groups_vector = vector_create (sizeof (group));
@@ -164,20 +176,26 @@ gamegroup_erase (void)
       memory_free (group->about);
       memory_free (group->title);
       memory_free (group->description);
+      memory_free (group->title_key);
 
-      memory_free (group->contents);
+      vector_destroy (group->contents);
 
       memset (group, 0, sizeof (*group));
       memory_free (group);
     }
 
   groups_head = NULL;
+  group_root = NULL;
 
   if (groups_vector)
     {
       vector_destroy (groups_vector);
       groups_vector = NULL;
     }
+
+  memory_free (game_memberships);
+  game_memberships = NULL;
+  game_memberships_length = 0;
 }
 
 
@@ -205,8 +223,10 @@ gamegroup_find_group (const char *name)
 
 /*
  * gamegroup_get_group_title()
+ * gamegroup_get_group_title_key()
  *
- * Convenience functions to return just the title field of a group.
+ * Convenience functions to return just the title field of a group, and its
+ * sort key, built on the first request for it.
  */
 const char *
 gamegroup_get_group_title (const groupref_t group)
@@ -216,14 +236,74 @@ gamegroup_get_group_title (const groupref_t group)
   return group->title;
 }
 
+const char *
+gamegroup_get_group_title_key (const groupref_t group)
+{
+  assert (gamegroup_is_group (group));
+
+  if (!group->title_key)
+    group->title_key = collate_create_key (group->title, FALSE);
+
+  return group->title_key;
+}
+
+
+/*
+ * gamegroup_add_node()
+ * gamegroup_is_game_member()
+ *
+ * Append a game or group node to a group, counting the new membership of
+ * the game or group it refers to, and check whether any group contains a
+ * given game.
+ */
+static void
+gamegroup_add_node (groupref_t group, const noderef_t node)
+{
+  vector_append (group->contents, node);
+
+  if (gamegroup_is_node_game (node))
+    {
+      glui32 id;
+
+      id = gameset_get_game_id (node->game);
+      if (id >= game_memberships_length)
+        {
+          glui32 length;
+
+          for (length = game_memberships_length; length <= id; )
+            length = length == 0 ? 64 : length << 1;
+
+          game_memberships = memory_realloc (game_memberships,
+                                             length * sizeof (glui32));
+          memset (game_memberships + game_memberships_length, 0,
+                  (length - game_memberships_length) * sizeof (glui32));
+          game_memberships_length = length;
+        }
+
+      game_memberships[id]++;
+    }
+  else
+    node->group->memberships++;
+}
+
+static int
+gamegroup_is_game_member (const gameref_t game)
+{
+  glui32 id;
+
+  id = gameset_get_game_id (game);
+  return id < game_memberships_length && game_memberships[id] > 0;
+}
+
 
 /*
  * gamegroup_add_game_to_group()
  * gamegroup_add_group_to_group()
+ * gamegroup_add_id_to_group()
  *
  * Add a game or a (sub-)group to a given game group.  The item to add is
- * found by lookup on location (for game) or about (for group).  Returns
- * true if added successfully, false otherwise.
+ * found by lookup on location (for game) or about (for group), or by its
+ * game or group id.  Returns true if added successfully, false otherwise.
  */
 int
 gamegroup_add_game_to_group (groupref_t group, const char *location)
@@ -237,7 +317,7 @@ gamegroup_add_game_to_group (groupref_t group, const char *location)
       node_t node;
 
       node.game = game;
-      vector_append (group->contents, &node);
+      gamegroup_add_node (group, &node);
     }
 
   return game != NULL;
@@ -249,24 +329,34 @@ gamegroup_add_group_to_group (groupref_t group, const char *about)
   groupref_t other;
   assert (gamegroup_is_group (group));
 
-  for (other = gamegroup_iterate (NULL); other;
-       other = gamegroup_iterate (other))
-    {
-      if (strcmp (other->about, about) == 0)
-        break;
-    }
-
+  other = gamegroup_find_group (about);
   if (other)
     {
       node_t node;
 
       node.group = other;
-      vector_append (group->contents, &node);
+      gamegroup_add_node (group, &node);
     }
 
   return other != NULL;
 }
 
+int
+gamegroup_add_id_to_group (groupref_t group, glui32 id)
+{
+  node_t node;
+  assert (gamegroup_is_group (group));
+
+  node.group = gamegroup_id_to_group (id);
+  if (!node.group)
+    node.game = gameset_id_to_game (id);
+
+  if (node.game)
+    gamegroup_add_node (group, &node);
+
+  return node.game != NULL;
+}
+
 
 /*
  * gamegroup_get_node_game()
@@ -302,6 +392,47 @@ gamegroup_is_node_group (const noderef_t node)
 }
 
 
+/*
+ * gamegroup_mark_reachable()
+ *
+ * Mark a group, and every group reachable from it through group contents,
+ * as reached.  Groups already marked are not traversed again, so loops in
+ * the groups are harmless.
+ */
+static void
+gamegroup_mark_reachable (groupref_t group, unsigned char *is_reached)
+{
+  vectorref_t stack;
+
+  if (is_reached[group->id])
+    return;
+
+  stack = vector_create (sizeof (group));
+  is_reached[group->id] = TRUE;
+  vector_append (stack, &group);
+
+  while (vector_get_length (stack) > 0)
+    {
+      noderef_t node;
+
+      vector_remove (stack, &group);
+
+      for (node = gamegroup_iterate_group (group, NULL);
+           node; node = gamegroup_iterate_group (group, node))
+        {
+          if (gamegroup_is_node_group (node)
+              && !is_reached[node->group->id])
+            {
+              is_reached[node->group->id] = TRUE;
+              vector_append (stack, &node->group);
+            }
+        }
+    }
+
+  vector_destroy (stack);
+}
+
+
 /*
  * gamegroup_get_root()
  *
@@ -312,7 +443,8 @@ groupref_t
 gamegroup_get_root (void)
 {
   vectorref_t nodes;
-  int nodes_count;
+  int nodes_count, groups_count;
+  unsigned char *is_reached;
   gameref_t game;
   groupref_t group;
 
@@ -326,57 +458,69 @@ gamegroup_get_root (void)
   else if (gameset_is_empty () && gamegroup_is_empty ())
     return NULL;
 
-  /* First, list every game and group known. */
+  /*
+   * First, list every game and group that is not itself a member of a
+   * group.  Membership counts are kept as groups are filled, so this is a
+   * single pass.
+   */
   nodes = vector_create (sizeof (node_t));
 
   for (game = gameset_iterate (NULL); game; game = gameset_iterate (game))
     {
-      node_t node;
+      if (!gamegroup_is_game_member (game))
+        {
+          node_t node;
 
-      node.game = game;
-      vector_append (nodes, &node);
+          node.game = game;
+          vector_append (nodes, &node);
+        }
     }
 
   for (group = gamegroup_iterate (NULL);
        group; group = gamegroup_iterate (group))
     {
-      node_t node;
+      if (group->memberships == 0)
+        {
+          node_t node;
 
-      node.group = group;
-      vector_append (nodes, &node);
+          node.group = group;
+          vector_append (nodes, &node);
+        }
     }
 
-  nodes_count = vector_get_length (nodes);
+  /*
+   * Find every group reachable from those top level groups.  Any group not
+   * reached lies only on or below loops in the groups.  For each such loop,
+   * promote the first unreached group found to the top level, so that every
+   * group is reachable from the root.
+   */
+  groups_count = groups_vector ? vector_get_length (groups_vector) : 0;
+  is_reached = memory_malloc (groups_count + 1);
+  memset (is_reached, FALSE, groups_count + 1);
 
-  /* Now remove all entries that are themselves members of a group. */
   for (group = gamegroup_iterate (NULL);
        group; group = gamegroup_iterate (group))
     {
-      noderef_t node;
+      if (group->memberships == 0)
+        gamegroup_mark_reachable (group, is_reached);
+    }
 
-      for (node = gamegroup_iterate_group (group, NULL);
-           node; node = gamegroup_iterate_group (group, node))
+  for (group = gamegroup_iterate (NULL);
+       group; group = gamegroup_iterate (group))
+    {
+      if (!is_reached[group->id])
         {
-          int index_;
-
-          index_ = 0;
-          while (index_ < nodes_count)
-            {
-              node_t other;
-
-              vector_get (nodes, index_, &other);
+          node_t node;
 
-              if (memcmp (node, &other, sizeof (other)) == 0)
-                {
-                  vector_delete (nodes, index_);
-                  nodes_count--;
-                }
-              else
-                index_++;
-            }
+          node.group = group;
+          vector_append (nodes, &node);
+          gamegroup_mark_reachable (group, is_reached);
         }
     }
 
+  memory_free (is_reached);
+  nodes_count = vector_get_length (nodes);
+
   /* If the nodes count is one and that node is a group, return it. */
   if (nodes_count == 1)
     {
@@ -387,30 +531,13 @@ gamegroup_get_root (void)
     }
 
   /*
-   * The nodes count may be zero, indicating a loop in the groups, or more
-   * than one.  For the first case, choosing a group arbitrarily may leave
-   * some loop parts unreachable.  So for both cases, then, manufacture a
-   * top level group to contain either all groups (if length is zero) or all
-   * island nodes (where length is greater than one).
+   * Otherwise, manufacture a top level group to contain all the top level
+   * nodes found.
    */
   if (!group_root)
     {
       int index_;
 
-      /* Re-add groups if everything looks like it's contained. */
-      if (nodes_count == 0)
-        {
-          for (group = gamegroup_iterate (NULL);
-               group; group = gamegroup_iterate (group))
-            {
-              node_t node;
-
-              node.group = group;
-              vector_set (nodes, nodes_count++, &node);
-            }
-        }
-
-      /* Manufacture a root node and dump everything into it. */
       group_root = gamegroup_add_group ("[Root]", "Main", NULL);
 
       for (index_ = 0; index_ < nodes_count; index_++)
@@ -418,22 +545,7 @@ gamegroup_get_root (void)
           node_t node;
 
           vector_get (nodes, index_, &node);
-
-          if (gamegroup_is_node_game (&node))
-            {
-              gameref_t entry;
-
-              entry = gamegroup_get_node_game (&node);
-              gamegroup_add_game_to_group (group_root,
-                                           gameset_get_game_location (entry));
-            }
-          else if (gamegroup_is_node_group (&node))
-            {
-              groupref_t entry;
-
-              entry = gamegroup_get_node_group (&node);
-              gamegroup_add_group_to_group (group_root, entry->about);
-            }
+          gamegroup_add_node (group_root, &node);
         }
     }
 
@@ -57,7 +57,7 @@ gamepage_convert_date (const char *iso_date)
           if (!(count == 1 || (count == 2 && trailer == ' ')))
             {
               /* Not formatted correctly, so just display original value. */
-              glk_c_put_string (iso_date);
+              render_put_string (iso_date);
               return;
             }
         }
@@ -70,33 +70,33 @@ gamepage_convert_date (const char *iso_date)
   if (month < 0 || month > 12
       || day < 0 || day > 31)
     {
-      glk_c_put_string (iso_date);
+      render_put_string (iso_date);
       return;
     }
 
   /* Redisplay as a more normal date. */
   switch (month)
     {
-      case  1: glk_c_put_string ("Jan "); break;
-      case  2: glk_c_put_string ("Feb "); break;
-      case  3: glk_c_put_string ("Mar "); break;
-      case  4: glk_c_put_string ("Apr "); break;
-      case  5: glk_c_put_string ("May "); break;
-      case  6: glk_c_put_string ("Jun "); break;
-      case  7: glk_c_put_string ("Jul "); break;
-      case  8: glk_c_put_string ("Aug "); break;
-      case  9: glk_c_put_string ("Sep "); break;
-      case 10: glk_c_put_string ("Oct "); break;
-      case 11: glk_c_put_string ("Nov "); break;
-      case 12: glk_c_put_string ("Dec "); break;
+      case  1: render_put_string ("Jan "); break;
+      case  2: render_put_string ("Feb "); break;
+      case  3: render_put_string ("Mar "); break;
+      case  4: render_put_string ("Apr "); break;
+      case  5: render_put_string ("May "); break;
+      case  6: render_put_string ("Jun "); break;
+      case  7: render_put_string ("Jul "); break;
+      case  8: render_put_string ("Aug "); break;
+      case  9: render_put_string ("Sep "); break;
+      case 10: render_put_string ("Oct "); break;
+      case 11: render_put_string ("Nov "); break;
+      case 12: render_put_string ("Dec "); break;
     }
   if (day > 0)
     {
       snprintf (buffer, sizeof (buffer), "%2d ", day);
-      glk_c_put_string (buffer);
+      render_put_string (buffer);
     }
   snprintf (buffer, sizeof (buffer), "%04d", year);
-  glk_c_put_string (buffer);
+  render_put_string (buffer);
 }
 
 
@@ -126,99 +126,99 @@ gamepage_game_details (const gameref_t game,
   if (has_hyperlinks)
     {
       display_button (mapping + 1, ">>", TRUE);
-      glk_c_put_string ("  ");
+      render_put_string ("  ");
     }
   else
     {
       char buffer[32];
 
       snprintf (buffer, sizeof (buffer), "%lu.  ", mapping + 1);
-      glk_c_put_string (buffer);
+      render_put_string (buffer);
     }
 
-  glk_set_style (style_Subheader);
-  glk_c_put_string (title);
-  glk_set_style (style_Normal);
+  render_set_style (style_Subheader);
+  render_put_string (title);
+  render_set_style (style_Normal);
 
   if (byline || author || publisher)
     {
-      glk_put_char (' ');
+      render_put_char (' ');
       if (byline)
-        glk_c_put_string (byline);
+        render_put_string (byline);
       else if (author)
         {
-          glk_c_put_string ("by ");
-          glk_c_put_string (author);
+          render_put_string ("by ");
+          render_put_string (author);
         }
       else
         {
-          glk_c_put_string ("from ");
-          glk_c_put_string (publisher);
+          render_put_string ("from ");
+          render_put_string (publisher);
         }
     }
-  glk_put_char ('\n');
+  render_put_char ('\n');
 
   if (display_show_games_in_full ())
     {
       if (genre)
         {
-          glk_c_put_string ("Genre: ");
-          glk_set_style (style_Emphasized);
-          glk_c_put_string (genre);
-          glk_set_style (style_Normal);
-          glk_c_put_string ("  ");
+          render_put_string ("Genre: ");
+          render_set_style (style_Emphasized);
+          render_put_string (genre);
+          render_set_style (style_Normal);
+          render_put_string ("  ");
         }
 
       if (version)
         {
-          glk_c_put_string ("Version: ");
-          glk_set_style (style_Emphasized);
-          glk_c_put_string (version);
-          glk_set_style (style_Normal);
-          glk_c_put_string ("  ");
+          render_put_string ("Version: ");
+          render_set_style (style_Emphasized);
+          render_put_string (version);
+          render_set_style (style_Normal);
+          render_put_string ("  ");
         }
 
       if (release_date)
         {
-          glk_c_put_string ("Release Date: ");
-          glk_set_style (style_Emphasized);
+          render_put_string ("Release Date: ");
+          render_set_style (style_Emphasized);
           gamepage_convert_date (release_date);
-          glk_set_style (style_Normal);
-          glk_c_put_string ("  ");
+          render_set_style (style_Normal);
+          render_put_string ("  ");
         }
 
       if (length)
         {
-          glk_c_put_string ("Length: ");
-          glk_set_style (style_Emphasized);
-          glk_c_put_string (length);
-          glk_set_style (style_Normal);
-          glk_c_put_string ("  ");
+          render_put_string ("Length: ");
+          render_set_style (style_Emphasized);
+          render_put_string (length);
+          render_set_style (style_Normal);
+          render_put_string ("  ");
         }
 
       if (genre || version || release_date || length)
-        glk_put_char ('\n');
+        render_put_char ('\n');
 
       if (description)
         {
-          glk_c_put_string (description);
-          glk_put_char ('\n');
+          render_put_string (description);
+          render_put_char ('\n');
         }
       else if (headline)
         {
-          glk_c_put_string ("Brief Description: ");
-          glk_c_put_string (headline);
-          glk_put_char ('\n');
+          render_put_string ("Brief Description: ");
+          render_put_string (headline);
+          render_put_char ('\n');
         }
     }
 
-  glk_c_put_string ("Location: ");
-  glk_set_style (style_Emphasized);
-  glk_c_put_string (about);
-  glk_set_style (style_Normal);
-  glk_put_char ('\n');
+  render_put_string ("Location: ");
+  render_set_style (style_Emphasized);
+  render_put_string (about);
+  render_set_style (style_Normal);
+  render_put_char ('\n');
 
-  glk_put_char ('\n');
+  render_put_char ('\n');
 }
 
 
@@ -243,28 +243,28 @@ gamepage_group_details (const groupref_t group, vectorref_t display_map,
   if (has_hyperlinks)
     {
       display_button (mapping + 1, ">>", TRUE);
-      glk_c_put_string ("  ");
+      render_put_string ("  ");
     }
   else
     {
       char buffer[32];
 
       snprintf (buffer, sizeof (buffer), "%lu.  ", mapping + 1);
-      glk_c_put_string (buffer);
+      render_put_string (buffer);
     }
 
-  glk_set_style (style_Subheader);
-  glk_c_put_string (title);
-  glk_set_style (style_Normal);
-  glk_put_char ('\n');
+  render_set_style (style_Subheader);
+  render_put_string (title);
+  render_set_style (style_Normal);
+  render_put_char ('\n');
 
   if (description)
     {
-      glk_c_put_string (description);
-      glk_put_char ('\n');
+      render_put_string (description);
+      render_put_char ('\n');
     }
 
-  glk_put_char ('\n');
+  render_put_char ('\n');
 }
 
 
@@ -276,61 +276,88 @@ gamepage_group_details (const groupref_t group, vectorref_t display_map,
 static void
 gamepage_preamble (int has_hyperlinks, int is_endpoint)
 {
-  glk_c_put_string (
+  render_put_string (
     "Gamebox offers a browser-like interface to a collection of Interactive"
     " Fiction games.  Details of the collection are stored in XML or INI"
     " files.\n\n");
 
   if (has_hyperlinks)
     {
-      glk_c_put_string (
+      render_put_string (
         "To run a game or to view a different category, use the [>>] hyperlink"
         " alongside its list entry.  ");
 
       if (is_endpoint)
-        glk_c_put_string (
+        render_put_string (
           "To close Gamebox, use the [X] hyperlink at the top of the page, or"
           " the 'q' keyboard accelerator.  ");
       else
-        glk_c_put_string (
+        render_put_string (
           "To close Gamebox, or to return to the previous category, use the"
           " [X] or [<<] hyperlinks at the top of the page, or the 'q' or 'u'"
           " keyboard accelerators.  ");
 
-      glk_c_put_string (
+      render_put_string (
           "For multiple game pages, use the [<] and [>] hyperlinks to move"
           " between pages.  ");
 
-      glk_c_put_string (
+      render_put_string (
         "For more about Gamebox, use the [About] hyperlink or the '?' keyboard"
         " accelerator.\n\n");
     }
   else
     {
-      glk_c_put_string (
+      render_put_string (
         "To run a game or to view a different category, enter its number at"
         " the Gamebox prompt.  To close Gamebox, enter 'q' at the prompt.  ");
 
       if (!is_endpoint)
-        glk_c_put_string (
+        render_put_string (
           "To return to the previous category, enter 'u' at the prompt.  ");
 
-      glk_c_put_string (
+      render_put_string (
           "For multiple game pages, use '-' and '+' to move between pages.  ");
 
-      glk_c_put_string ("For more about Gamebox, enter '?' at the prompt.\n\n");
+      render_put_string (
+        "For more about Gamebox, enter '?' at the prompt.\n\n");
     }
 }
 
 
+/*
+ * Sort orders for group entries, and a cache of each group's entries sorted
+ * in each order used so far.  Groups do not change once built, so a sorted
+ * list stays valid until the groups are erased.
+ */
+enum { GAMEPAGE_BY_TITLE = 0, GAMEPAGE_BY_AUTHOR = 1, GAMEPAGE_BY_GENRE = 2 };
+typedef struct {
+  groupref_t group;
+  int sort_by;
+  vectorref_t nodes;
+} gamepage_sorted_t;
+
+static vectorref_t gamepage_sorted_cache = NULL;
+
+/*
+ * Results of the last search, and the query that produced them.  Searches
+ * run only when the query changes, so that paging does not repeat them.
+ */
+static vectorref_t gamepage_search_results = NULL;
+static char *gamepage_search_query = NULL;
+
+/* Sort order in use by gamepage_compare(), set for the duration of qsort. */
+static int gamepage_sort_by = GAMEPAGE_BY_TITLE;
+
+
 /*
  * gamepage_compare_get_primary()
  * gamepage_compare_get_secondary()
  * gamepage_compare()
  *
  * Comparison function and helpers for qsort.  Sorts group entries by the
- * primary sort field, and by game or group title within equal primaries.
- * Primary may be NULL, in which case any non-NULL is deemed greater.
+ * primary sort key, and by game or group title key within equal primaries.
+ * Primary may be NULL, in which case any non-NULL is deemed greater.  Keys
+ * are built once per game or group, so comparisons are plain strcmp()s.
  */
 static const char *
 gamepage_compare_get_primary (const noderef_t node)
@@ -340,17 +367,15 @@ gamepage_compare_get_primary (const noderef_t node)
   game = gamegroup_get_node_game (node);
   if (game)
     {
-      if (display_sort_games_by_author ())
+      switch (gamepage_sort_by)
         {
-          const char *author;
-
-          author = gameset_get_game_author (game);
-          return author ? author : gameset_get_game_publisher (game);
+        case GAMEPAGE_BY_AUTHOR:
+          return gameset_get_game_author_key (game);
+        case GAMEPAGE_BY_GENRE:
+          return gameset_get_game_genre_key (game);
+        default:
+          return NULL;
         }
-      else if (display_sort_games_by_genre ())
-        return gameset_get_game_genre (game);
-
-      return NULL;
     }
 
   assert (gamegroup_get_node_group (node));
@@ -364,26 +389,14 @@ gamepage_compare_get_secondary (const noderef_t node)
 
   game = gamegroup_get_node_game (node);
   if (game)
-    {
-      const char *title;
-
-      title = gameset_get_game_title (game);
-      if (strncasecmp (title, "The ", 4) == 0)
-        return title + 4;
-      else if (strncasecmp (title, "An ", 3) == 0)
-        return title + 3;
-      else if (strncasecmp (title, "A ", 2) == 0)
-        return title + 2;
-      else
-        return title;
-    }
+    return gameset_get_game_title_key (game);
   else
     {
       groupref_t group;
 
       group = gamegroup_get_node_group (node);
       assert (group);
-      return gamegroup_get_group_title (group);
+      return gamegroup_get_group_title_key (group);
     }
 }
 
@@ -398,8 +411,11 @@ gamepage_compare (const void *left_ptr, const void *right_ptr)
 
   if (compare && with)
     {
-      if (strcasecmp (compare, with) != 0)
-        return strcasecmp (compare, with);
+      int status;
+
+      status = strcmp (compare, with);
+      if (status != 0)
+        return status;
     }
 
   else if (compare && !with)
@@ -411,25 +427,158 @@ gamepage_compare (const void *left_ptr, const void *right_ptr)
   with = gamepage_compare_get_secondary (right);
   assert (compare && with);
 
-  return strcasecmp (compare, with);
+  return strcmp (compare, with);
 }
 
 
 /*
- * gamepage_gamegroup()
+ * gamepage_get_sorted_nodes()
+ * gamepage_erase()
  *
- * Print details of each game and group in the given group.
+ * Return a vector of the entries in a group, sorted in the order currently
+ * selected for display, from the cache if sorted in that order before, and
+ * empty the cache and last search results.  Returned vectors belong to the
+ * cache.
+ */
+static vectorref_t
+gamepage_get_sorted_nodes (const groupref_t group)
+{
+  gamepage_sorted_t sorted;
+  noderef_t node;
+  int sort_by, index_;
+
+  if (display_sort_games_by_author ())
+    sort_by = GAMEPAGE_BY_AUTHOR;
+  else if (display_sort_games_by_genre ())
+    sort_by = GAMEPAGE_BY_GENRE;
+  else
+    sort_by = GAMEPAGE_BY_TITLE;
+
+  if (!gamepage_sorted_cache)
+    gamepage_sorted_cache = vector_create (sizeof (sorted));
+
+  for (index_ = 0;
+       index_ < vector_get_length (gamepage_sorted_cache); index_++)
+    {
+      vector_get (gamepage_sorted_cache, index_, &sorted);
+      if (sorted.group == group && sorted.sort_by == sort_by)
+        return sorted.nodes;
+    }
+
+  sorted.group = group;
+  sorted.sort_by = sort_by;
+  sorted.nodes = vector_create (sizeof (noderef_t));
+
+  for (node = gamegroup_iterate_group (group, NULL);
+       node; node = gamegroup_iterate_group (group, node))
+    vector_append (sorted.nodes, &node);
+
+  if (vector_get_length (sorted.nodes) > 0)
+    {
+      gamepage_sort_by = sort_by;
+      qsort ((void *) vector_get_address (sorted.nodes, 0),
+             vector_get_length (sorted.nodes), sizeof (noderef_t),
+             gamepage_compare);
+    }
+
+  vector_append (gamepage_sorted_cache, &sorted);
+  return sorted.nodes;
+}
+
+void
+gamepage_erase (void)
+{
+  int index_;
+
+  if (gamepage_search_results)
+    {
+      vector_destroy (gamepage_search_results);
+      gamepage_search_results = NULL;
+    }
+  memory_free (gamepage_search_query);
+  gamepage_search_query = NULL;
+
+  if (!gamepage_sorted_cache)
+    return;
+
+  for (index_ = 0;
+       index_ < vector_get_length (gamepage_sorted_cache); index_++)
+    {
+      gamepage_sorted_t sorted;
+
+      vector_get (gamepage_sorted_cache, index_, &sorted);
+      vector_destroy (sorted.nodes);
+    }
+
+  vector_destroy (gamepage_sorted_cache);
+  gamepage_sorted_cache = NULL;
+}
+
+
+/*
+ * gamepage_paginate()
+ *
+ * Apply a page increment to a page number, keeping it in range for the
+ * count of entries, and if more than one page is needed, print the page
+ * number and count, with pagination buttons where hyperlinks are available.
  */
 static void
-gamepage_gamegroup (const groupref_t group, vectorref_t display_map,
-                    int has_hyperlinks, int page_increment)
+gamepage_paginate (int entries_count, int *page_number,
+                   int page_increment, int has_hyperlinks)
+{
+  char buffer[32];
+  int last_page;
+
+  if (entries_count <= GAMEPAGE_ITEMS_PER_PAGE)
+    {
+      *page_number = 0;
+      return;
+    }
+
+  last_page = entries_count / GAMEPAGE_ITEMS_PER_PAGE;
+  *page_number += page_increment;
+
+  if (*page_number < 0)
+    *page_number = 0;
+  else if (*page_number > last_page)
+    *page_number = last_page;
+
+  render_put_string ("Page ");
+  snprintf (buffer, sizeof (buffer), "%d", *page_number + 1);
+  render_put_string (buffer);
+  render_put_string (" of ");
+  snprintf (buffer, sizeof (buffer), "%d", last_page + 1);
+  render_put_string (buffer);
+
+  if (has_hyperlinks)
+    {
+      int prior_page_code, next_page_code;
+
+      render_put_string ("  ");
+
+      display_get_pagination_codes (&prior_page_code, &next_page_code);
+      display_button (prior_page_code, "<", *page_number > 0);
+      display_button (next_page_code, ">", *page_number < last_page);
+    }
+
+  render_put_string ("\n\n");
+}
+
+
+/*
+ * gamepage_turn_page()
+ *
+ * Apply a page increment to the page number shown for a group, keeping it
+ * in range for the count of entries in the group, and return the new page
+ * number.  The page number returns to the first page on a change of group.
+ */
+int
+gamepage_turn_page (const groupref_t group, int page_increment)
 {
   static int page_number = 0;
   static groupref_t last_group = NULL;
 
-  int has_games, has_groups, nodes_count, begin, end, index_;
-  vectorref_t nodes;
-  noderef_t node;
+  int nodes_count, last_page;
 
   if (group != last_group)
     {
@@ -437,78 +586,73 @@ gamepage_gamegroup (const groupref_t group, vectorref_t display_map,
       last_group = group;
     }
 
-  nodes = vector_create (sizeof (noderef_t));
+  nodes_count = vector_get_length (gamepage_get_sorted_nodes (group));
+  if (nodes_count <= GAMEPAGE_ITEMS_PER_PAGE)
+    {
+      page_number = 0;
+      return page_number;
+    }
+
+  last_page = nodes_count / GAMEPAGE_ITEMS_PER_PAGE;
+  page_number += page_increment;
+
+  if (page_number < 0)
+    page_number = 0;
+  else if (page_number > last_page)
+    page_number = last_page;
+
+  return page_number;
+}
+
+
+/*
+ * gamepage_gamegroup()
+ *
+ * Print details of each game and group on the given page of a group.
+ */
+static void
+gamepage_gamegroup (const groupref_t group, vectorref_t display_map,
+                    int has_hyperlinks, int page_number)
+{
+  int has_games, has_groups, nodes_count, begin, end, index_;
+  vectorref_t nodes;
+  noderef_t node;
+
+  nodes = gamepage_get_sorted_nodes (group);
+  nodes_count = vector_get_length (nodes);
 
   has_games = has_groups = FALSE;
 
-  for (node = gamegroup_iterate_group (group, NULL);
-       node; node = gamegroup_iterate_group (group, node))
+  for (index_ = 0; index_ < nodes_count; index_++)
     {
+      vector_get (nodes, index_, &node);
+
       has_games |= gamegroup_is_node_game (node);
       has_groups |= gamegroup_is_node_group (node);
-
-      vector_append (nodes, &node);
     }
 
-  glk_c_put_string ("The ");
-  glk_set_style (style_Subheader);
-  glk_c_put_string (gamegroup_get_group_title (group));
-  glk_set_style (style_Normal);
-  glk_c_put_string (" category");
+  render_put_string ("The ");
+  render_set_style (style_Subheader);
+  render_put_string (gamegroup_get_group_title (group));
+  render_set_style (style_Normal);
+  render_put_string (" category");
 
-  nodes_count = vector_get_length (nodes);
   if (nodes_count == 0)
     {
-      glk_c_put_string (" contains no entries.  Sorry.\n\n");
-      vector_destroy (nodes);
+      render_put_string (" contains no entries.  Sorry.\n\n");
       return;
     }
 
-  glk_c_put_string (" offers the following");
+  render_put_string (" offers the following");
   if (has_games)
-    glk_c_put_string (" games");
+    render_put_string (" games");
   if (has_games && has_groups)
-    glk_c_put_string (" and");
+    render_put_string (" and");
   if (has_groups)
-    glk_c_put_string (" categories");
-  glk_c_put_string (":\n\n");
-
-  qsort ((void *) vector_get_address (nodes, 0),
-         nodes_count, sizeof (noderef_t), gamepage_compare);
-
-  if (nodes_count > GAMEPAGE_ITEMS_PER_PAGE)
-    {
-      char buffer[32];
-      int last_page;
-
-      last_page = nodes_count / GAMEPAGE_ITEMS_PER_PAGE;
-      page_number += page_increment;
+    render_put_string (" categories");
+  render_put_string (":\n\n");
 
-      if (page_number < 0)
-        page_number = 0;
-      else if (page_number > last_page)
-        page_number = last_page;
-
-      glk_c_put_string ("Page ");
-      snprintf (buffer, sizeof (buffer), "%d", page_number + 1);
-      glk_c_put_string (buffer);
-      glk_c_put_string (" of ");
-      snprintf (buffer, sizeof (buffer), "%d", last_page + 1);
-      glk_c_put_string (buffer);
-
-      if (has_hyperlinks)
-        {
-          int prior_page_code, next_page_code;
-
-          glk_c_put_string ("  ");
-
-          display_get_pagination_codes (&prior_page_code, &next_page_code);
-          display_button (prior_page_code, "<", page_number > 0);
-          display_button (next_page_code, ">", page_number < last_page);
-        }
-
-      glk_c_put_string ("\n\n");
-    }
+  gamepage_paginate (nodes_count, &page_number, 0, has_hyperlinks);
 
   begin = page_number * GAMEPAGE_ITEMS_PER_PAGE;
   end = (page_number + 1) * GAMEPAGE_ITEMS_PER_PAGE;
@@ -536,21 +680,108 @@ gamepage_gamegroup (const groupref_t group, vectorref_t display_map,
 
   if (nodes_count > GAMEPAGE_ITEMS_PER_PAGE
       && page_number < nodes_count / GAMEPAGE_ITEMS_PER_PAGE)
-    glk_c_put_string ("More...\n");
-
-  vector_destroy (nodes);
+    render_put_string ("More...\n");
 }
 
 
 /*
  * gamepage_display()
  *
- * Repaginate the complete details of each game and group in the given group.
+ * Repaginate the complete details of each game and group on the given page
+ * of the given group.
  */
 void
 gamepage_display (const groupref_t group, vectorref_t display_map,
-                  int has_hyperlinks, int page_increment, int is_endpoint)
+                  int has_hyperlinks, int page_number, int is_endpoint)
 {
   gamepage_preamble (has_hyperlinks, is_endpoint);
-  gamepage_gamegroup (group, display_map, has_hyperlinks, page_increment);
+  gamepage_gamegroup (group, display_map, has_hyperlinks, page_number);
+}
+
+
+/*
+ * gamepage_search_preamble()
+ * gamepage_display_search()
+ *
+ * Print the search page preamble, and the games matching a search query,
+ * best matches first.
+ */
+static void
+gamepage_search_preamble (int has_hyperlinks)
+{
+  if (has_hyperlinks)
+    render_put_string (
+      "Type words to search game titles, authors, genres, and descriptions."
+      "  Matching games are listed as you type.  Use Backspace to edit the"
+      " search, and Escape to return to the Games page.  To run a game, use"
+      " the [>>] hyperlink alongside its list entry.\n\n");
+  else
+    render_put_string (
+      "To search game titles, authors, genres, and descriptions, enter '/'"
+      " followed by the words to search for at the Gamebox prompt.  To run"
+      " a game, enter its number at the prompt.\n\n");
+}
+
+void
+gamepage_display_search (const char *query, vectorref_t display_map,
+                         int has_hyperlinks, int page_increment)
+{
+  static int page_number = 0;
+
+  int results_count, begin, end, index_;
+  char buffer[32];
+  assert (query);
+
+  gamepage_search_preamble (has_hyperlinks);
+
+  if (!gamepage_search_results)
+    gamepage_search_results = vector_create (sizeof (gameref_t));
+
+  if (!gamepage_search_query || strcmp (gamepage_search_query, query) != 0)
+    {
+      search_find_games (query, gamepage_search_results);
+
+      memory_free (gamepage_search_query);
+      gamepage_search_query = memory_strdup (query);
+      page_number = 0;
+    }
+
+  render_put_string ("Search: ");
+  render_set_style (style_Input);
+  render_put_string (query);
+  render_set_style (style_Normal);
+  if (has_hyperlinks)
+    render_put_char ('_');
+  render_put_string ("\n\n");
+
+  results_count = vector_get_length (gamepage_search_results);
+  if (results_count == 0)
+    {
+      render_put_string (query[0] ? "No games match.\n\n"
+                                  : "Enter words to search for.\n\n");
+      return;
+    }
+
+  snprintf (buffer, sizeof (buffer), "%d", results_count);
+  render_put_string (buffer);
+  render_put_string (results_count == 1 ? " game matches:\n\n"
+                                        : " games match:\n\n");
+
+  gamepage_paginate (results_count, &page_number,
+                     page_increment, has_hyperlinks);
+
+  begin = page_number * GAMEPAGE_ITEMS_PER_PAGE;
+  end = (page_number + 1) * GAMEPAGE_ITEMS_PER_PAGE;
+
+  for (index_ = begin; index_ < end && index_ < results_count; index_++)
+    {
+      gameref_t game;
+
+      vector_get (gamepage_search_results, index_, &game);
+      gamepage_game_details (game, display_map, has_hyperlinks);
+    }
+
+  if (results_count > GAMEPAGE_ITEMS_PER_PAGE
+      && page_number < results_count / GAMEPAGE_ITEMS_PER_PAGE)
+    render_put_string ("More...\n");
 }
@@ -35,6 +35,8 @@ struct game_s {
 
   char *about;         /* IFMES:    BAF:game about (the game file!) */
                        /* iFiction: annotation, gamebox, about, or url+IFID */
+  char *ifid;          /* IFMES:    (not available, unused) */
+                       /* iFiction: identification, ifid */
   char *author;        /* IFMES:    author (if no Byline) */
                        /* iFiction: bibliographic, author */
   char *byline;        /* IFMES:    byline (overrides author) */
@@ -57,16 +59,135 @@ struct game_s {
   char *version;       /* IFMES:    version */
                        /* iFiction: (not available, unused) */
 
+  char *title_key;     /* Sort keys, built on first request */
+  char *author_key;
+  char *genre_key;
+  int has_keys;
+
   glui32 digest;
+  glui32 ifid_digest;
   glui32 id;
-  gameref_t next;
 };
 
-/* List of game descriptors, unordered. */
-static gameref_t games_head = NULL;
+/*
+ * Games are held in fixed size blocks, allocated as needed and never moved,
+ * so that game references held by groups stay valid as the set grows.  A
+ * game's id is its index across all blocks, in order of addition.
+ */
+enum { GAMESET_BLOCK_SIZE = 256 };
+static vectorref_t games_blocks = NULL;
+static glui32 games_count = 0;
+
+/*
+ * Hash indexes of games by location and by IFID.  Each is an open addressed
+ * table of game references, probed linearly, sized to a power of two and
+ * kept at most half full.  Where several games share a key, the index holds
+ * the one added last.
+ */
+typedef struct {
+  gameref_t *slots;
+  glui32 capacity;
+  glui32 count;
+} gameset_index_t;
 
-/* Vector of games in existence, for fast lookup by game id. */
-static vectorref_t games_vector = NULL;
+static gameset_index_t games_by_location = { NULL, 0, 0 },
+                       games_by_ifid = { NULL, 0, 0 };
+
+
+/*
+ * gameset_index_find_slot()
+ * gameset_index_insert()
+ * gameset_index_lookup()
+ * gameset_index_erase()
+ *
+ * Internal hash index implementation.  Find the slot for a key, add a game
+ * with its key, replacing any game already held for that key, look up the
+ * game for a key, and empty the index.  The is_ifid flag selects whether
+ * games are keyed by IFID or by location.
+ */
+static gameref_t *
+gameset_index_find_slot (const gameset_index_t *index_, int is_ifid,
+                         const char *key, glui32 digest)
+{
+  glui32 mask, slot;
+
+  mask = index_->capacity - 1;
+  for (slot = digest & mask; index_->slots[slot]; slot = (slot + 1) & mask)
+    {
+      gameref_t game;
+
+      game = index_->slots[slot];
+      if (is_ifid ? game->ifid_digest == digest
+                    && strcmp (game->ifid, key) == 0
+                  : game->digest == digest
+                    && strcmp (game->about, key) == 0)
+        break;
+    }
+
+  return index_->slots + slot;
+}
+
+static void
+gameset_index_insert (gameset_index_t *index_, int is_ifid, gameref_t game)
+{
+  gameref_t *slot;
+
+  /* Grow and rehash when the addition would take the table past half. */
+  if ((index_->count + 1) * 2 > index_->capacity)
+    {
+      gameref_t *slots;
+      glui32 capacity, entry;
+
+      slots = index_->slots;
+      capacity = index_->capacity;
+
+      index_->capacity = capacity == 0 ? 64 : capacity << 1;
+      index_->slots = memory_malloc (index_->capacity * sizeof (*slots));
+      memset (index_->slots, 0, index_->capacity * sizeof (*slots));
+
+      for (entry = 0; entry < capacity; entry++)
+        {
+          gameref_t other;
+
+          other = slots[entry];
+          if (other)
+            {
+              slot = gameset_index_find_slot (index_, is_ifid,
+                                              is_ifid ? other->ifid
+                                                      : other->about,
+                                              is_ifid ? other->ifid_digest
+                                                      : other->digest);
+              *slot = other;
+            }
+        }
+      memory_free (slots);
+    }
+
+  slot = gameset_index_find_slot (index_, is_ifid,
+                                  is_ifid ? game->ifid : game->about,
+                                  is_ifid ? game->ifid_digest : game->digest);
+  if (!*slot)
+    index_->count++;
+  *slot = game;
+}
+
+static gameref_t
+gameset_index_lookup (const gameset_index_t *index_, int is_ifid,
+                      const char *key)
+{
+  if (index_->count == 0)
+    return NULL;
+
+  return *gameset_index_find_slot (index_, is_ifid, key, hash (key));
+}
+
+static void
+gameset_index_erase (gameset_index_t *index_)
+{
+  memory_free (index_->slots);
+  index_->slots = NULL;
+  index_->capacity = index_->count = 0;
+}
 
 
 /*
@@ -78,10 +199,11 @@ static vectorref_t games_vector = NULL;
  * gameset_erase()
  *
  * Create, iterate through, check, and erase a growable array of games.
- * All fields except 'about' and 'title' may be NULL.
+ * All fields except 'about' and 'title' may be NULL.  Iteration runs from
+ * the most recently added game to the first.
  */
 void
-gameset_add_game (const char *about,
+gameset_add_game (const char *about, const char *ifid,
                   const char *author, const char *byline,
                   const char *description, const char *genre,
                   const char *headline, const char *length,
@@ -91,9 +213,24 @@ gameset_add_game (const char *about,
   gameref_t game;
   assert (about && title);
 
-  game = memory_malloc (sizeof (*game));
+  if (!games_blocks)
+    games_blocks = vector_create (sizeof (game));
+
+  /* Start a new block if the last is full, or there is none yet. */
+  if (games_count % GAMESET_BLOCK_SIZE == 0)
+    {
+      gameref_t block;
+
+      block = memory_malloc (GAMESET_BLOCK_SIZE * sizeof (*block));
+      vector_append (games_blocks, &block);
+    }
+
+  vector_get (games_blocks, games_count / GAMESET_BLOCK_SIZE, &game);
+  game += games_count % GAMESET_BLOCK_SIZE;
+
   game->magic = GAMESET_MAGIC;
   game->about = memory_strdup (about);
+  game->ifid = memory_strdup (ifid);
   game->author = memory_strdup (author);
   game->byline = memory_strdup (byline);
   game->description = memory_strdup (description);
@@ -105,15 +242,18 @@ gameset_add_game (const char *about,
   game->title = memory_strdup (title);
   game->version = memory_strdup (version);
 
-  if (!games_vector)
-    games_vector = vector_create (sizeof (game));
+  game->title_key = game->author_key = game->genre_key = NULL;
+  game->has_keys = FALSE;
 
   game->digest = hash (about);
-  game->id = vector_get_length (games_vector);
-  vector_append (games_vector, &game);
+  game->ifid_digest = ifid ? hash (ifid) : 0;
+  game->id = games_count++;
+
+  gameset_index_insert (&games_by_location, FALSE, game);
+  if (ifid)
+    gameset_index_insert (&games_by_ifid, TRUE, game);
 
-  game->next = games_head;
-  games_head = game;
+  search_index_game (game);
 }
 
 int
@@ -164,25 +304,34 @@ gameset_iterate (const gameref_t game)
 {
   assert (!game || gameset_is_game (game));
 
-  return game ? game->next : games_head;
+  if (!game)
+    return games_count > 0 ? gameset_id_to_game (games_count - 1) : NULL;
+
+  return game->id > 0 ? gameset_id_to_game (game->id - 1) : NULL;
 }
 
 int
 gameset_is_empty (void)
 {
-  return games_head == NULL;
+  return games_count == 0;
 }
 
 void
 gameset_erase (void)
 {
-  gameref_t game, next;
+  glui32 id;
+  int block_index;
+
+  if (!games_blocks)
+    return;
 
-  for (game = games_head; game; game = next)
+  for (id = 0; id < games_count; id++)
     {
-      next = game->next;
+      gameref_t game;
 
+      game = gameset_id_to_game (id);
       memory_free (game->about);
+      memory_free (game->ifid);
       memory_free (game->author);
       memory_free (game->byline);
       memory_free (game->description);
@@ -193,45 +342,55 @@ gameset_erase (void)
       memory_free (game->release_date);
       memory_free (game->title);
       memory_free (game->version);
-
-      memset (game, 0, sizeof (*game));
-      memory_free (game);
+      memory_free (game->title_key);
+      memory_free (game->author_key);
+      memory_free (game->genre_key);
     }
 
-  games_head = NULL;
-
-  if (games_vector)
+  for (block_index = 0;
+       block_index < vector_get_length (games_blocks); block_index++)
     {
-      vector_destroy (games_vector);
-      games_vector = NULL;
+      gameref_t block;
+
+      vector_get (games_blocks, block_index, &block);
+
+      memset (block, 0, GAMESET_BLOCK_SIZE * sizeof (*block));
+      memory_free (block);
     }
+
+  vector_destroy (games_blocks);
+  games_blocks = NULL;
+  games_count = 0;
+
+  gameset_index_erase (&games_by_location);
+  gameset_index_erase (&games_by_ifid);
+  search_erase ();
 }
 
 
 /*
  * gameset_find_game()
+ * gameset_find_game_by_ifid()
  *
- * Return the game for a given location, NULL if not found.
+ * Return the game for a given location, or for a given IFID, NULL if not
+ * found.  Where several games match, return the one added last.
  */
 gameref_t
 gameset_find_game (const char *location)
 {
-  glui32 digest;
-  gameref_t game;
-
-  digest = hash (location);
-  for (game = games_head; game; game = game->next)
-    {
-      if (game->digest == digest && strcmp (game->about, location) == 0)
-        break;
-    }
+  return gameset_index_lookup (&games_by_location, FALSE, location);
+}
 
-  return game;
+gameref_t
+gameset_find_game_by_ifid (const char *ifid)
+{
+  return gameset_index_lookup (&games_by_ifid, TRUE, ifid);
 }
 
 
 /*
  * gameset_get_game_location()
+ * gameset_get_game_ifid()
  * gameset_get_game_title()
  * gameset_get_game_author()
  * gameset_get_game_publisher()
@@ -249,6 +408,14 @@ gameset_get_game_location (const gameref_t game)
   return game->about;
 }
 
+const char *
+gameset_get_game_ifid (const gameref_t game)
+{
+  assert (gameset_is_game (game));
+
+  return game->ifid;
+}
+
 const char *
 gameset_get_game_title (const gameref_t game)
 {
@@ -282,6 +449,58 @@ gameset_get_game_genre (const gameref_t game)
 }
 
 
+/*
+ * gameset_build_game_keys()
+ * gameset_get_game_title_key()
+ * gameset_get_game_author_key()
+ * gameset_get_game_genre_key()
+ *
+ * Return sort keys for a game's title, its author (or publisher if no
+ * author), and its genre, building all of them on the first request for
+ * any.  Keys may be NULL where the underlying fields are.
+ */
+static void
+gameset_build_game_keys (gameref_t game)
+{
+  if (!game->has_keys)
+    {
+      game->title_key = collate_create_key (game->title, TRUE);
+      game->author_key = collate_create_key (game->author
+                                             ? game->author
+                                             : game->publisher, FALSE);
+      game->genre_key = collate_create_key (game->genre, FALSE);
+      game->has_keys = TRUE;
+    }
+}
+
+const char *
+gameset_get_game_title_key (const gameref_t game)
+{
+  assert (gameset_is_game (game));
+
+  gameset_build_game_keys (game);
+  return game->title_key;
+}
+
+const char *
+gameset_get_game_author_key (const gameref_t game)
+{
+  assert (gameset_is_game (game));
+
+  gameset_build_game_keys (game);
+  return game->author_key;
+}
+
+const char *
+gameset_get_game_genre_key (const gameref_t game)
+{
+  assert (gameset_is_game (game));
+
+  gameset_build_game_keys (game);
+  return game->genre_key;
+}
+
+
 /*
  * gameset_get_game_id()
  * gameset_id_to_game()
@@ -300,11 +519,12 @@ gameset_get_game_id (const gameref_t game)
 gameref_t
 gameset_id_to_game (glui32 id)
 {
-  if (id < (glui32) vector_get_length (games_vector))
+  if (id < games_count)
     {
       gameref_t game;
 
-      vector_get (games_vector, id, &game);
+      vector_get (games_blocks, id / GAMESET_BLOCK_SIZE, &game);
+      game += id % GAMESET_BLOCK_SIZE;
       assert (game->id == id);
 
       return game;
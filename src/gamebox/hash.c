@@ -28,24 +28,20 @@
 /*
  * hash()
  *
- * Hash a string, hashpjw algorithm, from 'Compilers, principles, techniques,
- * and tools', page 436, unmodulo'ed.  Used to create a strings digest to help
- * with comparisons.
+ * Hash a string, 32-bit FNV-1a algorithm.  Used to create a strings digest
+ * to help with comparisons, and to place strings in hash indexes, where the
+ * low bits of the digest need to be as well mixed as the high ones.
  */
 glui32
 hash (const char *string)
 {
-  const char *sp;
-  glui32 h = 0, g;
+  const unsigned char *sp;
+  glui32 h = 2166136261U;
 
-  for (sp = string; *sp != '\0'; sp++)
-      {
-        h = (h << 4) + (*sp);
-        if ((g = (h & 0xF0000000)) != 0)
-          {
-            h = h ^ (g >> 24);
-            h = h ^ g;
-          }
-      }
+  for (sp = (const unsigned char *) string; *sp != '\0'; sp++)
+    {
+      h ^= *sp;
+      h = (h * 16777619U) & 0xffffffff;
+    }
   return h;
 }
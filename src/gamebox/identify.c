@@ -0,0 +1,1056 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2006-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <regex.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <zlib.h>
+
+#include "protos.h"
+
+
+/*
+ * Identification matches files against the acceptors and Blorb patterns of
+ * the interpreters discovered, in the same way as the IFP manager does when
+ * a game is run, so that a file cataloged as a game is one that some plugin
+ * will accept.  Where a file is accepted only by an uncompressing or
+ * unarchiving plugin, identification looks inside gzip, zip, and tar data
+ * for the first game, as those plugins do, inflating only as much as needed.
+ *
+ * Patterns are compiled once by identify_prepare() on the main thread.  After
+ * that, identify_file() reads only with pread() on file descriptors it is
+ * given, and uses neither Glk nor the game set, so that it may run on worker
+ * threads.
+ */
+enum {
+  IDENTIFY_MAX_DEPTH = 2,
+  IDENTIFY_MAX_MEMBERS = 64,
+  IDENTIFY_MAX_CHUNKS = 1024,
+  IDENTIFY_INFLATE_LIMIT = 2 * 1024 * 1024,
+  IDENTIFY_INFLATE_CHUNK = 64 * 1024,
+  IDENTIFY_SCAN_LIMIT = 1024 * 1024,
+  IDENTIFY_GAMEINFO_LIMIT = 4096,
+  IDENTIFY_UUID_LENGTH = 36,
+  IDENTIFY_ZIP_TAIL = 65536 + 22,
+  IDENTIFY_ZIP_DIRECTORY_LIMIT = 1024 * 1024,
+  IDENTIFY_TAR_BLOCK = 512
+};
+
+/* Plugins whose engine types mark them as containers, or as catalogs. */
+static const char *const IDENTIFY_CONTAINER_TYPES[] = {
+  "Uncompress", "Unarchive", NULL
+};
+static const char *const IDENTIFY_CATALOG_TYPE = "Xml+Ini";
+
+/* Interpreter patterns, compiled, and held in plugin search order. */
+typedef struct {
+  const char *engine_name;
+  int is_container;
+  int acceptor_offset, acceptor_length;
+  int has_acceptor, has_blorb;
+  regex_t acceptor, blorb;
+} identify_terp_t;
+
+static identify_terp_t *identify_terps = NULL;
+static int identify_terps_count = 0;
+
+/*
+ * A window onto data being identified, either part of a file read through
+ * its descriptor, or part of a memory buffer holding inflated data.
+ */
+typedef struct {
+  int fd;
+  const unsigned char *data;
+  off_t base, size;
+} identify_source_t;
+
+/* Identification results, filled in as found. */
+typedef struct {
+  const char *engine_name;
+  char *ifid, *title, *author, *metadata;
+  int metadata_length;
+} identify_result_t;
+
+
+/*
+ * identify_is_container_type()
+ *
+ * Return TRUE if an engine type is one of the container types.
+ */
+static int
+identify_is_container_type (const char *engine_type)
+{
+  int index_;
+
+  for (index_ = 0; IDENTIFY_CONTAINER_TYPES[index_]; index_++)
+    {
+      if (strcmp (engine_type, IDENTIFY_CONTAINER_TYPES[index_]) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * identify_prepare()
+ * identify_release()
+ *
+ * Compile the acceptor and Blorb patterns of each interpreter discovered,
+ * and free them again.  Interpreters must have been discovered first, and
+ * must not be erased while prepared.  Catalog plugins such as Gamebox itself
+ * are left out, so that catalogs and iFiction files are not taken as games.
+ */
+void
+identify_prepare (void)
+{
+  terpref_t terp;
+  int count, index_;
+
+  identify_release ();
+
+  count = 0;
+  for (terp = terps_iterate (NULL); terp; terp = terps_iterate (terp))
+    count++;
+
+  identify_terps = memory_malloc ((count > 0 ? count : 1)
+                                  * sizeof (*identify_terps));
+
+  /* Terps iterate in reverse of plugin search order, so fill from the end. */
+  index_ = count;
+  for (terp = terps_iterate (NULL); terp; terp = terps_iterate (terp))
+    {
+      int version, acceptor_offset, acceptor_length;
+      const char *build_timestamp, *engine_type, *engine_name,
+                 *engine_version, *blorb_pattern, *acceptor_pattern,
+                 *author_name, *author_email, *engine_home_url,
+                 *builder_name, *builder_email, *engine_description,
+                 *engine_copyright;
+      identify_terp_t *entry;
+
+      terps_get_interpreter (terp, &version, &build_timestamp, &engine_type,
+                             &engine_name, &engine_version, &blorb_pattern,
+                             &acceptor_offset, &acceptor_length,
+                             &acceptor_pattern, &author_name, &author_email,
+                             &engine_home_url, &builder_name, &builder_email,
+                             &engine_description, &engine_copyright);
+
+      entry = identify_terps + --index_;
+      entry->engine_name = engine_name;
+      entry->is_container = engine_type
+                            && identify_is_container_type (engine_type);
+      entry->acceptor_offset = acceptor_offset;
+      entry->acceptor_length = acceptor_length;
+
+      entry->has_acceptor = acceptor_pattern && acceptor_length > 0
+                            && acceptor_offset >= 0
+                            && regcomp (&entry->acceptor, acceptor_pattern,
+                                        REG_EXTENDED | REG_ICASE
+                                        | REG_NOSUB) == 0;
+      entry->has_blorb = blorb_pattern && blorb_pattern[0] != '\0'
+                         && regcomp (&entry->blorb, blorb_pattern,
+                                     REG_EXTENDED | REG_ICASE
+                                     | REG_NOSUB) == 0;
+
+      if (engine_type && strcmp (engine_type, IDENTIFY_CATALOG_TYPE) == 0)
+        {
+          if (entry->has_acceptor)
+            regfree (&entry->acceptor);
+          if (entry->has_blorb)
+            regfree (&entry->blorb);
+          entry->has_acceptor = entry->has_blorb = FALSE;
+        }
+    }
+
+  identify_terps_count = count;
+}
+
+void
+identify_release (void)
+{
+  int index_;
+
+  for (index_ = 0; index_ < identify_terps_count; index_++)
+    {
+      if (identify_terps[index_].has_acceptor)
+        regfree (&identify_terps[index_].acceptor);
+      if (identify_terps[index_].has_blorb)
+        regfree (&identify_terps[index_].blorb);
+    }
+
+  memory_free (identify_terps);
+  identify_terps = NULL;
+  identify_terps_count = 0;
+}
+
+
+/*
+ * identify_read()
+ *
+ * Read data from a source window at the given offset.  Returns FALSE unless
+ * the whole length requested lies within the window, and is read.
+ */
+static int
+identify_read (const identify_source_t *source,
+               off_t offset, void *buffer, size_t length)
+{
+  unsigned char *cursor;
+
+  if (offset < 0 || offset > source->size
+      || (off_t) length > source->size - offset)
+    return FALSE;
+
+  if (!source->data)
+    {
+      cursor = buffer;
+      offset += source->base;
+      while (length > 0)
+        {
+          ssize_t count;
+
+          count = pread (source->fd, cursor, length, offset);
+          if (count <= 0)
+            return FALSE;
+
+          cursor += count;
+          offset += count;
+          length -= count;
+        }
+      return TRUE;
+    }
+
+  memcpy (buffer, source->data + source->base + offset, length);
+  return TRUE;
+}
+
+
+/*
+ * identify_read_prefix()
+ *
+ * Return a malloc'ed copy of up to limit bytes from the start of a source
+ * window, setting its length.  Returns NULL if nothing could be read.
+ */
+static unsigned char *
+identify_read_prefix (const identify_source_t *source,
+                      off_t limit, off_t *length)
+{
+  unsigned char *buffer;
+
+  *length = source->size < limit ? source->size : limit;
+  if (*length == 0)
+    return NULL;
+
+  buffer = memory_malloc (*length);
+  if (!identify_read (source, 0, buffer, *length))
+    {
+      memory_free (buffer);
+      return NULL;
+    }
+
+  return buffer;
+}
+
+
+/*
+ * identify_get_u16()
+ * identify_get_u32()
+ * identify_get_le16()
+ * identify_get_le32()
+ *
+ * Unpack big and little endian values from a byte buffer.
+ */
+static unsigned long
+identify_get_u16 (const unsigned char *bytes)
+{
+  return ((unsigned long) bytes[0] << 8) | bytes[1];
+}
+
+static unsigned long
+identify_get_u32 (const unsigned char *bytes)
+{
+  return ((unsigned long) bytes[0] << 24) | ((unsigned long) bytes[1] << 16)
+         | ((unsigned long) bytes[2] << 8) | bytes[3];
+}
+
+static unsigned long
+identify_get_le16 (const unsigned char *bytes)
+{
+  return ((unsigned long) bytes[1] << 8) | bytes[0];
+}
+
+static unsigned long
+identify_get_le32 (const unsigned char *bytes)
+{
+  return ((unsigned long) bytes[3] << 24) | ((unsigned long) bytes[2] << 16)
+         | ((unsigned long) bytes[1] << 8) | bytes[0];
+}
+
+
+/*
+ * identify_match_binary()
+ *
+ * Match a compiled pattern against the "%02x" space separated rendering of
+ * binary data, as the IFP recognizer does.
+ */
+static int
+identify_match_binary (const regex_t *pattern,
+                       const unsigned char *data, int length)
+{
+  char *representation, *cursor;
+  int index_, match;
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+
+  representation = memory_malloc (length > 0 ? length * 3 : 1);
+  cursor = representation;
+  for (index_ = 0; index_ < length; index_++)
+    {
+      if (index_ > 0)
+        *cursor++ = ' ';
+      *cursor++ = HEX_DIGITS[data[index_] >> 4];
+      *cursor++ = HEX_DIGITS[data[index_] & 0xf];
+    }
+  *cursor = '\0';
+
+  match = (regexec (pattern, representation, 0, NULL, 0) == 0);
+  memory_free (representation);
+  return match;
+}
+
+
+/*
+ * identify_match_acceptor()
+ *
+ * Return TRUE if the acceptor of an interpreter matches a source window.
+ */
+static int
+identify_match_acceptor (const identify_terp_t *terp,
+                         const identify_source_t *source)
+{
+  unsigned char *buffer;
+  int match;
+
+  if (!terp->has_acceptor)
+    return FALSE;
+
+  buffer = memory_malloc (terp->acceptor_length);
+  match = identify_read (source, terp->acceptor_offset,
+                         buffer, terp->acceptor_length)
+          && identify_match_binary (&terp->acceptor,
+                                    buffer, terp->acceptor_length);
+  memory_free (buffer);
+  return match;
+}
+
+
+/*
+ * identify_copy_ifid()
+ *
+ * Return a malloc'ed upper cased copy of an IFID of the given length.
+ */
+static char *
+identify_copy_ifid (const unsigned char *ifid, int length)
+{
+  char *copy;
+  int index_;
+
+  copy = memory_malloc (length + 1);
+  for (index_ = 0; index_ < length; index_++)
+    copy[index_] = toupper (ifid[index_]);
+  copy[length] = '\0';
+
+  return copy;
+}
+
+
+/*
+ * identify_find_uuid()
+ *
+ * Search story data for an embedded "UUID://...//" IFID, as written by
+ * Inform and other compilers, returning a malloc'ed IFID or NULL.
+ */
+static char *
+identify_find_uuid (const unsigned char *data, off_t length)
+{
+  static const char MARKER[] = "UUID://";
+  const int marker_length = sizeof (MARKER) - 1;
+  const unsigned char *cursor, *end;
+
+  if (length < marker_length + IDENTIFY_UUID_LENGTH + 2)
+    return NULL;
+
+  end = data + length - (marker_length + IDENTIFY_UUID_LENGTH + 2);
+  for (cursor = data; cursor <= end; cursor++)
+    {
+      const unsigned char *uuid;
+      int index_;
+
+      cursor = memchr (cursor, 'U', end - cursor + 1);
+      if (!cursor)
+        break;
+      if (memcmp (cursor, MARKER, marker_length) != 0)
+        continue;
+
+      uuid = cursor + marker_length;
+      for (index_ = 0; index_ < IDENTIFY_UUID_LENGTH; index_++)
+        {
+          if (!isxdigit (uuid[index_]) && uuid[index_] != '-')
+            break;
+        }
+
+      if (index_ == IDENTIFY_UUID_LENGTH
+          && memcmp (uuid + IDENTIFY_UUID_LENGTH, "//", 2) == 0)
+        return identify_copy_ifid (uuid, IDENTIFY_UUID_LENGTH);
+    }
+
+  return NULL;
+}
+
+
+/*
+ * identify_get_zcode_ifid()
+ *
+ * Form the legacy Treaty of Babel IFID of a Z-code story from its header
+ * release, serial, and checksum.  Returns NULL if the data is too short.
+ */
+static char *
+identify_get_zcode_ifid (const unsigned char *data, off_t length)
+{
+  const unsigned char *serial;
+  char buffer[64];
+  int index_;
+
+  if (length < 64)
+    return NULL;
+
+  serial = data + 0x12;
+  for (index_ = 0; index_ < 6; index_++)
+    {
+      if (!isalnum (serial[index_]))
+        return NULL;
+    }
+
+  snprintf (buffer, sizeof (buffer), "ZCODE-%lu-%.6s",
+            identify_get_u16 (data + 0x02), serial);
+  if (memcmp (serial, "000000", 6) != 0
+      && isdigit (serial[0]) && serial[0] != '8')
+    {
+      snprintf (buffer + strlen (buffer), sizeof (buffer) - strlen (buffer),
+                "-%04lX", identify_get_u16 (data + 0x1c));
+    }
+
+  return memory_strdup (buffer);
+}
+
+
+/*
+ * identify_get_gameinfo()
+ *
+ * Search TADS story data for its GameInfo.txt resource, and take the game
+ * name, byline, and IFID from it.  Values are left as UTF-8.
+ */
+static void
+identify_get_gameinfo (const unsigned char *data, off_t length,
+                       identify_result_t *result)
+{
+  static const char MARKER[] = "GameInfo.txt";
+  const int marker_length = sizeof (MARKER) - 1;
+  const unsigned char *cursor, *last, *end;
+
+  if (length < marker_length)
+    return;
+
+  end = NULL;
+  last = data + length - marker_length;
+  for (cursor = data; cursor && cursor <= last; cursor++)
+    {
+      cursor = memchr (cursor, 'G', last - cursor + 1);
+      if (cursor && memcmp (cursor, MARKER, marker_length) == 0)
+        {
+          end = cursor + IDENTIFY_GAMEINFO_LIMIT;
+          if (end > data + length)
+            end = data + length;
+          break;
+        }
+    }
+  if (!end)
+    return;
+
+  /* Read "Key: value" lines, stopping at the first NUL. */
+  while (cursor < end && *cursor != '\0')
+    {
+      const unsigned char *line_end, *value;
+      char **field;
+      int value_length;
+
+      line_end = cursor;
+      while (line_end < end && *line_end != '\n' && *line_end != '\0')
+        line_end++;
+
+      field = NULL;
+      value = NULL;
+      if (line_end - cursor > 5 && strncasecmp ((const char *) cursor,
+                                                "Name:", 5) == 0)
+        field = &result->title, value = cursor + 5;
+      else if (line_end - cursor > 7 && strncasecmp ((const char *) cursor,
+                                                     "Byline:", 7) == 0)
+        field = &result->author, value = cursor + 7;
+      else if (line_end - cursor > 5 && strncasecmp ((const char *) cursor,
+                                                     "IFID:", 5) == 0)
+        field = &result->ifid, value = cursor + 5;
+
+      if (field && !*field)
+        {
+          while (value < line_end && isspace (*value))
+            value++;
+          if (field == &result->author
+              && line_end - value > 3 && strncasecmp ((const char *) value,
+                                                      "by ", 3) == 0)
+            value += 3;
+
+          value_length = line_end - value;
+          while (value_length > 0 && isspace (value[value_length - 1]))
+            value_length--;
+
+          if (value_length > 0)
+            {
+              *field = memory_malloc (value_length + 1);
+              memcpy (*field, value, value_length);
+              (*field)[value_length] = '\0';
+            }
+        }
+
+      cursor = line_end + 1;
+    }
+}
+
+
+/*
+ * identify_get_story_metadata()
+ *
+ * Take what metadata can be found from the story data in a source window,
+ * by its format: an IFID for Z-code and Glulx, and name, byline, and IFID
+ * for TADS.  Only the leading part of large stories is searched.
+ */
+static void
+identify_get_story_metadata (const identify_source_t *source,
+                             identify_result_t *result)
+{
+  unsigned char *data;
+  off_t length;
+
+  data = identify_read_prefix (source, IDENTIFY_SCAN_LIMIT, &length);
+  if (!data)
+    return;
+
+  if (length >= 10 && (memcmp (data, "TADS2 bin", 9) == 0
+                       || memcmp (data, "T3-image", 8) == 0))
+    identify_get_gameinfo (data, length, result);
+
+  if (!result->ifid)
+    result->ifid = identify_find_uuid (data, length);
+
+  if (!result->ifid && data[0] >= 1 && data[0] <= 8)
+    result->ifid = identify_get_zcode_ifid (data, length);
+
+  memory_free (data);
+}
+
+
+/*
+ * identify_blorb()
+ *
+ * If a source window holds Blorb data, find the chunk type of its first
+ * executable resource, and the position of its executable and any IFmd
+ * metadata chunk.  Returns FALSE if not Blorb, or Blorb with no executable.
+ */
+static int
+identify_blorb (const identify_source_t *source, unsigned char exec_type[4],
+                off_t *exec_offset, off_t *exec_length,
+                off_t *metadata_offset, off_t *metadata_length)
+{
+  unsigned char header[12];
+  off_t offset, end, exec_start;
+  int chunk;
+
+  if (!identify_read (source, 0, header, sizeof (header))
+      || memcmp (header, "FORM", 4) != 0 || memcmp (header + 8, "IFRS", 4) != 0)
+    return FALSE;
+
+  end = 8 + (off_t) identify_get_u32 (header + 4);
+  if (end > source->size)
+    end = source->size;
+
+  exec_start = -1;
+  *metadata_offset = *metadata_length = 0;
+
+  /* Walk the chunks, noting the resource index and any metadata. */
+  offset = sizeof (header);
+  for (chunk = 0; chunk < IDENTIFY_MAX_CHUNKS && offset + 8 <= end; chunk++)
+    {
+      unsigned char chunk_header[8];
+      off_t length;
+
+      if (!identify_read (source, offset, chunk_header, sizeof (chunk_header)))
+        break;
+      length = identify_get_u32 (chunk_header + 4);
+
+      if (memcmp (chunk_header, "RIdx", 4) == 0 && exec_start < 0)
+        {
+          unsigned char count[4], entry[12];
+          unsigned long entries, index_;
+
+          if (!identify_read (source, offset + 8, count, sizeof (count)))
+            break;
+          entries = identify_get_u32 (count);
+          for (index_ = 0; index_ < entries && 4 + (index_ + 1) * 12
+                                               <= (unsigned long) length;
+               index_++)
+            {
+              if (!identify_read (source, offset + 12 + index_ * 12,
+                                  entry, sizeof (entry)))
+                break;
+              if (memcmp (entry, "Exec", 4) == 0
+                  && identify_get_u32 (entry + 4) == 0)
+                {
+                  exec_start = identify_get_u32 (entry + 8);
+                  break;
+                }
+            }
+        }
+      else if (memcmp (chunk_header, "IFmd", 4) == 0)
+        {
+          *metadata_offset = offset + 8;
+          *metadata_length = length;
+        }
+
+      offset += 8 + length + (length & 1);
+    }
+
+  if (exec_start < 0
+      || !identify_read (source, exec_start, header, 8))
+    return FALSE;
+
+  memcpy (exec_type, header, 4);
+  *exec_offset = exec_start + 8;
+  *exec_length = identify_get_u32 (header + 4);
+  if (*exec_offset + *exec_length > source->size)
+    *exec_length = source->size - *exec_offset;
+
+  return TRUE;
+}
+
+
+/*
+ * identify_inflate()
+ *
+ * Inflate compressed data from a source window, returning a malloc'ed
+ * buffer of up to IDENTIFY_INFLATE_LIMIT bytes of output and setting its
+ * length.  Inflation stops early, and without error, when the limit is
+ * reached.  Returns NULL if nothing could be inflated.
+ */
+static unsigned char *
+identify_inflate (const identify_source_t *source, off_t offset,
+                  off_t length, int window_bits, off_t *inflated_length)
+{
+  unsigned char *input, *output;
+  z_stream stream;
+  int status;
+
+  memset (&stream, 0, sizeof (stream));
+  if (inflateInit2 (&stream, window_bits) != Z_OK)
+    return NULL;
+
+  input = memory_malloc (IDENTIFY_INFLATE_CHUNK);
+  output = memory_malloc (IDENTIFY_INFLATE_LIMIT);
+  stream.next_out = output;
+  stream.avail_out = IDENTIFY_INFLATE_LIMIT;
+
+  status = Z_OK;
+  while (status == Z_OK && stream.avail_out > 0 && length > 0)
+    {
+      size_t count;
+
+      count = length < IDENTIFY_INFLATE_CHUNK ? length : IDENTIFY_INFLATE_CHUNK;
+      if (!identify_read (source, offset, input, count))
+        break;
+      offset += count;
+      length -= count;
+
+      stream.next_in = input;
+      stream.avail_in = count;
+      while (status == Z_OK && stream.avail_in > 0 && stream.avail_out > 0)
+        status = inflate (&stream, Z_SYNC_FLUSH);
+    }
+
+  *inflated_length = IDENTIFY_INFLATE_LIMIT - stream.avail_out;
+  inflateEnd (&stream);
+  memory_free (input);
+
+  if (*inflated_length == 0)
+    {
+      memory_free (output);
+      return NULL;
+    }
+
+  return output;
+}
+
+
+static int identify_source (const identify_source_t *source,
+                            int depth, identify_result_t *result);
+
+/*
+ * identify_member()
+ *
+ * Identify a member of a container, either stored, and so a window onto
+ * the container's source, or compressed and inflated into memory.
+ */
+static int
+identify_member (const identify_source_t *source, off_t offset,
+                 off_t length, int window_bits, int depth,
+                 identify_result_t *result)
+{
+  identify_source_t member;
+  unsigned char *inflated;
+  int status;
+
+  inflated = NULL;
+  if (window_bits)
+    {
+      inflated = identify_inflate (source, offset, length,
+                                   window_bits, &member.size);
+      if (!inflated)
+        return FALSE;
+
+      member.fd = -1;
+      member.data = inflated;
+      member.base = 0;
+    }
+  else
+    {
+      if (offset < 0 || offset > source->size
+          || length > source->size - offset)
+        return FALSE;
+
+      member = *source;
+      member.base += offset;
+      member.size = length;
+    }
+
+  status = identify_source (&member, depth + 1, result);
+  memory_free (inflated);
+  return status;
+}
+
+
+/*
+ * identify_zip()
+ *
+ * Identify the first game in zip data, using its central directory to find
+ * members, which may be stored or deflated.
+ */
+static int
+identify_zip (const identify_source_t *source, int depth,
+              identify_result_t *result)
+{
+  unsigned char *tail, *directory, *entry;
+  off_t tail_length, tail_offset, directory_offset, directory_length;
+  int index_, entries, status;
+
+  tail_length = source->size < IDENTIFY_ZIP_TAIL
+                ? source->size : IDENTIFY_ZIP_TAIL;
+  tail_offset = source->size - tail_length;
+  if (tail_length < 22)
+    return FALSE;
+
+  tail = memory_malloc (tail_length);
+  if (!identify_read (source, tail_offset, tail, tail_length))
+    {
+      memory_free (tail);
+      return FALSE;
+    }
+
+  /* Find the end of central directory record, searching backwards. */
+  for (index_ = tail_length - 22; index_ >= 0; index_--)
+    {
+      if (memcmp (tail + index_, "PK\5\6", 4) == 0)
+        break;
+    }
+  if (index_ < 0)
+    {
+      memory_free (tail);
+      return FALSE;
+    }
+
+  entries = identify_get_le16 (tail + index_ + 10);
+  directory_length = identify_get_le32 (tail + index_ + 12);
+  directory_offset = identify_get_le32 (tail + index_ + 16);
+  memory_free (tail);
+
+  if (directory_length > IDENTIFY_ZIP_DIRECTORY_LIMIT)
+    directory_length = IDENTIFY_ZIP_DIRECTORY_LIMIT;
+  directory = memory_malloc (directory_length > 0 ? directory_length : 1);
+  if (!identify_read (source, directory_offset, directory, directory_length))
+    {
+      memory_free (directory);
+      return FALSE;
+    }
+
+  /* Try each plain file member in turn, stopping at the first game. */
+  status = FALSE;
+  entry = directory;
+  for (index_ = 0; index_ < entries && index_ < IDENTIFY_MAX_MEMBERS
+                   && entry + 46 <= directory + directory_length; index_++)
+    {
+      unsigned long flags, method, compressed, name_length, local_offset;
+      unsigned char local[30];
+
+      if (memcmp (entry, "PK\1\2", 4) != 0)
+        break;
+
+      flags = identify_get_le16 (entry + 8);
+      method = identify_get_le16 (entry + 10);
+      compressed = identify_get_le32 (entry + 20);
+      name_length = identify_get_le16 (entry + 28);
+      local_offset = identify_get_le32 (entry + 42);
+
+      if (!(flags & 1) && (method == 0 || method == 8) && compressed > 0
+          && entry + 46 + name_length <= directory + directory_length
+          && entry[46 + name_length - 1] != '/'
+          && identify_read (source, local_offset, local, sizeof (local))
+          && memcmp (local, "PK\3\4", 4) == 0)
+        {
+          off_t data_offset;
+
+          data_offset = local_offset + sizeof (local)
+                        + identify_get_le16 (local + 26)
+                        + identify_get_le16 (local + 28);
+          status = identify_member (source, data_offset, compressed,
+                                    method == 8 ? -MAX_WBITS : 0,
+                                    depth, result);
+          if (status)
+            break;
+        }
+
+      entry += 46 + name_length + identify_get_le16 (entry + 30)
+               + identify_get_le16 (entry + 32);
+    }
+
+  memory_free (directory);
+  return status;
+}
+
+
+/*
+ * identify_tar()
+ *
+ * Identify the first game in ustar data, walking its member headers.
+ */
+static int
+identify_tar (const identify_source_t *source, int depth,
+              identify_result_t *result)
+{
+  unsigned char header[IDENTIFY_TAR_BLOCK];
+  off_t offset;
+  int member;
+
+  offset = 0;
+  for (member = 0; member < IDENTIFY_MAX_MEMBERS; member++)
+    {
+      off_t length;
+      int index_;
+
+      if (!identify_read (source, offset, header, sizeof (header))
+          || memcmp (header + 257, "ustar", 5) != 0)
+        break;
+
+      length = 0;
+      for (index_ = 124; index_ < 136 && header[index_] >= '0'
+                         && header[index_] <= '7'; index_++)
+        length = length * 8 + header[index_] - '0';
+
+      if ((header[156] == '0' || header[156] == '\0') && length > 0
+          && identify_member (source, offset + IDENTIFY_TAR_BLOCK, length,
+                              0, depth, result))
+        return TRUE;
+
+      offset += IDENTIFY_TAR_BLOCK
+                + (length + IDENTIFY_TAR_BLOCK - 1)
+                  / IDENTIFY_TAR_BLOCK * IDENTIFY_TAR_BLOCK;
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * identify_container()
+ *
+ * Look inside a source window accepted by a container plugin, if it holds
+ * gzip, zip, or tar data.  Other formats such plugins accept are not looked
+ * into, and so are not identified.
+ */
+static int
+identify_container (const identify_source_t *source, int depth,
+                    identify_result_t *result)
+{
+  unsigned char magic[262];
+
+  if (identify_read (source, 0, magic, 2)
+      && magic[0] == 0x1f && magic[1] == 0x8b)
+    return identify_member (source, 0, source->size,
+                            16 + MAX_WBITS, depth, result);
+
+  if (identify_read (source, 0, magic, 4) && memcmp (magic, "PK\3\4", 4) == 0)
+    return identify_zip (source, depth, result);
+
+  if (identify_read (source, 0, magic, sizeof (magic))
+      && memcmp (magic + 257, "ustar", 5) == 0)
+    return identify_tar (source, depth, result);
+
+  return FALSE;
+}
+
+
+/*
+ * identify_source()
+ *
+ * Identify the data in a source window.  Blorb data is matched on its
+ * executable chunk type, and other data on interpreter acceptors, taking
+ * the first interpreter to match.  Data accepted only by a container plugin
+ * is looked inside, to a limited depth.
+ */
+static int
+identify_source (const identify_source_t *source, int depth,
+                 identify_result_t *result)
+{
+  unsigned char exec_type[4];
+  off_t exec_offset, exec_length, metadata_offset, metadata_length;
+  int index_, is_container;
+
+  if (identify_blorb (source, exec_type, &exec_offset, &exec_length,
+                      &metadata_offset, &metadata_length))
+    {
+      identify_source_t exec;
+
+      for (index_ = 0; index_ < identify_terps_count; index_++)
+        {
+          if (identify_terps[index_].has_blorb
+              && identify_match_binary (&identify_terps[index_].blorb,
+                                        exec_type, sizeof (exec_type)))
+            break;
+        }
+      if (index_ == identify_terps_count)
+        return FALSE;
+
+      result->engine_name = identify_terps[index_].engine_name;
+
+      if (metadata_length > 0 && metadata_length < IDENTIFY_SCAN_LIMIT)
+        {
+          result->metadata = memory_malloc (metadata_length);
+          if (identify_read (source, metadata_offset,
+                             result->metadata, metadata_length))
+            result->metadata_length = metadata_length;
+          else
+            {
+              memory_free (result->metadata);
+              result->metadata = NULL;
+            }
+        }
+
+      exec = *source;
+      exec.base += exec_offset;
+      exec.size = exec_length;
+      identify_get_story_metadata (&exec, result);
+      return TRUE;
+    }
+
+  is_container = FALSE;
+  for (index_ = 0; index_ < identify_terps_count; index_++)
+    {
+      if (identify_match_acceptor (identify_terps + index_, source))
+        {
+          if (!identify_terps[index_].is_container)
+            {
+              result->engine_name = identify_terps[index_].engine_name;
+              identify_get_story_metadata (source, result);
+              return TRUE;
+            }
+
+          is_container = TRUE;
+        }
+    }
+
+  if (is_container && depth < IDENTIFY_MAX_DEPTH)
+    return identify_container (source, depth, result);
+
+  return FALSE;
+}
+
+
+/*
+ * identify_file()
+ *
+ * Identify the game, if any, in the open file of the given size.  Returns
+ * TRUE if the file is a game, with the name of the engine that will run it,
+ * any IFID, title, and author found, and any Blorb iFiction metadata.  Title
+ * and author are UTF-8.  Strings returned are malloc'ed, other than the
+ * engine name, which lasts while interpreters are prepared.
+ */
+int
+identify_file (int fd, off_t size, const char **engine_name,
+               char **ifid, char **title, char **author,
+               char **metadata, int *metadata_length)
+{
+  identify_source_t source;
+  identify_result_t result;
+  int status;
+  assert (fd >= 0 && engine_name && ifid && title && author
+          && metadata && metadata_length);
+
+  source.fd = fd;
+  source.data = NULL;
+  source.base = 0;
+  source.size = size;
+
+  memset (&result, 0, sizeof (result));
+  status = identify_source (&source, 0, &result);
+  if (!status)
+    {
+      memory_free (result.ifid);
+      memory_free (result.title);
+      memory_free (result.author);
+      memory_free (result.metadata);
+      memset (&result, 0, sizeof (result));
+    }
+
+  *engine_name = result.engine_name;
+  *ifid = result.ifid;
+  *title = result.title;
+  *author = result.author;
+  *metadata = result.metadata;
+  *metadata_length = result.metadata_length;
+  return status;
+}
@@ -19,6 +19,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "protos.h"
@@ -126,8 +127,9 @@ ini_parse_section (const inisectionref_t section, int is_iso_encoded)
       if (!title)
         title = memory_strdup ("[Unknown Game]");
 
-      gameset_add_game (about, author, byline, description, genre, headline,
-                        length, publisher, release_date, title, version);
+      gameset_add_game (about, NULL, author, byline, description, genre,
+                        headline, length, publisher, release_date, title,
+                        version);
     }
 
   memory_free (about);
@@ -144,18 +146,53 @@ ini_parse_section (const inisectionref_t section, int is_iso_encoded)
 }
 
 
+/*
+ * ini_parse_directory()
+ *
+ * Catalog the games in a directory named by an ini file.  A relative
+ * directory is taken relative to the ini file's own directory.
+ */
+static int
+ini_parse_directory (const char *ini_file,
+                     const char *directory, int dump_document)
+{
+  const char *slash;
+  char *path, *resolved;
+  int status;
+
+  slash = strrchr (ini_file, '/');
+  if (directory[0] != '/' && slash)
+    {
+      path = memory_malloc (slash - ini_file + strlen (directory) + 2);
+      memcpy (path, ini_file, slash - ini_file + 1);
+      strcpy (path + (slash - ini_file + 1), directory);
+    }
+  else
+    path = memory_strdup (directory);
+
+  /* Catalog under a canonical absolute path, so game locations are too. */
+  resolved = realpath (path, NULL);
+  status = dir_parse_directory (resolved ? resolved : path, dump_document);
+
+  free (resolved);
+  memory_free (path);
+  return status;
+}
+
+
 /*
  * ini_parse_file()
  *
- * Parse the given ini file into a set of games.
+ * Parse the given ini file into a set of games.  If the ini file sets the
+ * global property 'directory', also catalog the games found there.
  */
 int
 ini_parse_file (const char *ini_file, int dump_document)
 {
   inidocref_t document;
   inisectionref_t section;
-  const char *encoding;
-  int is_iso_encoded;
+  const char *encoding, *directory;
+  int is_iso_encoded, status;
 
   document = inidoc_parse (ini_file);
   if (!document)
@@ -173,6 +210,10 @@ ini_parse_file (const char *ini_file, int dump_document)
       ini_parse_section (section, is_iso_encoded);
     }
 
+  directory = inidoc_get_global_property_value (document, "directory");
+  status = directory
+           ? ini_parse_directory (ini_file, directory, dump_document) : TRUE;
+
   inidoc_free (document);
-  return TRUE;
+  return status;
 }
@@ -34,33 +34,36 @@ struct terp_s
 {
   unsigned int magic;
 
-  int  version;              /* Header version used by the engine. */
-  char *build_timestamp;     /* Date and time of plugin build */
+  int  version;                     /* Header version used by the engine. */
+  const char *build_timestamp;      /* Date and time of plugin build */
 
-  char *engine_type;         /* Data type the engine runs. */
-  char *engine_name;         /* Unique engine name. */
-  char *engine_version;      /* Engine's version number. */
+  const char *engine_type;          /* Data type the engine runs. */
+  const char *engine_name;          /* Unique engine name. */
+  const char *engine_version;       /* Engine's version number. */
 
-  char *blorb_pattern;       /* If Blorb-capable, the exec type. */
+  const char *blorb_pattern;        /* If Blorb-capable, the exec type. */
 
-  int  acceptor_offset;      /* Offset in file to "magic". */
-  int  acceptor_length;      /* Length of "magic". */
-  char *acceptor_pattern;    /* Regular expression for "magic". */
+  int  acceptor_offset;             /* Offset in file to "magic". */
+  int  acceptor_length;             /* Length of "magic". */
+  const char *acceptor_pattern;     /* Regular expression for "magic". */
 
-  char *author_name;         /* Interpreter author's name. */
-  char *author_email;        /* Interpreter author's email. */
-  char *engine_home_url;     /* Any URL regarding the interpreter. */
+  const char *author_name;          /* Interpreter author's name. */
+  const char *author_email;         /* Interpreter author's email. */
+  const char *engine_home_url;      /* Any URL regarding the interpreter. */
 
-  char *builder_name;        /* Engine porter/builder's name. */
-  char *builder_email;       /* Engine porter/builder's email. */
+  const char *builder_name;         /* Engine porter/builder's name. */
+  const char *builder_email;        /* Engine porter/builder's email. */
 
-  char *engine_description;  /* Miscellaneous engine information. */
-  char *engine_copyright;    /* Engine's copyright information. */
+  const char *engine_description;   /* Miscellaneous engine information. */
+  const char *engine_copyright;     /* Engine's copyright information. */
 
   terpref_t next;
 };
 
-/* List of interpreter descriptors, unordered. */
+/*
+ * List of interpreter descriptors, unordered.  Descriptor strings point into
+ * the IFP plugin header index, and remain valid until the list is erased.
+ */
 static terpref_t terps_head = NULL;
 
 
@@ -77,47 +80,32 @@ static terpref_t terps_head = NULL;
 void
 terps_discover (void)
 {
-  ifp_pluginref_t plugin;
+  ifp_index_entryref_t entry;
 
-  ifp_loader_search_plugins_path (ifp_manager_get_plugin_path ());
+  /*
+   * Read plugin headers from the index rather than the loader, so that
+   * listing interpreters neither loads nor maps any of them.
+   */
+  ifp_index_search_plugins_path (ifp_manager_get_plugin_path ());
 
-  for (plugin = ifp_loader_iterate_plugins (NULL);
-       plugin; plugin = ifp_loader_iterate_plugins (plugin))
+  for (entry = ifp_index_iterate_entries (NULL);
+       entry; entry = ifp_index_iterate_entries (entry))
     {
-      int version, acceptor_offset, acceptor_length;
-      const char *engine_type, *engine_name, *engine_version, *build_timestamp,
-                 *blorb_pattern, *acceptor_pattern, *author_name, *author_email,
-                 *engine_home_url, *builder_name, *builder_email,
-                 *engine_description, *engine_copyright;
       terpref_t terp;
 
-      ifp_plugin_dissect_header (plugin, &version,
-                                 &engine_type, &engine_name, &engine_version,
-                                 &build_timestamp, &blorb_pattern,
-                                 &acceptor_offset, &acceptor_length,
-                                 &acceptor_pattern, &author_name, &author_email,
-                                 &engine_home_url,
-                                 &builder_name, &builder_email,
-                                 &engine_description, &engine_copyright);
-
       terp = memory_malloc (sizeof (*terp));
       terp->magic = TERP_MAGIC;
-      terp->version = version;
-      terp->build_timestamp = memory_strdup (build_timestamp);
-      terp->engine_type = memory_strdup (engine_type);
-      terp->engine_name = memory_strdup (engine_name);
-      terp->engine_version = memory_strdup (engine_version);
-      terp->blorb_pattern = memory_strdup (blorb_pattern);
-      terp->acceptor_offset = acceptor_offset;
-      terp->acceptor_length = acceptor_length;
-      terp->acceptor_pattern = memory_strdup (acceptor_pattern);
-      terp->author_name = memory_strdup (author_name);
-      terp->author_email = memory_strdup (author_email);
-      terp->engine_home_url = memory_strdup (engine_home_url);
-      terp->builder_name = memory_strdup (builder_name);
-      terp->builder_email = memory_strdup (builder_email);
-      terp->engine_description = memory_strdup (engine_description);
-      terp->engine_copyright = memory_strdup (engine_copyright);
+      ifp_index_dissect_entry (entry, &terp->version,
+                               &terp->engine_type, &terp->engine_name,
+                               &terp->engine_version, &terp->build_timestamp,
+                               &terp->blorb_pattern,
+                               &terp->acceptor_offset, &terp->acceptor_length,
+                               &terp->acceptor_pattern,
+                               &terp->author_name, &terp->author_email,
+                               &terp->engine_home_url,
+                               &terp->builder_name, &terp->builder_email,
+                               &terp->engine_description,
+                               &terp->engine_copyright);
 
       terp->next = terps_head;
       terps_head = terp;
@@ -202,25 +190,12 @@ terps_erase (void)
     {
       next = terp->next;
 
-      memory_free (terp->build_timestamp);
-      memory_free (terp->engine_type);
-      memory_free (terp->engine_name);
-      memory_free (terp->engine_version);
-      memory_free (terp->blorb_pattern);
-      memory_free (terp->acceptor_pattern);
-      memory_free (terp->author_name);
-      memory_free (terp->author_email);
-      memory_free (terp->engine_home_url);
-      memory_free (terp->builder_name);
-      memory_free (terp->builder_email);
-      memory_free (terp->engine_description);
-      memory_free (terp->engine_copyright);
-
       memset (terp, 0, sizeof (*terp));
       memory_free (terp);
     }
 
   terps_head = NULL;
+  ifp_index_forget_all_entries ();
 }
 
 
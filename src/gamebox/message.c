@@ -131,6 +131,8 @@ message_read_line (const char *prompt, char *buffer, int length)
 
           glk_request_line_event (window, buffer, length - 1, partial.val1);
         }
+      else if (event.type == evtype_Timer)
+        prefetch_handle_timer ();
     }
   while (event.type != evtype_LineInput);
 
@@ -245,7 +247,7 @@ message_write_line (int return_immediately, const char *format, ...)
   winid_t window;
   strid_t stream;
   event_t event;
-  int timeouts = 0;
+  int timeouts = 0, is_prefetching;
   va_list ap;
   char message[1024];
   assert (format);
@@ -271,6 +273,12 @@ message_write_line (int return_immediately, const char *format, ...)
   if (!message_window)
     glk_c_put_string_stream (stream, "\n<Press Return to continue...>");
 
+  /*
+   * The message timeout replaces any prefetch timer, which is restored when
+   * the message is dismissed.
+   */
+  is_prefetching = prefetch_stop_timer ();
+
   glk_request_char_event (window);
   if (glk_gestalt (gestalt_Timer, 0))
     {
@@ -299,6 +307,8 @@ message_write_line (int return_immediately, const char *format, ...)
   glk_cancel_char_event (window);
   if (glk_gestalt (gestalt_Timer, 0))
     glk_request_timer_events (0);
+  if (is_prefetching)
+    prefetch_start_timer ();
 
   message_end_dialog ();
 }
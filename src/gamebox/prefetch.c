@@ -0,0 +1,563 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2006-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+#include <glk.h>
+#include <ifp.h>
+
+#include "protos.h"
+
+
+/*
+ * The prefetcher downloads remote games the user is likely to run next into
+ * the IFP URL cache, while Gamebox waits for input, so that running them is
+ * a cache hit rather than a download.  Likely games are those listed on the
+ * page on display, in page order, followed by those played most recently.
+ * Work is done a step at a time on Glk timer events, so the display stays
+ * responsive, and only one download is in progress at any time.
+ *
+ * Downloads are limited to a rate in bytes per second, by capping the data
+ * read on each timer event and leaving the rest in the network, and games
+ * prefetched but not yet played may fill only a share of the URL cache, so
+ * that they do not push out games already played.  A game that fails to
+ * download, or that is too large for the cache share, is not tried again.
+ */
+
+/* Timer tick in milliseconds, and default download rate in bytes/second. */
+enum { PREFETCH_TICK = 100, PREFETCH_DEFAULT_RATE = 65536 };
+
+/* Divisor giving the share of the URL cache limit prefetches may fill. */
+enum { PREFETCH_CACHE_SHARE = 2 };
+
+/* Count of recently played games to remember. */
+enum { PREFETCH_RECENT_GAMES = 8 };
+
+/*
+ * Locations to prefetch, most likely first, locations played most recently,
+ * most recent first, and locations that failed.  All hold copied strings.
+ */
+static vectorref_t prefetch_candidates = NULL,
+                   prefetch_recent = NULL,
+                   prefetch_failed = NULL;
+
+/*
+ * Locations prefetched and not yet played, with the bytes each added to the
+ * URL cache.  Locations are copied strings.
+ */
+typedef struct {
+  char *location;
+  int size;
+} prefetch_fetched_t;
+static vectorref_t prefetch_fetched = NULL;
+
+/* Download in progress, and its location. */
+static ifp_urlref_t prefetch_url = NULL;
+static char *prefetch_location = NULL;
+
+/* Flag set while Glk timer events are requested. */
+static int prefetch_is_timing = FALSE;
+
+
+/*
+ * prefetch_get_rate()
+ *
+ * Return the download rate limit in bytes per second, taken from the
+ * environment variable GAMEBOX_PREFETCH_RATE if set.  A rate of zero turns
+ * prefetching off.
+ */
+static int
+prefetch_get_rate (void)
+{
+  static int rate, initialized = FALSE;
+
+  if (!initialized)
+    {
+      const char *prefetch_rate;
+
+      prefetch_rate = getenv ("GAMEBOX_PREFETCH_RATE");
+      rate = prefetch_rate ? atoi (prefetch_rate) : PREFETCH_DEFAULT_RATE;
+      if (rate < 0)
+        rate = PREFETCH_DEFAULT_RATE;
+
+      initialized = TRUE;
+    }
+
+  return rate;
+}
+
+
+/*
+ * prefetch_is_remote()
+ * prefetch_is_listed()
+ * prefetch_clear_list()
+ *
+ * Return TRUE if a location is a remote URL, and if a location is in a list
+ * of locations.  And empty a list, freeing its location strings.
+ */
+static int
+prefetch_is_remote (const char *location)
+{
+  return strncasecmp (location, "http:", strlen ("http:")) == 0
+         || strncasecmp (location, "ftp:", strlen ("ftp:")) == 0;
+}
+
+static int
+prefetch_is_listed (const vectorref_t list, const char *location)
+{
+  int index_;
+
+  if (!list)
+    return FALSE;
+
+  for (index_ = 0; index_ < vector_get_length (list); index_++)
+    {
+      const char *entry;
+
+      vector_get (list, index_, &entry);
+      if (strcmp (entry, location) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+prefetch_clear_list (vectorref_t list)
+{
+  int index_;
+
+  for (index_ = 0; index_ < vector_get_length (list); index_++)
+    {
+      char *entry;
+
+      vector_get (list, index_, &entry);
+      memory_free (entry);
+    }
+
+  vector_clear (list);
+}
+
+
+/*
+ * prefetch_add_candidate()
+ * prefetch_set_page()
+ * prefetch_note_played()
+ *
+ * Add a location to the list to prefetch if it is remote and not already
+ * listed.  Rebuild the list from the games in a page's display map and the
+ * games played recently, and note a location as played.
+ */
+static void
+prefetch_add_candidate (const char *location)
+{
+  char *copy;
+
+  if (!prefetch_is_remote (location)
+      || prefetch_is_listed (prefetch_candidates, location))
+    return;
+
+  copy = memory_strdup (location);
+  vector_append (prefetch_candidates, &copy);
+}
+
+void
+prefetch_set_page (const vectorref_t display_map)
+{
+  int index_;
+
+  if (prefetch_candidates)
+    prefetch_clear_list (prefetch_candidates);
+  else
+    prefetch_candidates = vector_create (sizeof (char *));
+
+  for (index_ = 0; index_ < vector_get_length (display_map); index_++)
+    {
+      gameref_t game;
+      glui32 id;
+
+      vector_get (display_map, index_, &id);
+      game = gameset_id_to_game (id);
+      if (game)
+        prefetch_add_candidate (gameset_get_game_location (game));
+    }
+
+  if (prefetch_recent)
+    {
+      for (index_ = vector_get_length (prefetch_recent) - 1;
+           index_ >= 0; index_--)
+        {
+          const char *location;
+
+          vector_get (prefetch_recent, index_, &location);
+          prefetch_add_candidate (location);
+        }
+    }
+}
+
+void
+prefetch_note_played (const char *location)
+{
+  char *copy;
+  int index_;
+  assert (location);
+
+  if (!prefetch_is_remote (location))
+    return;
+
+  if (!prefetch_recent)
+    prefetch_recent = vector_create (sizeof (char *));
+
+  /* Remove any earlier note of the location, then append as most recent. */
+  for (index_ = 0; index_ < vector_get_length (prefetch_recent); index_++)
+    {
+      char *entry;
+
+      vector_get (prefetch_recent, index_, &entry);
+      if (strcmp (entry, location) == 0)
+        {
+          vector_delete (prefetch_recent, index_);
+          memory_free (entry);
+          break;
+        }
+    }
+
+  if (vector_get_length (prefetch_recent) == PREFETCH_RECENT_GAMES)
+    {
+      char *oldest;
+
+      vector_unqueue (prefetch_recent, &oldest);
+      memory_free (oldest);
+    }
+
+  copy = memory_strdup (location);
+  vector_append (prefetch_recent, &copy);
+
+  /* A played game no longer counts against the prefetch cache share. */
+  if (prefetch_fetched)
+    {
+      for (index_ = 0; index_ < vector_get_length (prefetch_fetched); index_++)
+        {
+          prefetch_fetched_t fetched;
+
+          vector_get (prefetch_fetched, index_, &fetched);
+          if (strcmp (fetched.location, location) == 0)
+            {
+              vector_delete (prefetch_fetched, index_);
+              memory_free (fetched.location);
+              break;
+            }
+        }
+    }
+}
+
+
+/*
+ * prefetch_get_budget()
+ * prefetch_next_candidate()
+ *
+ * Return the bytes that prefetched data may still add to the URL cache, and
+ * the most likely location not yet cached or failed, or NULL if none.  The
+ * budget counts only prefetched games not yet played that are still cached.
+ */
+static int
+prefetch_get_budget (void)
+{
+  int budget, index_;
+
+  budget = ifp_cache_get_limit () / PREFETCH_CACHE_SHARE;
+
+  if (prefetch_fetched)
+    {
+      for (index_ = 0; index_ < vector_get_length (prefetch_fetched); index_++)
+        {
+          prefetch_fetched_t fetched;
+
+          vector_get (prefetch_fetched, index_, &fetched);
+          if (ifp_cache_has_entry (fetched.location))
+            budget -= fetched.size;
+        }
+    }
+
+  return budget;
+}
+
+static const char *
+prefetch_next_candidate (void)
+{
+  int index_;
+
+  if (!prefetch_candidates)
+    return NULL;
+
+  for (index_ = 0; index_ < vector_get_length (prefetch_candidates); index_++)
+    {
+      const char *location;
+
+      vector_get (prefetch_candidates, index_, &location);
+      if (!ifp_cache_has_entry (location)
+          && !prefetch_is_listed (prefetch_failed, location))
+        return location;
+    }
+
+  return NULL;
+}
+
+
+/*
+ * prefetch_is_pending()
+ *
+ * Return TRUE if there is prefetching to do, and the Glk library offers
+ * the timers that drive it.
+ */
+static int
+prefetch_is_pending (void)
+{
+  if (!glk_gestalt (gestalt_Timer, 0) || prefetch_get_rate () == 0)
+    return FALSE;
+
+  return prefetch_url
+         || (prefetch_next_candidate () && prefetch_get_budget () > 0);
+}
+
+
+/*
+ * prefetch_fail()
+ * prefetch_succeed()
+ * prefetch_finish()
+ *
+ * Note the current download's location as failed, or as fetched with the
+ * bytes it added to the URL cache, and end the current download, canceling
+ * it if incomplete.
+ */
+static void
+prefetch_fail (void)
+{
+  if (!prefetch_failed)
+    prefetch_failed = vector_create (sizeof (char *));
+
+  vector_append (prefetch_failed, &prefetch_location);
+  prefetch_location = NULL;
+}
+
+static void
+prefetch_succeed (int size)
+{
+  prefetch_fetched_t fetched;
+
+  if (!prefetch_fetched)
+    prefetch_fetched = vector_create (sizeof (fetched));
+
+  fetched.location = prefetch_location;
+  fetched.size = size;
+  vector_append (prefetch_fetched, &fetched);
+  prefetch_location = NULL;
+}
+
+static void
+prefetch_finish (void)
+{
+  assert (prefetch_url);
+
+  ifp_url_forget (prefetch_url);
+  prefetch_url = NULL;
+
+  memory_free (prefetch_location);
+  prefetch_location = NULL;
+}
+
+
+/*
+ * prefetch_start()
+ *
+ * Begin downloading the most likely location not yet cached, if the cache
+ * share allows.
+ */
+static void
+prefetch_start (void)
+{
+  const char *location;
+
+  location = prefetch_next_candidate ();
+  if (!location || prefetch_get_budget () <= 0)
+    return;
+
+  prefetch_location = memory_strdup (location);
+  prefetch_url = ifp_url_new_resolve_async (prefetch_location);
+  if (!prefetch_url)
+    prefetch_fail ();
+}
+
+
+/*
+ * prefetch_handle_timer()
+ *
+ * Advance prefetching by one step on a Glk timer event.  Reads only as much
+ * as the rate limit allows in one tick, ends downloads that complete, fail,
+ * or outgrow the cache share, and stops timer events when there is nothing
+ * left to do.
+ */
+void
+prefetch_handle_timer (void)
+{
+  int limit;
+
+  if (!prefetch_url)
+    {
+      prefetch_start ();
+      if (!prefetch_is_pending ())
+        prefetch_stop_timer ();
+      return;
+    }
+
+  limit = prefetch_get_rate () * PREFETCH_TICK / 1000;
+  ifp_url_set_read_limit (prefetch_url, limit > 0 ? limit : 1);
+
+  if (ifp_url_poll_resolved_async (prefetch_url))
+    {
+      if (ifp_url_get_status_async (prefetch_url) != 0)
+        prefetch_fail ();
+      else
+        prefetch_succeed (ifp_url_poll_progress_async (prefetch_url));
+      prefetch_finish ();
+    }
+  else if (ifp_url_poll_progress_async (prefetch_url) > prefetch_get_budget ())
+    {
+      prefetch_fail ();
+      prefetch_finish ();
+    }
+}
+
+
+/*
+ * prefetch_start_timer()
+ * prefetch_stop_timer()
+ *
+ * Request Glk timer events to drive prefetching while waiting for input,
+ * if there is prefetching to do, and cancel them, returning TRUE if they
+ * had been requested.
+ */
+void
+prefetch_start_timer (void)
+{
+  if (!prefetch_is_timing && prefetch_is_pending ())
+    {
+      glk_request_timer_events (PREFETCH_TICK);
+      prefetch_is_timing = TRUE;
+    }
+}
+
+int
+prefetch_stop_timer (void)
+{
+  if (prefetch_is_timing)
+    {
+      glk_request_timer_events (0);
+      prefetch_is_timing = FALSE;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * prefetch_claim_url()
+ *
+ * Called before resolving a location to run it.  Only one download may be
+ * in progress, so any prefetch download is ended here.  If it is for the
+ * location requested, it is handed to the caller, still downloading and no
+ * longer rate limited, rather than being canceled.  Otherwise, returns NULL.
+ */
+ifp_urlref_t
+prefetch_claim_url (const char *location)
+{
+  ifp_urlref_t url;
+  assert (location);
+
+  if (!prefetch_url)
+    return NULL;
+
+  if (strcmp (prefetch_location, location) != 0)
+    {
+      prefetch_finish ();
+      return NULL;
+    }
+
+  url = prefetch_url;
+  prefetch_url = NULL;
+  ifp_url_set_read_limit (url, -1);
+
+  memory_free (prefetch_location);
+  prefetch_location = NULL;
+
+  return url;
+}
+
+
+/*
+ * prefetch_erase()
+ *
+ * Cancel any prefetch download and timer, and empty all location lists.
+ */
+void
+prefetch_erase (void)
+{
+  prefetch_stop_timer ();
+
+  if (prefetch_url)
+    prefetch_finish ();
+
+  if (prefetch_candidates)
+    {
+      prefetch_clear_list (prefetch_candidates);
+      vector_destroy (prefetch_candidates);
+      prefetch_candidates = NULL;
+    }
+  if (prefetch_recent)
+    {
+      prefetch_clear_list (prefetch_recent);
+      vector_destroy (prefetch_recent);
+      prefetch_recent = NULL;
+    }
+  if (prefetch_failed)
+    {
+      prefetch_clear_list (prefetch_failed);
+      vector_destroy (prefetch_failed);
+      prefetch_failed = NULL;
+    }
+  if (prefetch_fetched)
+    {
+      int index_;
+
+      for (index_ = 0; index_ < vector_get_length (prefetch_fetched); index_++)
+        {
+          prefetch_fetched_t fetched;
+
+          vector_get (prefetch_fetched, index_, &fetched);
+          memory_free (fetched.location);
+        }
+      vector_destroy (prefetch_fetched);
+      prefetch_fetched = NULL;
+    }
+}
@@ -18,6 +18,7 @@
  *
  */
 #include <stdio.h>
+#include <sys/types.h>
 
 #include <glk.h>
 #include <ifp.h>
@@ -56,7 +57,7 @@ extern glui32 hash (const char *string);
 
 /* Basic game aggregation functions. */
 typedef struct game_s *gameref_t;
-extern void gameset_add_game (const char *about,
+extern void gameset_add_game (const char *about, const char *ifid,
                               const char *author, const char *byline,
                               const char *description, const char *genre,
                               const char *headline, const char *length,
@@ -75,11 +76,16 @@ extern int gameset_is_empty (void);
 extern void gameset_erase (void);
 
 extern gameref_t gameset_find_game (const char *location);
+extern gameref_t gameset_find_game_by_ifid (const char *ifid);
 extern const char *gameset_get_game_location (const gameref_t game);
+extern const char *gameset_get_game_ifid (const gameref_t game);
 extern const char *gameset_get_game_title (const gameref_t game);
 extern const char *gameset_get_game_author (const gameref_t game);
 extern const char *gameset_get_game_publisher (const gameref_t game);
 extern const char *gameset_get_game_genre (const gameref_t game);
+extern const char *gameset_get_game_title_key (const gameref_t game);
+extern const char *gameset_get_game_author_key (const gameref_t game);
+extern const char *gameset_get_game_genre_key (const gameref_t game);
 
 extern glui32 gameset_get_game_id (const gameref_t game);
 extern gameref_t gameset_id_to_game (glui32 id);
@@ -100,9 +106,11 @@ extern void gamegroup_erase (void);
 
 extern groupref_t gamegroup_find_group (const char *name);
 extern const char *gamegroup_get_group_title (const groupref_t group);
+extern const char *gamegroup_get_group_title_key (const groupref_t group);
 
 extern int gamegroup_add_game_to_group (groupref_t group, const char *location);
 extern int gamegroup_add_group_to_group (groupref_t group, const char *about);
+extern int gamegroup_add_id_to_group (groupref_t group, glui32 id);
 
 typedef union node_u *noderef_t;
 extern gameref_t gamegroup_get_node_game (const noderef_t node);
@@ -149,6 +157,15 @@ extern void message_write_line (int return_immediately,
     __attribute__ ((__format__ (__printf__, 2, 3)));
 extern void message_windows_closed (void);
 
+/* Game prefetch functions. */
+extern void prefetch_set_page (const vectorref_t display_map);
+extern void prefetch_note_played (const char *location);
+extern void prefetch_handle_timer (void);
+extern void prefetch_start_timer (void);
+extern int prefetch_stop_timer (void);
+extern ifp_urlref_t prefetch_claim_url (const char *location);
+extern void prefetch_erase (void);
+
 /* URL handler functions. */
 extern void url_cleanup (void);
 extern ifp_urlref_t url_resolve (winid_t window,
@@ -157,6 +174,10 @@ extern ifp_urlref_t url_resolve (winid_t window,
 /* UTF handler and XML parser functions. */
 extern char *utf_utf8_to_iso8859 (const unsigned char *utf_string);
 extern int xml_parse_file (const char *xml_file, int dump_document);
+extern int xml_parse_story_buffer (const char *buffer, int length,
+                                   const char *location);
+extern int xml_parse_story_file (const char *xml_file, const char *location);
+extern char *xml_get_babel_download (void);
 
 /* INI reader and parser functions. */
 typedef struct inidoc_s *inidocref_t;
@@ -173,6 +194,40 @@ extern void inidoc_debug_dump (FILE *stream, inidocref_t doc);
 extern inidocref_t inidoc_parse (const char *file);
 extern int ini_parse_file (const char *ini_file, int dump_document);
 
+/* Game identification and directory cataloging functions. */
+extern void identify_prepare (void);
+extern void identify_release (void);
+extern int identify_file (int fd, off_t size, const char **engine_name,
+                          char **ifid, char **title, char **author,
+                          char **metadata, int *metadata_length);
+extern int dir_parse_directory (const char *directory, int dump_document);
+extern int dir_is_cataloged (void);
+
+/* Sort key collation function. */
+extern char *collate_create_key (const char *string, int is_title);
+
+/* Full text search functions. */
+extern void search_index_game (const gameref_t game);
+extern void search_erase (void);
+extern int search_find_games (const char *query, vectorref_t results);
+
+/* Compiled catalog cache functions. */
+extern int cache_load_catalog (const char *meta_file);
+extern void cache_save_catalog (const char *meta_file);
+
+/* Page output recording and replay functions. */
+extern void render_put_buffer (const char *buffer, int length);
+extern void render_put_string (const char *string);
+extern void render_put_char (char character);
+extern void render_set_style (glui32 style);
+extern void render_set_hyperlink (glui32 hyperlink);
+extern void render_begin (void);
+extern void render_end (const void *key, int key_length,
+                        const vectorref_t display_map);
+extern int render_replay (const void *key, int key_length,
+                          vectorref_t display_map);
+extern void render_erase (void);
+
 /* Public formatting and display functions. */
 extern void display_main_loop (void);
 extern void display_handle_redraw (void);
@@ -186,8 +241,13 @@ extern void display_get_pagination_codes (int *prior_page_code,
                                           int *next_page_code);
 extern void display_button (int hyperlink, const char *legend, int is_active);
 
+extern int gamepage_turn_page (const groupref_t group, int page_increment);
 extern void gamepage_display (const groupref_t group, vectorref_t display_map,
-                              int has_hyperlinks, int page_increment,
+                              int has_hyperlinks, int page_number,
                               int is_endpoint);
+extern void gamepage_display_search (const char *query,
+                                     vectorref_t display_map,
+                                     int has_hyperlinks, int page_increment);
+extern void gamepage_erase (void);
 extern void terppage_display (void);
 extern void aboutpage_display (int has_hyperlinks);
@@ -0,0 +1,365 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2006-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <glk.h>
+
+#include "protos.h"
+
+
+/*
+ * Pages are written through this module rather than straight to Glk.  While
+ * a page is being recorded, text is gathered into runs of a single style and
+ * hyperlink, and the page is then written out in one pass, one Glk call per
+ * run rather than one per string or character.  A recorded page may also be
+ * kept, along with the display map built for it, and replayed later without
+ * being laid out again.
+ */
+typedef struct {
+  glui32 style;
+  glui32 hyperlink;
+  int offset;
+  int length;
+} render_run_t;
+
+/* Recorded page definition. */
+typedef struct render_page_s *render_pageref_t;
+struct render_page_s {
+  void *key;
+  int key_length;
+
+  vectorref_t runs;
+  char *text;
+  int text_length;
+  int text_allocation;
+
+  glui32 final_style;
+  glui32 final_hyperlink;
+  vectorref_t map;
+};
+
+/*
+ * Page being recorded, if any, with the style and hyperlink to apply to the
+ * next text written.  Glk windows start out in the normal style and with no
+ * hyperlink, so recording and replay assume these initially.
+ */
+static render_pageref_t render_recording = NULL;
+static glui32 render_style = style_Normal;
+static glui32 render_hyperlink = 0;
+
+/* Pages kept for replay, least recently used first, and the limit kept. */
+enum { RENDER_CACHE_PAGES = 32 };
+static vectorref_t render_cache = NULL;
+
+
+/*
+ * render_create_page()
+ * render_destroy_page()
+ *
+ * Create an empty recorded page, and destroy a recorded page.
+ */
+static render_pageref_t
+render_create_page (void)
+{
+  render_pageref_t page;
+
+  page = memory_malloc (sizeof (*page));
+  page->key = NULL;
+  page->key_length = 0;
+  page->runs = vector_create (sizeof (render_run_t));
+  page->text = NULL;
+  page->text_length = page->text_allocation = 0;
+  page->final_style = style_Normal;
+  page->final_hyperlink = 0;
+  page->map = NULL;
+
+  return page;
+}
+
+static void
+render_destroy_page (render_pageref_t page)
+{
+  memory_free (page->key);
+  vector_destroy (page->runs);
+  memory_free (page->text);
+  if (page->map)
+    vector_destroy (page->map);
+
+  memset (page, 0, sizeof (*page));
+  memory_free (page);
+}
+
+
+/*
+ * render_write_page()
+ *
+ * Write a recorded page to the current Glk stream, setting style and
+ * hyperlink only where these change between runs.
+ */
+static void
+render_write_page (const render_pageref_t page)
+{
+  glui32 style, hyperlink;
+  int index_;
+
+  style = style_Normal;
+  hyperlink = 0;
+
+  for (index_ = 0; index_ < vector_get_length (page->runs); index_++)
+    {
+      const render_run_t *run;
+
+      run = vector_get_address (page->runs, index_);
+      if (run->style != style)
+        {
+          glk_set_style (run->style);
+          style = run->style;
+        }
+      if (run->hyperlink != hyperlink)
+        {
+          glk_set_hyperlink (run->hyperlink);
+          hyperlink = run->hyperlink;
+        }
+
+      glk_c_put_buffer (page->text + run->offset, run->length);
+    }
+
+  if (page->final_style != style)
+    glk_set_style (page->final_style);
+  if (page->final_hyperlink != hyperlink)
+    glk_set_hyperlink (page->final_hyperlink);
+}
+
+
+/*
+ * render_put_buffer()
+ * render_put_string()
+ * render_put_char()
+ * render_set_style()
+ * render_set_hyperlink()
+ *
+ * Glk output functions for pages.  These pass straight through to Glk
+ * unless a page is being recorded, in which case they add to the page.
+ */
+void
+render_put_buffer (const char *buffer, int length)
+{
+  render_pageref_t page;
+  render_run_t *run;
+  int runs_count;
+
+  page = render_recording;
+  if (!page)
+    {
+      glk_c_put_buffer (buffer, length);
+      return;
+    }
+
+  if (length <= 0)
+    return;
+
+  if (page->text_length + length > page->text_allocation)
+    {
+      while (page->text_length + length > page->text_allocation)
+        page->text_allocation = page->text_allocation * 2 + 1024;
+      page->text = memory_realloc (page->text, page->text_allocation);
+    }
+  memcpy (page->text + page->text_length, buffer, length);
+
+  /* Extend the last run if style and hyperlink are unchanged. */
+  runs_count = vector_get_length (page->runs);
+  run = runs_count > 0
+        ? (render_run_t *) vector_get_address (page->runs, runs_count - 1)
+        : NULL;
+
+  if (run && run->style == render_style
+      && run->hyperlink == render_hyperlink)
+    run->length += length;
+  else
+    {
+      render_run_t new_run;
+
+      new_run.style = render_style;
+      new_run.hyperlink = render_hyperlink;
+      new_run.offset = page->text_length;
+      new_run.length = length;
+      vector_append (page->runs, &new_run);
+    }
+
+  page->text_length += length;
+}
+
+void
+render_put_string (const char *string)
+{
+  assert (string);
+
+  render_put_buffer (string, strlen (string));
+}
+
+void
+render_put_char (char character)
+{
+  render_put_buffer (&character, 1);
+}
+
+void
+render_set_style (glui32 style)
+{
+  if (render_recording)
+    render_style = style;
+  else
+    glk_set_style (style);
+}
+
+void
+render_set_hyperlink (glui32 hyperlink)
+{
+  if (render_recording)
+    render_hyperlink = hyperlink;
+  else
+    glk_set_hyperlink (hyperlink);
+}
+
+
+/*
+ * render_begin()
+ * render_end()
+ *
+ * Begin recording a page, and end recording and write the page to the
+ * current Glk stream.  If a key is given, the page is kept for replay with
+ * a copy of the display map built while it was recorded.
+ */
+void
+render_begin (void)
+{
+  assert (!render_recording);
+
+  render_recording = render_create_page ();
+  render_style = style_Normal;
+  render_hyperlink = 0;
+}
+
+void
+render_end (const void *key, int key_length, const vectorref_t display_map)
+{
+  render_pageref_t page;
+  int index_;
+  assert (render_recording);
+
+  page = render_recording;
+  render_recording = NULL;
+
+  page->final_style = render_style;
+  page->final_hyperlink = render_hyperlink;
+  render_write_page (page);
+
+  if (!key)
+    {
+      render_destroy_page (page);
+      return;
+    }
+
+  page->key = memory_malloc (key_length);
+  memcpy (page->key, key, key_length);
+  page->key_length = key_length;
+
+  page->map = vector_create (sizeof (glui32));
+  for (index_ = 0; index_ < vector_get_length (display_map); index_++)
+    vector_append (page->map, vector_get_address (display_map, index_));
+
+  if (!render_cache)
+    render_cache = vector_create (sizeof (page));
+
+  if (vector_get_length (render_cache) == RENDER_CACHE_PAGES)
+    {
+      render_pageref_t oldest;
+
+      vector_unqueue (render_cache, &oldest);
+      render_destroy_page (oldest);
+    }
+
+  vector_append (render_cache, &page);
+}
+
+
+/*
+ * render_replay()
+ * render_erase()
+ *
+ * Write a kept page to the current Glk stream and restore its display map,
+ * returning TRUE, or return FALSE if no page is kept for the key.  And
+ * discard all kept pages.
+ */
+int
+render_replay (const void *key, int key_length, vectorref_t display_map)
+{
+  int index_;
+  assert (key && display_map);
+
+  if (!render_cache)
+    return FALSE;
+
+  for (index_ = 0; index_ < vector_get_length (render_cache); index_++)
+    {
+      render_pageref_t page;
+      int entry;
+
+      vector_get (render_cache, index_, &page);
+      if (page->key_length != key_length
+          || memcmp (page->key, key, key_length) != 0)
+        continue;
+
+      /* Move the page to the most recently used end of the cache. */
+      vector_delete (render_cache, index_);
+      vector_append (render_cache, &page);
+
+      vector_clear (display_map);
+      for (entry = 0; entry < vector_get_length (page->map); entry++)
+        vector_append (display_map, vector_get_address (page->map, entry));
+
+      render_write_page (page);
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+void
+render_erase (void)
+{
+  int index_;
+
+  if (!render_cache)
+    return;
+
+  for (index_ = 0; index_ < vector_get_length (render_cache); index_++)
+    {
+      render_pageref_t page;
+
+      vector_get (render_cache, index_, &page);
+      render_destroy_page (page);
+    }
+
+  vector_destroy (render_cache);
+  render_cache = NULL;
+}
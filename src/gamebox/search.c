@@ -0,0 +1,573 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2006-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <glk.h>
+
+#include "protos.h"
+
+
+/*
+ * Full text search uses an inverted index from words to the games that
+ * contain them.  Words are taken from the sort key forms of game fields, so
+ * that searching is case and accent insensitive in the same way as sorting.
+ * Each word has a list of postings, one per game containing it, noting the
+ * fields it appears in; games are indexed in id order, so postings lists are
+ * ordered by game id.  A separate vocabulary array, sorted on demand, lets
+ * each search word match as a prefix, so that results can follow typing.
+ */
+typedef struct {
+  glui32 id;
+  glui32 fields;
+} search_posting_t;
+
+typedef struct {
+  char *word;
+  glui32 digest;
+  vectorref_t postings;
+} search_word_t;
+
+/* Indexed fields, and the rank each contributes to a matching game. */
+enum { SEARCH_TITLE = 1 << 0, SEARCH_AUTHOR = 1 << 1, SEARCH_GENRE = 1 << 2,
+       SEARCH_HEADLINE = 1 << 3, SEARCH_DESCRIPTION = 1 << 4 };
+static const struct {
+  glui32 field;
+  glui32 rank;
+} SEARCH_RANKS[] = {
+  {SEARCH_TITLE, 16}, {SEARCH_AUTHOR, 8}, {SEARCH_GENRE, 4},
+  {SEARCH_HEADLINE, 2}, {SEARCH_DESCRIPTION, 1}, {0, 0}
+};
+
+/*
+ * Words, a hash of word indexes plus one (zero marks an empty slot), open
+ * addressed, probed linearly, sized to a power of two and kept at most half
+ * full, and an array of word indexes in word order.  The sorted array is
+ * rebuilt by searches whenever words have been added since it was last
+ * built; words are never removed other than by erasing the whole index.
+ */
+static vectorref_t search_words = NULL;
+static glui32 *search_slots = NULL;
+static glui32 search_slots_capacity = 0;
+static glui32 *search_sorted = NULL;
+static glui32 search_sorted_length = 0;
+
+/*
+ * Per-game search state, indexed by game id.  Generation marks a game as
+ * a candidate in the current search, avoiding clearing the array for every
+ * search; matched counts the search words matched, and rank accumulates.
+ * Ordinal is the game's position in title order, so that results of equal
+ * rank can be ordered by title without comparing strings.
+ */
+typedef struct {
+  glui32 generation;
+  glui32 matched;
+  glui32 rank;
+  glui32 ordinal;
+} search_state_t;
+
+static search_state_t *search_states = NULL;
+static glui32 search_states_length = 0;
+static glui32 search_generation = 0;
+
+
+/*
+ * search_find_slot()
+ * search_add_word()
+ *
+ * Find the hash slot for a word, or the empty slot where it belongs, and
+ * return the index of a word, adding it if new.
+ */
+static glui32
+search_find_slot (const char *word, glui32 digest)
+{
+  glui32 mask, slot;
+
+  mask = search_slots_capacity - 1;
+  for (slot = digest & mask;
+       search_slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+      const search_word_t *entry;
+
+      entry = vector_get_address (search_words, search_slots[slot] - 1);
+      if (entry->digest == digest && strcmp (entry->word, word) == 0)
+        break;
+    }
+
+  return slot;
+}
+
+static glui32
+search_add_word (const char *word, int length)
+{
+  search_word_t entry;
+  glui32 digest, slot;
+  int index_;
+
+  entry.word = memory_malloc (length + 1);
+  memcpy (entry.word, word, length);
+  entry.word[length] = '\0';
+  digest = hash (entry.word);
+
+  if (!search_words)
+    search_words = vector_create (sizeof (entry));
+
+  /* Grow the hash to keep it at most half full, rehashing all words. */
+  if (2 * (glui32) (vector_get_length (search_words) + 1)
+      > search_slots_capacity)
+    {
+      glui32 capacity;
+
+      capacity = search_slots_capacity == 0
+                 ? 1024 : search_slots_capacity << 1;
+      memory_free (search_slots);
+      search_slots = memory_malloc (capacity * sizeof (*search_slots));
+      memset (search_slots, 0, capacity * sizeof (*search_slots));
+      search_slots_capacity = capacity;
+
+      for (index_ = 0; index_ < vector_get_length (search_words); index_++)
+        {
+          const search_word_t *other;
+
+          other = vector_get_address (search_words, index_);
+          search_slots[search_find_slot (other->word, other->digest)]
+              = index_ + 1;
+        }
+    }
+
+  slot = search_find_slot (entry.word, digest);
+  if (search_slots[slot] != 0)
+    {
+      memory_free (entry.word);
+      return search_slots[slot] - 1;
+    }
+
+  entry.digest = digest;
+  entry.postings = vector_create (sizeof (search_posting_t));
+  index_ = vector_append (search_words, &entry);
+  search_slots[slot] = index_ + 1;
+
+  return index_;
+}
+
+
+/*
+ * search_is_word_char()
+ *
+ * Return TRUE if a sort key character is part of a word.  Words are runs of
+ * letters and digits, and the ISO 8859-1 characters that folding leaves.
+ */
+static int
+search_is_word_char (char character)
+{
+  return isalnum ((unsigned char) character)
+         || (unsigned char) character >= 0x80;
+}
+
+
+/*
+ * search_add_posting()
+ * search_index_field()
+ *
+ * Note that a game field contains a word, merging with the game's existing
+ * posting for the word if any, and add postings for each word in a field.
+ */
+static void
+search_add_posting (glui32 word_index, glui32 id, glui32 field)
+{
+  search_word_t entry;
+  search_posting_t posting;
+  int length;
+
+  vector_get (search_words, word_index, &entry);
+
+  length = vector_get_length (entry.postings);
+  if (length > 0)
+    {
+      vector_get (entry.postings, length - 1, &posting);
+      if (posting.id == id)
+        {
+          posting.fields |= field;
+          vector_set (entry.postings, length - 1, &posting);
+          return;
+        }
+    }
+
+  posting.id = id;
+  posting.fields = field;
+  vector_append (entry.postings, &posting);
+}
+
+static void
+search_index_field (glui32 id, const char *value, glui32 field)
+{
+  char *key;
+  const char *cursor;
+
+  key = collate_create_key (value, FALSE);
+  if (!key)
+    return;
+
+  for (cursor = key; *cursor; )
+    {
+      const char *word;
+
+      if (!search_is_word_char (*cursor))
+        {
+          cursor++;
+          continue;
+        }
+
+      for (word = cursor; search_is_word_char (*cursor); )
+        cursor++;
+
+      search_add_posting (search_add_word (word, cursor - word), id, field);
+    }
+
+  memory_free (key);
+}
+
+
+/*
+ * search_index_game()
+ * search_erase()
+ *
+ * Add a game's title, author, genre, headline, and description words to
+ * the search index, and empty the index.
+ */
+void
+search_index_game (const gameref_t game)
+{
+  const char *author, *description, *genre, *headline, *title;
+  glui32 id;
+
+  gameset_get_game (game, NULL, &author, NULL, &description, &genre,
+                    &headline, NULL, NULL, NULL, &title, NULL);
+  id = gameset_get_game_id (game);
+
+  search_index_field (id, title, SEARCH_TITLE);
+  search_index_field (id, author, SEARCH_AUTHOR);
+  search_index_field (id, genre, SEARCH_GENRE);
+  search_index_field (id, headline, SEARCH_HEADLINE);
+  search_index_field (id, description, SEARCH_DESCRIPTION);
+}
+
+void
+search_erase (void)
+{
+  int index_;
+
+  if (search_words)
+    {
+      for (index_ = 0; index_ < vector_get_length (search_words); index_++)
+        {
+          search_word_t entry;
+
+          vector_get (search_words, index_, &entry);
+          memory_free (entry.word);
+          vector_destroy (entry.postings);
+        }
+
+      vector_destroy (search_words);
+      search_words = NULL;
+    }
+
+  memory_free (search_slots);
+  search_slots = NULL;
+  search_slots_capacity = 0;
+
+  memory_free (search_sorted);
+  search_sorted = NULL;
+  search_sorted_length = 0;
+
+  memory_free (search_states);
+  search_states = NULL;
+  search_states_length = 0;
+}
+
+
+/*
+ * search_compare_words()
+ * search_sort_words()
+ *
+ * Order word indexes by word, and bring the sorted vocabulary up to date.
+ */
+static int
+search_compare_words (const void *left_ptr, const void *right_ptr)
+{
+  const search_word_t *left, *right;
+
+  left = vector_get_address (search_words, *(const glui32 *) left_ptr);
+  right = vector_get_address (search_words, *(const glui32 *) right_ptr);
+
+  return strcmp (left->word, right->word);
+}
+
+static void
+search_sort_words (void)
+{
+  glui32 length, index_;
+
+  length = search_words ? vector_get_length (search_words) : 0;
+  if (length == search_sorted_length)
+    return;
+
+  search_sorted = memory_realloc (search_sorted,
+                                  length * sizeof (*search_sorted));
+  for (index_ = 0; index_ < length; index_++)
+    search_sorted[index_] = index_;
+
+  qsort (search_sorted, length, sizeof (*search_sorted),
+         search_compare_words);
+  search_sorted_length = length;
+}
+
+
+/*
+ * search_match_prefix()
+ *
+ * Mark games containing any word starting with the given prefix.  For the
+ * first search word, every game found becomes a candidate; for later ones,
+ * only existing candidates that matched all earlier words progress.
+ */
+static void
+search_match_prefix (const char *prefix, int length,
+                     glui32 word_number, vectorref_t candidates)
+{
+  glui32 low, high;
+
+  /* Binary search for the first word not less than the prefix. */
+  low = 0;
+  high = search_sorted_length;
+  while (low < high)
+    {
+      glui32 middle;
+      const search_word_t *entry;
+
+      middle = low + (high - low) / 2;
+      entry = vector_get_address (search_words, search_sorted[middle]);
+      if (strncmp (entry->word, prefix, length) < 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  for (; low < search_sorted_length; low++)
+    {
+      const search_word_t *entry;
+      const search_posting_t *postings;
+      int count, posting;
+
+      entry = vector_get_address (search_words, search_sorted[low]);
+      if (strncmp (entry->word, prefix, length) != 0)
+        break;
+
+      count = vector_get_length (entry->postings);
+      postings = count > 0 ? vector_get_address (entry->postings, 0) : NULL;
+
+      for (posting = 0; posting < count; posting++)
+        {
+          search_state_t *state;
+          int rank;
+
+          state = search_states + postings[posting].id;
+          if (state->generation != search_generation)
+            {
+              if (word_number > 0)
+                continue;
+
+              state->generation = search_generation;
+              state->matched = 0;
+              state->rank = 0;
+              vector_append (candidates, &postings[posting].id);
+            }
+
+          if (state->matched < word_number)
+            continue;
+
+          for (rank = 0; SEARCH_RANKS[rank].field; rank++)
+            {
+              if (postings[posting].fields & SEARCH_RANKS[rank].field)
+                state->rank += SEARCH_RANKS[rank].rank;
+            }
+          state->matched = word_number + 1;
+        }
+    }
+}
+
+
+/*
+ * search_compare_titles()
+ * search_update_states()
+ *
+ * Order game ids by game title, and size the per-game state to the set of
+ * games, assigning title ordinals whenever games have been added since the
+ * last search.  Returns the count of games.
+ */
+static int
+search_compare_titles (const void *left_ptr, const void *right_ptr)
+{
+  gameref_t left, right;
+
+  left = gameset_id_to_game (*(const glui32 *) left_ptr);
+  right = gameset_id_to_game (*(const glui32 *) right_ptr);
+
+  return strcmp (gameset_get_game_title_key (left),
+                 gameset_get_game_title_key (right));
+}
+
+static glui32
+search_update_states (void)
+{
+  gameref_t game;
+  glui32 games_count, *ids, index_;
+
+  game = gameset_iterate (NULL);
+  games_count = game ? gameset_get_game_id (game) + 1 : 0;
+  if (games_count == search_states_length)
+    return games_count;
+
+  search_states = memory_realloc (search_states,
+                                  games_count * sizeof (*search_states));
+  memset (search_states, 0, games_count * sizeof (*search_states));
+  search_states_length = games_count;
+  search_generation = 0;
+
+  ids = memory_malloc (games_count * sizeof (*ids));
+  for (index_ = 0; index_ < games_count; index_++)
+    ids[index_] = index_;
+
+  qsort (ids, games_count, sizeof (*ids), search_compare_titles);
+  for (index_ = 0; index_ < games_count; index_++)
+    search_states[ids[index_]].ordinal = index_;
+
+  memory_free (ids);
+  return games_count;
+}
+
+
+/*
+ * search_compare_results()
+ *
+ * Order matching game ids by descending rank, then by title.
+ */
+static int
+search_compare_results (const void *left_ptr, const void *right_ptr)
+{
+  const search_state_t *left, *right;
+
+  left = search_states + *(const glui32 *) left_ptr;
+  right = search_states + *(const glui32 *) right_ptr;
+
+  if (left->rank != right->rank)
+    return left->rank < right->rank ? 1 : -1;
+
+  return left->ordinal < right->ordinal ? -1 : left->ordinal > right->ordinal;
+}
+
+
+/*
+ * search_find_games()
+ *
+ * Find games containing words starting with every word in the query, and
+ * set results to these games, best first.  A game ranks higher for words
+ * found in its title than its author, and so on down to its description.
+ * Returns the count of games found.
+ */
+int
+search_find_games (const char *query, vectorref_t results)
+{
+  vectorref_t candidates;
+  char *key;
+  const char *cursor;
+  glui32 word_number, matches, index_;
+
+  vector_clear (results);
+
+  key = collate_create_key (query, FALSE);
+  if (!key || !search_words)
+    {
+      memory_free (key);
+      return 0;
+    }
+
+  search_sort_words ();
+  search_update_states ();
+
+  /* Restart generations on wrapping, to avoid stale matches. */
+  if (++search_generation == 0)
+    {
+      for (index_ = 0; index_ < search_states_length; index_++)
+        search_states[index_].generation = 0;
+      search_generation = 1;
+    }
+
+  candidates = vector_create (sizeof (glui32));
+
+  word_number = 0;
+  for (cursor = key; *cursor; )
+    {
+      const char *word;
+
+      if (!search_is_word_char (*cursor))
+        {
+          cursor++;
+          continue;
+        }
+
+      for (word = cursor; search_is_word_char (*cursor); )
+        cursor++;
+
+      search_match_prefix (word, cursor - word, word_number++, candidates);
+    }
+
+  /* Keep candidates that matched every word, and order them for return. */
+  matches = 0;
+  for (index_ = 0; index_ < (glui32) vector_get_length (candidates); index_++)
+    {
+      glui32 id;
+
+      vector_get (candidates, index_, &id);
+      if (search_states[id].matched == word_number)
+        vector_set (candidates, matches++, &id);
+    }
+
+  if (matches > 0)
+    qsort ((void *) vector_get_address (candidates, 0),
+           matches, sizeof (glui32), search_compare_results);
+
+  for (index_ = 0; index_ < matches; index_++)
+    {
+      glui32 id;
+      gameref_t game;
+
+      vector_get (candidates, index_, &id);
+      game = gameset_id_to_game (id);
+      vector_append (results, &game);
+    }
+
+  vector_destroy (candidates);
+  memory_free (key);
+
+  return vector_get_length (results);
+}
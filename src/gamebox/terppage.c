@@ -45,17 +45,17 @@ terppage_convert_date (const char *ifp_date)
                   &day, &year, &hours, &minutes, &seconds, &trailer);
   if (!(count == 5 || (count == 6 && trailer == ' ')))
     {
-      glk_c_put_string (ifp_date);
+      render_put_string (ifp_date);
       return;
     }
 
   if (day < 1 || day > 31)
     {
-      glk_c_put_string (ifp_date);
+      render_put_string (ifp_date);
       return;
     }
 
-  glk_c_put_buffer (ifp_date, strchr (ifp_date, ',') - ifp_date);
+  render_put_buffer (ifp_date, strchr (ifp_date, ',') - ifp_date);
 }
 
 
@@ -83,76 +83,76 @@ terppage_interpreter_details (const terpref_t terp)
                          &engine_copyright);
   assert (engine_name);
 
-  glk_set_style (style_Subheader);
-  glk_c_put_string (engine_name);
-  glk_set_style (style_Normal);
+  render_set_style (style_Subheader);
+  render_put_string (engine_name);
+  render_set_style (style_Normal);
 
   if (engine_version)
     {
-      glk_c_put_string (" version ");
-      glk_c_put_string (engine_version);
+      render_put_string (" version ");
+      render_put_string (engine_version);
     }
 
   if (engine_type)
     {
-      glk_c_put_string (" (");
-      glk_c_put_string (engine_type);
-      glk_put_char (')');
+      render_put_string (" (");
+      render_put_string (engine_type);
+      render_put_char (')');
     }
-  glk_put_char ('\n');
+  render_put_char ('\n');
 
   if (author_name)
     {
-      glk_c_put_string ("Author: ");
-      glk_set_style (style_Emphasized);
-      glk_c_put_string (author_name);
-      glk_set_style (style_Normal);
+      render_put_string ("Author: ");
+      render_set_style (style_Emphasized);
+      render_put_string (author_name);
+      render_set_style (style_Normal);
 
       if (author_email)
         {
-          glk_set_style (style_Emphasized);
-          glk_c_put_string (" <");
-          glk_c_put_string (author_email);
-          glk_put_char ('>');
-          glk_set_style (style_Normal);
+          render_set_style (style_Emphasized);
+          render_put_string (" <");
+          render_put_string (author_email);
+          render_put_char ('>');
+          render_set_style (style_Normal);
         }
     }
 
   if (build_timestamp)
     {
-      glk_c_put_string ("  Built: ");
-      glk_set_style (style_Emphasized);
+      render_put_string ("  Built: ");
+      render_set_style (style_Emphasized);
       terppage_convert_date (build_timestamp);
-      glk_set_style (style_Normal);
+      render_set_style (style_Normal);
     }
 
   if (author_name || build_timestamp)
-    glk_put_char ('\n');
+    render_put_char ('\n');
 
   if (display_show_interpreters_in_full ())
     {
       if (engine_description)
-        glk_c_put_string (engine_description);
+        render_put_string (engine_description);
 
       if (engine_copyright)
         {
-          glk_set_style (style_Emphasized);
-          glk_c_put_string ("Licensing: ");
-          glk_set_style (style_Normal);
-          glk_c_put_string (engine_copyright);
+          render_set_style (style_Emphasized);
+          render_put_string ("Licensing: ");
+          render_set_style (style_Normal);
+          render_put_string (engine_copyright);
         }
 
       if (engine_home_url)
         {
-          glk_c_put_string ("Home Page: ");
-          glk_set_style (style_Emphasized);
-          glk_c_put_string (engine_home_url);
-          glk_set_style (style_Normal);
-          glk_put_char ('\n');
+          render_put_string ("Home Page: ");
+          render_set_style (style_Emphasized);
+          render_put_string (engine_home_url);
+          render_set_style (style_Normal);
+          render_put_char ('\n');
         }
     }
 
-  glk_put_char ('\n');
+  render_put_char ('\n');
 }
 
 
@@ -190,13 +190,14 @@ terppage_interpreters (void)
 
   if (vector_get_length (terps) == 0)
     {
-      glk_c_put_string ("Gamebox found no interpreters.  Sorry.\n\n");
+      render_put_string ("Gamebox found no interpreters.  Sorry.\n\n");
       vector_destroy (terps);
       return;
     }
 
-  glk_c_put_string ("Gamebox found the following interpreter engines available"
-                    " on your system:\n\n");
+  render_put_string (
+    "Gamebox found the following interpreter engines available"
+    " on your system:\n\n");
 
   qsort ((void *) vector_get_address (terps, 0),
          vector_get_length (terps),
@@ -222,7 +223,7 @@ terppage_preamble (void)
 {
   if (terps_is_empty ())
     {
-      glk_c_put_string (
+      render_put_string (
         "You do not have any interpreter plugins available at the moment."
         " Try setting a value for the environment variable IF_PLUGIN_PATH,"
         " or if you have set a value, please check it.  Without plugins,"
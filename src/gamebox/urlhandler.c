@@ -156,8 +156,13 @@ url_resolve (winid_t window, const char *url_path, int *url_errno)
 
   has_timers = glk_gestalt (gestalt_Timer, 0);
 
-  /* Start a new asynchronous URL. */
-  url = ifp_url_new_resolve_async (url_path);
+  /*
+   * Take over any prefetch already downloading this URL, otherwise start a
+   * new asynchronous URL.
+   */
+  url = prefetch_claim_url (url_path);
+  if (!url)
+    url = ifp_url_new_resolve_async (url_path);
   if (!url)
     {
       *url_errno = errno;
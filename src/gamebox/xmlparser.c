@@ -26,6 +26,7 @@
 
 #include <libxml/parser.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include <libxml/debugXML.h>
 
 #include "protos.h"
@@ -326,8 +327,9 @@ xml_parse_rdf_game_element (const xmlNodePtr node)
       if (!title)
         title = memory_strdup ("[Unknown Game]");
 
-      gameset_add_game (about, author, byline, description, genre, headline,
-                        length, publisher, release_date, title, version);
+      gameset_add_game (about, NULL, author, byline, description, genre,
+                        headline, length, publisher, release_date, title,
+                        version);
     }
 
   memory_free (about);
@@ -757,10 +759,13 @@ xml_normalize_babel_description (char *description)
  *
  * Parse an iFiction story node.  Extract the story properties and add an
  * entry to the game set to represent the node.  Creates 'about' using the
- * <annotation><gamebox><about> element, or download and IFID.
+ * <annotation><gamebox><about> element, or download and IFID.  If location
+ * is given, it is used as 'about' instead, and any group is ignored.
+ * Returns TRUE if a game was added.
  */
-static void
-xml_parse_babel_story_element (const xmlNodePtr node, const char *download)
+static int
+xml_parse_babel_story_element (const xmlNodePtr node,
+                               const char *download, const char *location)
 {
   char *about;         /* <annotation><gamebox><about>, or url+IFID */
   char *ifid;          /* <identification><ifid> */
@@ -777,6 +782,7 @@ xml_parse_babel_story_element (const xmlNodePtr node, const char *download)
   char *version;       /* NULL, or <tads?><version>|<zcode|glulx><release> */
   char *group;         /* <annotation><gamebox><group> */
   xmlNodePtr child;
+  int is_added;
 
   double_binding_t bindings[] = {
     { story_names.IDENTIFICATION, story_names.NAMESPACE,
@@ -828,7 +834,15 @@ xml_parse_babel_story_element (const xmlNodePtr node, const char *download)
   if (child)
     xml_get_babel_node_properties (child, gamebox_bindings);
   else
-    about = NULL;
+    about = group = NULL;
+
+  if (location)
+    {
+      memory_free (about);
+      memory_free (group);
+      about = memory_strdup (location);
+      group = NULL;
+    }
 
   if (!about && ifid)
     {
@@ -851,8 +865,9 @@ xml_parse_babel_story_element (const xmlNodePtr node, const char *download)
           author = NULL;
         }
 
-      gameset_add_game (about, author, byline, description, genre, headline,
-                        length, publisher, release_date, title, version);
+      gameset_add_game (about, ifid, author, byline, description, genre,
+                        headline, length, publisher, release_date, title,
+                        version);
 
       if (group)
         {
@@ -865,6 +880,7 @@ xml_parse_babel_story_element (const xmlNodePtr node, const char *download)
           gamegroup_add_game_to_group (gamegroup, about);
         }
     }
+  is_added = (about != NULL);
 
   memory_free (about);
   memory_free (ifid);
@@ -878,37 +894,140 @@ xml_parse_babel_story_element (const xmlNodePtr node, const char *download)
   memory_free (release_date);
   memory_free (title);
   memory_free (version);
+  return is_added;
 }
 
 
 /*
- * xml_parse_babel_root_element()
+ * xml_get_babel_download()
  *
- * Parse the ifindex root element, in iFiction, an ifindex node, searching
- * for story nodes within it.  The download base url is extracted from an
- * environment variable, defaulted to "http://babel.ifarchive.org/download/".
+ * Return an allocated copy of the base url to which iFiction IFIDs are
+ * appended to form game locations.  This is taken from an environment
+ * variable, defaulted to "http://babel.ifarchive.org/download/".
  */
-static void
-xml_parse_babel_root_element (const xmlNodePtr node)
+char *
+xml_get_babel_download (void)
 {
-  char *download;
-  xmlNodePtr child;
+  const char *download;
 
   download = getenv ("GAMEBOX_BABEL_URL");
   if (!download)
-    download = memory_strdup ("http://babel.ifarchive.org/download/");
-  else
-    download = memory_strdup (download);
+    download = "http://babel.ifarchive.org/download/";
 
-  for (child = node->xmlChildrenNode; child; child = child->next)
+  return memory_strdup (download);
+}
+
+
+/*
+ * xml_stream_t
+ *
+ * State for streaming a games collection.  Top level elements are parsed
+ * one at a time, as the reader completes each, and then discarded.  IFMES
+ * containers and their descriptions need to see each other and all games,
+ * so copies of these are retained in a skeleton document holding only the
+ * root and those elements, to be parsed once the stream ends.
+ */
+typedef struct {
+  int is_babel;
+  char *download;      /* iFiction IFID base url */
+  xmlDocPtr skeleton;  /* IFMES root, containers, and descriptions */
+} xml_stream_t;
+
+
+/*
+ * xml_stream_begin()
+ *
+ * Set up to stream a games collection with the given root element.  Returns
+ * FALSE if the root element is not that of a games collection.
+ */
+static int
+xml_stream_begin (xml_stream_t *stream, const xmlNodePtr root)
+{
+  stream->download = NULL;
+  stream->skeleton = NULL;
+
+  if (xml_node_element_matches (root, rdf_names.RDF, rdf_names.NAMESPACE))
     {
-      if (xml_node_element_matches (child,
+      stream->is_babel = FALSE;
+      stream->skeleton = xmlNewDoc ((const xmlChar *) "1.0");
+      xmlDocSetRootElement (stream->skeleton,
+                            xmlDocCopyNode (root, stream->skeleton, 2));
+      return TRUE;
+    }
+
+  else if (xml_node_element_matches (root,
+                                     babel_names.IFINDEX,
+                                     babel_names.NAMESPACE))
+    {
+      stream->is_babel = TRUE;
+      stream->download = xml_get_babel_download ();
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * xml_stream_element()
+ *
+ * Handle one complete top level element of a games collection.  iFiction
+ * stories and IFMES games become games immediately.  IFMES containers and
+ * descriptions are copied into the skeleton document for later.
+ */
+static void
+xml_stream_element (xml_stream_t *stream, const xmlNodePtr node)
+{
+  if (stream->is_babel)
+    {
+      if (xml_node_element_matches (node,
                                     story_names.STORY,
                                     story_names.NAMESPACE))
-        xml_parse_babel_story_element (child, download);
+        xml_parse_babel_story_element (node, stream->download, NULL);
     }
 
-  memory_free (download);
+  else if (xml_node_element_matches (node,
+                                     baf_names.GAME,
+                                     baf_names.NAMESPACE)
+           || xml_node_element_matches (node,
+                                        ifm_names.STORY,
+                                        ifm_names.NAMESPACE))
+    xml_parse_rdf_game_element (node);
+
+  else if (xml_node_element_matches (node,
+                                     rdf_names.SEQ,
+                                     rdf_names.NAMESPACE)
+           || xml_node_element_matches (node,
+                                        rdf_names.BAG,
+                                        rdf_names.NAMESPACE)
+           || xml_node_element_matches (node,
+                                        rdf_names.DESCRIPTION,
+                                        rdf_names.NAMESPACE))
+    {
+      xmlAddChild (xmlDocGetRootElement (stream->skeleton),
+                   xmlDocCopyNode (node, stream->skeleton, 1));
+    }
+}
+
+
+/*
+ * xml_stream_end()
+ *
+ * Finish streaming a games collection.  If the stream completed, parse any
+ * IFMES containers retained, now that all games and groups are known.
+ */
+static void
+xml_stream_end (xml_stream_t *stream, int is_complete)
+{
+  if (stream->skeleton)
+    {
+      if (is_complete)
+        xml_parse_rdf_root_element (xmlDocGetRootElement (stream->skeleton));
+
+      xmlFreeDoc (stream->skeleton);
+    }
+
+  memory_free (stream->download);
 }
 
 
@@ -918,42 +1037,130 @@ xml_parse_babel_root_element (const xmlNodePtr node)
  * Parse the given XML file, if it contains a collection, into a set of
  * games.  A collection is defined by an RDF:RDF node in IFMES, and by a
  * ifindex node in iFiction.  Returns FALSE if not apparently a games
- * collection.
+ * collection, or if the file is not well formed.
+ *
+ * The file is streamed, so that memory use is bounded by the largest single
+ * game or story rather than by the whole document, and games are added to
+ * the game set as each element completes.
  */
 int
 xml_parse_file (const char *xml_file, int dump_document)
 {
-  xmlDocPtr document;
-  xmlNodePtr node;
-  void (*root_node_handler) (xmlNodePtr);
+  xmlTextReaderPtr reader;
+  xml_stream_t stream;
+  int status;
 
-  document = xmlParseFile (xml_file);
-  if (!document)
+  reader = xmlReaderForFile (xml_file, NULL, 0);
+  if (!reader)
     return FALSE;
 
-  if (dump_document)
-    xmlDebugDumpDocument (stderr, document);
+  /* Find the root element, and check that it is a games collection. */
+  do
+    status = xmlTextReaderRead (reader);
+  while (status == 1
+         && xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT);
 
-  node = xmlDocGetRootElement (document);
-  if (xml_node_element_matches (node,
-                                rdf_names.RDF,
-                                rdf_names.NAMESPACE))
-    root_node_handler = xml_parse_rdf_root_element;
-  else if (xml_node_element_matches (node,
-                                     babel_names.IFINDEX,
-                                     babel_names.NAMESPACE))
-    root_node_handler = xml_parse_babel_root_element;
-  else
-    root_node_handler = NULL;
+  if (status != 1
+      || !xml_stream_begin (&stream, xmlTextReaderCurrentNode (reader)))
+    {
+      xmlFreeTextReader (reader);
+      return FALSE;
+    }
 
-  if (root_node_handler)
+  /*
+   * Expand and handle each top level element in turn, then skip past it,
+   * letting the reader free it.  Anything else, the root element's text,
+   * comments, and its end, is simply read over.
+   */
+  status = xmlTextReaderRead (reader);
+  while (status == 1)
     {
-      (*root_node_handler) (node);
-      xmlFreeDoc (document);
+      if (xmlTextReaderDepth (reader) == 1
+          && xmlTextReaderNodeType (reader) == XML_READER_TYPE_ELEMENT)
+        {
+          xmlNodePtr node;
 
-      return TRUE;
+          node = xmlTextReaderExpand (reader);
+          if (!node)
+            {
+              status = -1;
+              break;
+            }
+
+          if (dump_document)
+            xmlDebugDumpNode (stderr, node, 1);
+
+          xml_stream_element (&stream, node);
+          status = xmlTextReaderNext (reader);
+        }
+      else
+        status = xmlTextReaderRead (reader);
+    }
+
+  xml_stream_end (&stream, status == 0);
+  xmlFreeTextReader (reader);
+
+  return status == 0;
+}
+
+
+/*
+ * xml_parse_story_document()
+ * xml_parse_story_buffer()
+ * xml_parse_story_file()
+ *
+ * Parse the first story of an iFiction document describing a single game,
+ * from a memory buffer or a file, and add it to the game set with the given
+ * location as its 'about'.  Used for metadata found alongside or inside
+ * games, such as Blorb IFmd chunks.  Returns FALSE if the document is not
+ * well formed iFiction, or holds no story.
+ */
+static int
+xml_parse_story_document (xmlDocPtr document, const char *location)
+{
+  xmlNodePtr root, node;
+  int is_added;
+
+  is_added = FALSE;
+  root = xmlDocGetRootElement (document);
+  if (root && xml_node_element_matches (root,
+                                        babel_names.IFINDEX,
+                                        babel_names.NAMESPACE))
+    {
+      for (node = root->xmlChildrenNode; node; node = node->next)
+        {
+          if (xml_node_element_matches (node,
+                                        story_names.STORY,
+                                        story_names.NAMESPACE))
+            {
+              is_added = xml_parse_babel_story_element (node, NULL, location);
+              break;
+            }
+        }
     }
 
   xmlFreeDoc (document);
-  return FALSE;
+  return is_added;
+}
+
+int
+xml_parse_story_buffer (const char *buffer, int length, const char *location)
+{
+  xmlDocPtr document;
+  assert (buffer && location);
+
+  document = xmlReadMemory (buffer, length, NULL, NULL,
+                            XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+  return document ? xml_parse_story_document (document, location) : FALSE;
+}
+
+int
+xml_parse_story_file (const char *xml_file, const char *location)
+{
+  xmlDocPtr document;
+  assert (xml_file && location);
+
+  document = xmlReadFile (xml_file, NULL,
+                          XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+  return document ? xml_parse_story_document (document, location) : FALSE;
 }
@@ -18,7 +18,8 @@
  * USA
  */
 
-#include <assert.h>
+#include <limits.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -29,28 +30,239 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_FILE
+
 
 /*
- * Open files information structures.  Entries indicate either an open file
- * descriptor or an open file stream.
+ * Open file descriptors are held in a bitmap indexed by descriptor, so that
+ * adding, removing, and testing a descriptor are all constant time.  The
+ * bitmap grows (by doubling) when a descriptor beyond its end is added, so
+ * there is no allocation on each open.  A second bitmap notes descriptors
+ * that are owned by a listed stream, either from fdopen or because a stream
+ * was opened on them; these are closed by fclose, not by close.
  */
-struct ifp_fd_info
+struct ifp_fd_set
 {
-  int fd;
-  struct ifp_fd_info *next;
+  unsigned long *words;
+  int length;
+  int count;
+};
+typedef struct ifp_fd_set *ifp_fd_setref_t;
+
+enum { BITS_PER_WORD = sizeof (unsigned long) * CHAR_BIT };
+
+static struct ifp_fd_set ifp_fd_files = { NULL, 0, 0 },
+                         ifp_fd_stream_owned = { NULL, 0, 0 };
+
+/*
+ * Open streams are held in an open-addressed hash table of FILE pointers,
+ * using linear probing.  Removed entries leave a tombstone so that probe
+ * sequences remain intact; tombstones are dropped when the table is rebuilt.
+ * Table size is always a power of two.
+ */
+struct ifp_stream_set
+{
+  FILE **slots;
+  int size;
+  int count;
+  int used;
 };
-typedef struct ifp_fd_info *ifp_fd_inforef_t;
 
-struct ifp_stream_info
+static struct ifp_stream_set ifp_stream_files = { NULL, 0, 0, 0 };
+
+/* Marker for a removed stream table slot. */
+static char ifp_stream_tombstone_marker;
+#define STREAM_TOMBSTONE ((FILE *) &ifp_stream_tombstone_marker)
+
+/* Initial stream table size, and Knuth's multiplicative hash constant. */
+enum { STREAM_INITIAL_SIZE = 32 };
+static const glui32 STREAM_HASH_MULTIPLIER = 2654435761u;
+
+/*
+ * Checkpoint of open files and streams, with the file offset of each at the
+ * time the checkpoint was taken.
+ */
+struct ifp_file_image
 {
-  FILE* stream;
-  struct ifp_stream_info *next;
+  int fd;
+  FILE *stream;
+  off_t offset;
 };
-typedef struct ifp_stream_info *ifp_stream_inforef_t;
+typedef struct ifp_file_image *ifp_file_imageref_t;
+
+static ifp_file_imageref_t ifp_file_images = NULL;
+static int ifp_file_image_count = 0,
+           ifp_file_has_checkpoint = FALSE;
+
+
+/*
+ * ifp_file_set_contains()
+ * ifp_file_set_insert()
+ * ifp_file_set_erase()
+ * ifp_file_set_next()
+ *
+ * Test, set, and clear descriptor bits in a descriptor bitmap, and find the
+ * next set bit at or after a given descriptor.  Insert and erase return
+ * TRUE if they changed the bitmap.
+ */
+static int
+ifp_file_set_contains (ifp_fd_setref_t set, int fd)
+{
+  if (fd < 0 || fd / BITS_PER_WORD >= set->length)
+    return FALSE;
+
+  return (set->words[fd / BITS_PER_WORD] >> (fd % BITS_PER_WORD)) & 1;
+}
+
+static int
+ifp_file_set_insert (ifp_fd_setref_t set, int fd)
+{
+  unsigned long mask;
+  int word;
+
+  if (fd < 0)
+    return FALSE;
 
-/* List of open files and open streams. */
-static ifp_fd_inforef_t ifp_fd_list = NULL;
-static ifp_stream_inforef_t ifp_stream_list = NULL;
+  word = fd / BITS_PER_WORD;
+  if (word >= set->length)
+    {
+      int length;
+
+      length = set->length > 0 ? set->length : 1;
+      while (word >= length)
+        length *= 2;
+
+      set->words = ifp_realloc (set->words, length * sizeof (*set->words));
+      memset (set->words + set->length, 0,
+              (length - set->length) * sizeof (*set->words));
+      set->length = length;
+    }
+
+  mask = 1ul << (fd % BITS_PER_WORD);
+  if (set->words[word] & mask)
+    return FALSE;
+
+  set->words[word] |= mask;
+  set->count++;
+  return TRUE;
+}
+
+static int
+ifp_file_set_erase (ifp_fd_setref_t set, int fd)
+{
+  if (!ifp_file_set_contains (set, fd))
+    return FALSE;
+
+  set->words[fd / BITS_PER_WORD] &= ~(1ul << (fd % BITS_PER_WORD));
+  set->count--;
+  return TRUE;
+}
+
+static int
+ifp_file_set_next (ifp_fd_setref_t set, int fd)
+{
+  int word;
+
+  for (word = fd / BITS_PER_WORD; word < set->length; word++)
+    {
+      unsigned long bits;
+
+      bits = set->words[word];
+      if (word == fd / BITS_PER_WORD)
+        bits &= ~0ul << (fd % BITS_PER_WORD);
+
+      if (bits)
+        return word * BITS_PER_WORD + __builtin_ctzl (bits);
+    }
+
+  return -1;
+}
+
+
+/*
+ * ifp_file_stream_hash()
+ * ifp_file_stream_find_slot()
+ * ifp_file_stream_rebuild()
+ *
+ * Hash a stream pointer into the stream table, locate the slot holding a
+ * stream (or the slot where it should be inserted), and rebuild the table
+ * to a new size, discarding tombstones.
+ */
+static int
+ifp_file_stream_hash (FILE *stream)
+{
+  glui32 hash;
+
+  hash = (glui32) ((unsigned long) stream >> 4) * STREAM_HASH_MULTIPLIER;
+  return (int) (hash & (ifp_stream_files.size - 1));
+}
+
+static int
+ifp_file_stream_find_slot (FILE *stream)
+{
+  int slot, tombstone;
+
+  tombstone = -1;
+  for (slot = ifp_file_stream_hash (stream);
+       ifp_stream_files.slots[slot];
+       slot = (slot + 1) & (ifp_stream_files.size - 1))
+    {
+      if (ifp_stream_files.slots[slot] == stream)
+        return slot;
+
+      if (ifp_stream_files.slots[slot] == STREAM_TOMBSTONE && tombstone == -1)
+        tombstone = slot;
+    }
+
+  return tombstone != -1 ? tombstone : slot;
+}
+
+static void
+ifp_file_stream_rebuild (int size)
+{
+  FILE **slots;
+  int old_size, index_;
+
+  slots = ifp_stream_files.slots;
+  old_size = ifp_stream_files.size;
+
+  ifp_stream_files.slots = ifp_malloc (size * sizeof (*slots));
+  memset (ifp_stream_files.slots, 0, size * sizeof (*slots));
+  ifp_stream_files.size = size;
+  ifp_stream_files.used = ifp_stream_files.count;
+
+  for (index_ = 0; index_ < old_size; index_++)
+    {
+      if (slots[index_] && slots[index_] != STREAM_TOMBSTONE)
+        {
+          int slot;
+
+          slot = ifp_file_stream_find_slot (slots[index_]);
+          ifp_stream_files.slots[slot] = slots[index_];
+        }
+    }
+
+  ifp_free (slots);
+  ifp_trace ("file: stream table rebuilt with %d slots", size);
+}
+
+
+/*
+ * ifp_file_has_stream()
+ *
+ * Return TRUE if the given stream is on the open streams table.
+ */
+static int
+ifp_file_has_stream (FILE *stream)
+{
+  int slot;
+
+  if (ifp_stream_files.count == 0)
+    return FALSE;
+
+  slot = ifp_file_stream_find_slot (stream);
+  return ifp_stream_files.slots[slot] == stream;
+}
 
 
 /*
@@ -59,7 +271,7 @@ static ifp_stream_inforef_t ifp_stream_list = NULL;
  * ifp_file_remove_file()
  * ifp_file_remove_stream()
  *
- * Add and remove files and streams to/from the open file lists.
+ * Add and remove files and streams to/from the open file sets.
  *
  * Unlike our malloc-tracking cousin, we're a lot less strict about seeing
  * attempts to, say, delete a file not on our list.  This is because many
@@ -71,82 +283,79 @@ static ifp_stream_inforef_t ifp_stream_list = NULL;
 static void
 ifp_file_add_file (int fd)
 {
-  ifp_fd_inforef_t entry;
+  if (ifp_file_set_contains (&ifp_fd_stream_owned, fd))
+    {
+      ifp_trace ("file: file descriptor %d is owned by a stream", fd);
+      return;
+    }
 
-  entry = ifp_malloc (sizeof (*entry));
-  entry->fd = fd;
-  entry->next = ifp_fd_list;
-  ifp_fd_list = entry;
-  ifp_trace ("file: added file descriptor %d", fd);
+  if (ifp_file_set_insert (&ifp_fd_files, fd))
+    {
+      ifp_trace ("file: added file descriptor %d", fd);
+      ifp_plugin_check_file_usage (ifp_fd_files.count
+                                   + ifp_stream_files.count);
+    }
 }
 
 static void
 ifp_file_add_stream (FILE *stream)
 {
-  ifp_stream_inforef_t entry;
+  int slot, fd;
+
+  /* Grow the table (or clear tombstones) if over half full. */
+  if (2 * (ifp_stream_files.used + 1) > ifp_stream_files.size)
+    {
+      int size;
+
+      size = ifp_stream_files.size > 0
+             ? ifp_stream_files.size : STREAM_INITIAL_SIZE;
+      while (2 * (ifp_stream_files.count + 1) > size / 2)
+        size *= 2;
+      ifp_file_stream_rebuild (size);
+    }
+
+  slot = ifp_file_stream_find_slot (stream);
+  if (ifp_stream_files.slots[slot] == stream)
+    return;
+
+  if (!ifp_stream_files.slots[slot])
+    ifp_stream_files.used++;
+  ifp_stream_files.slots[slot] = stream;
+  ifp_stream_files.count++;
+
+  /* The stream now owns its descriptor; stop listing it as a plain file. */
+  fd = fileno (stream);
+  ifp_file_set_erase (&ifp_fd_files, fd);
+  ifp_file_set_insert (&ifp_fd_stream_owned, fd);
 
-  entry = ifp_malloc (sizeof (*entry));
-  entry->stream = stream;
-  entry->next = ifp_stream_list;
-  ifp_stream_list = entry;
   ifp_trace ("file: added file stream file_%p", ifp_trace_pointer (stream));
+  ifp_plugin_check_file_usage (ifp_fd_files.count + ifp_stream_files.count);
 }
 
 static void
 ifp_file_remove_file (int fd)
 {
-  ifp_fd_inforef_t entry, prior, next;
-
-  /* Search for the given file, and remove it if found. */
-  prior = NULL;
-  for (entry = ifp_fd_list; entry; entry = next)
-    {
-      next = entry->next;
-      if (entry->fd == fd)
-        {
-          ifp_trace ("file: removed file descriptor %d", fd);
-          if (!prior)
-            {
-              assert (entry == ifp_fd_list);
-              ifp_fd_list = next;
-            }
-          else
-            prior->next = next;
-
-          ifp_free (entry);
-        }
-      else
-        prior = entry;
-    }
+  if (ifp_file_set_erase (&ifp_fd_files, fd))
+    ifp_trace ("file: removed file descriptor %d", fd);
 }
 
 static void
-ifp_file_remove_stream (FILE *stream)
+ifp_file_remove_stream (FILE *stream, int fd)
 {
-  ifp_stream_inforef_t entry, prior, next;
+  int slot;
 
-  /* Search for the given stream, and remove it if found. */
-  prior = NULL;
-  for (entry = ifp_stream_list; entry; entry = next)
-    {
-      next = entry->next;
-      if (entry->stream == stream)
-        {
-          ifp_trace ("file: removed file stream"
-                     " file_%p", ifp_trace_pointer (stream));
-          if (!prior)
-            {
-              assert (entry == ifp_stream_list);
-              ifp_stream_list = next;
-            }
-          else
-            prior->next = next;
+  if (ifp_stream_files.count == 0)
+    return;
 
-          ifp_free (entry);
-        }
-      else
-        prior = entry;
-    }
+  slot = ifp_file_stream_find_slot (stream);
+  if (ifp_stream_files.slots[slot] != stream)
+    return;
+
+  ifp_stream_files.slots[slot] = STREAM_TOMBSTONE;
+  ifp_stream_files.count--;
+  ifp_file_set_erase (&ifp_fd_stream_owned, fd);
+
+  ifp_trace ("file: removed file stream file_%p", ifp_trace_pointer (stream));
 }
 
 
@@ -229,11 +438,20 @@ ifp_libc_intercept_dup2 (int oldfd, int newfd)
   int fd;
 
   fd = dup2 (oldfd, newfd);
-  if (fd != -1)
+  if (fd != -1 && oldfd != newfd)
     {
-      /* Remove newfd if listed, as dup2 will have closed it. */
-      ifp_file_remove_file (newfd);
-      ifp_file_add_file (fd);
+      /*
+       * If newfd belonged to a stream, the stream now holds the duplicate,
+       * and fclose will close it; otherwise remove newfd if listed, as dup2
+       * will have closed it, and list the duplicate.
+       */
+      if (ifp_file_set_contains (&ifp_fd_stream_owned, fd))
+        ifp_trace ("file: dup2 replaced stream descriptor %d", fd);
+      else
+        {
+          ifp_file_remove_file (newfd);
+          ifp_file_add_file (fd);
+        }
     }
 
   return fd;
@@ -269,8 +487,7 @@ ifp_libc_intercept_fdopen (int filedes, const char *mode)
   stream = fdopen (filedes, mode);
   if (stream)
     {
-      /* Remove filedes, and list the stream instead. */
-      ifp_file_remove_file (filedes);
+      /* The stream takes ownership of filedes, delisting it as a file. */
       ifp_file_add_stream (stream);
     }
 
@@ -281,13 +498,18 @@ FILE *
 ifp_libc_intercept_freopen (const char *path, const char *mode, FILE * stream)
 {
   FILE *new_stream;
+  int fd;
 
+  fd = fileno (stream);
   new_stream = freopen (path, mode, stream);
   if (new_stream)
     {
       /* Remove stream if listed, as freopen will have closed it. */
-      ifp_file_remove_stream (stream);
-      ifp_file_add_stream (new_stream);
+      if (ifp_file_has_stream (stream))
+        {
+          ifp_file_remove_stream (stream, fd);
+          ifp_file_add_stream (new_stream);
+        }
     }
 
   return new_stream;
@@ -296,50 +518,263 @@ ifp_libc_intercept_freopen (const char *path, const char *mode, FILE * stream)
 int
 ifp_libc_intercept_fclose (FILE * stream)
 {
-  int status;
+  int status, fd;
 
+  fd = fileno (stream);
   status = fclose (stream);
   if (status != EOF)
-    ifp_file_remove_stream (stream);
+    ifp_file_remove_stream (stream, fd);
 
   return status;
 }
 
 
+/*
+ * ifp_file_find_image()
+ *
+ * Return TRUE if the given file or stream is part of the current checkpoint.
+ */
+static int
+ifp_file_find_image (int fd, FILE *stream)
+{
+  int index_;
+
+  for (index_ = 0; index_ < ifp_file_image_count; index_++)
+    {
+      if (stream ? ifp_file_images[index_].stream == stream
+                 : (!ifp_file_images[index_].stream
+                    && ifp_file_images[index_].fd == fd))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * ifp_file_get_usage()
+ *
+ * Return the count of file descriptors and streams currently listed as
+ * open.  Either return pointer may be NULL.
+ */
+void
+ifp_file_get_usage (int *files, int *streams)
+{
+  if (files)
+    *files = ifp_fd_files.count;
+  if (streams)
+    *streams = ifp_stream_files.count;
+}
+
+
+/**
+ * ifp_file_checkpoint()
+ *
+ * Take a checkpoint of the files and streams currently open, noting the
+ * file offset of each.  Any prior checkpoint is discarded.  Returns TRUE
+ * if the checkpoint was taken.
+ */
+int
+ifp_file_checkpoint (void)
+{
+  int count, fd, slot;
+
+  ifp_trace ("file: ifp_file_checkpoint <- void");
+
+  ifp_file_discard_checkpoint ();
+
+  count = ifp_fd_files.count + ifp_stream_files.count;
+  ifp_file_images = count > 0
+                    ? ifp_malloc (count * sizeof (*ifp_file_images)) : NULL;
+  ifp_file_image_count = 0;
+
+  for (fd = ifp_file_set_next (&ifp_fd_files, 0);
+       fd != -1; fd = ifp_file_set_next (&ifp_fd_files, fd + 1))
+    {
+      ifp_file_imageref_t image;
+
+      image = ifp_file_images + ifp_file_image_count++;
+      image->fd = fd;
+      image->stream = NULL;
+      image->offset = lseek (fd, 0, SEEK_CUR);
+    }
+
+  for (slot = 0; slot < ifp_stream_files.size; slot++)
+    {
+      FILE *stream = ifp_stream_files.slots[slot];
+      ifp_file_imageref_t image;
+
+      if (!stream || stream == STREAM_TOMBSTONE)
+        continue;
+
+      image = ifp_file_images + ifp_file_image_count++;
+      image->fd = -1;
+      image->stream = stream;
+      image->offset = ftello (stream);
+    }
+
+  ifp_file_has_checkpoint = TRUE;
+
+  ifp_trace ("file: checkpointed %d file(s) and stream(s)", count);
+  return TRUE;
+}
+
+
+/**
+ * ifp_file_restore()
+ *
+ * Restore open files and streams to their state at the last checkpoint.
+ * Files and streams opened since the checkpoint are closed, and checkpointed
+ * ones are returned to their checkpoint file offsets.  If any checkpointed
+ * file or stream has since been closed, the checkpoint cannot be restored,
+ * and the function returns FALSE without changing anything.
+ */
+int
+ifp_file_restore (void)
+{
+  int index_, count, fd, slot;
+
+  ifp_trace ("file: ifp_file_restore <- void");
+
+  if (!ifp_file_has_checkpoint)
+    {
+      ifp_trace ("file: no checkpoint to restore");
+      return FALSE;
+    }
+
+  /* Verify that every checkpointed file and stream is still open. */
+  for (index_ = 0; index_ < ifp_file_image_count; index_++)
+    {
+      ifp_file_imageref_t image = ifp_file_images + index_;
+
+      if (image->stream ? !ifp_file_has_stream (image->stream)
+                        : !ifp_file_set_contains (&ifp_fd_files, image->fd))
+        {
+          ifp_trace ("file: checkpointed file %d/file_%p was closed",
+                     image->fd, ifp_trace_pointer (image->stream));
+          return FALSE;
+        }
+    }
+
+  /*
+   * Close files and streams opened since the checkpoint.  The open sets
+   * hold only the files and streams counted in the checkpoint if they are
+   * the same size, so only sweep them when they have grown.
+   */
+  if (ifp_fd_files.count + ifp_stream_files.count > ifp_file_image_count)
+    {
+      for (fd = ifp_file_set_next (&ifp_fd_files, 0);
+           fd != -1; fd = ifp_file_set_next (&ifp_fd_files, fd + 1))
+        {
+          if (!ifp_file_find_image (fd, NULL))
+            {
+              close (fd);
+              ifp_file_remove_file (fd);
+            }
+        }
+
+      for (slot = 0; slot < ifp_stream_files.size; slot++)
+        {
+          FILE *stream = ifp_stream_files.slots[slot];
+
+          if (stream && stream != STREAM_TOMBSTONE
+              && !ifp_file_find_image (-1, stream))
+            {
+              ifp_file_remove_stream (stream, fileno (stream));
+              fclose (stream);
+            }
+        }
+    }
+
+  /* Rewind checkpointed files and streams to their noted offsets. */
+  count = 0;
+  for (index_ = 0; index_ < ifp_file_image_count; index_++)
+    {
+      ifp_file_imageref_t image = ifp_file_images + index_;
+
+      if (image->offset == -1)
+        continue;
+
+      if (image->stream)
+        fseeko (image->stream, image->offset, SEEK_SET);
+      else
+        lseek (image->fd, image->offset, SEEK_SET);
+      count++;
+    }
+
+  ifp_trace ("file: restored %d file offset(s)", count);
+  return TRUE;
+}
+
+
+/**
+ * ifp_file_discard_checkpoint()
+ *
+ * Discard any held checkpoint of open files and streams.
+ */
+void
+ifp_file_discard_checkpoint (void)
+{
+  if (!ifp_file_has_checkpoint)
+    return;
+
+  ifp_trace ("file: ifp_file_discard_checkpoint <- void");
+
+  ifp_free (ifp_file_images);
+  ifp_file_images = NULL;
+  ifp_file_image_count = 0;
+  ifp_file_has_checkpoint = FALSE;
+}
+
+
 /**
  * ifp_file_open_files_cleanup()
  *
  * Close any files and streams that are listed as left open by a completed
- * plugin.
+ * plugin.  The open sets keep their storage for the next plugin.
  */
 void
 ifp_file_open_files_cleanup (void)
 {
-  ifp_fd_inforef_t fd_entry, fd_next;
-  ifp_stream_inforef_t stream_entry, stream_next;
+  int word, slot;
 
   ifp_trace ("file: ifp_file_open_files_cleanup <- void");
 
-  for (fd_entry = ifp_fd_list;
-       fd_entry; fd_entry = fd_next)
+  ifp_file_discard_checkpoint ();
+
+  for (word = 0; word < ifp_fd_files.length; word++)
     {
-      fd_next = fd_entry->next;
+      unsigned long bits;
 
-      close (fd_entry->fd);
-      ifp_trace ("file: reaped file descriptor %d", fd_entry->fd);
-      ifp_free (fd_entry);
+      for (bits = ifp_fd_files.words[word]; bits; bits &= bits - 1)
+        {
+          int fd;
+
+          fd = word * BITS_PER_WORD + __builtin_ctzl (bits);
+          close (fd);
+          ifp_trace ("file: reaped file descriptor %d", fd);
+        }
+      ifp_fd_files.words[word] = 0;
     }
-  ifp_fd_list = NULL;
+  ifp_fd_files.count = 0;
 
-  for (stream_entry = ifp_stream_list;
-       stream_entry; stream_entry = stream_next)
+  for (slot = 0; slot < ifp_stream_files.size; slot++)
     {
-      stream_next = stream_entry->next;
+      FILE *stream = ifp_stream_files.slots[slot];
 
-      fclose (stream_entry->stream);
-      ifp_trace ("file: reaped file stream"
-                 " file_%p", ifp_trace_pointer (stream_entry->stream));
-      ifp_free (stream_entry);
+      if (stream && stream != STREAM_TOMBSTONE)
+        {
+          ifp_trace ("file: reaping file stream"
+                     " file_%p", ifp_trace_pointer (stream));
+          fclose (stream);
+        }
+      ifp_stream_files.slots[slot] = NULL;
     }
-  ifp_stream_list = NULL;
+  ifp_stream_files.count = 0;
+  ifp_stream_files.used = 0;
+
+  if (ifp_fd_stream_owned.length > 0)
+    memset (ifp_fd_stream_owned.words, 0,
+            ifp_fd_stream_owned.length * sizeof (*ifp_fd_stream_owned.words));
+  ifp_fd_stream_owned.count = 0;
 }
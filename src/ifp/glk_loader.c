@@ -19,11 +19,14 @@
  */
 
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_GLKLOADER
+
 
 /*
  * Glk interface vectors.  There are two of these.  The first is private,
@@ -524,7 +527,8 @@ ifp_glk_unload_interface (void)
  * plugin on plugin load.  This allows the Glk interface to be passed
  * forwards to chained plugins.  Otherwise, the function returns the main
  * program Glk interface, listing the callable addresses of the real Glk
- * routines.
+ * routines, or if Glk call recording, replay, or profiling is selected, an
+ * interface that wraps it.
  */
 ifp_glk_interfaceref_t
 ifp_glk_get_interface (void)
@@ -541,12 +545,65 @@ ifp_glk_get_interface (void)
       if (public_glk_interface.version == 0)
         ifp_fatal ("glkloader: no interface loaded or initialized");
 
+      /*
+       * If recording or replaying, hand out a recorder interface wrapping
+       * this one, and if profiling, a profiling interface wrapping it.
+       */
+      if (ifp_glk_record_get_selected () || ifp_glk_replay_get_selected ())
+        {
+          ifp_trace ("glkloader: returning a recorder glk interface");
+          return ifp_glk_record_get_interface (&public_glk_interface);
+        }
+      else if (ifp_glk_profile_is_selected ())
+        {
+          ifp_trace ("glkloader: returning a profiling glk interface");
+          return ifp_glk_profile_get_interface (&public_glk_interface);
+        }
+
       ifp_trace ("glkloader: returning the main glk interface");
       return &public_glk_interface;
     }
 }
 
 
+/*
+ * ifp_glk_refresh_interface()
+ *
+ * Bring an interface that wraps another up to date with changes made to
+ * the wrapped one since a snapshot of it was taken.  An entry is copied
+ * only where the wrapped interface has changed and the wrapper still holds
+ * the snapshot's value, so that neither the wrapper's own entries nor any
+ * that a caller has since set on the wrapper are replaced.  The snapshot
+ * is then retaken.
+ */
+void
+ifp_glk_refresh_interface (ifp_glk_interfaceref_t wrapper,
+                           ifp_glk_interfaceref_t snapshot,
+                           ifp_glk_interfaceref_t wrapped)
+{
+  function_ptr_t *entries, *snapshots, *sources;
+  int count, index_;
+  assert (wrapper && snapshot && wrapped);
+
+  /* Note: the interface is, after its version, all function pointers. */
+  entries = (function_ptr_t *) &wrapper->glk_exit;
+  snapshots = (function_ptr_t *) &snapshot->glk_exit;
+  sources = (function_ptr_t *) &wrapped->glk_exit;
+  count = (sizeof (*wrapper) - offsetof (struct ifp_glk_interface, glk_exit))
+          / sizeof (function_ptr_t);
+
+  for (index_ = 0; index_ < count; index_++)
+    {
+      if (sources[index_] != snapshots[index_]
+          && entries[index_] == snapshots[index_])
+        entries[index_] = sources[index_];
+    }
+
+  wrapper->version = wrapped->version;
+  memcpy (snapshot, wrapped, sizeof (*wrapped));
+}
+
+
 /*
  * fallback_glk_function_handler()
  *
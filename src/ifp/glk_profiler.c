@@ -0,0 +1,2253 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2001-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ifp.h"
+#include "ifp_internal.h"
+
+#define IFP_TRACE_FACILITY IFP_TRACE_GLKPROFILE
+
+/*
+ * Glk call profiling works by interface vector swapping.  When profiling is
+ * selected, plugins are handed a profiling Glk interface rather than the
+ * main public one.  Each entry in the profiling interface is a wrapper that
+ * times the call through to the next interface, and accumulates a count,
+ * cumulative time, a log2 histogram of call latencies, and for stream put
+ * and get functions, a byte count.  When profiling is not selected, plugins
+ * get the public interface directly, so there is no cost at all.
+ *
+ * A few entries are not wrapped, and pass straight through: glk_exit, which
+ * is overridden on plugin attach and never returns, the dispatch registry
+ * setters, which are called once only, and gli_stream_open_pathname.
+ */
+
+/* Profiling selection flag, set by the direct interface. */
+static int ifp_glk_profile_selected = FALSE;
+
+/*
+ * Profiling Glk interface handed to plugins, the interface its wrappers
+ * call through to, and a snapshot of that interface as last copied from.
+ */
+static struct ifp_glk_interface profile_glk_interface,
+                                profile_glk_snapshot;
+static ifp_glk_interfaceref_t next_glk_interface = NULL;
+
+/* Indexes of profiled functions in the records table. */
+enum {
+  PROFILE_GLK_SET_INTERRUPT_HANDLER,
+  PROFILE_GLK_TICK,
+  PROFILE_GLK_GESTALT,
+  PROFILE_GLK_GESTALT_EXT,
+  PROFILE_GLK_CHAR_TO_LOWER,
+  PROFILE_GLK_CHAR_TO_UPPER,
+  PROFILE_GLK_WINDOW_GET_ROOT,
+  PROFILE_GLK_WINDOW_OPEN,
+  PROFILE_GLK_WINDOW_CLOSE,
+  PROFILE_GLK_WINDOW_GET_SIZE,
+  PROFILE_GLK_WINDOW_SET_ARRANGEMENT,
+  PROFILE_GLK_WINDOW_GET_ARRANGEMENT,
+  PROFILE_GLK_WINDOW_ITERATE,
+  PROFILE_GLK_WINDOW_GET_ROCK,
+  PROFILE_GLK_WINDOW_GET_TYPE,
+  PROFILE_GLK_WINDOW_GET_PARENT,
+  PROFILE_GLK_WINDOW_GET_SIBLING,
+  PROFILE_GLK_WINDOW_CLEAR,
+  PROFILE_GLK_WINDOW_MOVE_CURSOR,
+  PROFILE_GLK_WINDOW_GET_STREAM,
+  PROFILE_GLK_WINDOW_SET_ECHO_STREAM,
+  PROFILE_GLK_WINDOW_GET_ECHO_STREAM,
+  PROFILE_GLK_SET_WINDOW,
+  PROFILE_GLK_STREAM_OPEN_FILE,
+  PROFILE_GLK_STREAM_OPEN_MEMORY,
+  PROFILE_GLK_STREAM_CLOSE,
+  PROFILE_GLK_STREAM_ITERATE,
+  PROFILE_GLK_STREAM_GET_ROCK,
+  PROFILE_GLK_STREAM_SET_POSITION,
+  PROFILE_GLK_STREAM_GET_POSITION,
+  PROFILE_GLK_STREAM_SET_CURRENT,
+  PROFILE_GLK_STREAM_GET_CURRENT,
+  PROFILE_GLK_PUT_CHAR,
+  PROFILE_GLK_PUT_CHAR_STREAM,
+  PROFILE_GLK_PUT_STRING,
+  PROFILE_GLK_PUT_STRING_STREAM,
+  PROFILE_GLK_PUT_BUFFER,
+  PROFILE_GLK_PUT_BUFFER_STREAM,
+  PROFILE_GLK_SET_STYLE,
+  PROFILE_GLK_SET_STYLE_STREAM,
+  PROFILE_GLK_GET_CHAR_STREAM,
+  PROFILE_GLK_GET_LINE_STREAM,
+  PROFILE_GLK_GET_BUFFER_STREAM,
+  PROFILE_GLK_STYLEHINT_SET,
+  PROFILE_GLK_STYLEHINT_CLEAR,
+  PROFILE_GLK_STYLE_DISTINGUISH,
+  PROFILE_GLK_STYLE_MEASURE,
+  PROFILE_GLK_FILEREF_CREATE_TEMP,
+  PROFILE_GLK_FILEREF_CREATE_BY_NAME,
+  PROFILE_GLK_FILEREF_CREATE_BY_PROMPT,
+  PROFILE_GLK_FILEREF_CREATE_FROM_FILEREF,
+  PROFILE_GLK_FILEREF_DESTROY,
+  PROFILE_GLK_FILEREF_ITERATE,
+  PROFILE_GLK_FILEREF_GET_ROCK,
+  PROFILE_GLK_FILEREF_DELETE_FILE,
+  PROFILE_GLK_FILEREF_DOES_FILE_EXIST,
+  PROFILE_GLK_SELECT,
+  PROFILE_GLK_SELECT_POLL,
+  PROFILE_GLK_REQUEST_TIMER_EVENTS,
+  PROFILE_GLK_REQUEST_LINE_EVENT,
+  PROFILE_GLK_REQUEST_CHAR_EVENT,
+  PROFILE_GLK_REQUEST_MOUSE_EVENT,
+  PROFILE_GLK_CANCEL_LINE_EVENT,
+  PROFILE_GLK_CANCEL_CHAR_EVENT,
+  PROFILE_GLK_CANCEL_MOUSE_EVENT,
+  PROFILE_GLK_BUFFER_TO_LOWER_CASE_UNI,
+  PROFILE_GLK_BUFFER_TO_UPPER_CASE_UNI,
+  PROFILE_GLK_BUFFER_TO_TITLE_CASE_UNI,
+  PROFILE_GLK_PUT_CHAR_UNI,
+  PROFILE_GLK_PUT_STRING_UNI,
+  PROFILE_GLK_PUT_BUFFER_UNI,
+  PROFILE_GLK_PUT_CHAR_STREAM_UNI,
+  PROFILE_GLK_PUT_STRING_STREAM_UNI,
+  PROFILE_GLK_PUT_BUFFER_STREAM_UNI,
+  PROFILE_GLK_GET_CHAR_STREAM_UNI,
+  PROFILE_GLK_GET_BUFFER_STREAM_UNI,
+  PROFILE_GLK_GET_LINE_STREAM_UNI,
+  PROFILE_GLK_STREAM_OPEN_FILE_UNI,
+  PROFILE_GLK_STREAM_OPEN_MEMORY_UNI,
+  PROFILE_GLK_REQUEST_CHAR_EVENT_UNI,
+  PROFILE_GLK_REQUEST_LINE_EVENT_UNI,
+  PROFILE_GLK_IMAGE_DRAW,
+  PROFILE_GLK_IMAGE_DRAW_SCALED,
+  PROFILE_GLK_IMAGE_GET_INFO,
+  PROFILE_GLK_WINDOW_FLOW_BREAK,
+  PROFILE_GLK_WINDOW_ERASE_RECT,
+  PROFILE_GLK_WINDOW_FILL_RECT,
+  PROFILE_GLK_WINDOW_SET_BACKGROUND_COLOR,
+  PROFILE_GLK_SCHANNEL_CREATE,
+  PROFILE_GLK_SCHANNEL_DESTROY,
+  PROFILE_GLK_SCHANNEL_ITERATE,
+  PROFILE_GLK_SCHANNEL_GET_ROCK,
+  PROFILE_GLK_SCHANNEL_PLAY,
+  PROFILE_GLK_SCHANNEL_PLAY_EXT,
+  PROFILE_GLK_SCHANNEL_STOP,
+  PROFILE_GLK_SCHANNEL_SET_VOLUME,
+  PROFILE_GLK_SOUND_LOAD_HINT,
+  PROFILE_GLK_SET_HYPERLINK,
+  PROFILE_GLK_SET_HYPERLINK_STREAM,
+  PROFILE_GLK_REQUEST_HYPERLINK_EVENT,
+  PROFILE_GLK_CANCEL_HYPERLINK_EVENT,
+  PROFILE_GLKUNIX_SET_BASE_FILE,
+  PROFILE_GLKUNIX_STREAM_OPEN_PATHNAME,
+  PROFILE_GIDISPATCH_GET_OBJROCK,
+  PROFILE_GIDISPATCH_CALL,
+  PROFILE_GIDISPATCH_PROTOTYPE,
+  PROFILE_GIDISPATCH_COUNT_CLASSES,
+  PROFILE_GIDISPATCH_COUNT_INTCONST,
+  PROFILE_GIDISPATCH_GET_INTCONST,
+  PROFILE_GIDISPATCH_COUNT_FUNCTIONS,
+  PROFILE_GIDISPATCH_GET_FUNCTION,
+  PROFILE_GIDISPATCH_GET_FUNCTION_BY_ID,
+  PROFILE_GIBLORB_CREATE_MAP,
+  PROFILE_GIBLORB_DESTROY_MAP,
+  PROFILE_GIBLORB_LOAD_CHUNK_BY_TYPE,
+  PROFILE_GIBLORB_LOAD_CHUNK_BY_NUMBER,
+  PROFILE_GIBLORB_UNLOAD_CHUNK,
+  PROFILE_GIBLORB_LOAD_RESOURCE,
+  PROFILE_GIBLORB_COUNT_RESOURCES,
+  PROFILE_GIBLORB_SET_RESOURCE_MAP,
+  PROFILE_GIBLORB_GET_RESOURCE_MAP,
+  PROFILE_FUNCTION_COUNT
+};
+/*
+ * Per-function profile records.  Histogram bucket n counts calls that took
+ * between 2^n and 2^(n+1) nanoseconds; the last bucket counts everything
+ * longer.
+ */
+enum { PROFILE_HISTOGRAM_BUCKETS = 32 };
+
+typedef struct {
+  unsigned long calls;
+  unsigned long long nanoseconds;
+  unsigned long long bytes;
+  unsigned long histogram[PROFILE_HISTOGRAM_BUCKETS];
+} ifp_glk_profile_record_t;
+
+static ifp_glk_profile_record_t
+    ifp_glk_profile_records[PROFILE_FUNCTION_COUNT];
+
+/*
+ * Optional observer notified of each profiled call, used by the Glk call
+ * recorder to log calls.
+ */
+static void (*ifp_glk_profile_observer) (int function,
+                                         unsigned long long bytes) = NULL;
+
+/* Names of profiled functions, in record index order. */
+static const char *const PROFILE_FUNCTION_NAMES[PROFILE_FUNCTION_COUNT] = {
+  "glk_set_interrupt_handler",
+  "glk_tick",
+  "glk_gestalt",
+  "glk_gestalt_ext",
+  "glk_char_to_lower",
+  "glk_char_to_upper",
+  "glk_window_get_root",
+  "glk_window_open",
+  "glk_window_close",
+  "glk_window_get_size",
+  "glk_window_set_arrangement",
+  "glk_window_get_arrangement",
+  "glk_window_iterate",
+  "glk_window_get_rock",
+  "glk_window_get_type",
+  "glk_window_get_parent",
+  "glk_window_get_sibling",
+  "glk_window_clear",
+  "glk_window_move_cursor",
+  "glk_window_get_stream",
+  "glk_window_set_echo_stream",
+  "glk_window_get_echo_stream",
+  "glk_set_window",
+  "glk_stream_open_file",
+  "glk_stream_open_memory",
+  "glk_stream_close",
+  "glk_stream_iterate",
+  "glk_stream_get_rock",
+  "glk_stream_set_position",
+  "glk_stream_get_position",
+  "glk_stream_set_current",
+  "glk_stream_get_current",
+  "glk_put_char",
+  "glk_put_char_stream",
+  "glk_put_string",
+  "glk_put_string_stream",
+  "glk_put_buffer",
+  "glk_put_buffer_stream",
+  "glk_set_style",
+  "glk_set_style_stream",
+  "glk_get_char_stream",
+  "glk_get_line_stream",
+  "glk_get_buffer_stream",
+  "glk_stylehint_set",
+  "glk_stylehint_clear",
+  "glk_style_distinguish",
+  "glk_style_measure",
+  "glk_fileref_create_temp",
+  "glk_fileref_create_by_name",
+  "glk_fileref_create_by_prompt",
+  "glk_fileref_create_from_fileref",
+  "glk_fileref_destroy",
+  "glk_fileref_iterate",
+  "glk_fileref_get_rock",
+  "glk_fileref_delete_file",
+  "glk_fileref_does_file_exist",
+  "glk_select",
+  "glk_select_poll",
+  "glk_request_timer_events",
+  "glk_request_line_event",
+  "glk_request_char_event",
+  "glk_request_mouse_event",
+  "glk_cancel_line_event",
+  "glk_cancel_char_event",
+  "glk_cancel_mouse_event",
+  "glk_buffer_to_lower_case_uni",
+  "glk_buffer_to_upper_case_uni",
+  "glk_buffer_to_title_case_uni",
+  "glk_put_char_uni",
+  "glk_put_string_uni",
+  "glk_put_buffer_uni",
+  "glk_put_char_stream_uni",
+  "glk_put_string_stream_uni",
+  "glk_put_buffer_stream_uni",
+  "glk_get_char_stream_uni",
+  "glk_get_buffer_stream_uni",
+  "glk_get_line_stream_uni",
+  "glk_stream_open_file_uni",
+  "glk_stream_open_memory_uni",
+  "glk_request_char_event_uni",
+  "glk_request_line_event_uni",
+  "glk_image_draw",
+  "glk_image_draw_scaled",
+  "glk_image_get_info",
+  "glk_window_flow_break",
+  "glk_window_erase_rect",
+  "glk_window_fill_rect",
+  "glk_window_set_background_color",
+  "glk_schannel_create",
+  "glk_schannel_destroy",
+  "glk_schannel_iterate",
+  "glk_schannel_get_rock",
+  "glk_schannel_play",
+  "glk_schannel_play_ext",
+  "glk_schannel_stop",
+  "glk_schannel_set_volume",
+  "glk_sound_load_hint",
+  "glk_set_hyperlink",
+  "glk_set_hyperlink_stream",
+  "glk_request_hyperlink_event",
+  "glk_cancel_hyperlink_event",
+  "glkunix_set_base_file",
+  "glkunix_stream_open_pathname",
+  "gidispatch_get_objrock",
+  "gidispatch_call",
+  "gidispatch_prototype",
+  "gidispatch_count_classes",
+  "gidispatch_count_intconst",
+  "gidispatch_get_intconst",
+  "gidispatch_count_functions",
+  "gidispatch_get_function",
+  "gidispatch_get_function_by_id",
+  "giblorb_create_map",
+  "giblorb_destroy_map",
+  "giblorb_load_chunk_by_type",
+  "giblorb_load_chunk_by_number",
+  "giblorb_unload_chunk",
+  "giblorb_load_resource",
+  "giblorb_count_resources",
+  "giblorb_set_resource_map",
+  "giblorb_get_resource_map",
+
+};
+
+
+/**
+ * ifp_glk_profile_select()
+ * ifp_glk_profile_is_selected()
+ *
+ * Select or deselect Glk call profiling, and return the current selection.
+ * Setting the IFP_GLK_PROFILE environment variable overrides any selection
+ * made by the direct interface.  Selection takes effect for plugins loaded
+ * after the call.
+ */
+void
+ifp_glk_profile_select (int flag)
+{
+  ifp_trace ("glkprofile: profiling set to %d", flag);
+  ifp_glk_profile_selected = flag;
+}
+
+int
+ifp_glk_profile_is_selected (void)
+{
+  static int initialized = FALSE;
+  static const char *ifp_glk_profile;
+
+  if (!initialized)
+    {
+      ifp_glk_profile = getenv ("IFP_GLK_PROFILE");
+      if (ifp_glk_profile)
+        ifp_notice ("glkprofile: %s initialized Glk call profiling",
+                    "IFP_GLK_PROFILE");
+      initialized = TRUE;
+    }
+
+  return ifp_glk_profile ? TRUE : ifp_glk_profile_selected;
+}
+
+
+/*
+ * ifp_glk_profile_start()
+ * ifp_glk_profile_stop()
+ *
+ * Note the start time of a profiled call, and on its return, accumulate the
+ * elapsed time and bytes transferred into the record for the function.
+ */
+static inline void
+ifp_glk_profile_start (struct timespec *start)
+{
+  clock_gettime (CLOCK_MONOTONIC, start);
+}
+
+static inline void
+ifp_glk_profile_stop (int function, const struct timespec *start,
+                      unsigned long long bytes)
+{
+  ifp_glk_profile_record_t *record;
+  struct timespec end;
+  unsigned long long elapsed, scaled;
+  int bucket;
+
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  elapsed = (end.tv_sec - start->tv_sec) * 1000000000ULL
+            + end.tv_nsec - start->tv_nsec;
+
+  /* Find the log2 histogram bucket for this elapsed time. */
+  bucket = 0;
+  for (scaled = elapsed >> 1;
+       scaled > 0 && bucket < PROFILE_HISTOGRAM_BUCKETS - 1; scaled >>= 1)
+    bucket++;
+
+  record = ifp_glk_profile_records + function;
+  record->calls++;
+  record->nanoseconds += elapsed;
+  record->bytes += bytes;
+  record->histogram[bucket]++;
+
+  if (ifp_glk_profile_observer)
+    ifp_glk_profile_observer (function, bytes);
+}
+
+
+/*
+ * ifp_glk_profile_strlen_uni()
+ *
+ * Return the length of a zero-terminated Unicode string, in characters.
+ */
+static size_t
+ifp_glk_profile_strlen_uni (const glui32 *s)
+{
+  size_t length;
+
+  for (length = 0; s[length] != 0; length++)
+    ;
+
+  return length;
+}
+
+
+/*
+ * Profiling wrappers for each Glk interface function.  These call through
+ * to the next Glk interface, and accumulate profile data for the call.
+ */
+static void
+profile_glk_set_interrupt_handler (void (*func) (void))
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_set_interrupt_handler (func);
+  ifp_glk_profile_stop (PROFILE_GLK_SET_INTERRUPT_HANDLER, &start, 0);
+}
+
+static void
+profile_glk_tick (void)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_tick ();
+  ifp_glk_profile_stop (PROFILE_GLK_TICK, &start, 0);
+}
+
+static glui32
+profile_glk_gestalt (glui32 sel, glui32 val)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_gestalt (sel, val);
+  ifp_glk_profile_stop (PROFILE_GLK_GESTALT, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_gestalt_ext (glui32 sel, glui32 val, glui32 *arr, glui32 arrlen)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_gestalt_ext (sel, val, arr, arrlen);
+  ifp_glk_profile_stop (PROFILE_GLK_GESTALT_EXT, &start, 0);
+  return value;
+}
+
+static unsigned char
+profile_glk_char_to_lower (unsigned char ch)
+{
+  struct timespec start;
+  unsigned char value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_char_to_lower (ch);
+  ifp_glk_profile_stop (PROFILE_GLK_CHAR_TO_LOWER, &start, 0);
+  return value;
+}
+
+static unsigned char
+profile_glk_char_to_upper (unsigned char ch)
+{
+  struct timespec start;
+  unsigned char value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_char_to_upper (ch);
+  ifp_glk_profile_stop (PROFILE_GLK_CHAR_TO_UPPER, &start, 0);
+  return value;
+}
+
+static winid_t
+profile_glk_window_get_root (void)
+{
+  struct timespec start;
+  winid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_get_root ();
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_ROOT, &start, 0);
+  return value;
+}
+
+static winid_t
+profile_glk_window_open (winid_t split, glui32 method, glui32 size,
+                         glui32 wintype, glui32 rock)
+{
+  struct timespec start;
+  winid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_open (split, method, size, wintype,
+                                               rock);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_OPEN, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_window_close (winid_t win, stream_result_t *result)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_close (win, result);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_CLOSE, &start, 0);
+}
+
+static void
+profile_glk_window_get_size (winid_t win, glui32 *widthptr, glui32 *heightptr)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_get_size (win, widthptr, heightptr);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_SIZE, &start, 0);
+}
+
+static void
+profile_glk_window_set_arrangement (winid_t win, glui32 method, glui32 size,
+                                    winid_t keywin)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_set_arrangement (win, method, size, keywin);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_SET_ARRANGEMENT, &start, 0);
+}
+
+static void
+profile_glk_window_get_arrangement (winid_t win, glui32 *methodptr,
+                                    glui32 *sizeptr, winid_t *keywinptr)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_get_arrangement (win, methodptr, sizeptr,
+                                                  keywinptr);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_ARRANGEMENT, &start, 0);
+}
+
+static winid_t
+profile_glk_window_iterate (winid_t win, glui32 *rockptr)
+{
+  struct timespec start;
+  winid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_iterate (win, rockptr);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_ITERATE, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_window_get_rock (winid_t win)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_get_rock (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_ROCK, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_window_get_type (winid_t win)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_get_type (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_TYPE, &start, 0);
+  return value;
+}
+
+static winid_t
+profile_glk_window_get_parent (winid_t win)
+{
+  struct timespec start;
+  winid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_get_parent (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_PARENT, &start, 0);
+  return value;
+}
+
+static winid_t
+profile_glk_window_get_sibling (winid_t win)
+{
+  struct timespec start;
+  winid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_get_sibling (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_SIBLING, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_window_clear (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_clear (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_CLEAR, &start, 0);
+}
+
+static void
+profile_glk_window_move_cursor (winid_t win, glui32 xpos, glui32 ypos)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_move_cursor (win, xpos, ypos);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_MOVE_CURSOR, &start, 0);
+}
+
+static strid_t
+profile_glk_window_get_stream (winid_t win)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_get_stream (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_STREAM, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_window_set_echo_stream (winid_t win, strid_t str)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_set_echo_stream (win, str);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_SET_ECHO_STREAM, &start, 0);
+}
+
+static strid_t
+profile_glk_window_get_echo_stream (winid_t win)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_window_get_echo_stream (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_GET_ECHO_STREAM, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_set_window (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_set_window (win);
+  ifp_glk_profile_stop (PROFILE_GLK_SET_WINDOW, &start, 0);
+}
+
+static strid_t
+profile_glk_stream_open_file (frefid_t fileref, glui32 fmode, glui32 rock)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_open_file (fileref, fmode, rock);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_OPEN_FILE, &start, 0);
+  return value;
+}
+
+static strid_t
+profile_glk_stream_open_memory (char *buf, glui32 buflen, glui32 fmode,
+                                glui32 rock)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_open_memory (buf, buflen, fmode,
+                                                      rock);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_OPEN_MEMORY, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_stream_close (strid_t str, stream_result_t *result)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_stream_close (str, result);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_CLOSE, &start, 0);
+}
+
+static strid_t
+profile_glk_stream_iterate (strid_t str, glui32 *rockptr)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_iterate (str, rockptr);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_ITERATE, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_stream_get_rock (strid_t str)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_get_rock (str);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_GET_ROCK, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_stream_set_position (strid_t str, glsi32 pos, glui32 seekmode)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_stream_set_position (str, pos, seekmode);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_SET_POSITION, &start, 0);
+}
+
+static glui32
+profile_glk_stream_get_position (strid_t str)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_get_position (str);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_GET_POSITION, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_stream_set_current (strid_t str)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_stream_set_current (str);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_SET_CURRENT, &start, 0);
+}
+
+static strid_t
+profile_glk_stream_get_current (void)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_get_current ();
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_GET_CURRENT, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_put_char (unsigned char ch)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_char (ch);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_CHAR, &start, 1);
+}
+
+static void
+profile_glk_put_char_stream (strid_t str, unsigned char ch)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_char_stream (str, ch);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_CHAR_STREAM, &start, 1);
+}
+
+static void
+profile_glk_put_string (char *s)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_string (s);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_STRING, &start, strlen (s));
+}
+
+static void
+profile_glk_put_string_stream (strid_t str, char *s)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_string_stream (str, s);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_STRING_STREAM, &start, strlen (s));
+}
+
+static void
+profile_glk_put_buffer (char *buf, glui32 len)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_buffer (buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_BUFFER, &start, len);
+}
+
+static void
+profile_glk_put_buffer_stream (strid_t str, char *buf, glui32 len)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_buffer_stream (str, buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_BUFFER_STREAM, &start, len);
+}
+
+static void
+profile_glk_set_style (glui32 styl)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_set_style (styl);
+  ifp_glk_profile_stop (PROFILE_GLK_SET_STYLE, &start, 0);
+}
+
+static void
+profile_glk_set_style_stream (strid_t str, glui32 styl)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_set_style_stream (str, styl);
+  ifp_glk_profile_stop (PROFILE_GLK_SET_STYLE_STREAM, &start, 0);
+}
+
+static glsi32
+profile_glk_get_char_stream (strid_t str)
+{
+  struct timespec start;
+  glsi32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_get_char_stream (str);
+  ifp_glk_profile_stop (PROFILE_GLK_GET_CHAR_STREAM, &start,
+                        value != -1 ? 1 : 0);
+  return value;
+}
+
+static glui32
+profile_glk_get_line_stream (strid_t str, char *buf, glui32 len)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_get_line_stream (str, buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_GET_LINE_STREAM, &start, value);
+  return value;
+}
+
+static glui32
+profile_glk_get_buffer_stream (strid_t str, char *buf, glui32 len)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_get_buffer_stream (str, buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_GET_BUFFER_STREAM, &start, value);
+  return value;
+}
+
+static void
+profile_glk_stylehint_set (glui32 wintype, glui32 styl, glui32 hint,
+                           glsi32 val)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_stylehint_set (wintype, styl, hint, val);
+  ifp_glk_profile_stop (PROFILE_GLK_STYLEHINT_SET, &start, 0);
+}
+
+static void
+profile_glk_stylehint_clear (glui32 wintype, glui32 styl, glui32 hint)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_stylehint_clear (wintype, styl, hint);
+  ifp_glk_profile_stop (PROFILE_GLK_STYLEHINT_CLEAR, &start, 0);
+}
+
+static glui32
+profile_glk_style_distinguish (winid_t win, glui32 styl1, glui32 styl2)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_style_distinguish (win, styl1, styl2);
+  ifp_glk_profile_stop (PROFILE_GLK_STYLE_DISTINGUISH, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_style_measure (winid_t win, glui32 styl, glui32 hint,
+                           glui32 *result)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_style_measure (win, styl, hint, result);
+  ifp_glk_profile_stop (PROFILE_GLK_STYLE_MEASURE, &start, 0);
+  return value;
+}
+
+static frefid_t
+profile_glk_fileref_create_temp (glui32 usage, glui32 rock)
+{
+  struct timespec start;
+  frefid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_fileref_create_temp (usage, rock);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_CREATE_TEMP, &start, 0);
+  return value;
+}
+
+static frefid_t
+profile_glk_fileref_create_by_name (glui32 usage, char *name, glui32 rock)
+{
+  struct timespec start;
+  frefid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_fileref_create_by_name (usage, name, rock);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_CREATE_BY_NAME, &start, 0);
+  return value;
+}
+
+static frefid_t
+profile_glk_fileref_create_by_prompt (glui32 usage, glui32 fmode, glui32 rock)
+{
+  struct timespec start;
+  frefid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_fileref_create_by_prompt (usage, fmode,
+                                                            rock);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_CREATE_BY_PROMPT, &start, 0);
+  return value;
+}
+
+static frefid_t
+profile_glk_fileref_create_from_fileref (glui32 usage, frefid_t fref,
+                                         glui32 rock)
+{
+  struct timespec start;
+  frefid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_fileref_create_from_fileref (usage, fref,
+                                                               rock);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_CREATE_FROM_FILEREF, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_fileref_destroy (frefid_t fref)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_fileref_destroy (fref);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_DESTROY, &start, 0);
+}
+
+static frefid_t
+profile_glk_fileref_iterate (frefid_t fref, glui32 *rockptr)
+{
+  struct timespec start;
+  frefid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_fileref_iterate (fref, rockptr);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_ITERATE, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_fileref_get_rock (frefid_t fref)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_fileref_get_rock (fref);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_GET_ROCK, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_fileref_delete_file (frefid_t fref)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_fileref_delete_file (fref);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_DELETE_FILE, &start, 0);
+}
+
+static glui32
+profile_glk_fileref_does_file_exist (frefid_t fref)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_fileref_does_file_exist (fref);
+  ifp_glk_profile_stop (PROFILE_GLK_FILEREF_DOES_FILE_EXIST, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_select (event_t *event)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_select (event);
+  ifp_glk_profile_stop (PROFILE_GLK_SELECT, &start, 0);
+}
+
+static void
+profile_glk_select_poll (event_t *event)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_select_poll (event);
+  ifp_glk_profile_stop (PROFILE_GLK_SELECT_POLL, &start, 0);
+}
+
+static void
+profile_glk_request_timer_events (glui32 millisecs)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_request_timer_events (millisecs);
+  ifp_glk_profile_stop (PROFILE_GLK_REQUEST_TIMER_EVENTS, &start, 0);
+}
+
+static void
+profile_glk_request_line_event (winid_t win, char *buf, glui32 maxlen,
+                                glui32 initlen)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_request_line_event (win, buf, maxlen, initlen);
+  ifp_glk_profile_stop (PROFILE_GLK_REQUEST_LINE_EVENT, &start, 0);
+}
+
+static void
+profile_glk_request_char_event (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_request_char_event (win);
+  ifp_glk_profile_stop (PROFILE_GLK_REQUEST_CHAR_EVENT, &start, 0);
+}
+
+static void
+profile_glk_request_mouse_event (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_request_mouse_event (win);
+  ifp_glk_profile_stop (PROFILE_GLK_REQUEST_MOUSE_EVENT, &start, 0);
+}
+
+static void
+profile_glk_cancel_line_event (winid_t win, event_t *event)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_cancel_line_event (win, event);
+  ifp_glk_profile_stop (PROFILE_GLK_CANCEL_LINE_EVENT, &start, 0);
+}
+
+static void
+profile_glk_cancel_char_event (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_cancel_char_event (win);
+  ifp_glk_profile_stop (PROFILE_GLK_CANCEL_CHAR_EVENT, &start, 0);
+}
+
+static void
+profile_glk_cancel_mouse_event (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_cancel_mouse_event (win);
+  ifp_glk_profile_stop (PROFILE_GLK_CANCEL_MOUSE_EVENT, &start, 0);
+}
+
+static glui32
+profile_glk_buffer_to_lower_case_uni (glui32 *buf, glui32 len, glui32 numchars)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_buffer_to_lower_case_uni (buf, len,
+                                                            numchars);
+  ifp_glk_profile_stop (PROFILE_GLK_BUFFER_TO_LOWER_CASE_UNI, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_buffer_to_upper_case_uni (glui32 *buf, glui32 len, glui32 numchars)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_buffer_to_upper_case_uni (buf, len,
+                                                            numchars);
+  ifp_glk_profile_stop (PROFILE_GLK_BUFFER_TO_UPPER_CASE_UNI, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_buffer_to_title_case_uni (glui32 *buf, glui32 len, glui32 numchars,
+                                      glui32 lowerrest)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_buffer_to_title_case_uni (buf, len, numchars,
+                                                            lowerrest);
+  ifp_glk_profile_stop (PROFILE_GLK_BUFFER_TO_TITLE_CASE_UNI, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_put_char_uni (glui32 ch)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_char_uni (ch);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_CHAR_UNI, &start, sizeof (glui32));
+}
+
+static void
+profile_glk_put_string_uni (glui32 *s)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_string_uni (s);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_STRING_UNI, &start,
+                        ifp_glk_profile_strlen_uni (s) * sizeof (glui32));
+}
+
+static void
+profile_glk_put_buffer_uni (glui32 *buf, glui32 len)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_buffer_uni (buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_BUFFER_UNI, &start,
+                        len * sizeof (glui32));
+}
+
+static void
+profile_glk_put_char_stream_uni (strid_t str, glui32 ch)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_char_stream_uni (str, ch);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_CHAR_STREAM_UNI, &start,
+                        sizeof (glui32));
+}
+
+static void
+profile_glk_put_string_stream_uni (strid_t str, glui32 *s)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_string_stream_uni (str, s);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_STRING_STREAM_UNI, &start,
+                        ifp_glk_profile_strlen_uni (s) * sizeof (glui32));
+}
+
+static void
+profile_glk_put_buffer_stream_uni (strid_t str, glui32 *buf, glui32 len)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_put_buffer_stream_uni (str, buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_PUT_BUFFER_STREAM_UNI, &start,
+                        len * sizeof (glui32));
+}
+
+static glsi32
+profile_glk_get_char_stream_uni (strid_t str)
+{
+  struct timespec start;
+  glsi32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_get_char_stream_uni (str);
+  ifp_glk_profile_stop (PROFILE_GLK_GET_CHAR_STREAM_UNI, &start,
+                        value != -1 ? sizeof (glui32) : 0);
+  return value;
+}
+
+static glui32
+profile_glk_get_buffer_stream_uni (strid_t str, glui32 *buf, glui32 len)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_get_buffer_stream_uni (str, buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_GET_BUFFER_STREAM_UNI, &start,
+                        value * sizeof (glui32));
+  return value;
+}
+
+static glui32
+profile_glk_get_line_stream_uni (strid_t str, glui32 *buf, glui32 len)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_get_line_stream_uni (str, buf, len);
+  ifp_glk_profile_stop (PROFILE_GLK_GET_LINE_STREAM_UNI, &start,
+                        value * sizeof (glui32));
+  return value;
+}
+
+static strid_t
+profile_glk_stream_open_file_uni (frefid_t fileref, glui32 fmode, glui32 rock)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_open_file_uni (fileref, fmode, rock);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_OPEN_FILE_UNI, &start, 0);
+  return value;
+}
+
+static strid_t
+profile_glk_stream_open_memory_uni (glui32 *buf, glui32 buflen, glui32 fmode,
+                                    glui32 rock)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_stream_open_memory_uni (buf, buflen, fmode,
+                                                          rock);
+  ifp_glk_profile_stop (PROFILE_GLK_STREAM_OPEN_MEMORY_UNI, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_request_char_event_uni (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_request_char_event_uni (win);
+  ifp_glk_profile_stop (PROFILE_GLK_REQUEST_CHAR_EVENT_UNI, &start, 0);
+}
+
+static void
+profile_glk_request_line_event_uni (winid_t win, glui32 *buf, glui32 maxlen,
+                                    glui32 initlen)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_request_line_event_uni (win, buf, maxlen, initlen);
+  ifp_glk_profile_stop (PROFILE_GLK_REQUEST_LINE_EVENT_UNI, &start, 0);
+}
+
+static glui32
+profile_glk_image_draw (winid_t win, glui32 image, glsi32 val1, glsi32 val2)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_image_draw (win, image, val1, val2);
+  ifp_glk_profile_stop (PROFILE_GLK_IMAGE_DRAW, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_image_draw_scaled (winid_t win, glui32 image, glsi32 val1,
+                               glsi32 val2, glui32 width, glui32 height)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_image_draw_scaled (win, image, val1, val2,
+                                                     width, height);
+  ifp_glk_profile_stop (PROFILE_GLK_IMAGE_DRAW_SCALED, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_image_get_info (glui32 image, glui32 *width, glui32 *height)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_image_get_info (image, width, height);
+  ifp_glk_profile_stop (PROFILE_GLK_IMAGE_GET_INFO, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_window_flow_break (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_flow_break (win);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_FLOW_BREAK, &start, 0);
+}
+
+static void
+profile_glk_window_erase_rect (winid_t win, glsi32 left, glsi32 top,
+                               glui32 width, glui32 height)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_erase_rect (win, left, top, width, height);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_ERASE_RECT, &start, 0);
+}
+
+static void
+profile_glk_window_fill_rect (winid_t win, glui32 color, glsi32 left,
+                              glsi32 top, glui32 width, glui32 height)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_fill_rect (win, color, left, top, width,
+                                            height);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_FILL_RECT, &start, 0);
+}
+
+static void
+profile_glk_window_set_background_color (winid_t win, glui32 color)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_window_set_background_color (win, color);
+  ifp_glk_profile_stop (PROFILE_GLK_WINDOW_SET_BACKGROUND_COLOR, &start, 0);
+}
+
+static schanid_t
+profile_glk_schannel_create (glui32 rock)
+{
+  struct timespec start;
+  schanid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_schannel_create (rock);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_CREATE, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_schannel_destroy (schanid_t chan)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_schannel_destroy (chan);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_DESTROY, &start, 0);
+}
+
+static schanid_t
+profile_glk_schannel_iterate (schanid_t chan, glui32 *rockptr)
+{
+  struct timespec start;
+  schanid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_schannel_iterate (chan, rockptr);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_ITERATE, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_schannel_get_rock (schanid_t chan)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_schannel_get_rock (chan);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_GET_ROCK, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_schannel_play (schanid_t chan, glui32 snd)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_schannel_play (chan, snd);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_PLAY, &start, 0);
+  return value;
+}
+
+static glui32
+profile_glk_schannel_play_ext (schanid_t chan, glui32 snd, glui32 repeats,
+                               glui32 notify)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glk_schannel_play_ext (chan, snd, repeats,
+                                                     notify);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_PLAY_EXT, &start, 0);
+  return value;
+}
+
+static void
+profile_glk_schannel_stop (schanid_t chan)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_schannel_stop (chan);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_STOP, &start, 0);
+}
+
+static void
+profile_glk_schannel_set_volume (schanid_t chan, glui32 vol)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_schannel_set_volume (chan, vol);
+  ifp_glk_profile_stop (PROFILE_GLK_SCHANNEL_SET_VOLUME, &start, 0);
+}
+
+static void
+profile_glk_sound_load_hint (glui32 snd, glui32 flag)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_sound_load_hint (snd, flag);
+  ifp_glk_profile_stop (PROFILE_GLK_SOUND_LOAD_HINT, &start, 0);
+}
+
+static void
+profile_glk_set_hyperlink (glui32 linkval)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_set_hyperlink (linkval);
+  ifp_glk_profile_stop (PROFILE_GLK_SET_HYPERLINK, &start, 0);
+}
+
+static void
+profile_glk_set_hyperlink_stream (strid_t str, glui32 linkval)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_set_hyperlink_stream (str, linkval);
+  ifp_glk_profile_stop (PROFILE_GLK_SET_HYPERLINK_STREAM, &start, 0);
+}
+
+static void
+profile_glk_request_hyperlink_event (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_request_hyperlink_event (win);
+  ifp_glk_profile_stop (PROFILE_GLK_REQUEST_HYPERLINK_EVENT, &start, 0);
+}
+
+static void
+profile_glk_cancel_hyperlink_event (winid_t win)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glk_cancel_hyperlink_event (win);
+  ifp_glk_profile_stop (PROFILE_GLK_CANCEL_HYPERLINK_EVENT, &start, 0);
+}
+
+static void
+profile_glkunix_set_base_file (char *filename)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->glkunix_set_base_file (filename);
+  ifp_glk_profile_stop (PROFILE_GLKUNIX_SET_BASE_FILE, &start, 0);
+}
+
+static strid_t
+profile_glkunix_stream_open_pathname (char *pathname, glui32 textmode,
+                                      glui32 rock)
+{
+  struct timespec start;
+  strid_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->glkunix_stream_open_pathname (pathname, textmode,
+                                                            rock);
+  ifp_glk_profile_stop (PROFILE_GLKUNIX_STREAM_OPEN_PATHNAME, &start, 0);
+  return value;
+}
+
+static gidispatch_rock_t
+profile_gidispatch_get_objrock (void *obj, glui32 objclass)
+{
+  struct timespec start;
+  gidispatch_rock_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_get_objrock (obj, objclass);
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_GET_OBJROCK, &start, 0);
+  return value;
+}
+
+static void
+profile_gidispatch_call (glui32 funcnum, glui32 numargs,
+                         gluniversal_t *arglist)
+{
+  struct timespec start;
+
+  ifp_glk_profile_start (&start);
+  next_glk_interface->gidispatch_call (funcnum, numargs, arglist);
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_CALL, &start, 0);
+}
+
+static char *
+profile_gidispatch_prototype (glui32 funcnum)
+{
+  struct timespec start;
+  char *value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_prototype (funcnum);
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_PROTOTYPE, &start, 0);
+  return value;
+}
+
+static glui32
+profile_gidispatch_count_classes (void)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_count_classes ();
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_COUNT_CLASSES, &start, 0);
+  return value;
+}
+
+static glui32
+profile_gidispatch_count_intconst (void)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_count_intconst ();
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_COUNT_INTCONST, &start, 0);
+  return value;
+}
+
+static gidispatch_intconst_t *
+profile_gidispatch_get_intconst (glui32 index_)
+{
+  struct timespec start;
+  gidispatch_intconst_t *value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_get_intconst (index_);
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_GET_INTCONST, &start, 0);
+  return value;
+}
+
+static glui32
+profile_gidispatch_count_functions (void)
+{
+  struct timespec start;
+  glui32 value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_count_functions ();
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_COUNT_FUNCTIONS, &start, 0);
+  return value;
+}
+
+static gidispatch_function_t *
+profile_gidispatch_get_function (glui32 index_)
+{
+  struct timespec start;
+  gidispatch_function_t *value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_get_function (index_);
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_GET_FUNCTION, &start, 0);
+  return value;
+}
+
+static gidispatch_function_t *
+profile_gidispatch_get_function_by_id (glui32 id)
+{
+  struct timespec start;
+  gidispatch_function_t *value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->gidispatch_get_function_by_id (id);
+  ifp_glk_profile_stop (PROFILE_GIDISPATCH_GET_FUNCTION_BY_ID, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_create_map (strid_t file, giblorb_map_t **newmap)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_create_map (file, newmap);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_CREATE_MAP, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_destroy_map (giblorb_map_t *map)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_destroy_map (map);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_DESTROY_MAP, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_load_chunk_by_type (giblorb_map_t *map, glui32 method,
+                                    giblorb_result_t *res, glui32 chunktype,
+                                    glui32 count)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_load_chunk_by_type (map, method, res,
+                                                          chunktype, count);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_LOAD_CHUNK_BY_TYPE, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_load_chunk_by_number (giblorb_map_t *map, glui32 method,
+                                      giblorb_result_t *res, glui32 chunknum)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_load_chunk_by_number (map, method, res,
+                                                            chunknum);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_LOAD_CHUNK_BY_NUMBER, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_unload_chunk (giblorb_map_t *map, glui32 chunknum)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_unload_chunk (map, chunknum);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_UNLOAD_CHUNK, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_load_resource (giblorb_map_t *map, glui32 method,
+                               giblorb_result_t *res, glui32 usage,
+                               glui32 resnum)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_load_resource (map, method, res, usage,
+                                                     resnum);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_LOAD_RESOURCE, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_count_resources (giblorb_map_t *map, glui32 usage, glui32 *num,
+                                 glui32 *min, glui32 *max)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_count_resources (map, usage, num, min,
+                                                       max);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_COUNT_RESOURCES, &start, 0);
+  return value;
+}
+
+static giblorb_err_t
+profile_giblorb_set_resource_map (strid_t file)
+{
+  struct timespec start;
+  giblorb_err_t value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_set_resource_map (file);
+  ifp_glk_profile_stop (PROFILE_GIBLORB_SET_RESOURCE_MAP, &start, 0);
+  return value;
+}
+
+static giblorb_map_t *
+profile_giblorb_get_resource_map (void)
+{
+  struct timespec start;
+  giblorb_map_t *value;
+
+  ifp_glk_profile_start (&start);
+  value = next_glk_interface->giblorb_get_resource_map ();
+  ifp_glk_profile_stop (PROFILE_GIBLORB_GET_RESOURCE_MAP, &start, 0);
+  return value;
+}
+
+
+/*
+ * ifp_glk_profile_get_interface()
+ *
+ * Initialize the profiling Glk interface to wrap the given one, and return
+ * it.  Entries that are not profiled are copied from the given interface,
+ * as is the interface version.  The interface is built only once for a
+ * given wrapped interface, and is afterwards only refreshed, so that
+ * entries a caller sets on the returned interface are kept.
+ */
+ifp_glk_interfaceref_t
+ifp_glk_profile_get_interface (ifp_glk_interfaceref_t glk_interface)
+{
+  assert (glk_interface);
+
+  ifp_trace ("glkprofile: ifp_glk_profile_get_interface <- %p",
+             ifp_trace_pointer (glk_interface));
+
+  if (next_glk_interface == glk_interface)
+    {
+      ifp_glk_refresh_interface (&profile_glk_interface,
+                                 &profile_glk_snapshot, glk_interface);
+      return &profile_glk_interface;
+    }
+
+  next_glk_interface = glk_interface;
+  memcpy (&profile_glk_interface, glk_interface, sizeof (*glk_interface));
+  memcpy (&profile_glk_snapshot, glk_interface, sizeof (*glk_interface));
+
+  profile_glk_interface.glk_set_interrupt_handler
+    = profile_glk_set_interrupt_handler;
+  profile_glk_interface.glk_tick = profile_glk_tick;
+  profile_glk_interface.glk_gestalt = profile_glk_gestalt;
+  profile_glk_interface.glk_gestalt_ext = profile_glk_gestalt_ext;
+  profile_glk_interface.glk_char_to_lower = profile_glk_char_to_lower;
+  profile_glk_interface.glk_char_to_upper = profile_glk_char_to_upper;
+  profile_glk_interface.glk_window_get_root = profile_glk_window_get_root;
+  profile_glk_interface.glk_window_open = profile_glk_window_open;
+  profile_glk_interface.glk_window_close = profile_glk_window_close;
+  profile_glk_interface.glk_window_get_size = profile_glk_window_get_size;
+  profile_glk_interface.glk_window_set_arrangement
+    = profile_glk_window_set_arrangement;
+  profile_glk_interface.glk_window_get_arrangement
+    = profile_glk_window_get_arrangement;
+  profile_glk_interface.glk_window_iterate = profile_glk_window_iterate;
+  profile_glk_interface.glk_window_get_rock = profile_glk_window_get_rock;
+  profile_glk_interface.glk_window_get_type = profile_glk_window_get_type;
+  profile_glk_interface.glk_window_get_parent = profile_glk_window_get_parent;
+  profile_glk_interface.glk_window_get_sibling
+    = profile_glk_window_get_sibling;
+  profile_glk_interface.glk_window_clear = profile_glk_window_clear;
+  profile_glk_interface.glk_window_move_cursor
+    = profile_glk_window_move_cursor;
+  profile_glk_interface.glk_window_get_stream = profile_glk_window_get_stream;
+  profile_glk_interface.glk_window_set_echo_stream
+    = profile_glk_window_set_echo_stream;
+  profile_glk_interface.glk_window_get_echo_stream
+    = profile_glk_window_get_echo_stream;
+  profile_glk_interface.glk_set_window = profile_glk_set_window;
+  profile_glk_interface.glk_stream_open_file = profile_glk_stream_open_file;
+  profile_glk_interface.glk_stream_open_memory
+    = profile_glk_stream_open_memory;
+  profile_glk_interface.glk_stream_close = profile_glk_stream_close;
+  profile_glk_interface.glk_stream_iterate = profile_glk_stream_iterate;
+  profile_glk_interface.glk_stream_get_rock = profile_glk_stream_get_rock;
+  profile_glk_interface.glk_stream_set_position
+    = profile_glk_stream_set_position;
+  profile_glk_interface.glk_stream_get_position
+    = profile_glk_stream_get_position;
+  profile_glk_interface.glk_stream_set_current
+    = profile_glk_stream_set_current;
+  profile_glk_interface.glk_stream_get_current
+    = profile_glk_stream_get_current;
+  profile_glk_interface.glk_put_char = profile_glk_put_char;
+  profile_glk_interface.glk_put_char_stream = profile_glk_put_char_stream;
+  profile_glk_interface.glk_put_string = profile_glk_put_string;
+  profile_glk_interface.glk_put_string_stream = profile_glk_put_string_stream;
+  profile_glk_interface.glk_put_buffer = profile_glk_put_buffer;
+  profile_glk_interface.glk_put_buffer_stream = profile_glk_put_buffer_stream;
+  profile_glk_interface.glk_set_style = profile_glk_set_style;
+  profile_glk_interface.glk_set_style_stream = profile_glk_set_style_stream;
+  profile_glk_interface.glk_get_char_stream = profile_glk_get_char_stream;
+  profile_glk_interface.glk_get_line_stream = profile_glk_get_line_stream;
+  profile_glk_interface.glk_get_buffer_stream = profile_glk_get_buffer_stream;
+  profile_glk_interface.glk_stylehint_set = profile_glk_stylehint_set;
+  profile_glk_interface.glk_stylehint_clear = profile_glk_stylehint_clear;
+  profile_glk_interface.glk_style_distinguish = profile_glk_style_distinguish;
+  profile_glk_interface.glk_style_measure = profile_glk_style_measure;
+  profile_glk_interface.glk_fileref_create_temp
+    = profile_glk_fileref_create_temp;
+  profile_glk_interface.glk_fileref_create_by_name
+    = profile_glk_fileref_create_by_name;
+  profile_glk_interface.glk_fileref_create_by_prompt
+    = profile_glk_fileref_create_by_prompt;
+  profile_glk_interface.glk_fileref_create_from_fileref
+    = profile_glk_fileref_create_from_fileref;
+  profile_glk_interface.glk_fileref_destroy = profile_glk_fileref_destroy;
+  profile_glk_interface.glk_fileref_iterate = profile_glk_fileref_iterate;
+  profile_glk_interface.glk_fileref_get_rock = profile_glk_fileref_get_rock;
+  profile_glk_interface.glk_fileref_delete_file
+    = profile_glk_fileref_delete_file;
+  profile_glk_interface.glk_fileref_does_file_exist
+    = profile_glk_fileref_does_file_exist;
+  profile_glk_interface.glk_select = profile_glk_select;
+  profile_glk_interface.glk_select_poll = profile_glk_select_poll;
+  profile_glk_interface.glk_request_timer_events
+    = profile_glk_request_timer_events;
+  profile_glk_interface.glk_request_line_event
+    = profile_glk_request_line_event;
+  profile_glk_interface.glk_request_char_event
+    = profile_glk_request_char_event;
+  profile_glk_interface.glk_request_mouse_event
+    = profile_glk_request_mouse_event;
+  profile_glk_interface.glk_cancel_line_event = profile_glk_cancel_line_event;
+  profile_glk_interface.glk_cancel_char_event = profile_glk_cancel_char_event;
+  profile_glk_interface.glk_cancel_mouse_event
+    = profile_glk_cancel_mouse_event;
+  profile_glk_interface.glk_buffer_to_lower_case_uni
+    = profile_glk_buffer_to_lower_case_uni;
+  profile_glk_interface.glk_buffer_to_upper_case_uni
+    = profile_glk_buffer_to_upper_case_uni;
+  profile_glk_interface.glk_buffer_to_title_case_uni
+    = profile_glk_buffer_to_title_case_uni;
+  profile_glk_interface.glk_put_char_uni = profile_glk_put_char_uni;
+  profile_glk_interface.glk_put_string_uni = profile_glk_put_string_uni;
+  profile_glk_interface.glk_put_buffer_uni = profile_glk_put_buffer_uni;
+  profile_glk_interface.glk_put_char_stream_uni
+    = profile_glk_put_char_stream_uni;
+  profile_glk_interface.glk_put_string_stream_uni
+    = profile_glk_put_string_stream_uni;
+  profile_glk_interface.glk_put_buffer_stream_uni
+    = profile_glk_put_buffer_stream_uni;
+  profile_glk_interface.glk_get_char_stream_uni
+    = profile_glk_get_char_stream_uni;
+  profile_glk_interface.glk_get_buffer_stream_uni
+    = profile_glk_get_buffer_stream_uni;
+  profile_glk_interface.glk_get_line_stream_uni
+    = profile_glk_get_line_stream_uni;
+  profile_glk_interface.glk_stream_open_file_uni
+    = profile_glk_stream_open_file_uni;
+  profile_glk_interface.glk_stream_open_memory_uni
+    = profile_glk_stream_open_memory_uni;
+  profile_glk_interface.glk_request_char_event_uni
+    = profile_glk_request_char_event_uni;
+  profile_glk_interface.glk_request_line_event_uni
+    = profile_glk_request_line_event_uni;
+  profile_glk_interface.glk_image_draw = profile_glk_image_draw;
+  profile_glk_interface.glk_image_draw_scaled = profile_glk_image_draw_scaled;
+  profile_glk_interface.glk_image_get_info = profile_glk_image_get_info;
+  profile_glk_interface.glk_window_flow_break = profile_glk_window_flow_break;
+  profile_glk_interface.glk_window_erase_rect = profile_glk_window_erase_rect;
+  profile_glk_interface.glk_window_fill_rect = profile_glk_window_fill_rect;
+  profile_glk_interface.glk_window_set_background_color
+    = profile_glk_window_set_background_color;
+  profile_glk_interface.glk_schannel_create = profile_glk_schannel_create;
+  profile_glk_interface.glk_schannel_destroy = profile_glk_schannel_destroy;
+  profile_glk_interface.glk_schannel_iterate = profile_glk_schannel_iterate;
+  profile_glk_interface.glk_schannel_get_rock = profile_glk_schannel_get_rock;
+  profile_glk_interface.glk_schannel_play = profile_glk_schannel_play;
+  profile_glk_interface.glk_schannel_play_ext = profile_glk_schannel_play_ext;
+  profile_glk_interface.glk_schannel_stop = profile_glk_schannel_stop;
+  profile_glk_interface.glk_schannel_set_volume
+    = profile_glk_schannel_set_volume;
+  profile_glk_interface.glk_sound_load_hint = profile_glk_sound_load_hint;
+  profile_glk_interface.glk_set_hyperlink = profile_glk_set_hyperlink;
+  profile_glk_interface.glk_set_hyperlink_stream
+    = profile_glk_set_hyperlink_stream;
+  profile_glk_interface.glk_request_hyperlink_event
+    = profile_glk_request_hyperlink_event;
+  profile_glk_interface.glk_cancel_hyperlink_event
+    = profile_glk_cancel_hyperlink_event;
+  profile_glk_interface.glkunix_set_base_file = profile_glkunix_set_base_file;
+  profile_glk_interface.glkunix_stream_open_pathname
+    = profile_glkunix_stream_open_pathname;
+  profile_glk_interface.gidispatch_get_objrock
+    = profile_gidispatch_get_objrock;
+  profile_glk_interface.gidispatch_call = profile_gidispatch_call;
+  profile_glk_interface.gidispatch_prototype = profile_gidispatch_prototype;
+  profile_glk_interface.gidispatch_count_classes
+    = profile_gidispatch_count_classes;
+  profile_glk_interface.gidispatch_count_intconst
+    = profile_gidispatch_count_intconst;
+  profile_glk_interface.gidispatch_get_intconst
+    = profile_gidispatch_get_intconst;
+  profile_glk_interface.gidispatch_count_functions
+    = profile_gidispatch_count_functions;
+  profile_glk_interface.gidispatch_get_function
+    = profile_gidispatch_get_function;
+  profile_glk_interface.gidispatch_get_function_by_id
+    = profile_gidispatch_get_function_by_id;
+  profile_glk_interface.giblorb_create_map = profile_giblorb_create_map;
+  profile_glk_interface.giblorb_destroy_map = profile_giblorb_destroy_map;
+  profile_glk_interface.giblorb_load_chunk_by_type
+    = profile_giblorb_load_chunk_by_type;
+  profile_glk_interface.giblorb_load_chunk_by_number
+    = profile_giblorb_load_chunk_by_number;
+  profile_glk_interface.giblorb_unload_chunk = profile_giblorb_unload_chunk;
+  profile_glk_interface.giblorb_load_resource = profile_giblorb_load_resource;
+  profile_glk_interface.giblorb_count_resources
+    = profile_giblorb_count_resources;
+  profile_glk_interface.giblorb_set_resource_map
+    = profile_giblorb_set_resource_map;
+  profile_glk_interface.giblorb_get_resource_map
+    = profile_giblorb_get_resource_map;
+  return &profile_glk_interface;
+}
+
+
+/*
+ * ifp_glk_profile_set_observer()
+ *
+ * Set a function to be called with the function index and byte count of
+ * each profiled call, or NULL to clear any observer.
+ */
+void
+ifp_glk_profile_set_observer (void (*observer) (int, unsigned long long))
+{
+  ifp_trace ("glkprofile: observer set to %p",
+             ifp_trace_pointer ((void *) observer));
+
+  ifp_glk_profile_observer = observer;
+}
+
+
+/*
+ * ifp_glk_profile_find_function()
+ *
+ * Return the index of the named Glk function, or -1 if not profiled.
+ */
+int
+ifp_glk_profile_find_function (const char *name)
+{
+  int index_;
+
+  for (index_ = 0; index_ < PROFILE_FUNCTION_COUNT; index_++)
+    {
+      if (strcmp (PROFILE_FUNCTION_NAMES[index_], name) == 0)
+        return index_;
+    }
+
+  return -1;
+}
+
+
+/**
+ * ifp_glk_profile_reset()
+ *
+ * Clear all accumulated Glk call profile data.
+ */
+void
+ifp_glk_profile_reset (void)
+{
+  ifp_trace ("glkprofile: ifp_glk_profile_reset <- void");
+
+  memset (ifp_glk_profile_records, 0, sizeof (ifp_glk_profile_records));
+}
+
+
+/**
+ * ifp_glk_profile_get_count()
+ *
+ * Return the number of Glk functions profiled.  Valid function indexes for
+ * ifp_glk_profile_get_entry() and ifp_glk_profile_get_histogram() run from
+ * zero to one less than this count.
+ */
+int
+ifp_glk_profile_get_count (void)
+{
+  return PROFILE_FUNCTION_COUNT;
+}
+
+
+/**
+ * ifp_glk_profile_get_entry()
+ *
+ * Return the name of the Glk function at the given index, the number of
+ * calls made to it, their cumulative time in nanoseconds, and the count of
+ * bytes written or read by them.  Any of the return pointers may be NULL.
+ * Returns FALSE if the index is out of range.
+ */
+int
+ifp_glk_profile_get_entry (int index_, const char **name,
+                           unsigned long *calls,
+                           unsigned long long *nanoseconds,
+                           unsigned long long *bytes)
+{
+  const ifp_glk_profile_record_t *record;
+
+  if (index_ < 0 || index_ >= PROFILE_FUNCTION_COUNT)
+    {
+      ifp_error ("glkprofile: function index %d is out of range", index_);
+      return FALSE;
+    }
+
+  record = ifp_glk_profile_records + index_;
+  if (name)
+    *name = PROFILE_FUNCTION_NAMES[index_];
+  if (calls)
+    *calls = record->calls;
+  if (nanoseconds)
+    *nanoseconds = record->nanoseconds;
+  if (bytes)
+    *bytes = record->bytes;
+
+  return TRUE;
+}
+
+
+/**
+ * ifp_glk_profile_get_histogram()
+ *
+ * Copy up to length latency histogram buckets for the Glk function at the
+ * given index into histogram.  Bucket n counts calls that took between 2^n
+ * and 2^(n+1) nanoseconds, except for the last bucket, which counts all
+ * longer calls.  Returns the number of buckets copied, or zero if the index
+ * is out of range.  Call with a NULL histogram to find the bucket count.
+ */
+int
+ifp_glk_profile_get_histogram (int index_, unsigned long *histogram,
+                               int length)
+{
+  if (index_ < 0 || index_ >= PROFILE_FUNCTION_COUNT)
+    {
+      ifp_error ("glkprofile: function index %d is out of range", index_);
+      return 0;
+    }
+
+  if (!histogram)
+    return PROFILE_HISTOGRAM_BUCKETS;
+
+  if (length > PROFILE_HISTOGRAM_BUCKETS)
+    length = PROFILE_HISTOGRAM_BUCKETS;
+  if (length > 0)
+    memcpy (histogram, ifp_glk_profile_records[index_].histogram,
+            length * sizeof (*histogram));
+
+  return length > 0 ? length : 0;
+}
+
+
+/*
+ * ifp_glk_profile_compare()
+ *
+ * Sort comparison function, orders record indexes by descending cumulative
+ * time.
+ */
+static int
+ifp_glk_profile_compare (const void *first, const void *second)
+{
+  const ifp_glk_profile_record_t *record1, *record2;
+
+  record1 = ifp_glk_profile_records + *(const int *) first;
+  record2 = ifp_glk_profile_records + *(const int *) second;
+
+  if (record1->nanoseconds != record2->nanoseconds)
+    return record1->nanoseconds < record2->nanoseconds ? 1 : -1;
+  else
+    return *(const int *) first - *(const int *) second;
+}
+
+
+/*
+ * ifp_glk_profile_percentile()
+ *
+ * Return an upper bound in nanoseconds on the given percentile of call
+ * latencies, taken from the histogram buckets of a record.
+ */
+static unsigned long long
+ifp_glk_profile_percentile (const ifp_glk_profile_record_t *record,
+                            int percentile)
+{
+  unsigned long threshold, total;
+  int bucket;
+
+  threshold = (record->calls * percentile + 99) / 100;
+  total = 0;
+  for (bucket = 0; bucket < PROFILE_HISTOGRAM_BUCKETS - 1; bucket++)
+    {
+      total += record->histogram[bucket];
+      if (total >= threshold)
+        break;
+    }
+
+  return 2ULL << bucket;
+}
+
+
+/**
+ * ifp_glk_profile_report()
+ *
+ * Print a summary of accumulated Glk call profile data on stderr, listing
+ * each Glk function called, most expensive first.  Note that times for
+ * glk_select() include any time spent waiting for user input.
+ */
+void
+ifp_glk_profile_report (void)
+{
+  int indexes[PROFILE_FUNCTION_COUNT], count, index_;
+  unsigned long long total;
+
+  ifp_trace ("glkprofile: ifp_glk_profile_report <- void");
+
+  count = 0;
+  total = 0;
+  for (index_ = 0; index_ < PROFILE_FUNCTION_COUNT; index_++)
+    {
+      if (ifp_glk_profile_records[index_].calls > 0)
+        {
+          indexes[count++] = index_;
+          total += ifp_glk_profile_records[index_].nanoseconds;
+        }
+    }
+  qsort (indexes, count, sizeof (*indexes), ifp_glk_profile_compare);
+
+  fprintf (stderr, "%-32s %10s %12s %6s %10s %10s %10s %12s\n",
+           "glk function", "calls", "total ms", "%", "mean ns",
+           "p50 ns", "p99 ns", "bytes");
+
+  for (index_ = 0; index_ < count; index_++)
+    {
+      const ifp_glk_profile_record_t *record;
+
+      record = ifp_glk_profile_records + indexes[index_];
+      fprintf (stderr,
+               "%-32s %10lu %12.3f %6.2f %10llu %10llu %10llu %12llu\n",
+               PROFILE_FUNCTION_NAMES[indexes[index_]], record->calls,
+               record->nanoseconds / 1000000.0,
+               total > 0 ? record->nanoseconds * 100.0 / total : 0.0,
+               record->nanoseconds / record->calls,
+               ifp_glk_profile_percentile (record, 50),
+               ifp_glk_profile_percentile (record, 99), record->bytes);
+    }
+}
@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <signal.h>
 
 #include "ifp.h"
@@ -33,6 +34,18 @@ strid_t gli_stream_open_pathname (char *pathname, int textmode, glui32 rock);
 /* Pointer to our interface table. */
 static ifp_glk_interfaceref_t glk_interface = NULL;
 
+/*
+ * Coalescing buffer for output to the current stream.  Consecutive calls
+ * to glk_put_char(), glk_put_string(), and glk_put_buffer() accumulate here,
+ * and go out as a single glk_put_buffer() on the next call of any other Glk
+ * function.  Since any call that could change the current stream or its
+ * style flushes the buffer first, everything in it is for the same stream
+ * and style.
+ */
+enum { OUTPUT_BUFFER_SIZE = 4096 };
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static glui32 output_length = 0;
+
 
 /*
  * ifpi_attach_glk_interface()
@@ -54,6 +67,9 @@ ifpi_attach_glk_interface (ifp_glk_interfaceref_t interface)
   if (interface && interface->version != IFP_GLK_VERSION)
     return FALSE;
 
+  /* Send any output buffered for the old interface on its way. */
+  ifpi_glk_flush_output ();
+
   glk_interface = interface;
   return TRUE;
 }
@@ -73,6 +89,27 @@ ifpi_retrieve_glk_interface (void)
 
 
 /*
+ * ifpi_glk_flush_output()
+ *
+ * Write out anything held in the output coalescing buffer.  The proxy
+ * functions flush automatically as needed; this function lets the plugin
+ * handler flush on return from plugin code.
+ */
+void
+ifpi_glk_flush_output (void)
+{
+  if (output_length > 0 && glk_interface)
+    {
+      glui32 length = output_length;
+
+      output_length = 0;
+      glk_interface->glk_put_buffer (output_buffer, length);
+    }
+}
+
+
+/*
+ * ifp_check_interface_unflushed()
  * ifp_check_interface()
  *
  * Ensure there is a Glk interface to work with.  If we somehow try to make
@@ -85,7 +122,7 @@ ifpi_retrieve_glk_interface (void)
  * back to the main program.
  */
 static void
-ifp_check_interface (void)
+ifp_check_interface_unflushed (void)
 {
   if (!glk_interface)
     {
@@ -97,6 +134,44 @@ ifp_check_interface (void)
     }
 }
 
+/*
+ * All proxies other than the buffered output ones use this version, which
+ * also flushes buffered output, so it reaches Glk ahead of the call.
+ */
+static void
+ifp_check_interface (void)
+{
+  ifp_check_interface_unflushed ();
+
+  if (output_length > 0)
+    ifpi_glk_flush_output ();
+}
+
+
+/*
+ * ifp_buffer_output()
+ *
+ * Add data to the output coalescing buffer, flushing if it won't fit.  Data
+ * too large for the buffer goes straight to Glk.
+ */
+static void
+ifp_buffer_output (const char *data, glui32 length)
+{
+  if (output_length + length > OUTPUT_BUFFER_SIZE)
+    {
+      ifpi_glk_flush_output ();
+
+      if (length > OUTPUT_BUFFER_SIZE)
+        {
+          glk_interface->glk_put_buffer ((char *) data, length);
+          return;
+        }
+    }
+
+  memcpy (output_buffer + output_length, data, length);
+  output_length += length;
+}
+
 
 /**
  * glk_*()
@@ -346,8 +421,11 @@ glk_stream_get_current (void)
 void
 glk_put_char (unsigned char ch)
 {
-  ifp_check_interface ();
-  glk_interface->glk_put_char (ch);
+  ifp_check_interface_unflushed ();
+
+  if (output_length == OUTPUT_BUFFER_SIZE)
+    ifpi_glk_flush_output ();
+  output_buffer[output_length++] = ch;
 }
 
 void
@@ -360,8 +438,8 @@ glk_put_char_stream (strid_t str, unsigned char ch)
 void
 glk_put_string (char *s)
 {
-  ifp_check_interface ();
-  glk_interface->glk_put_string (s);
+  ifp_check_interface_unflushed ();
+  ifp_buffer_output (s, strlen (s));
 }
 
 void
@@ -374,8 +452,8 @@ glk_put_string_stream (strid_t str, char *s)
 void
 glk_put_buffer (char *buf, glui32 len)
 {
-  ifp_check_interface ();
-  glk_interface->glk_put_buffer (buf, len);
+  ifp_check_interface_unflushed ();
+  ifp_buffer_output (buf, len);
 }
 
 void
@@ -0,0 +1,1394 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2001-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ifp.h"
+#include "ifp_internal.h"
+
+#define IFP_TRACE_FACILITY IFP_TRACE_GLKRECORD
+
+/*
+ * Glk call recording and replay.  When either is selected, plugins are
+ * handed a recorder Glk interface, layered over the profiling interface,
+ * which is in turn layered over the main public one.  The profiling layer
+ * reports every call to us, and we log each as its function index and byte
+ * count.  Our own layer handles Glk input: each glk_select() or
+ * glk_select_poll() event is logged, along with any line input it returns.
+ * It also logs the results of calls that return data from the library to
+ * the game, following the call's record: return values and out-parameters,
+ * with data read from streams or converted in game buffers logged as its
+ * length and a hash.  Calls returning only Glk objects, pure character
+ * mappings, and output calls carry no such results, and neither does the
+ * array of glk_gestalt_ext(), which libraries fill only in part.
+ *
+ * On replay, glk_select() and glk_select_poll() do not reach the real Glk
+ * library.  Instead, they return the recorded events, cancelling the real
+ * pending input request on the event's window and filling line input
+ * buffers from the trace.  Calls and their results are checked against the
+ * trace as they occur, and the first divergence is reported; interpreters
+ * that seed random numbers from the clock may diverge harmlessly in their
+ * output.  When the trace runs out, or its next event does not fit the
+ * game's pending input requests, the replay prints a timing summary and
+ * ends the game through glk_exit().
+ *
+ * The trace is a binary file, a short header followed by records, each
+ * a tag byte and a set of unsigned numbers in LEB128 encoding.  Windows in
+ * events are identified by their creation order, which is stable across
+ * runs where object addresses are not.
+ */
+
+/* Trace file header, version, and record tags. */
+static const char RECORD_MAGIC[] = "IFPGLKTR";
+enum { RECORD_MAGIC_LENGTH = 8, RECORD_VERSION = 2 };
+enum { TAG_CALL = 1, TAG_EVENT = 2, TAG_POLL = 3, TAG_CANCEL = 4,
+       TAG_RESULT = 5 };
+
+/* Most values in a result record. */
+enum { RECORD_RESULT_VALUES = 4 };
+
+/* Trace file names for record and replay, set by the direct interface. */
+static const char *ifp_glk_record_filename = NULL,
+                  *ifp_glk_replay_filename = NULL;
+
+/*
+ * Recorder Glk interface handed to plugins, the profiling interface its
+ * entries call through to, and the base interface beneath that, used to
+ * cancel input requests without the call being logged.  A snapshot of the
+ * profiling interface as last copied from lets later requests refresh the
+ * recorder interface without losing entries callers have set on it.
+ */
+static struct ifp_glk_interface record_glk_interface,
+                                record_glk_snapshot;
+static ifp_glk_interfaceref_t next_glk_interface = NULL,
+                              base_glk_interface = NULL;
+
+/*
+ * Open trace stream, flags for replay mode and replay divergence, and flag
+ * set once the trace has been opened, or tried, for this run.
+ */
+static FILE *ifp_glk_record_stream = NULL;
+static int ifp_glk_record_is_replaying = FALSE,
+           ifp_glk_record_is_diverged = FALSE,
+           ifp_glk_record_is_opened = FALSE;
+
+/* Profiling indexes of glk_select() and glk_select_poll(). */
+static int ifp_glk_record_select_function = -1,
+           ifp_glk_record_select_poll_function = -1;
+
+/* Counts of calls and events, input turns, and trace start time. */
+static unsigned long ifp_glk_record_calls = 0,
+                     ifp_glk_record_events = 0,
+                     ifp_glk_record_turns = 0;
+static struct timespec ifp_glk_record_start_time;
+
+/*
+ * Windows opened by the plugin, in creation order, with details of any
+ * line or character input request pending on each.  Closed windows keep
+ * their entry, with a NULL window, so that creation order indexes remain
+ * stable.
+ */
+typedef struct {
+  winid_t window;
+  void *line_buffer;
+  glui32 line_length;
+  int is_unicode;
+  int is_char_requested;
+} ifp_glk_record_window_t;
+
+static ifp_glk_record_window_t *ifp_glk_record_windows = NULL;
+static int ifp_glk_record_windows_length = 0,
+           ifp_glk_record_windows_allocation = 0;
+
+
+/**
+ * ifp_glk_record_select()
+ * ifp_glk_record_get_selected()
+ * ifp_glk_replay_select()
+ * ifp_glk_replay_get_selected()
+ *
+ * Select a file to record a Glk call trace into, or to replay a trace from,
+ * or NULL to cancel, and return the current selections.  The IFP_GLK_RECORD
+ * and IFP_GLK_REPLAY environment variables override selections made by the
+ * direct interface.  The trace is opened when a plugin first requests a Glk
+ * interface, and covers the rest of the run, across every plugin loaded and
+ * chained to, so selection must be made before then.  If both are selected,
+ * replay takes precedence.
+ */
+void
+ifp_glk_record_select (const char *filename)
+{
+  ifp_trace ("glkrecord: record file set to %s",
+             filename ? filename : "(nil)");
+  ifp_glk_record_filename = filename;
+}
+
+const char *
+ifp_glk_record_get_selected (void)
+{
+  static int initialized = FALSE;
+  static const char *ifp_glk_record;
+
+  if (!initialized)
+    {
+      ifp_glk_record = getenv ("IFP_GLK_RECORD");
+      if (ifp_glk_record)
+        ifp_notice ("glkrecord: %s initialized Glk record file to %s",
+                    "IFP_GLK_RECORD", ifp_glk_record);
+      initialized = TRUE;
+    }
+
+  return ifp_glk_record ? ifp_glk_record : ifp_glk_record_filename;
+}
+
+void
+ifp_glk_replay_select (const char *filename)
+{
+  ifp_trace ("glkrecord: replay file set to %s",
+             filename ? filename : "(nil)");
+  ifp_glk_replay_filename = filename;
+}
+
+const char *
+ifp_glk_replay_get_selected (void)
+{
+  static int initialized = FALSE;
+  static const char *ifp_glk_replay;
+
+  if (!initialized)
+    {
+      ifp_glk_replay = getenv ("IFP_GLK_REPLAY");
+      if (ifp_glk_replay)
+        ifp_notice ("glkrecord: %s initialized Glk replay file to %s",
+                    "IFP_GLK_REPLAY", ifp_glk_replay);
+      initialized = TRUE;
+    }
+
+  return ifp_glk_replay ? ifp_glk_replay : ifp_glk_replay_filename;
+}
+
+
+/*
+ * ifp_glk_record_write_number()
+ * ifp_glk_record_read_number()
+ *
+ * Write and read a single unsigned LEB128 number to and from the trace.
+ * Reading returns FALSE on end of file or on a malformed number.
+ */
+static void
+ifp_glk_record_write_number (unsigned long number)
+{
+  while (number >= 0x80)
+    {
+      putc ((number & 0x7f) | 0x80, ifp_glk_record_stream);
+      number >>= 7;
+    }
+  putc (number, ifp_glk_record_stream);
+}
+
+static int
+ifp_glk_record_read_number (unsigned long *number)
+{
+  unsigned long value;
+  int shift, byte;
+
+  value = 0;
+  for (shift = 0; shift < (int) sizeof (value) * 8; shift += 7)
+    {
+      byte = getc (ifp_glk_record_stream);
+      if (byte == EOF)
+        return FALSE;
+
+      value |= (unsigned long) (byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        {
+          *number = value;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * ifp_glk_record_find_window()
+ * ifp_glk_record_get_window()
+ *
+ * Convert between windows and trace window numbers.  Window numbers are
+ * one more than the window's creation order index, with zero for NULL or
+ * unknown windows.
+ */
+static int
+ifp_glk_record_find_window (winid_t window)
+{
+  int index_;
+
+  if (window)
+    {
+      for (index_ = 0; index_ < ifp_glk_record_windows_length; index_++)
+        {
+          if (ifp_glk_record_windows[index_].window == window)
+            return index_ + 1;
+        }
+    }
+
+  return 0;
+}
+
+static ifp_glk_record_window_t *
+ifp_glk_record_get_window (unsigned long number)
+{
+  if (number == 0 || number > (unsigned long) ifp_glk_record_windows_length)
+    return NULL;
+
+  return ifp_glk_record_windows + number - 1;
+}
+
+
+/*
+ * ifp_glk_record_add_window()
+ *
+ * Add a newly opened window to the creation order list.
+ */
+static void
+ifp_glk_record_add_window (winid_t window)
+{
+  ifp_glk_record_window_t *entry;
+  int index_;
+
+  /*
+   * A window closed by garbage collection, unseen here, may leave an entry
+   * whose address the new window reuses; retire it, so that the new window
+   * gets a number of its own.
+   */
+  for (index_ = 0; index_ < ifp_glk_record_windows_length; index_++)
+    {
+      if (ifp_glk_record_windows[index_].window == window)
+        ifp_glk_record_windows[index_].window = NULL;
+    }
+
+  if (ifp_glk_record_windows_length == ifp_glk_record_windows_allocation)
+    {
+      ifp_glk_record_windows_allocation =
+          ifp_glk_record_windows_allocation == 0
+          ? 8 : ifp_glk_record_windows_allocation << 1;
+      ifp_glk_record_windows =
+          ifp_realloc (ifp_glk_record_windows,
+                       ifp_glk_record_windows_allocation
+                       * sizeof (*ifp_glk_record_windows));
+    }
+
+  entry = ifp_glk_record_windows + ifp_glk_record_windows_length++;
+  memset (entry, 0, sizeof (*entry));
+  entry->window = window;
+}
+
+
+/*
+ * ifp_glk_record_report_divergence()
+ *
+ * Report the first point at which a replayed run departs from its trace.
+ * Once diverged, replay stops checking calls, but continues to return
+ * recorded events for as long as they fit the game's input requests.
+ */
+static void
+ifp_glk_record_report_divergence (int function, const char *expected)
+{
+  const char *name;
+
+  if (!ifp_glk_profile_get_entry (function, &name, NULL, NULL, NULL))
+    name = "(unknown)";
+
+  ifp_error ("glkrecord: replay diverged at call %lu, %s, expected %s",
+             ifp_glk_record_calls, name, expected);
+  ifp_glk_record_is_diverged = TRUE;
+}
+
+
+/*
+ * ifp_glk_record_check_call()
+ *
+ * On replay, check a call against the next record in the trace.
+ */
+static void
+ifp_glk_record_check_call (int function, unsigned long long bytes)
+{
+  unsigned long recorded_function, recorded_bytes;
+  const char *expected;
+  int tag;
+
+  ifp_glk_record_calls++;
+  if (ifp_glk_record_is_diverged)
+    return;
+
+  tag = getc (ifp_glk_record_stream);
+  if (tag != TAG_CALL)
+    {
+      if (tag != EOF)
+        ungetc (tag, ifp_glk_record_stream);
+      ifp_glk_record_report_divergence (function, tag == TAG_RESULT
+                                                  ? "a result" : "an event");
+      return;
+    }
+
+  if (!ifp_glk_record_read_number (&recorded_function)
+      || !ifp_glk_record_read_number (&recorded_bytes))
+    {
+      ifp_glk_record_report_divergence (function, "a valid call");
+      return;
+    }
+
+  if (recorded_function != (unsigned long) function
+      || recorded_bytes != (unsigned long) bytes)
+    {
+      if (!ifp_glk_profile_get_entry (recorded_function,
+                                      &expected, NULL, NULL, NULL))
+        expected = "(unknown)";
+      ifp_glk_record_report_divergence (function, expected);
+    }
+}
+
+
+/*
+ * ifp_glk_record_observe_call()
+ *
+ * Observer for calls made through the profiling layer.  Log the call when
+ * recording, and check it against the trace when replaying.
+ */
+static void
+ifp_glk_record_observe_call (int function, unsigned long long bytes)
+{
+  if (ifp_glk_record_is_replaying)
+    ifp_glk_record_check_call (function, bytes);
+  else
+    {
+      putc (TAG_CALL, ifp_glk_record_stream);
+      ifp_glk_record_write_number (function);
+      ifp_glk_record_write_number (bytes);
+      ifp_glk_record_calls++;
+    }
+}
+
+
+/*
+ * ifp_glk_record_hash()
+ *
+ * Hash data returned into a game buffer, 32-bit FNV-1a algorithm, so that
+ * results record the data without its bulk.
+ */
+static unsigned long
+ifp_glk_record_hash (const void *data, size_t length)
+{
+  const unsigned char *byte;
+  glui32 hash;
+
+  hash = 2166136261u;
+  for (byte = data; length > 0; byte++, length--)
+    {
+      hash ^= *byte;
+      hash *= 16777619u;
+    }
+
+  return hash;
+}
+
+
+/*
+ * ifp_glk_record_read_result()
+ *
+ * Read the values of the result record whose tag has just been read from
+ * the trace, or skip them if values is NULL.  Returns the count of values
+ * in the record, or -1 if the record is malformed.
+ */
+static int
+ifp_glk_record_read_result (unsigned long *values)
+{
+  unsigned long count, value, index_;
+
+  if (!ifp_glk_record_read_number (&count)
+      || count > RECORD_RESULT_VALUES)
+    return -1;
+
+  for (index_ = 0; index_ < count; index_++)
+    {
+      if (!ifp_glk_record_read_number (&value))
+        return -1;
+      if (values)
+        values[index_] = value;
+    }
+
+  return count;
+}
+
+
+/*
+ * ifp_glk_record_result()
+ *
+ * Log the results of a call that returns data to the game, or on replay,
+ * check them against the trace.  Called after the call itself, so that the
+ * result record follows the call record logged by the profiling layer.
+ */
+static void
+ifp_glk_record_result (const char *name, int count, const unsigned long *values)
+{
+  unsigned long recorded[RECORD_RESULT_VALUES];
+  int tag, recorded_count, index_;
+
+  assert (count <= RECORD_RESULT_VALUES);
+
+  if (!ifp_glk_record_stream)
+    return;
+
+  if (!ifp_glk_record_is_replaying)
+    {
+      putc (TAG_RESULT, ifp_glk_record_stream);
+      ifp_glk_record_write_number (count);
+      for (index_ = 0; index_ < count; index_++)
+        ifp_glk_record_write_number (values[index_]);
+      return;
+    }
+
+  if (ifp_glk_record_is_diverged)
+    return;
+
+  tag = getc (ifp_glk_record_stream);
+  if (tag != TAG_RESULT)
+    {
+      if (tag != EOF)
+        ungetc (tag, ifp_glk_record_stream);
+      ifp_glk_record_report_divergence (ifp_glk_profile_find_function (name),
+                                        "a result");
+      return;
+    }
+
+  recorded_count = ifp_glk_record_read_result (recorded);
+  if (recorded_count != count
+      || memcmp (recorded, values, count * sizeof (*values)) != 0)
+    {
+      ifp_glk_record_report_divergence (ifp_glk_profile_find_function (name),
+                                        "the recorded results");
+    }
+}
+
+
+/*
+ * ifp_glk_record_write_event()
+ *
+ * Log an event returned by the Glk library, with any line input it carries.
+ */
+static void
+ifp_glk_record_write_event (int tag, const event_t *event)
+{
+  ifp_glk_record_window_t *entry;
+  int number;
+  glui32 index_;
+
+  number = ifp_glk_record_find_window (event->win);
+  entry = ifp_glk_record_get_window (number);
+
+  putc (tag, ifp_glk_record_stream);
+  ifp_glk_record_write_number (event->type);
+  ifp_glk_record_write_number (number);
+  ifp_glk_record_write_number (event->val1);
+  ifp_glk_record_write_number (event->val2);
+
+  if (event->type == evtype_LineInput)
+    {
+      for (index_ = 0; index_ < event->val1; index_++)
+        {
+          if (entry && entry->line_buffer && index_ < entry->line_length)
+            {
+              ifp_glk_record_write_number (entry->is_unicode
+                  ? ((glui32 *) entry->line_buffer)[index_]
+                  : ((unsigned char *) entry->line_buffer)[index_]);
+            }
+          else
+            ifp_glk_record_write_number (0);
+        }
+
+      if (entry)
+        entry->line_buffer = NULL;
+    }
+  else if (event->type == evtype_CharInput)
+    {
+      if (entry)
+        entry->is_char_requested = FALSE;
+    }
+
+  ifp_glk_record_events++;
+  if (event->type == evtype_LineInput || event->type == evtype_CharInput)
+    ifp_glk_record_turns++;
+}
+
+
+/*
+ * ifp_glk_record_read_event()
+ *
+ * Read the next event record of the given kind from the trace.  Line
+ * input carried by the event is copied into the buffer of the line request
+ * on its window.  Returns FALSE when the trace is exhausted, or when the
+ * event does not fit the game's pending input requests.
+ */
+static int
+ifp_glk_record_read_event (int tag, event_t *event)
+{
+  unsigned long type, number, val1, val2, character, dummy;
+  ifp_glk_record_window_t *entry;
+  int function, recorded_tag;
+  glui32 index_;
+
+  function = tag == TAG_POLL ? ifp_glk_record_select_poll_function
+                             : ifp_glk_record_select_function;
+
+  /*
+   * Skip records of calls not made, or left unchecked after divergence, and
+   * of their results.
+   */
+  for (recorded_tag = getc (ifp_glk_record_stream);
+       recorded_tag == TAG_CALL || recorded_tag == TAG_RESULT;
+       recorded_tag = getc (ifp_glk_record_stream))
+    {
+      if (!ifp_glk_record_is_diverged)
+        ifp_glk_record_report_divergence (function, "a further call");
+
+      if (recorded_tag == TAG_RESULT)
+        {
+          if (ifp_glk_record_read_result (NULL) == -1)
+            return FALSE;
+        }
+      else if (!ifp_glk_record_read_number (&dummy)
+               || !ifp_glk_record_read_number (&dummy))
+        return FALSE;
+    }
+
+  if (recorded_tag == EOF)
+    return FALSE;
+  else if (recorded_tag != tag)
+    {
+      if (!ifp_glk_record_is_diverged)
+        ifp_glk_record_report_divergence (function, "a different event");
+      return FALSE;
+    }
+
+  if (!ifp_glk_record_read_number (&type)
+      || !ifp_glk_record_read_number (&number)
+      || !ifp_glk_record_read_number (&val1)
+      || !ifp_glk_record_read_number (&val2))
+    return FALSE;
+
+  /* Refuse input events that the game has not asked for. */
+  entry = ifp_glk_record_get_window (number);
+  if ((type == evtype_LineInput && !(entry && entry->line_buffer))
+      || (type == evtype_CharInput && !(entry && entry->is_char_requested)))
+    {
+      if (!ifp_glk_record_is_diverged)
+        ifp_glk_record_report_divergence (function, "no input request");
+      return FALSE;
+    }
+
+  event->type = type;
+  event->win = entry ? entry->window : NULL;
+  event->val1 = val1;
+  event->val2 = val2;
+
+  if (type == evtype_LineInput)
+    {
+      for (index_ = 0; index_ < val1; index_++)
+        {
+          if (!ifp_glk_record_read_number (&character))
+            return FALSE;
+
+          if (index_ < entry->line_length)
+            {
+              if (entry->is_unicode)
+                ((glui32 *) entry->line_buffer)[index_] = character;
+              else
+                ((unsigned char *) entry->line_buffer)[index_] = character;
+            }
+        }
+
+      if (val1 > entry->line_length)
+        event->val1 = entry->line_length;
+      entry->line_buffer = NULL;
+    }
+  else if (type == evtype_CharInput)
+    entry->is_char_requested = FALSE;
+
+  ifp_glk_record_events++;
+  if (type == evtype_LineInput || type == evtype_CharInput)
+    ifp_glk_record_turns++;
+
+  return TRUE;
+}
+
+
+/*
+ * ifp_glk_record_replay_event()
+ *
+ * Return the next recorded event on replay.  The real Glk library still
+ * holds the input request the event satisfies, so cancel it first, then
+ * overlay the recorded input.  If no usable event remains, end the game.
+ */
+static void
+ifp_glk_record_replay_event (int tag, event_t *event)
+{
+  event_t scratch;
+
+  if (!ifp_glk_record_read_event (tag, event))
+    {
+      ifp_trace ("glkrecord: replay trace exhausted");
+      ifp_glk_record_finalize ();
+      record_glk_interface.glk_exit ();
+    }
+
+  if (!event->win)
+    return;
+
+  switch (event->type)
+    {
+    case evtype_LineInput:
+      base_glk_interface->glk_cancel_line_event (event->win, &scratch);
+      break;
+    case evtype_CharInput:
+      base_glk_interface->glk_cancel_char_event (event->win);
+      break;
+    case evtype_MouseInput:
+      base_glk_interface->glk_cancel_mouse_event (event->win);
+      break;
+    case evtype_Hyperlink:
+      base_glk_interface->glk_cancel_hyperlink_event (event->win);
+      break;
+    default:
+      break;
+    }
+}
+
+
+/*
+ * Recorder wrappers for Glk window and input functions.  Window opening is
+ * tracked to number windows, and line requests to find input buffers.
+ */
+static winid_t
+record_glk_window_open (winid_t split, glui32 method, glui32 size,
+                        glui32 wintype, glui32 rock)
+{
+  winid_t window;
+
+  window = next_glk_interface->glk_window_open (split, method, size,
+                                                wintype, rock);
+  if (window)
+    ifp_glk_record_add_window (window);
+
+  return window;
+}
+
+static void
+record_glk_window_close (winid_t win, stream_result_t *result)
+{
+  ifp_glk_record_window_t *entry;
+  stream_result_t counts;
+  unsigned long values[2];
+
+  next_glk_interface->glk_window_close (win, &counts);
+  values[0] = counts.readcount;
+  values[1] = counts.writecount;
+  ifp_glk_record_result ("glk_window_close", 2, values);
+  if (result)
+    *result = counts;
+
+  entry = ifp_glk_record_get_window (ifp_glk_record_find_window (win));
+  if (entry)
+    entry->window = NULL;
+}
+
+static void
+record_glk_request_line_event (winid_t win, char *buf,
+                               glui32 maxlen, glui32 initlen)
+{
+  ifp_glk_record_window_t *entry;
+
+  entry = ifp_glk_record_get_window (ifp_glk_record_find_window (win));
+  if (entry)
+    {
+      entry->line_buffer = buf;
+      entry->line_length = maxlen;
+      entry->is_unicode = FALSE;
+    }
+
+  next_glk_interface->glk_request_line_event (win, buf, maxlen, initlen);
+}
+
+static void
+record_glk_request_line_event_uni (winid_t win, glui32 *buf,
+                                   glui32 maxlen, glui32 initlen)
+{
+  ifp_glk_record_window_t *entry;
+
+  entry = ifp_glk_record_get_window (ifp_glk_record_find_window (win));
+  if (entry)
+    {
+      entry->line_buffer = buf;
+      entry->line_length = maxlen;
+      entry->is_unicode = TRUE;
+    }
+
+  next_glk_interface->glk_request_line_event_uni (win, buf, maxlen, initlen);
+}
+
+static void
+record_glk_request_char_event (winid_t win)
+{
+  ifp_glk_record_window_t *entry;
+
+  entry = ifp_glk_record_get_window (ifp_glk_record_find_window (win));
+  if (entry)
+    entry->is_char_requested = TRUE;
+
+  next_glk_interface->glk_request_char_event (win);
+}
+
+static void
+record_glk_request_char_event_uni (winid_t win)
+{
+  ifp_glk_record_window_t *entry;
+
+  entry = ifp_glk_record_get_window (ifp_glk_record_find_window (win));
+  if (entry)
+    entry->is_char_requested = TRUE;
+
+  next_glk_interface->glk_request_char_event_uni (win);
+}
+
+static void
+record_glk_cancel_line_event (winid_t win, event_t *event)
+{
+  ifp_glk_record_window_t *entry;
+  event_t cancelled;
+
+  next_glk_interface->glk_cancel_line_event (win, &cancelled);
+
+  if (ifp_glk_record_is_replaying)
+    ifp_glk_record_read_event (TAG_CANCEL, &cancelled);
+  else
+    ifp_glk_record_write_event (TAG_CANCEL, &cancelled);
+
+  entry = ifp_glk_record_get_window (ifp_glk_record_find_window (win));
+  if (entry)
+    entry->line_buffer = NULL;
+
+  if (event)
+    *event = cancelled;
+}
+
+static void
+record_glk_cancel_char_event (winid_t win)
+{
+  ifp_glk_record_window_t *entry;
+
+  entry = ifp_glk_record_get_window (ifp_glk_record_find_window (win));
+  if (entry)
+    entry->is_char_requested = FALSE;
+
+  next_glk_interface->glk_cancel_char_event (win);
+}
+
+static void
+record_glk_select (event_t *event)
+{
+  if (ifp_glk_record_is_replaying)
+    {
+      ifp_glk_record_check_call (ifp_glk_record_select_function, 0);
+      ifp_glk_record_replay_event (TAG_EVENT, event);
+    }
+  else
+    {
+      next_glk_interface->glk_select (event);
+      ifp_glk_record_write_event (TAG_EVENT, event);
+    }
+}
+
+static void
+record_glk_select_poll (event_t *event)
+{
+  if (ifp_glk_record_is_replaying)
+    {
+      ifp_glk_record_check_call (ifp_glk_record_select_poll_function, 0);
+      ifp_glk_record_replay_event (TAG_POLL, event);
+    }
+  else
+    {
+      next_glk_interface->glk_select_poll (event);
+      ifp_glk_record_write_event (TAG_POLL, event);
+    }
+}
+
+
+/*
+ * Recorder wrappers for Glk functions that return data to the game.  Each
+ * calls through, then logs or checks the results of the call.
+ */
+
+static glui32
+record_glk_gestalt (glui32 sel, glui32 val)
+{
+  unsigned long values[1];
+  glui32 value;
+
+  value = next_glk_interface->glk_gestalt (sel, val);
+  values[0] = value;
+  ifp_glk_record_result ("glk_gestalt", 1, values);
+  return value;
+}
+
+static glui32
+record_glk_gestalt_ext (glui32 sel, glui32 val, glui32 *arr, glui32 arrlen)
+{
+  unsigned long values[1];
+  glui32 value;
+
+  value = next_glk_interface->glk_gestalt_ext (sel, val, arr, arrlen);
+  values[0] = value;
+  ifp_glk_record_result ("glk_gestalt_ext", 1, values);
+  return value;
+}
+
+static void
+record_glk_window_get_size (winid_t win, glui32 *widthptr, glui32 *heightptr)
+{
+  unsigned long values[2];
+  glui32 width, height;
+
+  next_glk_interface->glk_window_get_size (win, &width, &height);
+  values[0] = width;
+  values[1] = height;
+  ifp_glk_record_result ("glk_window_get_size", 2, values);
+
+  if (widthptr)
+    *widthptr = width;
+  if (heightptr)
+    *heightptr = height;
+}
+
+static void
+record_glk_window_get_arrangement (winid_t win, glui32 *methodptr,
+                                   glui32 *sizeptr, winid_t *keywinptr)
+{
+  unsigned long values[3];
+  glui32 method, size;
+  winid_t keywin;
+
+  next_glk_interface->glk_window_get_arrangement (win, &method,
+                                                  &size, &keywin);
+  values[0] = method;
+  values[1] = size;
+  values[2] = ifp_glk_record_find_window (keywin);
+  ifp_glk_record_result ("glk_window_get_arrangement", 3, values);
+
+  if (methodptr)
+    *methodptr = method;
+  if (sizeptr)
+    *sizeptr = size;
+  if (keywinptr)
+    *keywinptr = keywin;
+}
+
+static strid_t
+record_glk_stream_open_file (frefid_t fileref, glui32 fmode, glui32 rock)
+{
+  unsigned long values[1];
+  strid_t stream;
+
+  stream = next_glk_interface->glk_stream_open_file (fileref, fmode, rock);
+  values[0] = stream != NULL;
+  ifp_glk_record_result ("glk_stream_open_file", 1, values);
+  return stream;
+}
+
+static strid_t
+record_glk_stream_open_file_uni (frefid_t fileref, glui32 fmode,
+                                 glui32 rock)
+{
+  unsigned long values[1];
+  strid_t stream;
+
+  stream = next_glk_interface->glk_stream_open_file_uni (fileref, fmode,
+                                                         rock);
+  values[0] = stream != NULL;
+  ifp_glk_record_result ("glk_stream_open_file_uni", 1, values);
+  return stream;
+}
+
+static strid_t
+record_glkunix_stream_open_pathname (char *pathname, glui32 textmode,
+                                     glui32 rock)
+{
+  unsigned long values[1];
+  strid_t stream;
+
+  stream = next_glk_interface->glkunix_stream_open_pathname (pathname,
+                                                             textmode, rock);
+  values[0] = stream != NULL;
+  ifp_glk_record_result ("glkunix_stream_open_pathname", 1, values);
+  return stream;
+}
+
+static void
+record_glk_stream_close (strid_t str, stream_result_t *result)
+{
+  unsigned long values[2];
+  stream_result_t counts;
+
+  next_glk_interface->glk_stream_close (str, &counts);
+  values[0] = counts.readcount;
+  values[1] = counts.writecount;
+  ifp_glk_record_result ("glk_stream_close", 2, values);
+
+  if (result)
+    *result = counts;
+}
+
+static glui32
+record_glk_stream_get_position (strid_t str)
+{
+  unsigned long values[1];
+  glui32 value;
+
+  value = next_glk_interface->glk_stream_get_position (str);
+  values[0] = value;
+  ifp_glk_record_result ("glk_stream_get_position", 1, values);
+  return value;
+}
+
+static glsi32
+record_glk_get_char_stream (strid_t str)
+{
+  unsigned long values[1];
+  glsi32 value;
+
+  value = next_glk_interface->glk_get_char_stream (str);
+  values[0] = (glui32) value;
+  ifp_glk_record_result ("glk_get_char_stream", 1, values);
+  return value;
+}
+
+static glsi32
+record_glk_get_char_stream_uni (strid_t str)
+{
+  unsigned long values[1];
+  glsi32 value;
+
+  value = next_glk_interface->glk_get_char_stream_uni (str);
+  values[0] = (glui32) value;
+  ifp_glk_record_result ("glk_get_char_stream_uni", 1, values);
+  return value;
+}
+
+static glui32
+record_glk_get_line_stream (strid_t str, char *buf, glui32 len)
+{
+  unsigned long values[2];
+  glui32 value;
+
+  value = next_glk_interface->glk_get_line_stream (str, buf, len);
+  values[0] = value;
+  values[1] = ifp_glk_record_hash (buf, value);
+  ifp_glk_record_result ("glk_get_line_stream", 2, values);
+  return value;
+}
+
+static glui32
+record_glk_get_line_stream_uni (strid_t str, glui32 *buf, glui32 len)
+{
+  unsigned long values[2];
+  glui32 value;
+
+  value = next_glk_interface->glk_get_line_stream_uni (str, buf, len);
+  values[0] = value;
+  values[1] = ifp_glk_record_hash (buf, value * sizeof (*buf));
+  ifp_glk_record_result ("glk_get_line_stream_uni", 2, values);
+  return value;
+}
+
+static glui32
+record_glk_get_buffer_stream (strid_t str, char *buf, glui32 len)
+{
+  unsigned long values[2];
+  glui32 value;
+
+  value = next_glk_interface->glk_get_buffer_stream (str, buf, len);
+  values[0] = value;
+  values[1] = ifp_glk_record_hash (buf, value);
+  ifp_glk_record_result ("glk_get_buffer_stream", 2, values);
+  return value;
+}
+
+static glui32
+record_glk_get_buffer_stream_uni (strid_t str, glui32 *buf, glui32 len)
+{
+  unsigned long values[2];
+  glui32 value;
+
+  value = next_glk_interface->glk_get_buffer_stream_uni (str, buf, len);
+  values[0] = value;
+  values[1] = ifp_glk_record_hash (buf, value * sizeof (*buf));
+  ifp_glk_record_result ("glk_get_buffer_stream_uni", 2, values);
+  return value;
+}
+
+static glui32
+record_glk_style_distinguish (winid_t win, glui32 styl1, glui32 styl2)
+{
+  unsigned long values[1];
+  glui32 value;
+
+  value = next_glk_interface->glk_style_distinguish (win, styl1, styl2);
+  values[0] = value;
+  ifp_glk_record_result ("glk_style_distinguish", 1, values);
+  return value;
+}
+
+static glui32
+record_glk_style_measure (winid_t win, glui32 styl, glui32 hint,
+                          glui32 *result)
+{
+  unsigned long values[2];
+  glui32 value, measure;
+
+  measure = 0;
+  value = next_glk_interface->glk_style_measure (win, styl, hint, &measure);
+  values[0] = value;
+  values[1] = value ? measure : 0;
+  ifp_glk_record_result ("glk_style_measure", 2, values);
+
+  if (value && result)
+    *result = measure;
+  return value;
+}
+
+static frefid_t
+record_glk_fileref_create_by_prompt (glui32 usage, glui32 fmode, glui32 rock)
+{
+  unsigned long values[1];
+  frefid_t fileref;
+
+  fileref = next_glk_interface->glk_fileref_create_by_prompt (usage,
+                                                              fmode, rock);
+  values[0] = fileref != NULL;
+  ifp_glk_record_result ("glk_fileref_create_by_prompt", 1, values);
+  return fileref;
+}
+
+static glui32
+record_glk_fileref_does_file_exist (frefid_t fref)
+{
+  unsigned long values[1];
+  glui32 value;
+
+  value = next_glk_interface->glk_fileref_does_file_exist (fref);
+  values[0] = value;
+  ifp_glk_record_result ("glk_fileref_does_file_exist", 1, values);
+  return value;
+}
+
+static glui32
+record_glk_buffer_to_lower_case_uni (glui32 *buf, glui32 len, glui32 numchars)
+{
+  unsigned long values[2];
+  glui32 value;
+
+  value = next_glk_interface->glk_buffer_to_lower_case_uni (buf, len,
+                                                            numchars);
+  values[0] = value;
+  values[1] = ifp_glk_record_hash (buf, (value < len ? value : len)
+                                        * sizeof (*buf));
+  ifp_glk_record_result ("glk_buffer_to_lower_case_uni", 2, values);
+  return value;
+}
+
+static glui32
+record_glk_buffer_to_upper_case_uni (glui32 *buf, glui32 len, glui32 numchars)
+{
+  unsigned long values[2];
+  glui32 value;
+
+  value = next_glk_interface->glk_buffer_to_upper_case_uni (buf, len,
+                                                            numchars);
+  values[0] = value;
+  values[1] = ifp_glk_record_hash (buf, (value < len ? value : len)
+                                        * sizeof (*buf));
+  ifp_glk_record_result ("glk_buffer_to_upper_case_uni", 2, values);
+  return value;
+}
+
+static glui32
+record_glk_buffer_to_title_case_uni (glui32 *buf, glui32 len,
+                                     glui32 numchars, glui32 lowerrest)
+{
+  unsigned long values[2];
+  glui32 value;
+
+  value = next_glk_interface->glk_buffer_to_title_case_uni (buf, len,
+                                                            numchars,
+                                                            lowerrest);
+  values[0] = value;
+  values[1] = ifp_glk_record_hash (buf, (value < len ? value : len)
+                                        * sizeof (*buf));
+  ifp_glk_record_result ("glk_buffer_to_title_case_uni", 2, values);
+  return value;
+}
+
+static glui32
+record_glk_image_get_info (glui32 image, glui32 *width, glui32 *height)
+{
+  unsigned long values[3];
+  glui32 value, image_width, image_height;
+
+  image_width = image_height = 0;
+  value = next_glk_interface->glk_image_get_info (image, &image_width,
+                                                  &image_height);
+  values[0] = value;
+  values[1] = value ? image_width : 0;
+  values[2] = value ? image_height : 0;
+  ifp_glk_record_result ("glk_image_get_info", 3, values);
+
+  if (value && width)
+    *width = image_width;
+  if (value && height)
+    *height = image_height;
+  return value;
+}
+
+
+/*
+ * ifp_glk_record_open()
+ *
+ * Open the trace file for recording or replay, and write or verify its
+ * header.  Returns FALSE if the file cannot be used.
+ */
+static int
+ifp_glk_record_open (const char *filename, int is_replaying)
+{
+  char magic[RECORD_MAGIC_LENGTH];
+  unsigned long version;
+
+  ifp_glk_record_stream = fopen (filename, is_replaying ? "rb" : "wb");
+  if (!ifp_glk_record_stream)
+    {
+      ifp_error ("glkrecord: unable to open %s", filename);
+      return FALSE;
+    }
+
+  if (is_replaying)
+    {
+      if (fread (magic, 1, sizeof (magic), ifp_glk_record_stream)
+          != sizeof (magic)
+          || memcmp (magic, RECORD_MAGIC, sizeof (magic)) != 0
+          || !ifp_glk_record_read_number (&version)
+          || version != RECORD_VERSION)
+        {
+          ifp_error ("glkrecord: %s is not a Glk trace file", filename);
+          fclose (ifp_glk_record_stream);
+          ifp_glk_record_stream = NULL;
+          return FALSE;
+        }
+    }
+  else
+    {
+      fwrite (RECORD_MAGIC, 1, RECORD_MAGIC_LENGTH, ifp_glk_record_stream);
+      ifp_glk_record_write_number (RECORD_VERSION);
+    }
+
+  return TRUE;
+}
+
+
+/*
+ * ifp_glk_record_start()
+ *
+ * Open the selected trace file for the rest of the run, and arrange for it
+ * to be closed on exit.  Returns FALSE if the file cannot be used.
+ */
+static int
+ifp_glk_record_start (void)
+{
+  const char *filename;
+  int is_replaying;
+
+  is_replaying = ifp_glk_replay_get_selected () != NULL;
+  filename = is_replaying ? ifp_glk_replay_get_selected ()
+                          : ifp_glk_record_get_selected ();
+  if (!ifp_glk_record_open (filename, is_replaying))
+    return FALSE;
+
+  ifp_trace ("glkrecord: %s %s", is_replaying ? "replaying" : "recording",
+             filename);
+
+  ifp_glk_record_is_replaying = is_replaying;
+  ifp_glk_record_is_diverged = FALSE;
+  ifp_glk_record_calls = ifp_glk_record_events = ifp_glk_record_turns = 0;
+  ifp_glk_record_windows_length = 0;
+  clock_gettime (CLOCK_MONOTONIC, &ifp_glk_record_start_time);
+
+  ifp_glk_record_select_function =
+      ifp_glk_profile_find_function ("glk_select");
+  ifp_glk_record_select_poll_function =
+      ifp_glk_profile_find_function ("glk_select_poll");
+  ifp_glk_profile_set_observer (ifp_glk_record_observe_call);
+
+  ifp_register_finalizer (ifp_glk_record_finalize);
+  return TRUE;
+}
+
+
+/*
+ * ifp_glk_record_get_interface()
+ *
+ * Open the selected trace file on first call, and return the recorder Glk
+ * interface, wrapping a profiling layer over the given one.  The recorder
+ * interface is built once, and afterwards only refreshed, so that entries
+ * a caller sets on it are kept.  Returns just the profiling interface if
+ * the trace file cannot be used, or has been closed.
+ */
+ifp_glk_interfaceref_t
+ifp_glk_record_get_interface (ifp_glk_interfaceref_t glk_interface)
+{
+  ifp_glk_interfaceref_t profile_interface;
+
+  assert (glk_interface);
+
+  ifp_trace ("glkrecord: ifp_glk_record_get_interface <- %p",
+             ifp_trace_pointer (glk_interface));
+
+  base_glk_interface = glk_interface;
+  profile_interface = ifp_glk_profile_get_interface (glk_interface);
+
+  if (!ifp_glk_record_is_opened)
+    {
+      ifp_glk_record_is_opened = TRUE;
+      ifp_glk_record_start ();
+    }
+  if (!ifp_glk_record_stream)
+    return profile_interface;
+
+  if (next_glk_interface == profile_interface)
+    {
+      ifp_glk_refresh_interface (&record_glk_interface,
+                                 &record_glk_snapshot, profile_interface);
+      return &record_glk_interface;
+    }
+
+  next_glk_interface = profile_interface;
+  memcpy (&record_glk_snapshot, next_glk_interface,
+          sizeof (*next_glk_interface));
+  memcpy (&record_glk_interface, next_glk_interface,
+          sizeof (*next_glk_interface));
+
+  record_glk_interface.glk_window_open = record_glk_window_open;
+  record_glk_interface.glk_window_close = record_glk_window_close;
+  record_glk_interface.glk_request_line_event = record_glk_request_line_event;
+  record_glk_interface.glk_request_line_event_uni
+    = record_glk_request_line_event_uni;
+  record_glk_interface.glk_request_char_event = record_glk_request_char_event;
+  record_glk_interface.glk_request_char_event_uni
+    = record_glk_request_char_event_uni;
+  record_glk_interface.glk_cancel_line_event = record_glk_cancel_line_event;
+  record_glk_interface.glk_cancel_char_event = record_glk_cancel_char_event;
+  record_glk_interface.glk_select = record_glk_select;
+  record_glk_interface.glk_select_poll = record_glk_select_poll;
+  record_glk_interface.glk_gestalt = record_glk_gestalt;
+  record_glk_interface.glk_gestalt_ext = record_glk_gestalt_ext;
+  record_glk_interface.glk_window_get_size = record_glk_window_get_size;
+  record_glk_interface.glk_window_get_arrangement
+    = record_glk_window_get_arrangement;
+  record_glk_interface.glk_stream_open_file = record_glk_stream_open_file;
+  record_glk_interface.glk_stream_open_file_uni
+    = record_glk_stream_open_file_uni;
+  record_glk_interface.glkunix_stream_open_pathname
+    = record_glkunix_stream_open_pathname;
+  record_glk_interface.glk_stream_close = record_glk_stream_close;
+  record_glk_interface.glk_stream_get_position = record_glk_stream_get_position;
+  record_glk_interface.glk_get_char_stream = record_glk_get_char_stream;
+  record_glk_interface.glk_get_char_stream_uni = record_glk_get_char_stream_uni;
+  record_glk_interface.glk_get_line_stream = record_glk_get_line_stream;
+  record_glk_interface.glk_get_line_stream_uni = record_glk_get_line_stream_uni;
+  record_glk_interface.glk_get_buffer_stream = record_glk_get_buffer_stream;
+  record_glk_interface.glk_get_buffer_stream_uni
+    = record_glk_get_buffer_stream_uni;
+  record_glk_interface.glk_style_distinguish = record_glk_style_distinguish;
+  record_glk_interface.glk_style_measure = record_glk_style_measure;
+  record_glk_interface.glk_fileref_create_by_prompt
+    = record_glk_fileref_create_by_prompt;
+  record_glk_interface.glk_fileref_does_file_exist
+    = record_glk_fileref_does_file_exist;
+  record_glk_interface.glk_buffer_to_lower_case_uni
+    = record_glk_buffer_to_lower_case_uni;
+  record_glk_interface.glk_buffer_to_upper_case_uni
+    = record_glk_buffer_to_upper_case_uni;
+  record_glk_interface.glk_buffer_to_title_case_uni
+    = record_glk_buffer_to_title_case_uni;
+  record_glk_interface.glk_image_get_info = record_glk_image_get_info;
+
+  return &record_glk_interface;
+}
+
+
+/*
+ * ifp_glk_record_finalize()
+ *
+ * Close any open trace, on exit or when a replay runs out.  On replay,
+ * print a summary of the run's timing, giving input turns per second, on
+ * stderr.  Safe to call when no trace is open.
+ */
+void
+ifp_glk_record_finalize (void)
+{
+  struct timespec end;
+  double elapsed;
+
+  if (!ifp_glk_record_stream)
+    return;
+
+  ifp_trace ("glkrecord: ifp_glk_record_finalize <- void");
+
+  if (ifp_glk_record_is_replaying)
+    {
+      clock_gettime (CLOCK_MONOTONIC, &end);
+      elapsed = (end.tv_sec - ifp_glk_record_start_time.tv_sec)
+                + (end.tv_nsec - ifp_glk_record_start_time.tv_nsec) / 1.0e9;
+
+      fprintf (stderr, "glk replay: %lu calls, %lu events, %lu turns"
+               " in %.3f seconds, %.1f turns/sec%s\n",
+               ifp_glk_record_calls, ifp_glk_record_events,
+               ifp_glk_record_turns, elapsed,
+               elapsed > 0.0 ? ifp_glk_record_turns / elapsed : 0.0,
+               ifp_glk_record_is_diverged ? " (diverged)" : "");
+    }
+
+  ifp_glk_profile_set_observer (NULL);
+  fclose (ifp_glk_record_stream);
+  ifp_glk_record_stream = NULL;
+
+  ifp_glk_record_windows_length = 0;
+}
@@ -26,11 +26,14 @@ extern "C"
 {
 #endif
 
+#include <stddef.h>
+
 #include "glk.h"
 #include "glkstart.h"
 
 /* Plugin trace and error reporting function definitions. */
 extern void ifp_trace_select (const char *selector);
+extern void ifp_trace_dump (void);
 extern void ifp_messages (int enabled);
 extern int ifp_messages_enabled (void);
 
@@ -45,6 +48,7 @@ extern const char *ifp_url_get_url_path (ifp_urlref_t url);
 extern const char *ifp_url_get_data_file (ifp_urlref_t url);
 extern int ifp_url_is_remote (ifp_urlref_t url);
 extern void ifp_url_scrub (ifp_urlref_t url);
+extern void ifp_url_set_read_limit (ifp_urlref_t url, int limit);
 extern int ifp_url_poll_resolved_async (ifp_urlref_t url);
 extern int ifp_url_poll_progress_async (ifp_urlref_t url);
 extern int ifp_url_get_status_async (ifp_urlref_t url);
@@ -75,6 +79,7 @@ extern int ifp_plugin_is_unloadable (ifp_pluginref_t plugin);
 extern void ifp_plugin_unload (ifp_pluginref_t plugin);
 extern int ifp_plugin_load (ifp_pluginref_t plugin, const char *filename);
 extern ifp_pluginref_t ifp_plugin_new_load (const char *filename);
+extern int ifp_plugin_complete_load (ifp_pluginref_t plugin);
 extern int
     ifp_plugin_attach_glk_interface (ifp_pluginref_t plugin,
                                      ifp_glk_interfaceref_t glk_interface);
@@ -109,6 +114,22 @@ extern int ifp_plugin_acceptor_length (ifp_pluginref_t plugin);
 extern const char *ifp_plugin_acceptor_pattern (ifp_pluginref_t plugin);
 extern ifp_pluginref_t ifp_plugin_find_chain_end (ifp_pluginref_t plugin);
 extern int ifp_plugin_is_equal (ifp_pluginref_t plugin, ifp_pluginref_t check);
+extern int ifp_plugin_checkpoint (ifp_pluginref_t plugin);
+extern int ifp_plugin_has_checkpoint (ifp_pluginref_t plugin);
+extern int ifp_plugin_restore (ifp_pluginref_t plugin);
+extern void ifp_plugin_discard_checkpoint (ifp_pluginref_t plugin);
+extern void ifp_plugin_set_heap_limits (size_t soft_limit, size_t hard_limit);
+extern void ifp_plugin_get_heap_limits (size_t *soft_limit,
+                                        size_t *hard_limit);
+extern void ifp_plugin_set_file_limits (int soft_limit, int hard_limit);
+extern void ifp_plugin_get_file_limits (int *soft_limit, int *hard_limit);
+extern int ifp_plugin_get_usage (ifp_pluginref_t plugin,
+                                 size_t *heap_current, size_t *heap_peak,
+                                 int *open_files, int *open_streams,
+                                 int *glk_objects);
+extern int ifp_plugin_get_allocation_counts (ifp_pluginref_t plugin,
+                                             unsigned long *counts,
+                                             int length);
 extern void ifp_plugin_dissect_header (ifp_pluginref_t plugin,
                                        int *ifp_version,
                                        const char **engine_type,
@@ -130,6 +151,9 @@ extern void ifp_plugin_dissect_header (ifp_pluginref_t plugin,
 /* Plugin loader function definitions. */
 extern ifp_pluginref_t ifp_loader_iterate_plugins (ifp_pluginref_t current);
 extern int ifp_loader_count_plugins (void);
+extern ifp_pluginref_t ifp_loader_find_plugin (const char *filename);
+extern ifp_pluginref_t ifp_loader_find_engine (const char *engine_name,
+                                               const char *engine_version);
 extern ifp_pluginref_t ifp_loader_replace_with_clone (ifp_pluginref_t plugin);
 extern ifp_pluginref_t ifp_loader_load_plugin (const char *filename);
 extern int ifp_loader_search_plugins_directory (const char *dir_path);
@@ -137,15 +161,79 @@ extern int ifp_loader_search_plugins_path (const char *load_path);
 extern void ifp_loader_forget_plugin (ifp_pluginref_t plugin);
 extern int ifp_loader_forget_all_plugins (void);
 
+/* Plugin header index function definitions. */
+typedef struct ifp_index_entry *ifp_index_entryref_t;
+extern int ifp_index_search_plugins_path (const char *load_path);
+extern ifp_index_entryref_t ifp_index_iterate_entries
+                                         (ifp_index_entryref_t current);
+extern int ifp_index_count_entries (void);
+extern const char *ifp_index_get_filename (ifp_index_entryref_t entry);
+extern void ifp_index_dissect_entry (ifp_index_entryref_t entry,
+                                     int *ifp_version,
+                                     const char **engine_type,
+                                     const char **engine_name,
+                                     const char **engine_version,
+                                     const char **build_timestamp,
+                                     const char **blorb_type,
+                                     int *acceptor_offset,
+                                     int *acceptor_length,
+                                     const char **acceptor_pattern,
+                                     const char **author_name,
+                                     const char **author_email,
+                                     const char **engine_home_url,
+                                     const char **builder_name,
+                                     const char **builder_email,
+                                     const char **engine_description,
+                                     const char **engine_copyright);
+extern void ifp_index_forget_all_entries (void);
+
 /* Glk handler function definition. */
 extern ifp_glk_interfaceref_t ifp_glk_get_interface (void);
 
+/* Glk call profiler function definitions. */
+extern void ifp_glk_profile_select (int flag);
+extern int ifp_glk_profile_is_selected (void);
+extern void ifp_glk_profile_reset (void);
+extern int ifp_glk_profile_get_count (void);
+extern int ifp_glk_profile_get_entry (int index_, const char **name,
+                                      unsigned long *calls,
+                                      unsigned long long *nanoseconds,
+                                      unsigned long long *bytes);
+extern int ifp_glk_profile_get_histogram (int index_,
+                                          unsigned long *histogram,
+                                          int length);
+extern void ifp_glk_profile_report (void);
+
+/* Startup phase timing function definitions. */
+extern void ifp_timing_select (int flag);
+extern int ifp_timing_is_selected (void);
+extern void ifp_timing_reset (void);
+extern int ifp_timing_get_count (void);
+extern int ifp_timing_get_entry (int index_, const char **name,
+                                 unsigned long *calls,
+                                 unsigned long long *nanoseconds);
+extern void ifp_timing_report (void);
+
+/* Glk call recorder function definitions. */
+extern void ifp_glk_record_select (const char *filename);
+extern const char *ifp_glk_record_get_selected (void);
+extern void ifp_glk_replay_select (const char *filename);
+extern const char *ifp_glk_replay_get_selected (void);
+
 /* Libc functions handler function definition. */
 extern ifp_libc_interfaceref_t ifp_libc_get_interface (void);
 
-/* Libc memory and file cleanup functions. */
+/* Libc memory and file cleanup and checkpoint functions. */
 extern void ifp_memory_malloc_garbage_collect (void);
+extern void ifp_memory_malloc_get_usage (size_t *current, size_t *peak);
+extern void ifp_memory_mmap_get_usage (size_t *current, size_t *peak);
+extern int ifp_memory_malloc_checkpoint (void);
+extern int ifp_memory_malloc_restore (void);
+extern void ifp_memory_malloc_discard_checkpoint (void);
 extern void ifp_file_open_files_cleanup (void);
+extern int ifp_file_checkpoint (void);
+extern int ifp_file_restore (void);
+extern void ifp_file_discard_checkpoint (void);
 
 /* Game data recognizer function definitions. */
 extern int ifp_recognizer_match_string (const char *string,
@@ -180,6 +268,8 @@ extern void ifp_pref_forget_startup_data (glkunix_startup_t *data);
 extern const char *ifp_manager_build_timestamp (void);
 extern void ifp_manager_clone_selected_plugins (int flag);
 extern int ifp_manager_cloning_selected (void);
+extern void ifp_manager_checkpoint_selected_plugins (int flag);
+extern int ifp_manager_checkpointing_selected (void);
 extern void ifp_manager_set_plugin_path (const char *new_path);
 extern const char *ifp_manager_get_plugin_path (void);
 extern int ifp_manager_reset_glk_library_partial (void);
@@ -188,11 +278,13 @@ extern int ifp_manager_collect_plugin_garbage (void);
 extern ifp_pluginref_t ifp_manager_locate_plugin (const char *filename);
 extern ifp_pluginref_t ifp_manager_locate_plugin_url (ifp_urlref_t url);
 extern void ifp_manager_run_plugin (ifp_pluginref_t plugin);
+extern int ifp_manager_restart_plugin (ifp_pluginref_t plugin);
 
 /* URL cache function definitions. */
 extern void ifp_cache_set_limit (int limit);
 extern int ifp_cache_get_limit (void);
 extern int ifp_cache_size (void);
+extern int ifp_cache_has_entry (const char *url_path);
 
 /* Const-correct Glk convenience wrapper functions. */
 extern strid_t glk_c_stream_open_memory (const char *buf, glui32 buflen,
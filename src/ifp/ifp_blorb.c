@@ -25,6 +25,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_BLORB
+
 
 /**
  * ifp_blorb_is_file_blorb()
@@ -31,6 +31,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_CACHE
+
 
 /*
  * Current set limit on the size the cache may grow to.  Some games are very
@@ -178,6 +180,22 @@ ifp_cache_lookup_url_path (const char *url_path)
 }
 
 
+/**
+ * ifp_cache_has_entry()
+ *
+ * Return TRUE if the URL cache holds data for a URL path.  Unlike a lookup
+ * made to resolve a URL, this does not count as a use of the entry, so it
+ * leaves the entry's standing for scavenging unchanged.
+ */
+int
+ifp_cache_has_entry (const char *url_path)
+{
+  assert (url_path);
+
+  return ifp_cache_lookup_url_path (url_path) != NULL;
+}
+
+
 /*
  * ifp_cache_timestamp()
  *
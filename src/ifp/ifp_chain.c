@@ -23,6 +23,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_CHAIN
+
 /*
  * A note of the plugin reference that this code is running in.  If NULL,
  * the code is not running in a plugin (and is therefore in some form of
@@ -28,6 +28,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_CONFIG
+
 
 /* Line buffer length, the longest input line the module can handle. */
 enum { MAX_INPUT_LINE = 8192 };
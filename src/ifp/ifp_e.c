@@ -55,7 +55,8 @@ glkunix_startup_code (glkunix_startup_t *data)
   if (data->argc != 2)
     {
       snprintf (error_message, sizeof (error_message),
-                "Usage: %s [-glk <library>] <game_file or game URL>\n",
+                "Usage: %s [-timings] [-glk <library>]"
+                " <game_file or game URL>\n",
                 data->argv[0]);
       return TRUE;
     }
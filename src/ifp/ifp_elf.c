@@ -0,0 +1,583 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2001-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stddef.h>
+#include <elf.h>
+#include <link.h>
+
+#include "ifp.h"
+#include "ifp_internal.h"
+
+#define IFP_TRACE_FACILITY IFP_TRACE_ELF
+
+/*
+ * Reading shared object symbol tables directly from their files lets us
+ * examine a file without handing it to dlopen, which maps it, processes all
+ * of its relocations, and runs its constructors, all while holding the
+ * dynamic linker's global lock.  Only the native ELF class is understood;
+ * anything else is left for dlopen to judge.  Functions here do not use Glk,
+ * and other than ifp_elf_read_header(), do not malloc, so that they may run
+ * on worker threads.
+ */
+
+
+/*
+ * ifp_elf_in_bounds()
+ *
+ * Return TRUE if the given range lies wholly within a file image of the
+ * given size.
+ */
+static int
+ifp_elf_in_bounds (size_t size, ElfW(Off) offset, ElfW(Xword) length)
+{
+  return offset <= size && length <= size - offset;
+}
+
+
+/*
+ * ifp_elf_get_dynsym()
+ *
+ * Locate the dynamic symbol table in a mapped ELF image, and the string
+ * table it links to.  Returns FALSE if the image is not a native ELF shared
+ * object with a usable dynamic symbol table.
+ */
+static int
+ifp_elf_get_dynsym (const unsigned char *image, size_t size,
+                    const ElfW(Sym) **symbols, size_t *symbol_count,
+                    const char **strings, size_t *strings_size)
+{
+  const ElfW(Ehdr) *ehdr;
+  const ElfW(Shdr) *shdrs, *dynsym, *dynstr;
+  int section;
+
+  ehdr = (const ElfW(Ehdr) *) image;
+  if (size < sizeof (*ehdr)
+      || memcmp (ehdr->e_ident, ELFMAG, SELFMAG) != 0
+      || ehdr->e_ident[EI_CLASS] != (sizeof (void *) == 8
+                                     ? ELFCLASS64 : ELFCLASS32)
+      || ehdr->e_type != ET_DYN
+      || ehdr->e_shentsize != sizeof (ElfW(Shdr))
+      || !ifp_elf_in_bounds (size, ehdr->e_shoff,
+                             (ElfW(Xword)) ehdr->e_shnum
+                             * sizeof (ElfW(Shdr))))
+    return FALSE;
+
+  /* Find the dynamic symbol table, and the string table it links to. */
+  shdrs = (const ElfW(Shdr) *) (image + ehdr->e_shoff);
+  dynsym = NULL;
+  for (section = 0; section < ehdr->e_shnum; section++)
+    {
+      if (shdrs[section].sh_type == SHT_DYNSYM)
+        {
+          dynsym = shdrs + section;
+          break;
+        }
+    }
+
+  if (!dynsym || dynsym->sh_link >= ehdr->e_shnum
+      || dynsym->sh_entsize != sizeof (ElfW(Sym))
+      || !ifp_elf_in_bounds (size, dynsym->sh_offset, dynsym->sh_size))
+    return FALSE;
+
+  dynstr = shdrs + dynsym->sh_link;
+  if (dynstr->sh_type != SHT_STRTAB || dynstr->sh_size == 0
+      || !ifp_elf_in_bounds (size, dynstr->sh_offset, dynstr->sh_size))
+    return FALSE;
+
+  *symbols = (const ElfW(Sym) *) (image + dynsym->sh_offset);
+  *symbol_count = dynsym->sh_size / sizeof (ElfW(Sym));
+  *strings = (const char *) image + dynstr->sh_offset;
+  *strings_size = dynstr->sh_size;
+  return TRUE;
+}
+
+
+/*
+ * ifp_elf_get_name()
+ *
+ * Return the name of a dynamic symbol, or NULL if the name does not lie
+ * wholly within the string table.
+ */
+static const char *
+ifp_elf_get_name (const ElfW(Sym) *symbol,
+                  const char *strings, size_t strings_size)
+{
+  const char *name;
+
+  if (symbol->st_name >= strings_size)
+    return NULL;
+
+  name = strings + symbol->st_name;
+  if (!memchr (name, '\0', strings_size - symbol->st_name))
+    return NULL;
+
+  return name;
+}
+
+
+/*
+ * ifp_elf_map_file()
+ * ifp_elf_unmap_file()
+ *
+ * Map a file read-only, returning its image and size, and unmap it again.
+ * If will_load, mapping also starts reading the whole file into the page
+ * cache, in anticipation of it being loaded.  Returns NULL if the file
+ * can't be opened or mapped, or is not a regular file.
+ */
+static void *
+ifp_elf_map_file (const char *filename, int will_load, size_t *size)
+{
+  struct stat statbuf;
+  void *image;
+  int fd;
+
+  fd = open (filename, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    {
+      ifp_trace ("elf: failed to open '%s'", filename);
+      return NULL;
+    }
+
+  if (fstat (fd, &statbuf) == -1 || !S_ISREG (statbuf.st_mode)
+      || statbuf.st_size == 0)
+    {
+      ifp_trace ("elf: '%s' is not a regular file", filename);
+      close (fd);
+      return NULL;
+    }
+
+  if (will_load)
+    posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+
+  image = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (image == MAP_FAILED)
+    {
+      ifp_trace ("elf: failed to map '%s'", filename);
+      return NULL;
+    }
+
+  *size = statbuf.st_size;
+  return image;
+}
+
+static void
+ifp_elf_unmap_file (void *image, size_t size)
+{
+  munmap (image, size);
+}
+
+
+/*
+ * ifp_elf_find_symbols()
+ *
+ * Look in the dynamic symbol table of a shared object file for each of the
+ * NULL-terminated list of names, and set the corresponding found flag for
+ * each defined there.  Returns FALSE if the file can't be read, or is not
+ * a native ELF shared object with a dynamic symbol table, in which case the
+ * found flags mean nothing.  As a side effect, starts reading the whole
+ * file into the page cache, in anticipation of it being loaded.
+ */
+int
+ifp_elf_find_symbols (const char *filename,
+                      const char *const names[], int found[])
+{
+  const ElfW(Sym) *symbols;
+  const char *strings;
+  size_t size, symbol_count, strings_size, index_;
+  void *image;
+  int entry, status;
+  assert (filename && names && found);
+
+  ifp_trace ("elf: ifp_elf_find_symbols <- '%s'", filename);
+
+  for (entry = 0; names[entry]; entry++)
+    found[entry] = FALSE;
+
+  image = ifp_elf_map_file (filename, TRUE, &size);
+  if (!image)
+    return FALSE;
+
+  status = ifp_elf_get_dynsym (image, size, &symbols, &symbol_count,
+                               &strings, &strings_size);
+  if (status)
+    {
+      /* Check each defined symbol's name against the names requested. */
+      for (index_ = 0; index_ < symbol_count; index_++)
+        {
+          const char *name;
+
+          if (symbols[index_].st_shndx == SHN_UNDEF)
+            continue;
+
+          name = ifp_elf_get_name (symbols + index_, strings, strings_size);
+          if (!name)
+            continue;
+
+          for (entry = 0; names[entry]; entry++)
+            {
+              if (!found[entry] && strcmp (name, names[entry]) == 0)
+                {
+                  found[entry] = TRUE;
+                  break;
+                }
+            }
+        }
+    }
+  ifp_elf_unmap_file (image, size);
+
+  ifp_trace ("elf: '%s' %s", filename,
+             status ? "symbols searched" : "is not a native shared object");
+  return status;
+}
+
+
+/*
+ * ifp_elf_visit_undefined()
+ *
+ * Call the visitor function once for each symbol that a shared object file
+ * needs from elsewhere, that is, each undefined dynamic symbol that is not
+ * weak.  Returns FALSE if the file can't be read, or is not a native ELF
+ * shared object with a dynamic symbol table, in which case the visitor is
+ * not called.  Names passed to the visitor are valid only for the duration
+ * of the call.
+ */
+int
+ifp_elf_visit_undefined (const char *filename,
+                         void (*visitor) (const char *, void *), void *data)
+{
+  const ElfW(Sym) *symbols;
+  const char *strings;
+  size_t size, symbol_count, strings_size, index_;
+  void *image;
+  int status;
+  assert (filename && visitor);
+
+  ifp_trace ("elf: ifp_elf_visit_undefined <- '%s'", filename);
+
+  image = ifp_elf_map_file (filename, TRUE, &size);
+  if (!image)
+    return FALSE;
+
+  status = ifp_elf_get_dynsym (image, size, &symbols, &symbol_count,
+                               &strings, &strings_size);
+  if (status)
+    {
+      /* Symbol zero is always the reserved null symbol, so skip it. */
+      for (index_ = 1; index_ < symbol_count; index_++)
+        {
+          const char *name;
+
+          if (symbols[index_].st_shndx != SHN_UNDEF
+              || ELF64_ST_BIND (symbols[index_].st_info) == STB_WEAK)
+            continue;
+
+          name = ifp_elf_get_name (symbols + index_, strings, strings_size);
+          if (name && name[0] != '\0')
+            visitor (name, data);
+        }
+    }
+  ifp_elf_unmap_file (image, size);
+
+  ifp_trace ("elf: '%s' %s", filename,
+             status ? "undefined symbols visited"
+                    : "is not a native shared object");
+  return status;
+}
+
+
+/*
+ * Relocation type that adds the load base to an addend, for the native
+ * machine.  Where unknown, header pointers can't be resolved from a file.
+ */
+#if defined(__x86_64__)
+#  define IFP_ELF_R_RELATIVE R_X86_64_RELATIVE
+#elif defined(__i386__)
+#  define IFP_ELF_R_RELATIVE R_386_RELATIVE
+#elif defined(__aarch64__)
+#  define IFP_ELF_R_RELATIVE R_AARCH64_RELATIVE
+#elif defined(__arm__)
+#  define IFP_ELF_R_RELATIVE R_ARM_RELATIVE
+#endif
+
+#if __ELF_NATIVE_CLASS == 64
+#  define IFP_ELF_R_TYPE(info) ELF64_R_TYPE (info)
+#else
+#  define IFP_ELF_R_TYPE(info) ELF32_R_TYPE (info)
+#endif
+
+/* Offsets of the string pointers in a plugin header. */
+static const size_t IFP_ELF_HEADER_STRINGS[] = {
+  offsetof (struct ifp_header, build_timestamp),
+  offsetof (struct ifp_header, engine_type),
+  offsetof (struct ifp_header, engine_name),
+  offsetof (struct ifp_header, engine_version),
+  offsetof (struct ifp_header, blorb_pattern),
+  offsetof (struct ifp_header, acceptor_pattern),
+  offsetof (struct ifp_header, author_name),
+  offsetof (struct ifp_header, author_email),
+  offsetof (struct ifp_header, engine_home_url),
+  offsetof (struct ifp_header, builder_name),
+  offsetof (struct ifp_header, builder_email),
+  offsetof (struct ifp_header, engine_description),
+  offsetof (struct ifp_header, engine_copyright)
+};
+enum { IFP_ELF_HEADER_STRING_COUNT = sizeof (IFP_ELF_HEADER_STRINGS)
+                                     / sizeof (IFP_ELF_HEADER_STRINGS[0]) };
+
+
+/*
+ * ifp_elf_get_file_offset()
+ *
+ * Convert a virtual address range in a mapped ELF image to a file offset,
+ * using the loadable segments.  Returns FALSE if the range does not lie
+ * wholly within the file data of one segment.
+ */
+static int
+ifp_elf_get_file_offset (const unsigned char *image, size_t size,
+                         ElfW(Addr) address, ElfW(Xword) length,
+                         ElfW(Off) *offset)
+{
+  const ElfW(Ehdr) *ehdr;
+  const ElfW(Phdr) *phdrs;
+  int segment;
+
+  ehdr = (const ElfW(Ehdr) *) image;
+  if (ehdr->e_phentsize != sizeof (ElfW(Phdr))
+      || !ifp_elf_in_bounds (size, ehdr->e_phoff,
+                             (ElfW(Xword)) ehdr->e_phnum
+                             * sizeof (ElfW(Phdr))))
+    return FALSE;
+
+  phdrs = (const ElfW(Phdr) *) (image + ehdr->e_phoff);
+  for (segment = 0; segment < ehdr->e_phnum; segment++)
+    {
+      const ElfW(Phdr) *phdr;
+
+      phdr = phdrs + segment;
+      if (phdr->p_type == PT_LOAD
+          && address >= phdr->p_vaddr
+          && address - phdr->p_vaddr <= phdr->p_filesz
+          && length <= phdr->p_filesz - (address - phdr->p_vaddr))
+        {
+          *offset = phdr->p_offset + (address - phdr->p_vaddr);
+          return ifp_elf_in_bounds (size, *offset, length);
+        }
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * ifp_elf_relocate_header()
+ *
+ * Apply to a copy of a plugin header the relocations that the dynamic
+ * linker would, given the header's address.  Only relative relocations
+ * are expected; with RELA, the addend replaces the pointer, and with REL
+ * or RELR the pointer already holds it.  Returns FALSE if the header has
+ * any other kind of relocation, which can't be resolved from the file.
+ */
+static int
+ifp_elf_relocate_header (const unsigned char *image, size_t size,
+                         ElfW(Addr) address, unsigned char *header)
+{
+  const ElfW(Ehdr) *ehdr;
+  const ElfW(Shdr) *shdrs;
+  int section;
+
+  ehdr = (const ElfW(Ehdr) *) image;
+  shdrs = (const ElfW(Shdr) *) (image + ehdr->e_shoff);
+  for (section = 0; section < ehdr->e_shnum; section++)
+    {
+      const ElfW(Shdr) *shdr;
+      size_t entry_size, count, index_;
+
+      shdr = shdrs + section;
+      if (shdr->sh_type != SHT_RELA && shdr->sh_type != SHT_REL)
+        continue;
+
+      entry_size = shdr->sh_type == SHT_RELA
+                   ? sizeof (ElfW(Rela)) : sizeof (ElfW(Rel));
+      if (shdr->sh_entsize != entry_size
+          || !ifp_elf_in_bounds (size, shdr->sh_offset, shdr->sh_size))
+        return FALSE;
+
+      count = shdr->sh_size / entry_size;
+      for (index_ = 0; index_ < count; index_++)
+        {
+          const ElfW(Rel) *relocation;
+          ElfW(Addr) field;
+
+          relocation = (const ElfW(Rel) *) (image + shdr->sh_offset
+                                            + index_ * entry_size);
+          if (relocation->r_offset < address
+              || relocation->r_offset >= address + sizeof (struct ifp_header))
+            continue;
+
+#if defined(IFP_ELF_R_RELATIVE)
+          if (IFP_ELF_R_TYPE (relocation->r_info) != IFP_ELF_R_RELATIVE)
+            return FALSE;
+#else
+          return FALSE;
+#endif
+
+          field = relocation->r_offset - address;
+          if (field + sizeof (ElfW(Addr)) > sizeof (struct ifp_header))
+            return FALSE;
+
+          if (shdr->sh_type == SHT_RELA)
+            {
+              ElfW(Addr) addend;
+
+              addend = ((const ElfW(Rela) *) relocation)->r_addend;
+              memcpy (header + field, &addend, sizeof (addend));
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+
+/*
+ * ifp_elf_read_header()
+ *
+ * Read a plugin's ifpi_header from its shared object file, without loading
+ * it.  The header is copied, with its string pointers set to strings in a
+ * single block, returned in strings, that the caller must free with
+ * ifp_free().  Returns FALSE if the file is not a native ELF shared object
+ * defining a header that can be read this way.
+ */
+int
+ifp_elf_read_header (const char *filename,
+                     struct ifp_header *header, char **strings)
+{
+  const ElfW(Sym) *symbols, *symbol;
+  const char *symbol_strings;
+  size_t size, symbol_count, strings_size, index_, total;
+  ElfW(Off) offset, string_offsets[IFP_ELF_HEADER_STRING_COUNT];
+  unsigned char raw[sizeof (struct ifp_header)];
+  void *image;
+  char *block;
+  int entry, status;
+  assert (filename && header && strings);
+
+  ifp_trace ("elf: ifp_elf_read_header <- '%s'", filename);
+
+  image = ifp_elf_map_file (filename, FALSE, &size);
+  if (!image)
+    return FALSE;
+
+  /* Find the header symbol, and copy the header from the file. */
+  symbol = NULL;
+  status = ifp_elf_get_dynsym (image, size, &symbols, &symbol_count,
+                               &symbol_strings, &strings_size);
+  for (index_ = 0; status && index_ < symbol_count; index_++)
+    {
+      const char *name;
+
+      if (symbols[index_].st_shndx == SHN_UNDEF)
+        continue;
+
+      name = ifp_elf_get_name (symbols + index_,
+                               symbol_strings, strings_size);
+      if (name && strcmp (name, "ifpi_header") == 0)
+        {
+          symbol = symbols + index_;
+          break;
+        }
+    }
+
+  status = symbol && symbol->st_size == sizeof (raw)
+           && ifp_elf_get_file_offset (image, size, symbol->st_value,
+                                       sizeof (raw), &offset);
+  if (status)
+    {
+      memcpy (raw, (unsigned char *) image + offset, sizeof (raw));
+      status = ifp_elf_relocate_header (image, size, symbol->st_value, raw);
+    }
+
+  /* Locate each string the header points to, and total their lengths. */
+  total = 0;
+  for (entry = 0; status && entry < IFP_ELF_HEADER_STRING_COUNT; entry++)
+    {
+      ElfW(Addr) address;
+      const char *string, *end;
+
+      memcpy (&address, raw + IFP_ELF_HEADER_STRINGS[entry], sizeof (address));
+      if (address == 0)
+        {
+          string_offsets[entry] = 0;
+          continue;
+        }
+
+      status = ifp_elf_get_file_offset (image, size, address, 1,
+                                        string_offsets + entry);
+      if (!status)
+        break;
+
+      /* Strings must end inside the image; a truncated file may cut one. */
+      string = (const char *) image + string_offsets[entry];
+      end = memchr (string, '\0', size - string_offsets[entry]);
+      status = end != NULL;
+      if (!status)
+        break;
+
+      total += end - string + 1;
+    }
+
+  /* Copy the header and its strings out of the image. */
+  if (status)
+    {
+      char *cursor;
+
+      memcpy (header, raw, sizeof (raw));
+      block = ifp_malloc (total > 0 ? total : 1);
+      cursor = block;
+      for (entry = 0; entry < IFP_ELF_HEADER_STRING_COUNT; entry++)
+        {
+          const char *string;
+
+          string = NULL;
+          if (string_offsets[entry] != 0)
+            {
+              strcpy (cursor, (const char *) image + string_offsets[entry]);
+              string = cursor;
+              cursor += strlen (cursor) + 1;
+            }
+          memcpy ((unsigned char *) header + IFP_ELF_HEADER_STRINGS[entry],
+                  &string, sizeof (string));
+        }
+      *strings = block;
+    }
+  ifp_elf_unmap_file (image, size);
+
+  ifp_trace ("elf: '%s' %s", filename,
+             status ? "header read" : "header not readable from file");
+  return status;
+}
@@ -27,6 +27,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_FINALIZER
+
 
 /* Forward declaration for the signal handler function. */
 static void ifp_finalizer_signal_catcher (int signum);
@@ -23,6 +23,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_GLKSTREAM
+
 
 /*
  * Duplication of the definition of a Glk internal function that is common to
@@ -26,6 +26,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_HEADER
+
 
 /**
  * ifp_plugin_engine_type()
@@ -204,40 +206,33 @@ ifp_plugin_is_equal (ifp_pluginref_t plugin, ifp_pluginref_t check)
 }
 
 
-/**
- * ifp_plugin_dissect_header()
+/*
+ * ifp_header_dissect()
  *
- * Return each header field to the caller individually.  Passing in a NULL
- * pointer indicates no interest in the field on the part of the caller.
+ * Return each field of a header to the caller individually.  Passing in a
+ * NULL pointer indicates no interest in the field on the part of the caller.
+ * Shared by plugins, and by entries in the plugin header index.
  */
 void
-ifp_plugin_dissect_header (ifp_pluginref_t plugin,
-                           int *version,
-                           const char **engine_type,
-                           const char **engine_name,
-                           const char **engine_version,
-                           const char **build_timestamp,
-                           const char **blorb_pattern,
-                           int *acceptor_offset,
-                           int *acceptor_length,
-                           const char **acceptor_pattern,
-                           const char **author_name,
-                           const char **author_email,
-                           const char **engine_home_url,
-                           const char **builder_name,
-                           const char **builder_email,
-                           const char **engine_description,
-                           const char **engine_copyright)
+ifp_header_dissect (ifp_headerref_t header,
+                    int *version,
+                    const char **engine_type,
+                    const char **engine_name,
+                    const char **engine_version,
+                    const char **build_timestamp,
+                    const char **blorb_pattern,
+                    int *acceptor_offset,
+                    int *acceptor_length,
+                    const char **acceptor_pattern,
+                    const char **author_name,
+                    const char **author_email,
+                    const char **engine_home_url,
+                    const char **builder_name,
+                    const char **builder_email,
+                    const char **engine_description,
+                    const char **engine_copyright)
 {
-  ifp_headerref_t header;
-  assert (ifp_plugin_is_valid (plugin));
-
-  header = ifp_plugin_get_header (plugin);
-  if (!header)
-    {
-      ifp_error ("header: failed to obtain plugin header");
-      return;
-    }
+  assert (header);
 
   if (version)
     *version = header->version;
@@ -272,3 +267,47 @@ ifp_plugin_dissect_header (ifp_pluginref_t plugin,
   if (engine_copyright)
     *engine_copyright = header->engine_copyright;
 }
+
+
+/**
+ * ifp_plugin_dissect_header()
+ *
+ * Return each header field to the caller individually.  Passing in a NULL
+ * pointer indicates no interest in the field on the part of the caller.
+ */
+void
+ifp_plugin_dissect_header (ifp_pluginref_t plugin,
+                           int *version,
+                           const char **engine_type,
+                           const char **engine_name,
+                           const char **engine_version,
+                           const char **build_timestamp,
+                           const char **blorb_pattern,
+                           int *acceptor_offset,
+                           int *acceptor_length,
+                           const char **acceptor_pattern,
+                           const char **author_name,
+                           const char **author_email,
+                           const char **engine_home_url,
+                           const char **builder_name,
+                           const char **builder_email,
+                           const char **engine_description,
+                           const char **engine_copyright)
+{
+  ifp_headerref_t header;
+  assert (ifp_plugin_is_valid (plugin));
+
+  header = ifp_plugin_get_header (plugin);
+  if (!header)
+    {
+      ifp_error ("header: failed to obtain plugin header");
+      return;
+    }
+
+  ifp_header_dissect (header, version, engine_type, engine_name,
+                      engine_version, build_timestamp, blorb_pattern,
+                      acceptor_offset, acceptor_length, acceptor_pattern,
+                      author_name, author_email, engine_home_url,
+                      builder_name, builder_email, engine_description,
+                      engine_copyright);
+}
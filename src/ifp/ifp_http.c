@@ -23,6 +23,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <signal.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -33,6 +34,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_HTTP
+
 /*
  * Record of current asynchronous work in progress, and pending SIGIO.  This
  * holds the active/inactive flag, the receiving file descriptor, the HTTP
@@ -165,15 +168,16 @@ ifp_http_sigio_handler (void)
  *
  * Called from the main poll handler for URLs.  If SIGIO was received, reads
  * as much data as is available and stores in the file used to collect
- * download data.
+ * download data.  A non-negative read limit caps the bytes read in this
+ * call, leaving the rest for later calls.
  */
 void
-ifp_http_poll_handler (void)
+ifp_http_poll_handler (int read_limit)
 {
   char buffer[4096];
-  int buflen, saved_errno;
+  int buflen, saved_errno, remaining;
 
-  ifp_trace ("http: ifp_http_poll_handler <- void");
+  ifp_trace ("http: ifp_http_poll_handler <- %d", read_limit);
 
   if (!ifp_current_http.is_active)
     {
@@ -191,11 +195,20 @@ ifp_http_poll_handler (void)
 
   /*
    * Transfer as much data as is available from the socket to the current
-   * open output file.  Save errno from this loop for later.
+   * open output file, up to any read limit.  If the limit stops the loop,
+   * buflen stays positive, so that the transfer counts as incomplete.  Save
+   * errno from this loop for later.
    */
-  buflen = read (ifp_current_http.http_socket, buffer, sizeof (buffer));
-  while (buflen > 0)
+  remaining = read_limit < 0 ? INT_MAX : read_limit;
+  buflen = 1;
+  while (remaining > 0)
     {
+      buflen = read (ifp_current_http.http_socket, buffer,
+                     remaining < (int) sizeof (buffer)
+                     ? remaining : (int) sizeof (buffer));
+      if (buflen <= 0)
+        break;
+
       if (write (ifp_current_http.fd, buffer, buflen) != buflen)
         {
           ifp_error ("http: write failed, download may be incomplete");
@@ -203,7 +216,7 @@ ifp_http_poll_handler (void)
         }
 
       ifp_current_http.bytes_transferred += buflen;
-      buflen = read (ifp_current_http.http_socket, buffer, sizeof (buffer));
+      remaining -= buflen;
     }
   saved_errno = errno;
 
@@ -0,0 +1,408 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2001-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "ifp.h"
+#include "ifp_internal.h"
+
+#define IFP_TRACE_FACILITY IFP_TRACE_INDEX
+
+/*
+ * The plugin header index lists the header of every plugin on a path, read
+ * straight from each shared object file, for callers that only want to show
+ * or match against plugin headers.  Unlike the loader, it neither dlopens
+ * nor maps any plugin for execution.  Entries are listed in the order the
+ * loader would find the plugins, and a plugin that duplicates the engine
+ * name and version of one listed earlier is left out, as the loader would.
+ * Entries are kept between searches, and a file unchanged since last read
+ * is not read again.
+ */
+static const char *DSO_EXTENSION = ".so",
+                  PATH_SEPARATOR = ':';
+
+/* Index entry definition, and list of entries. */
+struct ifp_index_entry
+{
+  char *filename;
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  struct timespec mtime;
+  struct ifp_header header;
+  char *strings;
+  ifp_index_entryref_t next;
+};
+
+static ifp_index_entryref_t ifp_index_head = NULL;
+
+
+/*
+ * ifp_index_destroy_entry()
+ *
+ * Free an index entry, and its strings.
+ */
+static void
+ifp_index_destroy_entry (ifp_index_entryref_t entry)
+{
+  ifp_free (entry->filename);
+  ifp_free (entry->strings);
+  ifp_free (entry);
+}
+
+
+/*
+ * ifp_index_take_entry()
+ *
+ * Remove and return the entry for a file from a list of entries, if the
+ * file is unchanged since the entry was read.  Returns NULL if none.
+ */
+static ifp_index_entryref_t
+ifp_index_take_entry (ifp_index_entryref_t *list,
+                      const char *filename, const struct stat *status)
+{
+  ifp_index_entryref_t *link;
+
+  for (link = list; *link; link = &(*link)->next)
+    {
+      ifp_index_entryref_t entry;
+
+      entry = *link;
+      if (strcmp (entry->filename, filename) == 0)
+        {
+          if (entry->device != status->st_dev
+              || entry->inode != status->st_ino
+              || entry->size != status->st_size
+              || entry->mtime.tv_sec != status->st_mtim.tv_sec
+              || entry->mtime.tv_nsec != status->st_mtim.tv_nsec)
+            return NULL;
+
+          *link = entry->next;
+          entry->next = NULL;
+          return entry;
+        }
+    }
+
+  return NULL;
+}
+
+
+/*
+ * ifp_index_read_entry()
+ *
+ * Create an index entry for a file by reading its plugin header.  Returns
+ * NULL if the file is not a plugin whose header can be read from the file,
+ * or whose header version does not match this library's.
+ */
+static ifp_index_entryref_t
+ifp_index_read_entry (const char *filename, const struct stat *status)
+{
+  ifp_index_entryref_t entry;
+  struct ifp_header header;
+  char *strings;
+
+  if (!ifp_plugin_verify_file (filename)
+      || !ifp_elf_read_header (filename, &header, &strings))
+    {
+      ifp_trace ("index: file '%s' has no readable plugin header", filename);
+      return NULL;
+    }
+
+  if (header.version != IFP_HEADER_VERSION
+      || !header.engine_name || !header.engine_version)
+    {
+      ifp_trace ("index: file '%s' has an unusable header", filename);
+      ifp_free (strings);
+      return NULL;
+    }
+
+  entry = ifp_malloc (sizeof (*entry));
+  entry->filename = ifp_malloc (strlen (filename) + 1);
+  strcpy (entry->filename, filename);
+  entry->device = status->st_dev;
+  entry->inode = status->st_ino;
+  entry->size = status->st_size;
+  entry->mtime = status->st_mtim;
+  entry->header = header;
+  entry->strings = strings;
+  entry->next = NULL;
+
+  return entry;
+}
+
+
+/*
+ * ifp_index_is_duplicate()
+ *
+ * Return TRUE if a list of entries already holds the engine of an entry.
+ */
+static int
+ifp_index_is_duplicate (ifp_index_entryref_t list, ifp_index_entryref_t entry)
+{
+  ifp_index_entryref_t check;
+
+  for (check = list; check; check = check->next)
+    {
+      if (strcmp (check->header.engine_name, entry->header.engine_name) == 0
+          && strcmp (check->header.engine_version,
+                     entry->header.engine_version) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * ifp_index_filter_plugins_directory()
+ * ifp_index_search_plugins_directory()
+ *
+ * Find each shared object file in a directory, and append an entry for each
+ * that is a plugin to the new list, reusing entries from the old list for
+ * files unchanged since read.  Returns the updated tail link of the new list.
+ */
+static int
+ifp_index_filter_plugins_directory (const struct dirent *entry)
+{
+  const char *extension;
+
+  extension = strrchr (entry->d_name, '.');
+  return extension && strcmp (extension, DSO_EXTENSION) == 0;
+}
+
+static ifp_index_entryref_t *
+ifp_index_search_plugins_directory (const char *directory_path,
+                                    ifp_index_entryref_t *old_list,
+                                    ifp_index_entryref_t *new_list,
+                                    ifp_index_entryref_t *tail)
+{
+  struct dirent **entries;
+  int filenames, index_;
+
+  filenames = scandir (directory_path, &entries,
+                       ifp_index_filter_plugins_directory, alphasort);
+  if (filenames == -1)
+    {
+      ifp_trace ("index: error scanning directory '%s'", directory_path);
+      return tail;
+    }
+
+  for (index_ = 0; index_ < filenames; index_++)
+    {
+      ifp_index_entryref_t entry;
+      struct stat status;
+      char *path;
+      int allocation;
+
+      allocation = strlen (directory_path)
+                   + strlen (entries[index_]->d_name) + 2;
+      path = ifp_malloc (allocation);
+      snprintf (path, allocation, "%s/%s",
+                directory_path, entries[index_]->d_name);
+
+      entry = NULL;
+      if (stat (path, &status) == 0 && S_ISREG (status.st_mode))
+        {
+          entry = ifp_index_take_entry (old_list, path, &status);
+          if (entry)
+            ifp_trace ("index: file '%s' unchanged", path);
+          else
+            entry = ifp_index_read_entry (path, &status);
+        }
+
+      if (entry && ifp_index_is_duplicate (*new_list, entry))
+        {
+          ifp_trace ("index: file '%s' duplicates an engine listed", path);
+          ifp_index_destroy_entry (entry);
+          entry = NULL;
+        }
+
+      if (entry)
+        {
+          *tail = entry;
+          tail = &entry->next;
+        }
+
+      ifp_free (path);
+      free (entries[index_]);
+    }
+  free (entries);
+
+  return tail;
+}
+
+
+/**
+ * ifp_index_search_plugins_path()
+ *
+ * Given a ':'-separated path of directories, rebuild the index from the
+ * header of each plugin found in those directories, without loading any.
+ * Returns the count of entries in the index.
+ */
+int
+ifp_index_search_plugins_path (const char *load_path)
+{
+  ifp_index_entryref_t old_list, new_list, *tail;
+  char **elements;
+  int count, index_;
+  assert (load_path);
+
+  ifp_trace ("index: ifp_index_search_plugins_path <- '%s'", load_path);
+
+  old_list = ifp_index_head;
+  new_list = NULL;
+  tail = &new_list;
+
+  count = ifp_split_string (load_path, PATH_SEPARATOR, &elements);
+  for (index_ = 0; index_ < count; index_++)
+    {
+      if (strlen (elements[index_]) > 0)
+        tail = ifp_index_search_plugins_directory (elements[index_],
+                                                   &old_list, &new_list,
+                                                   tail);
+    }
+  ifp_free_split_string (elements, count);
+
+  /* Anything left on the old list has gone, or changed and been re-read. */
+  while (old_list)
+    {
+      ifp_index_entryref_t next;
+
+      next = old_list->next;
+      ifp_index_destroy_entry (old_list);
+      old_list = next;
+    }
+
+  ifp_index_head = new_list;
+
+  count = ifp_index_count_entries ();
+  ifp_trace ("index: indexed %d plugins from path", count);
+  return count;
+}
+
+
+/**
+ * ifp_index_iterate_entries()
+ *
+ * Iterator for index entries.  Returns the first entry if called with
+ * NULL, otherwise the entry after the one given, or NULL at the end.
+ */
+ifp_index_entryref_t
+ifp_index_iterate_entries (ifp_index_entryref_t current)
+{
+  return current ? current->next : ifp_index_head;
+}
+
+
+/**
+ * ifp_index_count_entries()
+ *
+ * Return the count of entries in the index.
+ */
+int
+ifp_index_count_entries (void)
+{
+  ifp_index_entryref_t entry;
+  int count;
+
+  count = 0;
+  for (entry = ifp_index_head; entry; entry = entry->next)
+    count++;
+
+  return count;
+}
+
+
+/**
+ * ifp_index_get_filename()
+ *
+ * Return the path of the plugin file an index entry was read from.
+ */
+const char *
+ifp_index_get_filename (ifp_index_entryref_t entry)
+{
+  assert (entry);
+
+  return entry->filename;
+}
+
+
+/**
+ * ifp_index_dissect_entry()
+ *
+ * Return each header field of an index entry to the caller individually,
+ * as for ifp_plugin_dissect_header().  Strings remain valid until the
+ * entry changes on a later search, or the index is forgotten.
+ */
+void
+ifp_index_dissect_entry (ifp_index_entryref_t entry,
+                         int *version,
+                         const char **engine_type,
+                         const char **engine_name,
+                         const char **engine_version,
+                         const char **build_timestamp,
+                         const char **blorb_pattern,
+                         int *acceptor_offset,
+                         int *acceptor_length,
+                         const char **acceptor_pattern,
+                         const char **author_name,
+                         const char **author_email,
+                         const char **engine_home_url,
+                         const char **builder_name,
+                         const char **builder_email,
+                         const char **engine_description,
+                         const char **engine_copyright)
+{
+  assert (entry);
+
+  ifp_header_dissect (&entry->header, version, engine_type, engine_name,
+                      engine_version, build_timestamp, blorb_pattern,
+                      acceptor_offset, acceptor_length, acceptor_pattern,
+                      author_name, author_email, engine_home_url,
+                      builder_name, builder_email, engine_description,
+                      engine_copyright);
+}
+
+
+/**
+ * ifp_index_forget_all_entries()
+ *
+ * Empty the index, freeing all entries.
+ */
+void
+ifp_index_forget_all_entries (void)
+{
+  ifp_trace ("index: ifp_index_forget_all_entries <- void");
+
+  while (ifp_index_head)
+    {
+      ifp_index_entryref_t next;
+
+      next = ifp_index_head->next;
+      ifp_index_destroy_entry (ifp_index_head);
+      ifp_index_head = next;
+    }
+}
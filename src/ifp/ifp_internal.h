@@ -71,7 +71,7 @@ struct ifp_header
  * the program that loads the plugin can track what it uses, and garbage-
  * collect when the plugin completes.
  */
-enum { IFP_LIBC_VERSION = 0x00000400 };
+enum { IFP_LIBC_VERSION = 0x00000500 };
 struct ifp_libc_interface
 {
   int version;
@@ -80,12 +80,20 @@ struct ifp_libc_interface
   void *(*calloc) (size_t, size_t);
   void *(*realloc) (void *, size_t);
   char *(*strdup) (const char *);
+  char *(*strndup) (const char *, size_t);
   char *(*getcwd) (char *, size_t);
   int (*scandir) (const char *, struct dirent ***,
                   int (*) (const struct dirent *),
                   int (*) (const struct dirent **, const struct dirent **));
   void (*free) (void *);
 
+  int (*posix_memalign) (void **, size_t, size_t);
+  void *(*aligned_alloc) (size_t, size_t);
+  void *(*memalign) (size_t, size_t);
+  void *(*valloc) (size_t);
+  void *(*mmap) (void *, size_t, int, int, int, off_t);
+  int (*munmap) (void *, size_t);
+
   int (*open_2) (const char *, int);
   int (*open_3) (const char *, int, mode_t);
   int (*close) (int);
@@ -110,6 +118,7 @@ extern void *ifp_libc_intercept_malloc (size_t size);
 extern void *ifp_libc_intercept_calloc (size_t nmemb, size_t size);
 extern void *ifp_libc_intercept_realloc (void *ptr, size_t size);
 extern char *ifp_libc_intercept_strdup (const char *s);
+extern char *ifp_libc_intercept_strndup (const char *s, size_t n);
 extern char *ifp_libc_intercept_getcwd (char *buf, size_t size);
 extern int ifp_libc_intercept_scandir (const char *dir,
                                        struct dirent ***namelist,
@@ -117,6 +126,16 @@ extern int ifp_libc_intercept_scandir (const char *dir,
                                        int (*compar_) (const void *,
                                                        const void *));
 extern void ifp_libc_intercept_free (void *ptr);
+extern int ifp_libc_intercept_posix_memalign (void **memptr,
+                                              size_t alignment, size_t size);
+extern void *ifp_libc_intercept_aligned_alloc (size_t alignment,
+                                               size_t size);
+extern void *ifp_libc_intercept_memalign (size_t alignment, size_t size);
+extern void *ifp_libc_intercept_valloc (size_t size);
+extern void *ifp_libc_intercept_mmap (void *start, size_t length,
+                                      int prot, int flags,
+                                      int fd, off_t offset);
+extern int ifp_libc_intercept_munmap (void *start, size_t length);
 
 extern int ifp_libc_intercept_open_2 (const char *pathname, int flags);
 extern int ifp_libc_intercept_open_3 (const char *pathname,
@@ -385,6 +404,7 @@ extern void ifpi_initializer (void);
 extern void ifpi_finalizer (void);
 extern int ifpi_attach_glk_interface (ifp_glk_interfaceref_t interface);
 extern ifp_glk_interfaceref_t ifpi_retrieve_glk_interface (void);
+extern void ifpi_glk_flush_output (void);
 extern int ifpi_attach_libc_interface (ifp_libc_interfaceref_t interface);
 extern ifp_libc_interfaceref_t ifpi_retrieve_libc_interface (void);
 extern void ifpi_chain_set_plugin_self (ifp_pluginref_t plugin);
@@ -395,9 +415,59 @@ extern int ifpi_glkunix_startup_code (glkunix_startup_t *startdata);
 extern void ifpi_glk_main (void);
 extern void ifpi_force_link (void);
 
+/*
+ * Trace facilities, one per module.  A module defines IFP_TRACE_FACILITY
+ * as its facility, and ifp_trace() then costs a single test of that
+ * facility's bit in the trace mask while tracing is off, without evaluating
+ * its arguments.  Defining IFP_NO_TRACE compiles tracing out altogether.
+ * Facility names, as given in trace selectors, are listed in ifp_tracer.c,
+ * in the same order.
+ */
+enum ifp_trace_facility
+{
+  IFP_TRACE_BLORB, IFP_TRACE_CACHE, IFP_TRACE_CHAIN, IFP_TRACE_CONFIG,
+  IFP_TRACE_ELF, IFP_TRACE_FILE, IFP_TRACE_FINALIZER, IFP_TRACE_FTP,
+  IFP_TRACE_GLKLOADER, IFP_TRACE_GLKPROFILE, IFP_TRACE_GLKRECORD,
+  IFP_TRACE_GLKSTREAM, IFP_TRACE_HEADER, IFP_TRACE_HTTP, IFP_TRACE_INDEX,
+  IFP_TRACE_LIBC, IFP_TRACE_LOADER, IFP_TRACE_MAIN, IFP_TRACE_MANAGER,
+  IFP_TRACE_MEMORY, IFP_TRACE_PLUGIN, IFP_TRACE_PREFERENCES,
+  IFP_TRACE_RECOGNIZER, IFP_TRACE_TIMING, IFP_TRACE_UNARCHIVE,
+  IFP_TRACE_UNCOMPRESS, IFP_TRACE_URL, IFP_TRACE_UTIL,
+  IFP_TRACE_FACILITIES
+};
+
+extern unsigned int ifp_trace_mask;
+
+#ifndef IFP_NO_TRACE
+#define ifp_trace(...)                                                      \
+  do {                                                                      \
+    if (__builtin_expect (ifp_trace_mask & (1u << IFP_TRACE_FACILITY), 0))  \
+      ifp_trace_message (IFP_TRACE_FACILITY, __VA_ARGS__);                  \
+  } while (0)
+#else
+#define ifp_trace(...)                                                      \
+  do {                                                                      \
+    if (0)                                                                  \
+      ifp_trace_message (IFP_TRACE_FACILITY, __VA_ARGS__);                  \
+  } while (0)
+#endif
+
+/*
+ * Timed startup phases.  Phase names, as reported, are listed in
+ * ifp_timing.c, in the same order.
+ */
+enum ifp_timing_phase
+{
+  IFP_TIMING_CONFIG_READ, IFP_TIMING_GLK_LOAD, IFP_TIMING_PLUGIN_SEARCH,
+  IFP_TIMING_PLUGIN_LOAD, IFP_TIMING_URL_RESOLVE, IFP_TIMING_RECOGNIZE,
+  IFP_TIMING_PLUGIN_COMPLETE, IFP_TIMING_CLONE, IFP_TIMING_GLK_RESET,
+  IFP_TIMING_GARBAGE_COLLECT, IFP_TIMING_PLUGIN_INITIALIZE,
+  IFP_TIMING_PHASES
+};
+
 /* Internal-only interfaces. */
-extern void ifp_trace (const char *format, ...)
-    __attribute__ ((format (printf, 1, 2)));
+extern void ifp_trace_message (int facility, const char *format, ...)
+    __attribute__ ((format (printf, 2, 3)));
 extern void ifp_notice (const char *format, ...)
     __attribute__ ((format (printf, 1, 2)));
 extern void ifp_error (const char *format, ...)
@@ -406,13 +476,26 @@ extern void ifp_fatal (const char *format, ...)
     __attribute__ ((format (printf, 1, 2)))
     __attribute__ ((noreturn));
 extern const void *ifp_trace_pointer (const void *pointer);
+extern unsigned long long ifp_timing_start (void);
+extern void ifp_timing_stop (int phase, unsigned long long start);
 
 extern void ifp_config_read (void);
 extern void ifp_main_set_glk_libraries (const char *glk_libraries);
 extern int ifp_glk_load_interface (const char *filename);
 extern int ifp_glk_verify_dso (const char *filename);
 extern void *ifp_glk_get_main (void);
+extern void ifp_glk_refresh_interface (ifp_glk_interfaceref_t wrapper,
+                                       ifp_glk_interfaceref_t snapshot,
+                                       ifp_glk_interfaceref_t wrapped);
 extern void ifp_glk_unload_interface (void);
+extern ifp_glk_interfaceref_t ifp_glk_profile_get_interface
+    (ifp_glk_interfaceref_t glk_interface);
+extern void ifp_glk_profile_set_observer
+    (void (*observer) (int, unsigned long long));
+extern int ifp_glk_profile_find_function (const char *name);
+extern ifp_glk_interfaceref_t ifp_glk_record_get_interface
+    (ifp_glk_interfaceref_t glk_interface);
+extern void ifp_glk_record_finalize (void);
 
 extern void ifp_plugin_set_next (ifp_pluginref_t plugin,
                                  ifp_pluginref_t next);
@@ -421,9 +504,31 @@ extern void ifp_plugin_set_prior (ifp_pluginref_t plugin,
                                   ifp_pluginref_t prior);
 extern ifp_pluginref_t ifp_plugin_get_prior (ifp_pluginref_t plugin);
 extern void ifp_plugin_force_unload (ifp_pluginref_t plugin);
+extern int ifp_plugin_verify_file (const char *filename);
+extern int ifp_elf_find_symbols (const char *filename,
+                                 const char *const names[], int found[]);
+extern int ifp_elf_visit_undefined (const char *filename,
+                                    void (*visitor) (const char *, void *),
+                                    void *data);
+extern int ifp_elf_read_header (const char *filename,
+                                struct ifp_header *header, char **strings);
+extern void ifp_plugin_check_heap_usage (size_t current);
+extern void ifp_plugin_check_file_usage (int current);
+extern int ifp_memory_malloc_get_class_counts (unsigned long *counts,
+                                               int length);
+extern void ifp_file_get_usage (int *files, int *streams);
 
 typedef struct ifp_header *ifp_headerref_t;
 extern ifp_headerref_t ifp_plugin_get_header (ifp_pluginref_t plugin);
+extern void ifp_header_dissect (ifp_headerref_t header, int *version,
+                const char **engine_type, const char **engine_name,
+                const char **engine_version, const char **build_timestamp,
+                const char **blorb_pattern, int *acceptor_offset,
+                int *acceptor_length, const char **acceptor_pattern,
+                const char **author_name, const char **author_email,
+                const char **engine_home_url, const char **builder_name,
+                const char **builder_email, const char **engine_description,
+                const char **engine_copyright);
 
 extern void ifp_self_set_plugin (ifp_pluginref_t plugin);
 extern ifp_pluginref_t ifp_self (void);
@@ -438,13 +543,13 @@ extern void ifp_cache_release_entry (const char *url_path);
 extern void ifp_cache_remove_entry (const char *url_path);
 extern int  ifp_cache_add_entry (const char *url_path, const char *data_file);
 extern void ifp_http_sigio_handler (void);
-extern void ifp_http_poll_handler (void);
+extern void ifp_http_poll_handler (int read_limit);
 extern void ifp_http_cancel_download (void);
 extern int  ifp_http_download (int tofd, const char *host,
                                int port, const char *document, int *progress,
                                int *status);
 extern void ifp_ftp_sigio_handler (void);
-extern void ifp_ftp_poll_handler (void);
+extern void ifp_ftp_poll_handler (int read_limit);
 extern void ifp_ftp_cancel_download (void);
 extern int  ifp_ftp_download (int tofd, const char *host,
                               int port, const char *document, int *progress,
@@ -454,6 +559,7 @@ extern strid_t ifp_glkstream_open_pathname (char *pathname,
                                             glui32 textmode, glui32 rock);
 extern void ifp_glkstream_close (strid_t glk_stream, stream_result_t *result);
 extern void *ifp_dlopen (const char *filename);
+extern void *ifp_dlopen_lazy (const char *filename);
 extern const char *ifp_dlerror (void);
 extern void *ifp_dlsym (void *handle, const char *symbol);
 extern int  ifp_dlclose (void *handle);
@@ -20,7 +20,10 @@
 
 #include <assert.h>
 #include <sys/types.h>
+#include <sys/inotify.h>
 #include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
 #include <string.h>
 #include <limits.h>
 #include <stdlib.h>
@@ -30,6 +33,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_LOADER
+
 
 /* Temporary file template, DSO extension, and path separator. */
 static const char *TMPFILE_TEMPLATE = "/tmp/ifp_so_XXXXXX",
@@ -40,6 +45,273 @@ static const char *TMPFILE_TEMPLATE = "/tmp/ifp_so_XXXXXX",
 static ifp_pluginref_t ifp_plugins_head = NULL,
                        ifp_plugins_tail = NULL;
 
+/*
+ * Indexes of the plugins list, one by plugin filename and one by engine
+ * name and version.  Each is an open-addressed hash table of plugins, using
+ * linear probing, with tombstones left by removals.  A key may appear more
+ * than once, as a plugin and its clone are briefly listed together, so
+ * removal looks for the plugin itself rather than its key.  Table size is
+ * always a power of two.
+ */
+struct ifp_plugin_table
+{
+  ifp_pluginref_t *slots;
+  int size;
+  int count;
+  int used;
+  int is_by_engine;
+};
+typedef struct ifp_plugin_table *ifp_plugin_tableref_t;
+
+static struct ifp_plugin_table ifp_plugins_by_filename =
+                                 { NULL, 0, 0, 0, FALSE },
+                               ifp_plugins_by_engine =
+                                 { NULL, 0, 0, 0, TRUE };
+
+/* Marker for a removed plugin table slot. */
+static char ifp_plugin_tombstone_marker;
+#define PLUGIN_TOMBSTONE ((ifp_pluginref_t) &ifp_plugin_tombstone_marker)
+
+/* Initial plugin table size, and FNV-1a string hash constants. */
+enum { PLUGIN_TABLE_INITIAL_SIZE = 32 };
+static const glui32 FNV_OFFSET_BASIS = 2166136261u,
+                    FNV_PRIME = 16777619u;
+
+/*
+ * Plugin directories watched for changes.  The first search of a directory
+ * adds an inotify watch on it, then scans it in full.  Later searches read
+ * any pending inotify events, forget plugins whose files were removed or
+ * replaced, and load only the files that were added, replaced, or whose
+ * plugins were forgotten since.  A directory whose watch is lost, or whose
+ * events overflow the inotify queue, is scanned in full again on its next
+ * search.  Without inotify, or inside a chaining plugin, every search is a
+ * full scan.
+ */
+struct ifp_loader_watch
+{
+  char *directory;
+  int descriptor;
+  int is_scanned;
+  char **pending;
+  int pending_count;
+  int pending_allocation;
+};
+typedef struct ifp_loader_watch *ifp_loader_watchref_t;
+
+static ifp_loader_watchref_t ifp_loader_watches = NULL;
+static int ifp_loader_watch_count = 0,
+           ifp_loader_inotify = -1;
+
+/*
+ * Verification of candidate plugin files found by a directory scan.  Each
+ * file's symbol table is checked on a pool of worker threads, which take
+ * files from a shared index, before the files that pass are loaded, in
+ * order, on the calling thread.  Dlopen holds a process-wide lock while it
+ * maps and relocates, so loading itself gains nothing from threads.
+ */
+enum { VERIFY_MAX_WORKERS = 16 };
+
+struct ifp_loader_verify_job
+{
+  char **paths;
+  int *verdicts;
+  int count;
+  int next;
+};
+
+/* Inotify events of interest on a plugin directory. */
+static const glui32 WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE
+                                   | IN_MOVED_FROM | IN_DELETE_SELF
+                                   | IN_MOVE_SELF | IN_ONLYDIR;
+
+
+/*
+ * ifp_loader_table_key()
+ * ifp_loader_table_hash()
+ * ifp_loader_table_find_slot()
+ * ifp_loader_table_rebuild()
+ *
+ * Return the key strings of a plugin for a table; the second is NULL for
+ * the filename table.  Hash a key into a table, locate the slot holding a
+ * plugin with a key (or, if plugin is given, holding that plugin), or else
+ * the slot where it should be inserted, and rebuild a table to a new size,
+ * discarding tombstones.
+ */
+static void
+ifp_loader_table_key (ifp_plugin_tableref_t table, ifp_pluginref_t plugin,
+                      const char **first, const char **second)
+{
+  if (table->is_by_engine)
+    {
+      *first = ifp_plugin_engine_name (plugin);
+      *second = ifp_plugin_engine_version (plugin);
+    }
+  else
+    {
+      *first = ifp_plugin_get_filename (plugin);
+      *second = NULL;
+    }
+}
+
+static int
+ifp_loader_table_hash (ifp_plugin_tableref_t table,
+                       const char *first, const char *second)
+{
+  glui32 hash;
+  const char *cursor;
+
+  hash = FNV_OFFSET_BASIS;
+  for (cursor = first; *cursor; cursor++)
+    hash = (hash ^ (unsigned char) *cursor) * FNV_PRIME;
+
+  if (second)
+    {
+      hash = (hash ^ '/') * FNV_PRIME;
+      for (cursor = second; *cursor; cursor++)
+        hash = (hash ^ (unsigned char) *cursor) * FNV_PRIME;
+    }
+
+  return (int) (hash & (table->size - 1));
+}
+
+static int
+ifp_loader_table_find_slot (ifp_plugin_tableref_t table,
+                            const char *first, const char *second,
+                            ifp_pluginref_t plugin)
+{
+  int slot, tombstone;
+
+  tombstone = -1;
+  for (slot = ifp_loader_table_hash (table, first, second);
+       table->slots[slot]; slot = (slot + 1) & (table->size - 1))
+    {
+      ifp_pluginref_t entry;
+
+      entry = table->slots[slot];
+      if (entry == PLUGIN_TOMBSTONE)
+        {
+          if (tombstone == -1)
+            tombstone = slot;
+        }
+      else if (plugin)
+        {
+          if (entry == plugin)
+            return slot;
+        }
+      else
+        {
+          const char *entry_first, *entry_second;
+
+          ifp_loader_table_key (table, entry, &entry_first, &entry_second);
+          if (strcmp (entry_first, first) == 0
+              && (!second || strcmp (entry_second, second) == 0))
+            return slot;
+        }
+    }
+
+  return tombstone != -1 ? tombstone : slot;
+}
+
+static void
+ifp_loader_table_rebuild (ifp_plugin_tableref_t table, int size)
+{
+  ifp_pluginref_t *slots;
+  int old_size, index_;
+
+  slots = table->slots;
+  old_size = table->size;
+
+  table->slots = ifp_malloc (size * sizeof (*slots));
+  memset (table->slots, 0, size * sizeof (*slots));
+  table->size = size;
+  table->used = table->count;
+
+  for (index_ = 0; index_ < old_size; index_++)
+    {
+      if (slots[index_] && slots[index_] != PLUGIN_TOMBSTONE)
+        {
+          const char *first, *second;
+          int slot;
+
+          ifp_loader_table_key (table, slots[index_], &first, &second);
+          slot = ifp_loader_table_find_slot (table,
+                                             first, second, slots[index_]);
+          table->slots[slot] = slots[index_];
+        }
+    }
+
+  ifp_free (slots);
+  ifp_trace ("loader: plugin table rebuilt with %d slots", size);
+}
+
+
+/*
+ * ifp_loader_table_insert()
+ * ifp_loader_table_remove()
+ * ifp_loader_table_lookup()
+ *
+ * Add and remove plugins to/from a plugin table, and find a plugin in a
+ * table by key.  Removing a plugin not in the table is not an error.
+ */
+static void
+ifp_loader_table_insert (ifp_plugin_tableref_t table, ifp_pluginref_t plugin)
+{
+  const char *first, *second;
+  int slot;
+
+  /* Grow the table (or clear tombstones) if over half full. */
+  if (2 * (table->used + 1) > table->size)
+    {
+      int size;
+
+      size = table->size > 0 ? table->size : PLUGIN_TABLE_INITIAL_SIZE;
+      while (2 * (table->count + 1) > size / 2)
+        size *= 2;
+      ifp_loader_table_rebuild (table, size);
+    }
+
+  ifp_loader_table_key (table, plugin, &first, &second);
+  slot = ifp_loader_table_find_slot (table, first, second, plugin);
+  if (table->slots[slot] == plugin)
+    return;
+
+  if (!table->slots[slot])
+    table->used++;
+  table->slots[slot] = plugin;
+  table->count++;
+}
+
+static void
+ifp_loader_table_remove (ifp_plugin_tableref_t table, ifp_pluginref_t plugin)
+{
+  const char *first, *second;
+  int slot;
+
+  if (table->count == 0)
+    return;
+
+  ifp_loader_table_key (table, plugin, &first, &second);
+  slot = ifp_loader_table_find_slot (table, first, second, plugin);
+  if (table->slots[slot] != plugin)
+    return;
+
+  table->slots[slot] = PLUGIN_TOMBSTONE;
+  table->count--;
+}
+
+static ifp_pluginref_t
+ifp_loader_table_lookup (ifp_plugin_tableref_t table,
+                         const char *first, const char *second)
+{
+  int slot;
+
+  if (table->count == 0)
+    return NULL;
+
+  slot = ifp_loader_table_find_slot (table, first, second, NULL);
+  return table->slots[slot] != PLUGIN_TOMBSTONE ? table->slots[slot] : NULL;
+}
+
 
 /*
  * ifp_loader_delete_plugin()
@@ -70,6 +342,9 @@ ifp_loader_delete_plugin (ifp_pluginref_t plugin)
     ifp_plugins_tail = ifp_plugin_get_prior (plugin);
   if (plugin == ifp_plugins_head)
     ifp_plugins_head = ifp_plugin_get_next (plugin);
+
+  ifp_loader_table_remove (&ifp_plugins_by_filename, plugin);
+  ifp_loader_table_remove (&ifp_plugins_by_engine, plugin);
 }
 
 
@@ -95,6 +370,9 @@ ifp_loader_add_plugin (ifp_pluginref_t plugin)
       ifp_plugin_set_next (ifp_plugins_tail, plugin);
       ifp_plugins_tail = plugin;
     }
+
+  ifp_loader_table_insert (&ifp_plugins_by_filename, plugin);
+  ifp_loader_table_insert (&ifp_plugins_by_engine, plugin);
 }
 
 
@@ -121,15 +399,32 @@ ifp_loader_iterate_plugins (ifp_pluginref_t current)
 int
 ifp_loader_count_plugins (void)
 {
-  ifp_pluginref_t plugin;
-  int count;
+  return ifp_plugins_by_filename.count;
+}
 
-  count = 0;
-  for (plugin = ifp_plugins_head;
-       plugin; plugin = ifp_plugin_get_next (plugin))
-    count++;
 
-  return count;
+/**
+ * ifp_loader_find_plugin()
+ * ifp_loader_find_engine()
+ *
+ * Return the listed plugin loaded from the given file, or the listed plugin
+ * with the given engine name and version, or NULL if none is listed.
+ */
+ifp_pluginref_t
+ifp_loader_find_plugin (const char *filename)
+{
+  assert (filename);
+
+  return ifp_loader_table_lookup (&ifp_plugins_by_filename, filename, NULL);
+}
+
+ifp_pluginref_t
+ifp_loader_find_engine (const char *engine_name, const char *engine_version)
+{
+  assert (engine_name && engine_version);
+
+  return ifp_loader_table_lookup (&ifp_plugins_by_engine,
+                                  engine_name, engine_version);
 }
 
 
@@ -299,19 +594,15 @@ ifp_loader_replace_with_clone (ifp_pluginref_t plugin)
 ifp_pluginref_t
 ifp_loader_load_plugin (const char *filename)
 {
-  ifp_pluginref_t plugin, cursor;
+  ifp_pluginref_t plugin, duplicate;
 
   ifp_trace ("loader: ifp_loader_load_plugin <- '%s'", filename);
 
   /* Search for this filename in already loaded plugins. */
-  for (cursor = ifp_plugins_head;
-       cursor; cursor = ifp_plugin_get_next (cursor))
+  if (ifp_loader_find_plugin (filename))
     {
-      if (strcmp (filename, ifp_plugin_get_filename (cursor)) == 0)
-        {
-          ifp_trace ("loader: file '%s' already listed", filename);
-          return NULL;
-        }
+      ifp_trace ("loader: file '%s' already listed", filename);
+      return NULL;
     }
 
   /* Create and load a new plugin for this file to inhabit. */
@@ -326,18 +617,16 @@ ifp_loader_load_plugin (const char *filename)
    * Now see if this is a different file path, but still duplicates an
    * existing plugin.  If duplicate, refuse to add and return fail status.
    */
-  for (cursor = ifp_plugins_head;
-       cursor; cursor = ifp_plugin_get_next (cursor))
+  duplicate = ifp_loader_find_engine (ifp_plugin_engine_name (plugin),
+                                      ifp_plugin_engine_version (plugin));
+  if (duplicate)
     {
-      if (ifp_plugin_is_equal (plugin, cursor))
-        {
-          ifp_trace ("loader:"
-                     " plugin_%p is a duplicate of plugin_%p",
-                     ifp_trace_pointer (plugin), ifp_trace_pointer (cursor));
-          ifp_plugin_unload (plugin);
-          ifp_plugin_destroy (plugin);
-          return NULL;
-        }
+      ifp_trace ("loader:"
+                 " plugin_%p is a duplicate of plugin_%p",
+                 ifp_trace_pointer (plugin), ifp_trace_pointer (duplicate));
+      ifp_plugin_unload (plugin);
+      ifp_plugin_destroy (plugin);
+      return NULL;
     }
 
   /* Loaded okay, and distinct - add to the list and return. */
@@ -348,6 +637,385 @@ ifp_loader_load_plugin (const char *filename)
 }
 
 
+/*
+ * ifp_loader_reap_plugin()
+ *
+ * Remove from the list, unload, and destroy the given plugin.  Returns
+ * FALSE, and leaves the plugin untouched, if it is active.
+ */
+static int
+ifp_loader_reap_plugin (ifp_pluginref_t plugin)
+{
+  /*
+   * If the plugin is active, something has gone wrong.  This function should
+   * not be called until a running plugin has completed execution.
+   */
+  if (!ifp_plugin_is_unloadable (plugin))
+    {
+      ifp_error ("loader: attempt to reap an active plugin");
+      return FALSE;
+    }
+
+  /*
+   * Delete the plugin from the loader's list, unload it to finalize anything
+   * in it, then finally destroy it.
+   */
+  ifp_loader_delete_plugin (plugin);
+  ifp_plugin_unload (plugin);
+  ifp_plugin_destroy (plugin);
+  return TRUE;
+}
+
+
+/*
+ * ifp_loader_find_watch()
+ * ifp_loader_find_watch_for_file()
+ *
+ * Return the watch for a directory, or for the directory holding a file,
+ * or NULL if the directory has no watch.
+ */
+static ifp_loader_watchref_t
+ifp_loader_find_watch (const char *directory_path)
+{
+  int index_;
+
+  for (index_ = 0; index_ < ifp_loader_watch_count; index_++)
+    {
+      if (strcmp (ifp_loader_watches[index_].directory, directory_path) == 0)
+        return ifp_loader_watches + index_;
+    }
+
+  return NULL;
+}
+
+static ifp_loader_watchref_t
+ifp_loader_find_watch_for_file (const char *filename)
+{
+  int index_;
+
+  for (index_ = 0; index_ < ifp_loader_watch_count; index_++)
+    {
+      const char *directory;
+      int length;
+
+      directory = ifp_loader_watches[index_].directory;
+      length = strlen (directory);
+      if (strncmp (filename, directory, length) == 0
+          && filename[length] == '/'
+          && !strchr (filename + length + 1, '/'))
+        return ifp_loader_watches + index_;
+    }
+
+  return NULL;
+}
+
+
+/*
+ * ifp_loader_add_pending()
+ * ifp_loader_clear_pending()
+ *
+ * Note a plugin file in a watched directory as needing to be loaded on the
+ * directory's next search, and discard all such notes for a directory.
+ */
+static void
+ifp_loader_add_pending (ifp_loader_watchref_t watch, const char *filename)
+{
+  int index_;
+
+  for (index_ = 0; index_ < watch->pending_count; index_++)
+    {
+      if (strcmp (watch->pending[index_], filename) == 0)
+        return;
+    }
+
+  if (watch->pending_count == watch->pending_allocation)
+    {
+      watch->pending_allocation = watch->pending_allocation == 0
+                                  ? 4 : watch->pending_allocation * 2;
+      watch->pending = ifp_realloc (watch->pending,
+                                    watch->pending_allocation
+                                    * sizeof (*watch->pending));
+    }
+
+  watch->pending[watch->pending_count] = ifp_malloc (strlen (filename) + 1);
+  strcpy (watch->pending[watch->pending_count++], filename);
+
+  ifp_trace ("loader: file '%s' is pending load", filename);
+}
+
+static void
+ifp_loader_clear_pending (ifp_loader_watchref_t watch)
+{
+  int index_;
+
+  for (index_ = 0; index_ < watch->pending_count; index_++)
+    ifp_free (watch->pending[index_]);
+  watch->pending_count = 0;
+}
+
+
+/*
+ * ifp_loader_get_watch()
+ *
+ * Return the watch for a directory, creating it and adding an inotify watch
+ * for the directory if necessary, and re-adding a lost inotify watch.  If
+ * inotify is not available, or we are inside a chaining plugin, whose
+ * loader copy is discarded with it, return NULL.
+ */
+static ifp_loader_watchref_t
+ifp_loader_get_watch (const char *directory_path)
+{
+  static int initialized = FALSE;
+  ifp_loader_watchref_t watch;
+
+  if (!initialized)
+    {
+      if (!ifp_self_inside_plugin ())
+        {
+          ifp_loader_inotify = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+          if (ifp_loader_inotify == -1)
+            ifp_trace ("loader: inotify unavailable, errno %d", errno);
+        }
+      initialized = TRUE;
+    }
+
+  if (ifp_loader_inotify == -1)
+    return NULL;
+
+  watch = ifp_loader_find_watch (directory_path);
+  if (!watch)
+    {
+      ifp_loader_watches = ifp_realloc (ifp_loader_watches,
+                                        (ifp_loader_watch_count + 1)
+                                        * sizeof (*ifp_loader_watches));
+      watch = ifp_loader_watches + ifp_loader_watch_count++;
+
+      memset (watch, 0, sizeof (*watch));
+      watch->directory = ifp_malloc (strlen (directory_path) + 1);
+      strcpy (watch->directory, directory_path);
+      watch->descriptor = -1;
+    }
+
+  /*
+   * Add the inotify watch before any scan, so that no change made after
+   * the scan goes unseen.
+   */
+  if (watch->descriptor == -1)
+    {
+      watch->descriptor = inotify_add_watch (ifp_loader_inotify,
+                                             directory_path, WATCH_EVENTS);
+      watch->is_scanned = FALSE;
+      if (watch->descriptor == -1)
+        ifp_trace ("loader: can't watch directory '%s', errno %d",
+                   directory_path, errno);
+      else
+        ifp_trace ("loader: watching directory '%s'", directory_path);
+    }
+
+  return watch;
+}
+
+
+/*
+ * ifp_loader_handle_event()
+ * ifp_loader_read_events()
+ *
+ * Apply a single inotify event to the plugins list and pending files, and
+ * read and apply all queued inotify events.  Removed and replaced plugin
+ * files have their plugins forgotten, and added and replaced ones are noted
+ * as pending load.  A plugin that is active is left alone; if its file was
+ * replaced, the new file loads on a later search once it is forgotten.
+ */
+static void
+ifp_loader_handle_event (const struct inotify_event *event)
+{
+  ifp_loader_watchref_t watch;
+  const char *extension;
+  ifp_pluginref_t plugin;
+  char *path;
+  int index_, allocation;
+
+  if (event->mask & IN_Q_OVERFLOW)
+    {
+      ifp_trace ("loader: inotify queue overflowed");
+      for (index_ = 0; index_ < ifp_loader_watch_count; index_++)
+        ifp_loader_watches[index_].is_scanned = FALSE;
+      return;
+    }
+
+  watch = NULL;
+  for (index_ = 0; index_ < ifp_loader_watch_count; index_++)
+    {
+      if (ifp_loader_watches[index_].descriptor == event->wd)
+        {
+          watch = ifp_loader_watches + index_;
+          break;
+        }
+    }
+  if (!watch)
+    return;
+
+  if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+    {
+      ifp_trace ("loader: lost watch on directory '%s'", watch->directory);
+      if (!(event->mask & IN_IGNORED))
+        inotify_rm_watch (ifp_loader_inotify, watch->descriptor);
+      watch->descriptor = -1;
+      watch->is_scanned = FALSE;
+      return;
+    }
+
+  extension = event->len > 0 ? strrchr (event->name, '.') : NULL;
+  if (!extension || strcmp (extension, DSO_EXTENSION) != 0)
+    return;
+
+  allocation = strlen (watch->directory) + strlen (event->name) + 2;
+  path = ifp_malloc (allocation);
+  snprintf (path, allocation, "%s/%s", watch->directory, event->name);
+
+  ifp_trace ("loader: event 0x%lx on file '%s'",
+             (unsigned long) event->mask, path);
+
+  plugin = ifp_loader_find_plugin (path);
+  if (plugin && ifp_plugin_is_unloadable (plugin))
+    ifp_loader_reap_plugin (plugin);
+
+  if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+    ifp_loader_add_pending (watch, path);
+  else
+    {
+      for (index_ = 0; index_ < watch->pending_count; index_++)
+        {
+          if (strcmp (watch->pending[index_], path) == 0)
+            {
+              ifp_free (watch->pending[index_]);
+              watch->pending[index_] = watch->pending[--watch->pending_count];
+              break;
+            }
+        }
+    }
+
+  ifp_free (path);
+}
+
+static void
+ifp_loader_read_events (void)
+{
+  char buffer[4096]
+      __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  ssize_t bytes;
+
+  for (bytes = read (ifp_loader_inotify, buffer, sizeof (buffer));
+       bytes > 0; bytes = read (ifp_loader_inotify, buffer, sizeof (buffer)))
+    {
+      const char *cursor;
+
+      for (cursor = buffer; cursor < buffer + bytes;
+           cursor += sizeof (struct inotify_event)
+                     + ((const struct inotify_event *) cursor)->len)
+        ifp_loader_handle_event ((const struct inotify_event *) cursor);
+    }
+
+  if (bytes == -1 && errno != EAGAIN)
+    ifp_error ("loader: error reading inotify events");
+}
+
+
+/*
+ * ifp_loader_load_pending()
+ *
+ * Load each file pending on a watched directory, returning the count of
+ * plugins loaded.  If a pending file fails to load, possibly because it
+ * duplicates a listed plugin that may later go away, fall back to a full
+ * scan of the directory on its next search.
+ */
+static int
+ifp_loader_load_pending (ifp_loader_watchref_t watch)
+{
+  int index_, count;
+
+  count = 0;
+  for (index_ = 0; index_ < watch->pending_count; index_++)
+    {
+      const char *filename;
+
+      filename = watch->pending[index_];
+      if (ifp_loader_find_plugin (filename))
+        continue;
+
+      if (ifp_loader_load_plugin (filename))
+        count++;
+      else
+        watch->is_scanned = FALSE;
+    }
+
+  ifp_loader_clear_pending (watch);
+  return count;
+}
+
+
+/*
+ * ifp_loader_verify_worker()
+ * ifp_loader_verify_files()
+ *
+ * Verify candidate plugin files in parallel, setting a verdict for each
+ * path that is FALSE if the file certainly isn't a plugin.  The calling
+ * thread works alongside the pool.  Inside a chaining plugin, or on a
+ * single processor, all verification runs on the calling thread.
+ */
+static void *
+ifp_loader_verify_worker (void *argument)
+{
+  struct ifp_loader_verify_job *job;
+  int index_;
+
+  job = argument;
+  for (index_ = __atomic_fetch_add (&job->next, 1, __ATOMIC_RELAXED);
+       index_ < job->count;
+       index_ = __atomic_fetch_add (&job->next, 1, __ATOMIC_RELAXED))
+    job->verdicts[index_] = ifp_plugin_verify_file (job->paths[index_]);
+
+  return NULL;
+}
+
+static void
+ifp_loader_verify_files (char **paths, int *verdicts, int count)
+{
+  struct ifp_loader_verify_job job;
+  pthread_t workers[VERIFY_MAX_WORKERS];
+  long processors;
+  int worker_count, started, index_;
+
+  job.paths = paths;
+  job.verdicts = verdicts;
+  job.count = count;
+  job.next = 0;
+
+  processors = sysconf (_SC_NPROCESSORS_ONLN);
+  worker_count = processors > VERIFY_MAX_WORKERS
+                 ? VERIFY_MAX_WORKERS : (processors > 0 ? processors : 1);
+  if (worker_count > count)
+    worker_count = count;
+  if (ifp_self_inside_plugin ())
+    worker_count = 1;
+
+  started = 0;
+  for (index_ = 1; index_ < worker_count; index_++)
+    {
+      if (pthread_create (workers + started, NULL,
+                          ifp_loader_verify_worker, &job) == 0)
+        started++;
+    }
+
+  ifp_trace ("loader: verifying %d files with %d threads",
+             count, started + 1);
+  ifp_loader_verify_worker (&job);
+
+  for (index_ = 0; index_ < started; index_++)
+    pthread_join (workers[index_], NULL);
+}
+
+
 /**
  * ifp_loader_filter_plugins_directory()
  * ifp_loader_search_plugins_directory()
@@ -368,12 +1036,32 @@ ifp_loader_filter_plugins_directory (const struct dirent *entry)
 int
 ifp_loader_search_plugins_directory (const char *directory_path)
 {
+  ifp_loader_watchref_t watch;
   struct dirent **entries;
   int filenames, index_;
-  int count;
+  int count, candidates, *verdicts;
+  char **paths;
 
   ifp_trace ("loader: ifp_loader_search_plugins_dir <- '%s'", directory_path);
 
+  /*
+   * If the directory is watched and was scanned, catch up on changes since
+   * and load just the files pending.  Reading events may find the watch has
+   * lost track, in which case scan in full.
+   */
+  watch = ifp_loader_get_watch (directory_path);
+  if (watch && watch->is_scanned)
+    {
+      ifp_loader_read_events ();
+      if (watch->is_scanned)
+        {
+          count = ifp_loader_load_pending (watch);
+          ifp_trace ("loader: loaded %d pending plugins from directory",
+                     count);
+          return count;
+        }
+    }
+
   /* Scan the given directory, and accumulate entries of interest. */
   filenames = scandir (directory_path, &entries,
                        ifp_loader_filter_plugins_directory, alphasort);
@@ -386,8 +1074,9 @@ ifp_loader_search_plugins_directory (const char *directory_path)
 
   ifp_trace ("loader: searching directory '%s'", directory_path);
 
-  /* Try to load each listed file as a plugin, and count successful loads. */
-  count = 0;
+  /* Build full paths for each listed file not already loaded. */
+  paths = ifp_malloc ((filenames + 1) * sizeof (*paths));
+  candidates = 0;
   for (index_ = 0; index_ < filenames; index_++)
     {
       const char *filename;
@@ -401,10 +1090,14 @@ ifp_loader_search_plugins_directory (const char *directory_path)
       path = ifp_malloc (allocation);
       snprintf (path, allocation, "%s/%s", directory_path, filename);
 
-      if (ifp_loader_load_plugin (path))
-        count++;
+      if (ifp_loader_find_plugin (path))
+        {
+          ifp_trace ("loader: file '%s' already listed", path);
+          ifp_free (path);
+          continue;
+        }
 
-      ifp_free (path);
+      paths[candidates++] = path;
     }
 
   /* Free each individual entry, then the entries array itself. */
@@ -412,6 +1105,32 @@ ifp_loader_search_plugins_directory (const char *directory_path)
     free (entries[index_]);
   free (entries);
 
+  /*
+   * Verify candidates in parallel, then try to load each that passes as a
+   * plugin, in directory order, and count successful loads.
+   */
+  verdicts = ifp_malloc ((candidates + 1) * sizeof (*verdicts));
+  ifp_loader_verify_files (paths, verdicts, candidates);
+
+  count = 0;
+  for (index_ = 0; index_ < candidates; index_++)
+    {
+      if (verdicts[index_] && ifp_loader_load_plugin (paths[index_]))
+        count++;
+
+      ifp_free (paths[index_]);
+    }
+
+  ifp_free (verdicts);
+  ifp_free (paths);
+
+  /* A full scan covers any files pending on the directory's watch. */
+  if (watch)
+    {
+      ifp_loader_clear_pending (watch);
+      watch->is_scanned = watch->descriptor != -1;
+    }
+
   ifp_trace ("loader: loaded %d plugins from directory", count);
   return count;
 }
@@ -429,9 +1148,12 @@ ifp_loader_search_plugins_path (const char *load_path)
 {
   char **elements;
   int count, index_, loaded;
+  unsigned long long start;
 
   ifp_trace ("loader: ifp_loader_search_plugins_path <- '%s'", load_path);
 
+  start = ifp_timing_start ();
+
   /* Split the path string on ':' characters. */
   count = ifp_split_string (load_path, PATH_SEPARATOR, &elements);
 
@@ -452,6 +1174,7 @@ ifp_loader_search_plugins_path (const char *load_path)
     }
 
   ifp_free_split_string (elements, count);
+  ifp_timing_stop (IFP_TIMING_PLUGIN_SEARCH, start);
 
   ifp_trace ("loader: loaded %d plugins from path", count);
   return loaded;
@@ -461,33 +1184,24 @@ ifp_loader_search_plugins_path (const char *load_path)
 /**
  * ifp_loader_forget_plugin()
  *
- * Remove from the list, unload, and destroy the given plugin.
+ * Remove from the list, unload, and destroy the given plugin.  If it came
+ * from a watched plugin directory, its file loads again, as a fresh plugin,
+ * on the directory's next search.
  */
 void
 ifp_loader_forget_plugin (ifp_pluginref_t plugin)
 {
+  ifp_loader_watchref_t watch;
   assert (ifp_plugin_is_valid (plugin));
 
   ifp_trace ("loader: ifp_loader_forget_plugin <-"
              " plugin_%p", ifp_trace_pointer (plugin));
 
-  /*
-   * If the plugin is active, something has gone wrong.  This function should
-   * not be called until a running plugin has completed execution.
-   */
-  if (!ifp_plugin_is_unloadable (plugin))
-    {
-      ifp_error ("loader: attempt to reap an active plugin");
-      return;
-    }
+  watch = ifp_loader_find_watch_for_file (ifp_plugin_get_filename (plugin));
+  if (watch && watch->is_scanned && ifp_plugin_is_unloadable (plugin))
+    ifp_loader_add_pending (watch, ifp_plugin_get_filename (plugin));
 
-  /*
-   * Delete the plugin from the loader's list, unload it to finalize anything
-   * in it, then finally destroy it.
-   */
-  ifp_loader_delete_plugin (plugin);
-  ifp_plugin_unload (plugin);
-  ifp_plugin_destroy (plugin);
+  ifp_loader_reap_plugin (plugin);
 }
 
 
@@ -503,7 +1217,7 @@ int
 ifp_loader_forget_all_plugins (void)
 {
   ifp_pluginref_t plugin;
-  int count;
+  int count, index_;
 
   ifp_trace ("loader: ifp_loader_forget_all_plugins <- void");
 
@@ -514,5 +1228,12 @@ ifp_loader_forget_all_plugins (void)
       count++;
     }
 
+  /* With nothing listed, watched directories need scanning afresh. */
+  for (index_ = 0; index_ < ifp_loader_watch_count; index_++)
+    {
+      ifp_loader_clear_pending (ifp_loader_watches + index_);
+      ifp_loader_watches[index_].is_scanned = FALSE;
+    }
+
   return count;
 }
@@ -29,6 +29,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_MAIN
+
 
 /* Fallback default Glk library lists -- X, terminal, and dumb. */
 static const char *DEFAULT_XGLK_LIBRARY = "xglk",
@@ -336,35 +338,68 @@ main (int argc, char *argv[])
 {
   const char *glk_libraries;
   char **main_argv;
-  int main_argc, status;
+  int main_argc, status, first, is_loaded;
   int (*so_main) (int, char *[]);
+  unsigned long long start;
 
   /* Set up any initial configuration file conditions. */
+  start = ifp_timing_start ();
   ifp_config_read ();
+  ifp_timing_stop (IFP_TIMING_CONFIG_READ, start);
 
   /*
-   * Choose Glk; allow -glk option, if first, to select directly.  If -glk
-   * is given, construct a new argc and argv with -glk <value> removed.  If
-   * not, just use the normal argc and argv.
+   * Handle leading player options.  Allow -timings to request a report of
+   * startup phase timings on exit, and -glk to select Glk directly.  If any
+   * are given, construct a new argc and argv with them removed.  If not,
+   * just use the normal argc and argv.
    */
-  if (argc > 2 && strcmp (argv[1], "-glk") == 0)
+  glk_libraries = NULL;
+  for (first = 1; first < argc; )
     {
-      glk_libraries = argv[2];
+      if (strcmp (argv[first], "-timings") == 0)
+        {
+          ifp_timing_select (TRUE);
+          first++;
+        }
+      else if (first + 1 < argc && strcmp (argv[first], "-glk") == 0)
+        {
+          glk_libraries = argv[first + 1];
+          first += 2;
+        }
+      else
+        break;
+    }
 
-      main_argc = argc - 2;
+  if (first > 1)
+    {
+      main_argc = argc - first + 1;
       main_argv = ifp_malloc ((main_argc + 1) * sizeof (*main_argv));
       main_argv[0] = argv[0];
-      memcpy (main_argv + 1, argv + 3, (main_argc - 1) * sizeof (*main_argv));
+      memcpy (main_argv + 1,
+              argv + first, (main_argc - 1) * sizeof (*main_argv));
       main_argv[main_argc] = NULL;
     }
   else
     {
-      glk_libraries = ifp_main_get_glk_libraries ();
       main_argc = argc;
       main_argv = argv;
     }
 
-  if (!ifp_main_load_glk (glk_libraries))
+  if (!glk_libraries)
+    glk_libraries = ifp_main_get_glk_libraries ();
+
+  /*
+   * Glk libraries usually leave by calling exit() from glk_exit(), so print
+   * any timings report on the way out.
+   */
+  if (ifp_timing_is_selected ())
+    atexit (ifp_timing_report);
+
+  start = ifp_timing_start ();
+  is_loaded = ifp_main_load_glk (glk_libraries);
+  ifp_timing_stop (IFP_TIMING_GLK_LOAD, start);
+
+  if (!is_loaded)
     {
       ifp_error ("main: no glk library was loaded while searching for '%s'",
                  glk_libraries);
@@ -26,6 +26,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_MANAGER
+
 
 /*
  * The environment variable used as the path for loading plugins.  This is
@@ -51,6 +53,48 @@ static glkunix_startup_t *ifp_current_data = NULL;
  */
 static int ifp_clone_selected_flag = FALSE;
 
+/*
+ * Flag for checkpointing plugins once their startup code succeeds, and the
+ * plugin and startup data held for restarting from the checkpoint.  Glk
+ * windows, streams, and filerefs opened by startup code are noted along with
+ * the checkpoint, so that a restart can keep them while closing everything
+ * else.
+ */
+static int ifp_checkpoint_selected_flag = FALSE;
+static ifp_pluginref_t ifp_checkpoint_plugin = NULL;
+static glkunix_startup_t *ifp_checkpoint_data = NULL;
+
+struct ifp_checkpoint_stream
+{
+  strid_t glk_stream;
+  glui32 position;
+  int is_closed;
+};
+static struct ifp_checkpoint_stream *ifp_checkpoint_streams = NULL;
+static int ifp_checkpoint_stream_count = 0;
+static frefid_t *ifp_checkpoint_filerefs = NULL;
+static int ifp_checkpoint_fileref_count = 0;
+
+struct ifp_checkpoint_window
+{
+  winid_t glk_window;
+  glui32 method, size;
+  winid_t keywin;
+  strid_t echo_stream;
+};
+static struct ifp_checkpoint_window *ifp_checkpoint_windows = NULL;
+static int ifp_checkpoint_window_count = 0;
+static strid_t ifp_checkpoint_current_stream = NULL;
+
+/*
+ * While a checkpoint is held, the plugin's Glk interface has its stream
+ * close function replaced, so that the plugin cannot really close streams
+ * noted at checkpoint.  This is the replaced function.
+ */
+static ifp_glk_interfaceref_t ifp_checkpoint_glk_interface = NULL;
+static void (*ifp_checkpoint_glk_stream_close) (strid_t,
+                                                stream_result_t *) = NULL;
+
 
 /**
  * ifp_manager_build_timestamp()
@@ -127,6 +171,32 @@ ifp_manager_cloning_selected (void)
 }
 
 
+/**
+ * ifp_manager_checkpoint_selected_plugins()
+ * ifp_manager_checkpointing_selected()
+ *
+ * If flag is TRUE, set the manager up to checkpoint each plugin it locates
+ * immediately after the plugin's startup code succeeds, so that the game
+ * can later be restarted with ifp_manager_restart_plugin() without reading
+ * and parsing the game file again.  A checkpoint holds a copy of the
+ * plugin's heap and data, so this roughly doubles plugin memory use.
+ * Checkpointing is off by default.
+ */
+void
+ifp_manager_checkpoint_selected_plugins (int flag)
+{
+  ifp_checkpoint_selected_flag = (flag != 0);
+  ifp_trace ("manager: ifp_checkpoint_selected_flag %s",
+             flag ? "set" : "cleared");
+}
+
+int
+ifp_manager_checkpointing_selected (void)
+{
+  return ifp_checkpoint_selected_flag;
+}
+
+
 /**
  * ifp_manager_set_plugin_path()
  * ifp_manager_get_plugin_path()
@@ -238,6 +308,7 @@ ifp_manager_reset_glk_library_full (void)
   frefid_t glk_fileref;
   schanid_t glk_schannel;
   glui32 glk_style, glk_stylehint;
+  unsigned long long start;
 
   ifp_trace ("manager: ifp_manager_reset_glk_library_full <- void");
 
@@ -248,6 +319,8 @@ ifp_manager_reset_glk_library_full (void)
       return FALSE;
     }
 
+  start = ifp_timing_start ();
+
   /* Clear Glk callbacks using the partial Glk reset function. */
   ifp_manager_reset_glk_library_partial ();
 
@@ -326,11 +399,495 @@ ifp_manager_reset_glk_library_full (void)
         }
     }
 
+  ifp_timing_stop (IFP_TIMING_GLK_RESET, start);
   ifp_trace ("manager: ifp_manager_reset_glk_library_full finished");
   return TRUE;
 }
 
 
+/*
+ * ifp_manager_discard_checkpoint()
+ *
+ * Release any plugin checkpoint held, along with the startup data and Glk
+ * object notes kept for it.  The plugin's own copy of its data is released
+ * only if the plugin is still loaded; otherwise unloading has done it.
+ */
+static void
+ifp_manager_discard_checkpoint (void)
+{
+  ifp_pluginref_t plugin;
+
+  if (!ifp_checkpoint_plugin)
+    return;
+
+  ifp_trace ("manager: discarding checkpoint for"
+             " plugin_%p", ifp_trace_pointer (ifp_checkpoint_plugin));
+
+  for (plugin = ifp_loader_iterate_plugins (NULL);
+       plugin; plugin = ifp_loader_iterate_plugins (plugin))
+    {
+      if (plugin == ifp_checkpoint_plugin)
+        {
+          ifp_plugin_discard_checkpoint (plugin);
+          break;
+        }
+    }
+
+  /*
+   * Reinstate the real Glk stream close, and close any checkpointed streams
+   * the plugin tried to close.
+   */
+  if (ifp_checkpoint_glk_stream_close)
+    {
+      int index_;
+
+      ifp_checkpoint_glk_interface->glk_stream_close
+          = ifp_checkpoint_glk_stream_close;
+
+      for (index_ = 0; index_ < ifp_checkpoint_stream_count; index_++)
+        {
+          if (ifp_checkpoint_streams[index_].is_closed)
+            glk_stream_close (ifp_checkpoint_streams[index_].glk_stream, NULL);
+        }
+
+      ifp_checkpoint_glk_interface = NULL;
+      ifp_checkpoint_glk_stream_close = NULL;
+    }
+
+  if (ifp_checkpoint_data != ifp_current_data)
+    ifp_pref_forget_startup_data (ifp_checkpoint_data);
+  ifp_checkpoint_data = NULL;
+  ifp_checkpoint_plugin = NULL;
+
+  ifp_free (ifp_checkpoint_streams);
+  ifp_checkpoint_streams = NULL;
+  ifp_checkpoint_stream_count = 0;
+  ifp_free (ifp_checkpoint_filerefs);
+  ifp_checkpoint_filerefs = NULL;
+  ifp_checkpoint_fileref_count = 0;
+  ifp_free (ifp_checkpoint_windows);
+  ifp_checkpoint_windows = NULL;
+  ifp_checkpoint_window_count = 0;
+  ifp_checkpoint_current_stream = NULL;
+
+  ifp_memory_malloc_discard_checkpoint ();
+  ifp_file_discard_checkpoint ();
+}
+
+
+/*
+ * ifp_manager_override_glk_stream_close()
+ *
+ * Override routine for plugin calls to glk_stream_close() while a checkpoint
+ * is held.  Streams noted at checkpoint are only marked as closed, so that
+ * they are still there for a restart.  Other streams are closed as normal.
+ */
+static void
+ifp_manager_override_glk_stream_close (strid_t glk_stream,
+                                       stream_result_t *result)
+{
+  int index_;
+
+  for (index_ = 0; index_ < ifp_checkpoint_stream_count; index_++)
+    {
+      struct ifp_checkpoint_stream *checkpoint;
+
+      checkpoint = ifp_checkpoint_streams + index_;
+      if (checkpoint->glk_stream == glk_stream && !checkpoint->is_closed)
+        {
+          ifp_trace ("manager: deferring close of checkpoint"
+                     " stream_%p", ifp_trace_pointer (glk_stream));
+
+          if (result)
+            {
+              result->readcount = 0;
+              result->writecount = 0;
+            }
+          if (glk_stream_get_current () == glk_stream)
+            glk_stream_set_current (NULL);
+
+          checkpoint->is_closed = TRUE;
+          return;
+        }
+    }
+
+  ifp_checkpoint_glk_stream_close (glk_stream, result);
+}
+
+
+/*
+ * ifp_manager_checkpoint_plugin()
+ *
+ * Checkpoint a plugin whose startup code has just succeeded.  This notes
+ * the plugin's Glk windows, with their arrangements, and its streams and
+ * filerefs, and checkpoints its data, heap, and open files.  Returns TRUE
+ * if the checkpoint was taken.
+ */
+static int
+ifp_manager_checkpoint_plugin (ifp_pluginref_t plugin,
+                               glkunix_startup_t *data)
+{
+  winid_t glk_window;
+  strid_t glk_stream;
+  frefid_t glk_fileref;
+  int count;
+
+  ifp_trace ("manager: ifp_manager_checkpoint_plugin <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  ifp_manager_discard_checkpoint ();
+
+  if (!ifp_plugin_checkpoint (plugin))
+    {
+      ifp_trace ("manager: plugin refused checkpoint");
+      return FALSE;
+    }
+
+  if (!ifp_memory_malloc_checkpoint ())
+    {
+      ifp_trace ("manager: plugin heap refused checkpoint");
+      ifp_plugin_discard_checkpoint (plugin);
+      return FALSE;
+    }
+  ifp_file_checkpoint ();
+
+  /* Note Glk streams, with rocks and positions, and filerefs. */
+  count = 0;
+  for (glk_stream = glk_stream_iterate (NULL, NULL);
+       glk_stream; glk_stream = glk_stream_iterate (glk_stream, NULL))
+    count++;
+
+  ifp_checkpoint_streams = count > 0
+      ? ifp_malloc (count * sizeof (*ifp_checkpoint_streams)) : NULL;
+  for (glk_stream = glk_stream_iterate (NULL, NULL);
+       glk_stream; glk_stream = glk_stream_iterate (glk_stream, NULL))
+    {
+      struct ifp_checkpoint_stream *checkpoint;
+
+      checkpoint = ifp_checkpoint_streams + ifp_checkpoint_stream_count++;
+      checkpoint->glk_stream = glk_stream;
+      checkpoint->position = glk_stream_get_position (glk_stream);
+      checkpoint->is_closed = FALSE;
+    }
+
+  count = 0;
+  for (glk_fileref = glk_fileref_iterate (NULL, NULL);
+       glk_fileref; glk_fileref = glk_fileref_iterate (glk_fileref, NULL))
+    count++;
+
+  ifp_checkpoint_filerefs = count > 0
+      ? ifp_malloc (count * sizeof (*ifp_checkpoint_filerefs)) : NULL;
+  for (glk_fileref = glk_fileref_iterate (NULL, NULL);
+       glk_fileref; glk_fileref = glk_fileref_iterate (glk_fileref, NULL))
+    ifp_checkpoint_filerefs[ifp_checkpoint_fileref_count++] = glk_fileref;
+
+  /* Note windows, their echo streams, and pair arrangements. */
+  count = 0;
+  for (glk_window = glk_window_iterate (NULL, NULL);
+       glk_window; glk_window = glk_window_iterate (glk_window, NULL))
+    count++;
+
+  ifp_checkpoint_windows = count > 0
+      ? ifp_malloc (count * sizeof (*ifp_checkpoint_windows)) : NULL;
+  for (glk_window = glk_window_iterate (NULL, NULL);
+       glk_window; glk_window = glk_window_iterate (glk_window, NULL))
+    {
+      struct ifp_checkpoint_window *checkpoint;
+
+      checkpoint = ifp_checkpoint_windows + ifp_checkpoint_window_count++;
+      checkpoint->glk_window = glk_window;
+      checkpoint->echo_stream = glk_window_get_echo_stream (glk_window);
+      checkpoint->method = checkpoint->size = 0;
+      checkpoint->keywin = NULL;
+      if (glk_window_get_type (glk_window) == wintype_Pair)
+        glk_window_get_arrangement (glk_window, &checkpoint->method,
+                                    &checkpoint->size, &checkpoint->keywin);
+    }
+
+  ifp_checkpoint_current_stream = glk_stream_get_current ();
+
+  /* Stop the plugin from closing checkpointed streams from here on. */
+  ifp_checkpoint_glk_interface = ifp_plugin_retrieve_glk_interface (plugin);
+  ifp_checkpoint_glk_stream_close
+      = ifp_checkpoint_glk_interface->glk_stream_close;
+  ifp_checkpoint_glk_interface->glk_stream_close
+      = ifp_manager_override_glk_stream_close;
+
+  ifp_checkpoint_plugin = plugin;
+  ifp_checkpoint_data = data;
+
+  ifp_trace ("manager: checkpointed plugin_%p, %d window(s),"
+             " %d stream(s), %d fileref(s)", ifp_trace_pointer (plugin),
+             ifp_checkpoint_window_count,
+             ifp_checkpoint_stream_count, ifp_checkpoint_fileref_count);
+  return TRUE;
+}
+
+
+/*
+ * ifp_manager_is_checkpoint_window()
+ * ifp_manager_is_checkpoint_stream()
+ * ifp_manager_is_checkpoint_fileref()
+ *
+ * Return TRUE if the Glk window, stream, or fileref was noted at checkpoint.
+ */
+static int
+ifp_manager_is_checkpoint_window (winid_t glk_window)
+{
+  int index_;
+
+  for (index_ = 0; index_ < ifp_checkpoint_window_count; index_++)
+    {
+      if (ifp_checkpoint_windows[index_].glk_window == glk_window)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static int
+ifp_manager_is_checkpoint_stream (strid_t glk_stream)
+{
+  int index_;
+
+  for (index_ = 0; index_ < ifp_checkpoint_stream_count; index_++)
+    {
+      if (ifp_checkpoint_streams[index_].glk_stream == glk_stream)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static int
+ifp_manager_is_checkpoint_fileref (frefid_t glk_fileref)
+{
+  int index_;
+
+  for (index_ = 0; index_ < ifp_checkpoint_fileref_count; index_++)
+    {
+      if (ifp_checkpoint_filerefs[index_] == glk_fileref)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+/*
+ * ifp_manager_checkpoint_streams_intact()
+ *
+ * Return TRUE if every Glk window and fileref noted at checkpoint is still
+ * open, so that the checkpoint is usable.  Checkpointed streams cannot be
+ * closed by the plugin, but window streams close with their window.
+ */
+static int
+ifp_manager_checkpoint_streams_intact (void)
+{
+  winid_t glk_window;
+  frefid_t glk_fileref;
+  int index_;
+
+  for (index_ = 0; index_ < ifp_checkpoint_window_count; index_++)
+    {
+      struct ifp_checkpoint_window *checkpoint;
+
+      checkpoint = ifp_checkpoint_windows + index_;
+      for (glk_window = glk_window_iterate (NULL, NULL);
+           glk_window; glk_window = glk_window_iterate (glk_window, NULL))
+        {
+          if (glk_window == checkpoint->glk_window)
+            break;
+        }
+
+      if (!glk_window)
+        {
+          ifp_trace ("manager: checkpoint window_%p was closed",
+                     ifp_trace_pointer (checkpoint->glk_window));
+          return FALSE;
+        }
+    }
+
+  for (index_ = 0; index_ < ifp_checkpoint_fileref_count; index_++)
+    {
+      for (glk_fileref = glk_fileref_iterate (NULL, NULL);
+           glk_fileref; glk_fileref = glk_fileref_iterate (glk_fileref, NULL))
+        {
+          if (glk_fileref == ifp_checkpoint_filerefs[index_])
+            break;
+        }
+
+      if (!glk_fileref)
+        {
+          ifp_trace ("manager: checkpoint fileref_%p was destroyed",
+                     ifp_trace_pointer (ifp_checkpoint_filerefs[index_]));
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+
+/**
+ * ifp_manager_restart_plugin()
+ *
+ * Restart a plugin that has finished running from the checkpoint taken
+ * just after its startup code, where checkpointing is selected.  Glk windows,
+ * streams, and filerefs opened since the checkpoint are closed, windows that
+ * remain are cleared and rearranged, and files and memory are returned to
+ * their state at the checkpoint.  On success, the plugin is once again the
+ * current plugin, and may be run with ifp_manager_run_plugin().  Returns
+ * FALSE if the plugin holds no usable checkpoint; the caller should then
+ * forget the plugin and locate one afresh.
+ *
+ * Glk callbacks that a plugin registered in its startup code (interrupt
+ * handler, dispatch registries) are not reinstated on restart.
+ */
+int
+ifp_manager_restart_plugin (ifp_pluginref_t plugin)
+{
+  winid_t glk_window;
+  strid_t glk_stream, glk_next_stream;
+  frefid_t glk_fileref, glk_next_fileref;
+  schanid_t glk_schannel;
+  int index_;
+  assert (ifp_plugin_is_valid (plugin));
+
+  ifp_trace ("manager: ifp_manager_restart_plugin <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  if (ifp_current_plugin)
+    {
+      assert (ifp_current_data);
+      ifp_error ("manager: a plugin is already active");
+      return FALSE;
+    }
+
+  if (plugin != ifp_checkpoint_plugin || !ifp_plugin_has_checkpoint (plugin))
+    {
+      ifp_trace ("manager: plugin_%p has no checkpoint",
+                 ifp_trace_pointer (plugin));
+      return FALSE;
+    }
+
+  /*
+   * Check the Glk side before touching anything, then restore open files,
+   * which can also refuse if the plugin closed a checkpointed file.
+   */
+  if (!ifp_manager_checkpoint_streams_intact () || !ifp_file_restore ())
+    {
+      ifp_trace ("manager: checkpoint is no longer usable");
+      ifp_manager_discard_checkpoint ();
+      return FALSE;
+    }
+
+  /*
+   * Reset Glk as a full reset would, except that checkpointed windows,
+   * streams, and filerefs are kept, and stylehints are left alone, since
+   * startup code may have set them.  Closing a window also closes any pair
+   * window above it, so rescan windows after each close.  Pair windows are
+   * never closed directly, as that would close their checkpointed children.
+   */
+  ifp_manager_reset_glk_library_partial ();
+
+  for (glk_window = glk_window_iterate (NULL, NULL); glk_window;)
+    {
+      if (!ifp_manager_is_checkpoint_window (glk_window)
+          && glk_window_get_type (glk_window) != wintype_Pair)
+        {
+          ifp_trace ("manager: closing glk"
+                     " window_%p", ifp_trace_pointer (glk_window));
+          glk_window_close (glk_window, NULL);
+          glk_window = glk_window_iterate (NULL, NULL);
+        }
+      else
+        glk_window = glk_window_iterate (glk_window, NULL);
+    }
+
+  for (index_ = 0; index_ < ifp_checkpoint_window_count; index_++)
+    {
+      struct ifp_checkpoint_window *checkpoint;
+
+      checkpoint = ifp_checkpoint_windows + index_;
+      glk_window = checkpoint->glk_window;
+
+      if (glk_window_get_type (glk_window) == wintype_Pair)
+        glk_window_set_arrangement (glk_window, checkpoint->method,
+                                    checkpoint->size, checkpoint->keywin);
+      else
+        {
+          glk_cancel_line_event (glk_window, NULL);
+          glk_cancel_char_event (glk_window);
+          glk_cancel_mouse_event (glk_window);
+          glk_window_clear (glk_window);
+        }
+
+      glk_window_set_echo_stream (glk_window, checkpoint->echo_stream);
+    }
+
+  for (glk_stream = glk_stream_iterate (NULL, NULL);
+       glk_stream; glk_stream = glk_next_stream)
+    {
+      glk_next_stream = glk_stream_iterate (glk_stream, NULL);
+      if (!ifp_manager_is_checkpoint_stream (glk_stream))
+        {
+          ifp_trace ("manager: closing glk"
+                     " stream_%p", ifp_trace_pointer (glk_stream));
+          glk_stream_close (glk_stream, NULL);
+        }
+    }
+  for (glk_fileref = glk_fileref_iterate (NULL, NULL);
+       glk_fileref; glk_fileref = glk_next_fileref)
+    {
+      glk_next_fileref = glk_fileref_iterate (glk_fileref, NULL);
+      if (!ifp_manager_is_checkpoint_fileref (glk_fileref))
+        {
+          ifp_trace ("manager: destroying glk"
+                     " fileref_%p", ifp_trace_pointer (glk_fileref));
+          glk_fileref_destroy (glk_fileref);
+        }
+    }
+
+  for (glk_schannel = glk_schannel_iterate (NULL, NULL);
+       glk_schannel; glk_schannel = glk_schannel_iterate (NULL, NULL))
+    {
+      ifp_trace ("manager: destroying glk"
+                 " schannel_%p", ifp_trace_pointer (glk_schannel));
+      glk_schannel_destroy (glk_schannel);
+    }
+
+  for (index_ = 0; index_ < ifp_checkpoint_stream_count; index_++)
+    {
+      glk_stream_set_position (ifp_checkpoint_streams[index_].glk_stream,
+                               ifp_checkpoint_streams[index_].position,
+                               seekmode_Start);
+      ifp_checkpoint_streams[index_].is_closed = FALSE;
+    }
+  glk_stream_set_current (ifp_checkpoint_current_stream);
+
+  /* Put back the plugin's heap, then its data. */
+  if (!ifp_memory_malloc_restore ())
+    {
+      ifp_error ("manager: failed to restore plugin heap");
+      ifp_manager_discard_checkpoint ();
+      return FALSE;
+    }
+  if (!ifp_plugin_restore (plugin))
+    {
+      ifp_error ("manager: failed to restore plugin data");
+      ifp_manager_discard_checkpoint ();
+      return FALSE;
+    }
+
+  ifp_current_plugin = plugin;
+  ifp_current_data = ifp_checkpoint_data;
+
+  ifp_trace ("manager: restarted plugin_%p", ifp_trace_pointer (plugin));
+  return TRUE;
+}
+
+
 /**
  * ifp_manager_collect_plugin_garbage()
  *
@@ -345,6 +902,8 @@ ifp_manager_reset_glk_library_full (void)
 int
 ifp_manager_collect_plugin_garbage (void)
 {
+  unsigned long long start;
+
   ifp_trace ("manager: ifp_manager_collect_plugin_garbage <- void");
 
   if (ifp_current_plugin)
@@ -355,11 +914,15 @@ ifp_manager_collect_plugin_garbage (void)
     }
 
   /*
-   * Using the Libc interception modules, close unclosed files, and free any
+   * Drop any checkpoint held for restarting a prior plugin.  Then, using
+   * the Libc interception modules, close unclosed files, and free any
    * unfree'd memory.
    */
+  start = ifp_timing_start ();
+  ifp_manager_discard_checkpoint ();
   ifp_file_open_files_cleanup ();
   ifp_memory_malloc_garbage_collect ();
+  ifp_timing_stop (IFP_TIMING_GARBAGE_COLLECT, start);
   return TRUE;
 }
 
@@ -394,9 +957,10 @@ ifp_manager_fill_buffer (strid_t glk_stream,
 /*
  * ifp_manager_attach_plugin()
  *
- * If the plugin chains, set its self-reference.  For both chaining and
- * ordinary plugins, attach the Glk and Libc interfaces to a given plugin.
- * Return FALSE if either interface fails to take.
+ * Complete the load of a plugin found only probed.  If the plugin chains,
+ * set its self-reference.  For both chaining and ordinary plugins, attach
+ * the Glk and Libc interfaces to a given plugin.  Return FALSE if the load
+ * can't be completed, or either interface fails to take.
  */
 static int
 ifp_manager_attach_plugin (ifp_pluginref_t plugin)
@@ -406,6 +970,14 @@ ifp_manager_attach_plugin (ifp_pluginref_t plugin)
   ifp_trace ("manager: ifp_manager_attach_plugin <-"
              " plugin_%p", ifp_trace_pointer (plugin));
 
+  if (!ifp_plugin_complete_load (plugin))
+    {
+      ifp_error ("manager: plugin %s-%s failed to complete loading",
+                 ifp_plugin_engine_name (plugin),
+                 ifp_plugin_engine_version (plugin));
+      return FALSE;
+    }
+
   /*
    * Setting the plugin's self-reference lets it write error messages
    * prefixed with the plugin name and version.
@@ -684,6 +1256,7 @@ ifp_manager_locate_plugin (const char *filename)
   strid_t glk_stream;
   ifp_pluginref_t result;
   glkunix_startup_t *data;
+  unsigned long long start;
   assert (filename);
 
   ifp_trace ("manager: ifp_manager_locate_plugin <- '%s'", filename);
@@ -711,7 +1284,9 @@ ifp_manager_locate_plugin (const char *filename)
       return NULL;
     }
 
+  start = ifp_timing_start ();
   result = ifp_manager_locate_plugin_strid (glk_stream);
+  ifp_timing_stop (IFP_TIMING_RECOGNIZE, start);
   ifp_glkstream_close (glk_stream, NULL);
 
   if (!result)
@@ -733,7 +1308,9 @@ ifp_manager_locate_plugin (const char *filename)
     {
       ifp_pluginref_t clone;
 
+      start = ifp_timing_start ();
       clone = ifp_loader_replace_with_clone (result);
+      ifp_timing_stop (IFP_TIMING_CLONE, start);
       if (!clone)
         {
           /*
@@ -792,6 +1369,13 @@ ifp_manager_locate_plugin (const char *filename)
   ifp_current_plugin = result;
   ifp_current_data = data;
 
+  /*
+   * If checkpointing is selected, take one now, while the plugin is freshly
+   * initialized.  Failure here only means the plugin can't be restarted.
+   */
+  if (ifp_manager_checkpointing_selected ())
+    ifp_manager_checkpoint_plugin (result, data);
+
   /* If this is the first call, register our finalizer for the plugin. */
   if (!initialized)
     {
@@ -859,7 +1443,16 @@ ifp_manager_run_plugin (ifp_pluginref_t plugin)
 
   ifp_plugin_glk_main (plugin);
 
-  ifp_pref_forget_startup_data (ifp_current_data);
+  /* Dump and clear any Glk call profile gathered while running. */
+  if (ifp_glk_profile_is_selected ())
+    {
+      ifp_glk_profile_report ();
+      ifp_glk_profile_reset ();
+    }
+
+  /* Keep startup data if it's needed to restart from a checkpoint. */
+  if (ifp_current_data != ifp_checkpoint_data)
+    ifp_pref_forget_startup_data (ifp_current_data);
   ifp_current_data = NULL;
   ifp_current_plugin = NULL;
 
@@ -18,13 +18,20 @@
  * USA
  */
 
+#define _GNU_SOURCE       /* For dlinfo() and RTLD_DI_LINKMAP. */
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <setjmp.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <link.h>
 
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_PLUGIN
+
 
 /*
  * Plugin magic identifier, for safety purposes.  We slot this into each
@@ -55,15 +62,31 @@ static const unsigned int PLUGIN_MAGIC = 0x24ade36e;
  *               |                  unload                       |
  *               +-----------------------------------------------+
  *
- * Attempts at other state transitions are errors.
+ * Attempts at other state transitions are errors.  As an exception, a
+ * plugin checkpointed when Initialized may be restored from Finished back
+ * to Initialized.
+ *
+ * Loading is in two phases.  Load only probes the shared object, binding
+ * functions lazily and looking up just its header, and leaves the plugin
+ * Probed, between Unloaded and Attached.  Completing the load, done when the
+ * plugin is selected to run, checks that all of its function references can
+ * be bound, looks up the rest of its interface, and moves it on to Attached.
+ * A Probed plugin may also be unloaded.
  */
+struct ifp_plugin_segment
+{
+  void *address;
+  size_t size;
+  void *contents;
+};
+
 struct ifp_plugin
 {
   unsigned int magic;
 
   /* Plugin state. */
   enum
-  { PLUGIN_UNLOADED = 1,
+  { PLUGIN_UNLOADED = 1, PLUGIN_PROBED,
     PLUGIN_ATTACHED, PLUGIN_INITIALIZED, PLUGIN_RUNNING, PLUGIN_FINISHED
   } state;
 
@@ -79,6 +102,9 @@ struct ifp_plugin
   /* Plugin's Glk and Libc interface attach and retrieve functions. */
   int (*ifpi_attach_glk_interface) (ifp_glk_interfaceref_t);
   ifp_glk_interfaceref_t (*ifpi_retrieve_glk_interface) (void);
+
+  /* Optional function to flush plugin-side buffered Glk output. */
+  void (*ifpi_glk_flush_output) (void);
   int (*ifpi_attach_libc_interface) (ifp_libc_interfaceref_t);
   ifp_libc_interfaceref_t (*ifpi_retrieve_libc_interface) (void);
 
@@ -95,6 +121,10 @@ struct ifp_plugin
   int (*ifpi_glkunix_startup_code) (glkunix_startup_t *);
   void (*ifpi_glk_main) (void);
 
+  /* Copies of writable data segments, taken by ifp_plugin_checkpoint(). */
+  struct ifp_plugin_segment *segments;
+  int segment_count;
+
   /* List next and prior element. */
   ifp_pluginref_t next;
   ifp_pluginref_t prior;
@@ -104,11 +134,29 @@ struct ifp_plugin
 static jmp_buf glk_exit_jmp_buffer;
 static int glk_exit_is_handleable = FALSE;
 
+/*
+ * Set only in the thread that made the setjmp above.  A plugin may
+ * allocate from other threads, and those cannot longjmp into this one.
+ */
+static __thread int glk_exit_is_this_thread = FALSE;
+
+/*
+ * Soft and hard limits on heap bytes and open files for a running plugin,
+ * zero for no limit, and flags noting soft limits already reported.
+ */
+static size_t ifp_plugin_heap_soft_limit = 0,
+              ifp_plugin_heap_hard_limit = 0;
+static int ifp_plugin_file_soft_limit = 0,
+           ifp_plugin_file_hard_limit = 0;
+static int ifp_plugin_heap_soft_reported = FALSE,
+           ifp_plugin_file_soft_reported = FALSE;
+
 /*
  * Forward declarations of the function that we use to override glk_exit
  * in the Glk interface.
  */
 static void ifp_plugin_override_glk_exit (void);
+static void ifp_plugin_discard_segments (ifp_pluginref_t plugin);
 
 
 /**
@@ -191,7 +239,7 @@ ifp_plugin_is_initializable (ifp_pluginref_t plugin)
 {
   assert (ifp_plugin_is_valid (plugin));
 
-  return plugin->state == PLUGIN_ATTACHED;
+  return plugin->state == PLUGIN_PROBED || plugin->state == PLUGIN_ATTACHED;
 }
 
 
@@ -246,6 +294,9 @@ ifp_plugin_get_arguments (ifp_pluginref_t plugin)
       return NULL;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return NULL;
+
   return plugin->ifpi_glkunix_arguments;
 }
 
@@ -289,6 +340,9 @@ ifp_plugin_chain_set_self (ifp_pluginref_t plugin)
       return;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return;
+
   if (plugin->ifpi_chain_set_plugin_self)
     {
       ifp_trace ("plugin: sending self-reference to"
@@ -315,6 +369,9 @@ ifp_plugin_can_chain (ifp_pluginref_t plugin)
       return FALSE;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return FALSE;
+
   return plugin->ifpi_chain_set_plugin_self != NULL;
 }
 
@@ -341,6 +398,9 @@ ifp_plugin_get_chain (ifp_pluginref_t plugin)
       return NULL;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return NULL;
+
   /*
    * If we have a symbol for the chain function, call it.  If not, then the
    * plugin is not a chaining plugin, so return NULL.
@@ -420,6 +480,7 @@ ifp_plugin_is_unloadable (ifp_pluginref_t plugin)
   assert (ifp_plugin_is_valid (plugin));
 
   return plugin->state == PLUGIN_UNLOADED
+         || plugin->state == PLUGIN_PROBED
          || plugin->state == PLUGIN_ATTACHED
          || plugin->state == PLUGIN_FINISHED;
 }
@@ -446,7 +507,8 @@ ifp_plugin_unload (ifp_pluginref_t plugin)
       return;
     }
 
-  if (plugin->state == PLUGIN_ATTACHED || plugin->state == PLUGIN_FINISHED)
+  if (plugin->state == PLUGIN_PROBED
+      || plugin->state == PLUGIN_ATTACHED || plugin->state == PLUGIN_FINISHED)
     {
       if (plugin->ifpi_finalizer)
         {
@@ -455,6 +517,7 @@ ifp_plugin_unload (ifp_pluginref_t plugin)
           plugin->ifpi_finalizer ();
         }
 
+      ifp_plugin_discard_segments (plugin);
       ifp_dlclose (plugin->handle);
       ifp_free (plugin->filename);
 
@@ -488,6 +551,7 @@ ifp_plugin_force_unload (ifp_pluginref_t plugin)
           plugin->ifpi_finalizer ();
         }
 
+      ifp_plugin_discard_segments (plugin);
       ifp_dlclose (plugin->handle);
       ifp_free (plugin->filename);
 
@@ -505,18 +569,16 @@ ifp_plugin_force_unload (ifp_pluginref_t plugin)
  *
  * Try to load the given file as an IF plugin.  If successful, return TRUE,
  * otherwise, return FALSE.  The plugin passed in must not be loaded.
+ *
+ * This probes the file, binding its functions lazily and finding only its
+ * header, which is enough to recognize game files.  The load is completed
+ * by ifp_plugin_complete_load(), which other functions here call as needed.
  */
 int
 ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
 {
   void *handle;
   ifp_headerref_t header;
-  void *initializer, *finalizer,
-       *glkunix_arguments_, *attach_glk_interface,
-       *retrieve_glk_interface, *attach_libc_interface,
-       *retrieve_libc_interface, *chain_set_plugin_self,
-       *chain_return_plugin, *chain_accept_preferences,
-       *chain_accept_plugin_path, *glkunix_startup_code_, *glk_main_;
   assert (ifp_plugin_is_valid (plugin));
 
   ifp_trace ("plugin: ifp_plugin_load <-"
@@ -528,7 +590,7 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       return FALSE;
     }
 
-  handle = ifp_dlopen (filename);
+  handle = ifp_dlopen_lazy (filename);
   if (!handle)
     {
       ifp_trace ("plugin: dlopen failed: %s", ifp_dlerror ());
@@ -551,6 +613,89 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       return FALSE;
     }
 
+  /* Copy details to the assigned plugin entry. */
+  plugin->state = PLUGIN_PROBED;
+  plugin->handle = handle;
+  plugin->filename = ifp_malloc (strlen (filename) + 1);
+  strcpy (plugin->filename, filename);
+  plugin->ifpi_header = header;
+
+  ifp_trace ("plugin: probed plugin_%p [%s-%s]",
+             ifp_trace_pointer (plugin),
+             header->engine_name, header->engine_version);
+
+  return TRUE;
+}
+
+
+/*
+ * ifp_plugin_check_binding()
+ * ifp_plugin_check_bindings()
+ *
+ * Confirm that every function a probed plugin needs from elsewhere can be
+ * found, so that lazy binding cannot later fail and abort the process part
+ * way through a game.  Data references were already bound when the plugin
+ * was probed.  If the plugin's symbols can't be read, trust that it binds.
+ */
+struct ifp_plugin_bindings
+{
+  void *handle;
+  const char *filename;
+  int is_bound;
+};
+
+static void
+ifp_plugin_check_binding (const char *name, void *data)
+{
+  struct ifp_plugin_bindings *bindings = data;
+
+  if (!ifp_dlsym (bindings->handle, name) && !ifp_dlsym (RTLD_DEFAULT, name))
+    {
+      ifp_error ("plugin: %s: undefined symbol: %s", bindings->filename, name);
+      bindings->is_bound = FALSE;
+    }
+}
+
+static int
+ifp_plugin_check_bindings (ifp_pluginref_t plugin)
+{
+  struct ifp_plugin_bindings bindings;
+
+  bindings.handle = plugin->handle;
+  bindings.filename = plugin->filename;
+  bindings.is_bound = TRUE;
+
+  if (!ifp_elf_visit_undefined (plugin->filename,
+                                ifp_plugin_check_binding, &bindings))
+    ifp_trace ("plugin: can't read symbols, assuming plugin binds");
+
+  return bindings.is_bound;
+}
+
+
+/*
+ * ifp_plugin_find_interface()
+ *
+ * Look up the functions and data, other than its header, through which we
+ * drive a probed plugin, and note them in the plugin entry.  Returns FALSE
+ * if any required one is missing.
+ */
+static int
+ifp_plugin_find_interface (ifp_pluginref_t plugin)
+{
+  void *handle;
+  const char *filename;
+  void *initializer, *finalizer,
+       *glkunix_arguments_, *attach_glk_interface,
+       *retrieve_glk_interface, *attach_libc_interface,
+       *retrieve_libc_interface, *chain_set_plugin_self,
+       *chain_return_plugin, *chain_accept_preferences,
+       *chain_accept_plugin_path, *glkunix_startup_code_, *glk_main_,
+       *glk_flush_output;
+
+  handle = plugin->handle;
+  filename = plugin->filename;
+
   /*
    * Retrieve the functions we're expected to call on loading and unloading,
    * analogs to _init and _fini.  Either or both could be NULL, though as
@@ -572,7 +717,6 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       if (!chain_return_plugin)
         {
           ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-          ifp_dlclose (handle);
           return FALSE;
         }
 
@@ -581,7 +725,6 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       if (!chain_accept_preferences)
         {
           ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-          ifp_dlclose (handle);
           return FALSE;
         }
 
@@ -590,7 +733,6 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       if (!chain_accept_plugin_path)
         {
           ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-          ifp_dlclose (handle);
           return FALSE;
         }
     }
@@ -606,30 +748,32 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
   if (!attach_glk_interface)
     {
       ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-      ifp_dlclose (handle);
       return FALSE;
     }
   retrieve_glk_interface = ifp_dlsym (handle, "ifpi_retrieve_glk_interface");
   if (!retrieve_glk_interface)
     {
       ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-      ifp_dlclose (handle);
       return FALSE;
     }
 
+  /*
+   * Plugins built against older plugin libraries don't buffer Glk output,
+   * so the function to flush it is optional.
+   */
+  glk_flush_output = ifp_dlsym (handle, "ifpi_glk_flush_output");
+
   /* Get addresses of the functions that set and get Libc interface. */
   attach_libc_interface = ifp_dlsym (handle, "ifpi_attach_libc_interface");
   if (!attach_libc_interface)
     {
       ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-      ifp_dlclose (handle);
       return FALSE;
     }
   retrieve_libc_interface = ifp_dlsym (handle, "ifpi_retrieve_libc_interface");
   if (!retrieve_libc_interface)
     {
       ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-      ifp_dlclose (handle);
       return FALSE;
     }
 
@@ -644,7 +788,6 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       if (!glkunix_arguments_)
         {
           ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-          ifp_dlclose (handle);
           return FALSE;
         }
     }
@@ -661,7 +804,6 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       if (!glkunix_startup_code_)
         {
           ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-          ifp_dlclose (handle);
           return FALSE;
         }
     }
@@ -672,21 +814,16 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       if (!glk_main_)
         {
           ifp_error ("plugin: %s: %s", filename, ifp_dlerror ());
-          ifp_dlclose (handle);
           return FALSE;
         }
     }
 
-  /* Copy details to the assigned plugin entry. */
-  plugin->state = PLUGIN_ATTACHED;
-  plugin->handle = handle;
-  plugin->filename = ifp_malloc (strlen (filename) + 1);
-  strcpy (plugin->filename, filename);
-  plugin->ifpi_header = header;
+  /* Copy details to the plugin entry. */
   plugin->ifpi_initializer = initializer;
   plugin->ifpi_finalizer = finalizer;
   plugin->ifpi_attach_glk_interface = attach_glk_interface;
   plugin->ifpi_retrieve_glk_interface = retrieve_glk_interface;
+  plugin->ifpi_glk_flush_output = glk_flush_output;
   plugin->ifpi_attach_libc_interface = attach_libc_interface;
   plugin->ifpi_retrieve_libc_interface = retrieve_libc_interface;
   plugin->ifpi_chain_set_plugin_self = chain_set_plugin_self;
@@ -697,6 +834,45 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
   plugin->ifpi_glkunix_startup_code = glkunix_startup_code_;
   plugin->ifpi_glk_main = glk_main_;
 
+  return TRUE;
+}
+
+
+/**
+ * ifp_plugin_complete_load()
+ *
+ * Complete the load of a probed plugin, checking that all of its functions
+ * can be bound and finding the rest of its interface.  Returns TRUE if the
+ * plugin is now fully loaded, or already was, and FALSE if it is unusable.
+ */
+int
+ifp_plugin_complete_load (ifp_pluginref_t plugin)
+{
+  unsigned long long start;
+  assert (ifp_plugin_is_valid (plugin));
+
+  ifp_trace ("plugin: ifp_plugin_complete_load <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  if (plugin->state == PLUGIN_UNLOADED)
+    {
+      ifp_error ("plugin: attempt to complete an unloaded plugin");
+      return FALSE;
+    }
+
+  if (plugin->state != PLUGIN_PROBED)
+    return TRUE;
+
+  start = ifp_timing_start ();
+  if (!ifp_plugin_check_bindings (plugin)
+      || !ifp_plugin_find_interface (plugin))
+    {
+      ifp_timing_stop (IFP_TIMING_PLUGIN_COMPLETE, start);
+      return FALSE;
+    }
+
+  plugin->state = PLUGIN_ATTACHED;
+
   /* Finally, if the plugin has an initializer, call it. */
   if (plugin->ifpi_initializer)
     {
@@ -704,9 +880,70 @@ ifp_plugin_load (ifp_pluginref_t plugin, const char *filename)
       plugin->ifpi_initializer ();
     }
 
+  ifp_timing_stop (IFP_TIMING_PLUGIN_COMPLETE, start);
+
   ifp_trace ("plugin: loaded plugin_%p [%s-%s]",
              ifp_trace_pointer (plugin),
-             header->engine_name, header->engine_version);
+             plugin->ifpi_header->engine_name,
+             plugin->ifpi_header->engine_version);
+
+  return TRUE;
+}
+
+
+/*
+ * Symbols looked for by ifp_plugin_verify_file(), and the groups of them
+ * of which a plugin must define at least one.  These mirror the dlsym
+ * lookups that ifp_plugin_complete_load() requires to succeed.
+ */
+static const char *const VERIFY_SYMBOLS[] = {
+  "ifpi_header",
+  "ifpi_attach_glk_interface",
+  "ifpi_retrieve_glk_interface",
+  "ifpi_attach_libc_interface",
+  "ifpi_retrieve_libc_interface",
+  "ifpi_glkunix_arguments", "glkunix_arguments",
+  "ifpi_glkunix_startup_code", "glkunix_startup_code",
+  "ifpi_glk_main", "glk_main",
+  NULL
+};
+static const int VERIFY_GROUPS[] = { 1, 1, 1, 1, 1, 2, 2, 2, 0 };
+
+
+/*
+ * ifp_plugin_verify_file()
+ *
+ * Check a shared object file's dynamic symbol table for the symbols that a
+ * plugin must define, without loading it.  Returns FALSE only if the file
+ * is certainly not a loadable plugin.  If its symbols can't be read, the
+ * file might still be one, so returns TRUE, leaving dlopen to decide.  This
+ * function may be called on worker threads.
+ */
+int
+ifp_plugin_verify_file (const char *filename)
+{
+  int found[sizeof (VERIFY_SYMBOLS) / sizeof (VERIFY_SYMBOLS[0])];
+  int group, symbol;
+
+  if (!ifp_elf_find_symbols (filename, VERIFY_SYMBOLS, found))
+    return TRUE;
+
+  symbol = 0;
+  for (group = 0; VERIFY_GROUPS[group] > 0; group++)
+    {
+      int index_, is_found;
+
+      is_found = FALSE;
+      for (index_ = 0; index_ < VERIFY_GROUPS[group]; index_++)
+        is_found |= found[symbol++];
+
+      if (!is_found)
+        {
+          ifp_trace ("plugin: '%s' lacks symbol %s", filename,
+                     VERIFY_SYMBOLS[symbol - VERIFY_GROUPS[group]]);
+          return FALSE;
+        }
+    }
 
   return TRUE;
 }
@@ -722,11 +959,18 @@ ifp_pluginref_t
 ifp_plugin_new_load (const char *filename)
 {
   ifp_pluginref_t plugin;
+  unsigned long long start;
+  int is_loaded;
 
   ifp_trace ("plugin: ifp_plugin_new_load <- '%s'", filename);
 
   plugin = ifp_plugin_new ();
-  if (!ifp_plugin_load (plugin, filename))
+
+  start = ifp_timing_start ();
+  is_loaded = ifp_plugin_load (plugin, filename);
+  ifp_timing_stop (IFP_TIMING_PLUGIN_LOAD, start);
+
+  if (!is_loaded)
     {
       ifp_plugin_destroy (plugin);
       return NULL;
@@ -758,6 +1002,9 @@ ifp_plugin_attach_glk_interface (ifp_pluginref_t plugin,
       return FALSE;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return FALSE;
+
   /* Override the Glk interface's glk_exit with our own. */
   if (glk_interface)
     glk_interface->glk_exit = ifp_plugin_override_glk_exit;
@@ -780,6 +1027,9 @@ ifp_plugin_retrieve_glk_interface (ifp_pluginref_t plugin)
       return NULL;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return NULL;
+
   return plugin->ifpi_retrieve_glk_interface ();
 }
 
@@ -806,6 +1056,9 @@ ifp_plugin_attach_libc_interface (ifp_pluginref_t plugin,
       return FALSE;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return FALSE;
+
   return plugin->ifpi_attach_libc_interface (libc_interface);
 }
 
@@ -824,6 +1077,9 @@ ifp_plugin_retrieve_libc_interface (ifp_pluginref_t plugin)
       return NULL;
     }
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return NULL;
+
   return plugin->ifpi_retrieve_libc_interface ();
 }
 
@@ -842,6 +1098,7 @@ int
 ifp_plugin_initialize (ifp_pluginref_t plugin, glkunix_startup_t *data)
 {
   int index_, status;
+  unsigned long long start;
   assert (ifp_plugin_is_valid (plugin));
 
   ifp_trace ("plugin: ifp_plugin_initialize <-"
@@ -849,6 +1106,9 @@ ifp_plugin_initialize (ifp_pluginref_t plugin, glkunix_startup_t *data)
   for (index_ = 0; index_ < data->argc; index_++)
     ifp_trace ("plugin:   data->argv[%d] = '%s'", index_, data->argv[index_]);
 
+  if (plugin->state == PLUGIN_PROBED && !ifp_plugin_complete_load (plugin))
+    return FALSE;
+
   if (plugin->state != PLUGIN_ATTACHED)
     {
       ifp_error ("plugin: attempt to reinitialize a plugin");
@@ -866,6 +1126,8 @@ ifp_plugin_initialize (ifp_pluginref_t plugin, glkunix_startup_t *data)
       return FALSE;
     }
 
+  start = ifp_timing_start ();
+
   /*
    * If this looks like a chaining plugin, send it our list of registered
    * preferences, so it can build startup data as we would, and our plugin
@@ -886,10 +1148,15 @@ ifp_plugin_initialize (ifp_pluginref_t plugin, glkunix_startup_t *data)
       plugin->ifpi_chain_accept_plugin_path (ifp_manager_get_plugin_path ());
     }
 
+  /* Report soft limits afresh for each plugin. */
+  ifp_plugin_heap_soft_reported = FALSE;
+  ifp_plugin_file_soft_reported = FALSE;
+
   /* Use setjmp to catch plugin calls to glk_exit(). */
   if (setjmp (glk_exit_jmp_buffer) == 0)
     {
       glk_exit_is_handleable = TRUE;
+      glk_exit_is_this_thread = TRUE;
       ifp_trace ("plugin: setjmp for plugin_%p", ifp_trace_pointer (plugin));
 
       ifp_trace ("plugin: calling plugin's glkunix_startup_code");
@@ -904,6 +1171,11 @@ ifp_plugin_initialize (ifp_pluginref_t plugin, glkunix_startup_t *data)
 
   memset (&glk_exit_jmp_buffer, 0, sizeof (glk_exit_jmp_buffer));
   glk_exit_is_handleable = FALSE;
+  glk_exit_is_this_thread = FALSE;
+
+  /* Push out any Glk output the plugin has left buffered. */
+  if (plugin->ifpi_glk_flush_output)
+    plugin->ifpi_glk_flush_output ();
 
   if (status)
     {
@@ -916,6 +1188,7 @@ ifp_plugin_initialize (ifp_pluginref_t plugin, glkunix_startup_t *data)
       ifp_trace ("plugin: plugin's glkunix_startup_code failed");
     }
 
+  ifp_timing_stop (IFP_TIMING_PLUGIN_INITIALIZE, start);
   return status;
 }
 
@@ -964,6 +1237,7 @@ ifp_plugin_run (ifp_pluginref_t plugin)
   if (setjmp (glk_exit_jmp_buffer) == 0)
     {
       glk_exit_is_handleable = TRUE;
+      glk_exit_is_this_thread = TRUE;
       ifp_trace ("plugin: setjmp for plugin_%p", ifp_trace_pointer (plugin));
 
       plugin->state = PLUGIN_RUNNING;
@@ -976,6 +1250,11 @@ ifp_plugin_run (ifp_pluginref_t plugin)
 
   memset (&glk_exit_jmp_buffer, 0, sizeof (glk_exit_jmp_buffer));
   glk_exit_is_handleable = FALSE;
+  glk_exit_is_this_thread = FALSE;
+
+  /* Push out any Glk output the plugin has left buffered. */
+  if (plugin->ifpi_glk_flush_output)
+    plugin->ifpi_glk_flush_output ();
 
   /*
    * If this looks like a chaining plugin, clear the plugin search path we
@@ -1062,3 +1341,471 @@ ifp_plugin_cancel (ifp_pluginref_t plugin)
   longjmp (glk_exit_jmp_buffer, 1);
   ifp_fatal ("plugin: return from the dead");
 }
+
+
+/**
+ * ifp_plugin_set_heap_limits()
+ * ifp_plugin_get_heap_limits()
+ * ifp_plugin_set_file_limits()
+ * ifp_plugin_get_file_limits()
+ *
+ * Set and get soft and hard limits on the heap bytes and the open files
+ * and streams that a running plugin may hold; zero means no limit.  On
+ * passing a soft limit, IFP prints a notice, once per plugin run.  On
+ * passing a hard limit, IFP stops the plugin as if it had called
+ * glk_exit(), and the run ends in the usual way.  If the environment
+ * variables IFP_HEAP_LIMIT or IFP_FILE_LIMIT are set, they override any
+ * set hard limit.
+ */
+void
+ifp_plugin_set_heap_limits (size_t soft_limit, size_t hard_limit)
+{
+  ifp_trace ("plugin: ifp_plugin_set_heap_limits <- %zu %zu",
+             soft_limit, hard_limit);
+
+  ifp_plugin_heap_soft_limit = soft_limit;
+  ifp_plugin_heap_hard_limit = hard_limit;
+}
+
+void
+ifp_plugin_get_heap_limits (size_t *soft_limit, size_t *hard_limit)
+{
+  static size_t env_heap_hard_limit;
+  static int initialized = FALSE;
+  static const char *ifp_heap_limit;
+
+  if (!initialized)
+    {
+      ifp_heap_limit = getenv ("IFP_HEAP_LIMIT");
+      if (ifp_heap_limit)
+        {
+          env_heap_hard_limit = strtoul (ifp_heap_limit, NULL, 10);
+          ifp_notice ("plugin: %s initialized heap hard limit to %zu bytes",
+                      "IFP_HEAP_LIMIT", env_heap_hard_limit);
+        }
+      initialized = TRUE;
+    }
+
+  if (soft_limit)
+    *soft_limit = ifp_plugin_heap_soft_limit;
+  if (hard_limit)
+    *hard_limit = ifp_heap_limit
+                  ? env_heap_hard_limit : ifp_plugin_heap_hard_limit;
+}
+
+void
+ifp_plugin_set_file_limits (int soft_limit, int hard_limit)
+{
+  ifp_trace ("plugin: ifp_plugin_set_file_limits <- %d %d",
+             soft_limit, hard_limit);
+
+  ifp_plugin_file_soft_limit = soft_limit > 0 ? soft_limit : 0;
+  ifp_plugin_file_hard_limit = hard_limit > 0 ? hard_limit : 0;
+}
+
+void
+ifp_plugin_get_file_limits (int *soft_limit, int *hard_limit)
+{
+  static int env_file_hard_limit, initialized = FALSE;
+  static const char *ifp_file_limit;
+
+  if (!initialized)
+    {
+      ifp_file_limit = getenv ("IFP_FILE_LIMIT");
+      if (ifp_file_limit)
+        {
+          env_file_hard_limit = atoi (ifp_file_limit);
+          ifp_notice ("plugin: %s initialized file hard limit to %d files",
+                      "IFP_FILE_LIMIT", env_file_hard_limit);
+        }
+      initialized = TRUE;
+    }
+
+  if (soft_limit)
+    *soft_limit = ifp_plugin_file_soft_limit;
+  if (hard_limit)
+    *hard_limit = ifp_file_limit
+                  ? env_file_hard_limit : ifp_plugin_file_hard_limit;
+}
+
+
+/*
+ * ifp_plugin_stop_on_limit()
+ *
+ * Stop the running plugin on passing a hard resource limit.  This jumps
+ * out through the same route as a plugin call to glk_exit().  If no plugin
+ * is running, there is nothing to stop, and the function returns.  It also
+ * returns if called on a plugin thread other than the one running the
+ * plugin, leaving the stop to that thread's next check.
+ */
+static void
+ifp_plugin_stop_on_limit (void)
+{
+  if (!glk_exit_is_handleable || !glk_exit_is_this_thread)
+    return;
+
+  ifp_trace ("plugin: stopping plugin on hard limit");
+  longjmp (glk_exit_jmp_buffer, 1);
+  ifp_fatal ("plugin: return from the dead");
+}
+
+
+/*
+ * ifp_plugin_check_heap_usage()
+ * ifp_plugin_check_file_usage()
+ *
+ * Check heap bytes and open file counts from the Libc intercepts against
+ * any limits set, reporting soft limits and stopping the plugin on hard
+ * ones.  These may not return.
+ */
+void
+ifp_plugin_check_heap_usage (size_t current)
+{
+  size_t soft_limit, hard_limit;
+
+  ifp_plugin_get_heap_limits (&soft_limit, &hard_limit);
+
+  if (hard_limit > 0 && current > hard_limit)
+    {
+      ifp_error ("plugin: heap of %zu bytes exceeds hard limit of %zu",
+                 current, hard_limit);
+      ifp_plugin_stop_on_limit ();
+    }
+  else if (soft_limit > 0 && current > soft_limit
+           && !ifp_plugin_heap_soft_reported)
+    {
+      ifp_notice ("plugin: heap of %zu bytes exceeds soft limit of %zu",
+                  current, soft_limit);
+      ifp_plugin_heap_soft_reported = TRUE;
+    }
+}
+
+void
+ifp_plugin_check_file_usage (int current)
+{
+  int soft_limit, hard_limit;
+
+  ifp_plugin_get_file_limits (&soft_limit, &hard_limit);
+
+  if (hard_limit > 0 && current > hard_limit)
+    {
+      ifp_error ("plugin: %d open files exceeds hard limit of %d",
+                 current, hard_limit);
+      ifp_plugin_stop_on_limit ();
+    }
+  else if (soft_limit > 0 && current > soft_limit
+           && !ifp_plugin_file_soft_reported)
+    {
+      ifp_notice ("plugin: %d open files exceeds soft limit of %d",
+                  current, soft_limit);
+      ifp_plugin_file_soft_reported = TRUE;
+    }
+}
+
+
+/**
+ * ifp_plugin_get_usage()
+ *
+ * Return the resources held by a plugin: the heap bytes it has allocated,
+ * and the peak of this, the file descriptors and streams it has open, and
+ * the Glk windows, streams, file references, and sound channels that
+ * exist.  Any return pointer may be NULL.  Only one plugin runs at a time,
+ * so usage is that of the most recently run plugin, until it is cleaned
+ * up.  Returns FALSE if the plugin is not loaded.
+ */
+int
+ifp_plugin_get_usage (ifp_pluginref_t plugin,
+                      size_t *heap_current, size_t *heap_peak,
+                      int *open_files, int *open_streams, int *glk_objects)
+{
+  assert (ifp_plugin_is_valid (plugin));
+
+  ifp_trace ("plugin: ifp_plugin_get_usage <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  if (plugin->state == PLUGIN_UNLOADED)
+    {
+      ifp_error ("plugin: attempt to get usage of an unloaded plugin");
+      return FALSE;
+    }
+
+  ifp_memory_malloc_get_usage (heap_current, heap_peak);
+  ifp_file_get_usage (open_files, open_streams);
+
+  if (glk_objects)
+    {
+      winid_t window;
+      strid_t stream;
+      frefid_t fileref;
+      int count;
+
+      count = 0;
+      for (window = glk_window_iterate (NULL, NULL);
+           window; window = glk_window_iterate (window, NULL))
+        count++;
+      for (stream = glk_stream_iterate (NULL, NULL);
+           stream; stream = glk_stream_iterate (stream, NULL))
+        count++;
+      for (fileref = glk_fileref_iterate (NULL, NULL);
+           fileref; fileref = glk_fileref_iterate (fileref, NULL))
+        count++;
+      if (glk_gestalt (gestalt_Sound, 0))
+        {
+          schanid_t channel;
+
+          for (channel = glk_schannel_iterate (NULL, NULL);
+               channel; channel = glk_schannel_iterate (channel, NULL))
+            count++;
+        }
+      *glk_objects = count;
+    }
+
+  return TRUE;
+}
+
+
+/**
+ * ifp_plugin_get_allocation_counts()
+ *
+ * Copy up to length counts of a plugin's heap allocations, by size class,
+ * into counts, and return the number of size classes.  Class zero counts
+ * allocations of up to 16 bytes, and each following class doubles the
+ * upper bound, with the last taking all larger allocations.  Counts may be
+ * NULL, to find the number of classes.  Returns zero if the plugin is not
+ * loaded.
+ */
+int
+ifp_plugin_get_allocation_counts (ifp_pluginref_t plugin,
+                                  unsigned long *counts, int length)
+{
+  assert (ifp_plugin_is_valid (plugin));
+
+  ifp_trace ("plugin: ifp_plugin_get_allocation_counts <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  if (plugin->state == PLUGIN_UNLOADED)
+    {
+      ifp_error ("plugin: attempt to get usage of an unloaded plugin");
+      return 0;
+    }
+
+  return ifp_memory_malloc_get_class_counts (counts, length);
+}
+
+
+/*
+ * ifp_plugin_add_segments()
+ *
+ * Callback for dl_iterate_phdr().  On finding the plugin's shared object,
+ * identified by its link map, copy each writable loadable segment into the
+ * plugin's segments list, skipping any part made read-only after relocation.
+ */
+struct ifp_plugin_segment_search
+{
+  ifp_pluginref_t plugin;
+  struct link_map *link_map;
+};
+
+static int
+ifp_plugin_add_segments (struct dl_phdr_info *info, size_t size, void *data)
+{
+  struct ifp_plugin_segment_search *search = data;
+  ifp_pluginref_t plugin = search->plugin;
+  struct link_map *link_map = search->link_map;
+  ElfW(Addr) relro_start, relro_end;
+  long page_size;
+  int index_;
+  assert (size >= sizeof (*info));
+
+  if (info->dlpi_addr != link_map->l_addr
+      || strcmp (info->dlpi_name, link_map->l_name) != 0)
+    return 0;
+
+  /*
+   * Find any relocation read-only range.  The dynamic linker protects this
+   * to the page boundary below its end, so only that much is unwritable.
+   */
+  page_size = sysconf (_SC_PAGESIZE);
+  relro_start = relro_end = 0;
+  for (index_ = 0; index_ < info->dlpi_phnum; index_++)
+    {
+      const ElfW(Phdr) *phdr = info->dlpi_phdr + index_;
+
+      if (phdr->p_type == PT_GNU_RELRO)
+        {
+          relro_start = info->dlpi_addr + phdr->p_vaddr;
+          relro_end = (info->dlpi_addr + phdr->p_vaddr + phdr->p_memsz)
+                      & ~((ElfW(Addr)) page_size - 1);
+        }
+    }
+
+  for (index_ = 0; index_ < info->dlpi_phnum; index_++)
+    {
+      const ElfW(Phdr) *phdr = info->dlpi_phdr + index_;
+      ElfW(Addr) start, end;
+      struct ifp_plugin_segment *segment;
+
+      if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_W))
+        continue;
+
+      start = info->dlpi_addr + phdr->p_vaddr;
+      end = start + phdr->p_memsz;
+      if (start >= relro_start && start < relro_end)
+        start = relro_end;
+      if (end <= start)
+        continue;
+
+      plugin->segments = ifp_realloc (plugin->segments,
+                                      (plugin->segment_count + 1)
+                                      * sizeof (*plugin->segments));
+      segment = plugin->segments + plugin->segment_count++;
+      segment->address = (void *) start;
+      segment->size = end - start;
+      segment->contents = ifp_malloc (segment->size);
+      memcpy (segment->contents, segment->address, segment->size);
+
+      ifp_trace ("plugin: copied %zu byte segment at %p",
+                 segment->size, segment->address);
+    }
+
+  return 1;
+}
+
+
+/*
+ * ifp_plugin_discard_segments()
+ *
+ * Free any copies of writable data segments held for a plugin.
+ */
+static void
+ifp_plugin_discard_segments (ifp_pluginref_t plugin)
+{
+  int index_;
+
+  for (index_ = 0; index_ < plugin->segment_count; index_++)
+    ifp_free (plugin->segments[index_].contents);
+
+  ifp_free (plugin->segments);
+  plugin->segments = NULL;
+  plugin->segment_count = 0;
+}
+
+
+/**
+ * ifp_plugin_checkpoint()
+ *
+ * Copy the writable data segments of an initialized plugin, so that it can
+ * later be returned to its just-initialized state by ifp_plugin_restore().
+ * This covers only the plugin's static data; the caller is responsible for
+ * checkpointing its heap and files.  Chaining plugins cannot be checkpointed.
+ * Returns TRUE if the checkpoint was taken.
+ */
+int
+ifp_plugin_checkpoint (ifp_pluginref_t plugin)
+{
+  struct ifp_plugin_segment_search search;
+  assert (ifp_plugin_is_valid (plugin));
+
+  ifp_trace ("plugin: ifp_plugin_checkpoint <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  if (plugin->state != PLUGIN_INITIALIZED)
+    {
+      ifp_error ("plugin: attempt to checkpoint an uninitialized plugin");
+      return FALSE;
+    }
+
+  if (ifp_plugin_can_chain (plugin))
+    {
+      ifp_trace ("plugin: chaining plugins cannot be checkpointed");
+      return FALSE;
+    }
+
+  ifp_plugin_discard_segments (plugin);
+
+  search.plugin = plugin;
+  if (dlinfo (plugin->handle, RTLD_DI_LINKMAP, &search.link_map) != 0
+      || dl_iterate_phdr (ifp_plugin_add_segments, &search) != 1)
+    {
+      ifp_error ("plugin: unable to locate data segments for plugin %s-%s",
+                 ifp_plugin_engine_name (plugin),
+                 ifp_plugin_engine_version (plugin));
+      ifp_plugin_discard_segments (plugin);
+      return FALSE;
+    }
+
+  ifp_trace ("plugin: checkpointed %d segment(s)", plugin->segment_count);
+  return TRUE;
+}
+
+
+/**
+ * ifp_plugin_has_checkpoint()
+ *
+ * Returns TRUE if the plugin holds a checkpoint, otherwise FALSE.
+ */
+int
+ifp_plugin_has_checkpoint (ifp_pluginref_t plugin)
+{
+  assert (ifp_plugin_is_valid (plugin));
+
+  return plugin->segment_count > 0;
+}
+
+
+/**
+ * ifp_plugin_restore()
+ *
+ * Return a finished plugin's writable data segments to their state at its
+ * checkpoint, and make it runnable again.  The checkpoint is kept, so the
+ * plugin may be restored repeatedly.
+ */
+int
+ifp_plugin_restore (ifp_pluginref_t plugin)
+{
+  int index_;
+  assert (ifp_plugin_is_valid (plugin));
+
+  ifp_trace ("plugin: ifp_plugin_restore <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  if (plugin->state != PLUGIN_FINISHED)
+    {
+      ifp_error ("plugin: attempt to restore an unfinished plugin");
+      return FALSE;
+    }
+
+  if (plugin->segment_count == 0)
+    {
+      ifp_error ("plugin: attempt to restore a plugin with no checkpoint");
+      return FALSE;
+    }
+
+  for (index_ = 0; index_ < plugin->segment_count; index_++)
+    {
+      struct ifp_plugin_segment *segment = plugin->segments + index_;
+
+      memcpy (segment->address, segment->contents, segment->size);
+    }
+
+  plugin->state = PLUGIN_INITIALIZED;
+  ifp_trace ("plugin: restored %d segment(s)", plugin->segment_count);
+  return TRUE;
+}
+
+
+/**
+ * ifp_plugin_discard_checkpoint()
+ *
+ * Release any checkpoint held for a plugin.
+ */
+void
+ifp_plugin_discard_checkpoint (ifp_pluginref_t plugin)
+{
+  assert (ifp_plugin_is_valid (plugin));
+
+  ifp_trace ("plugin: ifp_plugin_discard_checkpoint <-"
+             " plugin_%p", ifp_trace_pointer (plugin));
+
+  ifp_plugin_discard_segments (plugin);
+}
@@ -24,6 +24,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_PREFERENCES
+
 /* Preferences set magic identifier, for safety purposes. */
 static const unsigned int PREF_MAGIC = 0x291e8779;
 
@@ -27,6 +27,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_RECOGNIZER
+
 
 /**
  * ifp_recognizer_match_string()
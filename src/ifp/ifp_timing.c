@@ -0,0 +1,222 @@
+/* vi: set ts=2 shiftwidth=2 expandtab:
+ *
+ * Copyright (C) 2001-2007  Simon Baldwin (simon_baldwin@yahoo.com)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ifp.h"
+#include "ifp_internal.h"
+
+#define IFP_TRACE_FACILITY IFP_TRACE_TIMING
+
+/*
+ * Startup phase timing.  Each phase of launching a game -- reading the
+ * configuration, loading Glk, searching for and loading plugins, resolving
+ * the game URL, recognizing it, completing the chosen plugin's load,
+ * cloning, resetting Glk, garbage collecting, and initializing the chosen
+ * plugin -- is bracketed by calls to start and stop, which accumulate a
+ * count and total monotonic-clock time for the phase.  Phases are coarse
+ * and few, so timing is always on; selection only controls whether players
+ * report timings on exit.
+ */
+
+/* Timing report selection flag, set by the direct interface. */
+static int ifp_timing_selected = FALSE;
+
+/*
+ * Per-phase call counts and cumulative times.  All phases are timed on the
+ * main thread today; updates are atomic only so that a phase timed from
+ * another thread later would not lose counts.
+ */
+typedef struct
+{
+  unsigned long calls;
+  unsigned long long nanoseconds;
+} ifp_timing_record_t;
+
+static ifp_timing_record_t ifp_timing_records[IFP_TIMING_PHASES];
+
+/* Names of timed phases, in the order of enum ifp_timing_phase. */
+static const char *const TIMING_PHASE_NAMES[IFP_TIMING_PHASES] = {
+  "config read", "glk load", "plugin search", "plugin load",
+  "url resolve", "recognize", "plugin complete", "clone", "glk reset",
+  "garbage collect", "plugin initialize"
+};
+
+
+/**
+ * ifp_timing_select()
+ * ifp_timing_is_selected()
+ *
+ * Select or deselect reporting of startup phase timings, and return the
+ * current selection.  Setting the IFP_TIMINGS environment variable overrides
+ * any selection made by the direct interface.  Timings are gathered whether
+ * or not reporting is selected.
+ */
+void
+ifp_timing_select (int flag)
+{
+  ifp_trace ("timing: reporting set to %d", flag);
+  ifp_timing_selected = flag;
+}
+
+int
+ifp_timing_is_selected (void)
+{
+  static int initialized = FALSE;
+  static const char *ifp_timings;
+
+  if (!initialized)
+    {
+      ifp_timings = getenv ("IFP_TIMINGS");
+      if (ifp_timings)
+        ifp_notice ("timing: %s initialized startup timing reports",
+                    "IFP_TIMINGS");
+      initialized = TRUE;
+    }
+
+  return ifp_timings ? TRUE : ifp_timing_selected;
+}
+
+
+/*
+ * ifp_timing_start()
+ * ifp_timing_stop()
+ *
+ * Return a monotonic start time for a phase, and on its completion,
+ * accumulate the elapsed time since that start into the phase's record.
+ */
+unsigned long long
+ifp_timing_start (void)
+{
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void
+ifp_timing_stop (int phase, unsigned long long start)
+{
+  ifp_timing_record_t *record;
+  unsigned long long elapsed;
+  assert (phase >= 0 && phase < IFP_TIMING_PHASES);
+
+  elapsed = ifp_timing_start () - start;
+
+  record = ifp_timing_records + phase;
+  __atomic_add_fetch (&record->calls, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&record->nanoseconds, elapsed, __ATOMIC_RELAXED);
+
+  ifp_trace ("timing: %s took %llu ns", TIMING_PHASE_NAMES[phase], elapsed);
+}
+
+
+/**
+ * ifp_timing_reset()
+ *
+ * Clear all accumulated startup phase timings.
+ */
+void
+ifp_timing_reset (void)
+{
+  ifp_trace ("timing: ifp_timing_reset <- void");
+
+  memset (ifp_timing_records, 0, sizeof (ifp_timing_records));
+}
+
+
+/**
+ * ifp_timing_get_count()
+ *
+ * Return the number of startup phases timed.  Valid phase indexes for
+ * ifp_timing_get_entry() run from zero to one less than this count.
+ */
+int
+ifp_timing_get_count (void)
+{
+  return IFP_TIMING_PHASES;
+}
+
+
+/**
+ * ifp_timing_get_entry()
+ *
+ * Return the name of the startup phase at the given index, the number of
+ * times it ran, and its cumulative time in nanoseconds.  Any of the return
+ * pointers may be NULL.  Returns FALSE if the index is out of range.
+ */
+int
+ifp_timing_get_entry (int index_, const char **name,
+                      unsigned long *calls, unsigned long long *nanoseconds)
+{
+  const ifp_timing_record_t *record;
+
+  if (index_ < 0 || index_ >= IFP_TIMING_PHASES)
+    {
+      ifp_error ("timing: phase index %d is out of range", index_);
+      return FALSE;
+    }
+
+  record = ifp_timing_records + index_;
+  if (name)
+    *name = TIMING_PHASE_NAMES[index_];
+  if (calls)
+    *calls = __atomic_load_n (&record->calls, __ATOMIC_RELAXED);
+  if (nanoseconds)
+    *nanoseconds = __atomic_load_n (&record->nanoseconds, __ATOMIC_RELAXED);
+
+  return TRUE;
+}
+
+
+/**
+ * ifp_timing_report()
+ *
+ * Print accumulated startup phase timings on stderr, in pipeline order,
+ * omitting phases that have not run.  Plugin search time includes the
+ * loading of the plugins found, clone time includes loading the clone, and
+ * recognize and clone times include completing the loads of plugins chosen.
+ */
+void
+ifp_timing_report (void)
+{
+  int index_;
+
+  ifp_trace ("timing: ifp_timing_report <- void");
+
+  fprintf (stderr, "%-20s %8s %12s %12s\n",
+           "startup phase", "calls", "total ms", "mean us");
+
+  for (index_ = 0; index_ < IFP_TIMING_PHASES; index_++)
+    {
+      unsigned long calls;
+      unsigned long long nanoseconds;
+
+      ifp_timing_get_entry (index_, NULL, &calls, &nanoseconds);
+      if (calls > 0)
+        fprintf (stderr, "%-20s %8lu %12.3f %12.1f\n",
+                 TIMING_PHASE_NAMES[index_], calls, nanoseconds / 1000000.0,
+                 nanoseconds / 1000.0 / calls);
+    }
+}
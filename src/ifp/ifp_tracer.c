@@ -24,6 +24,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "ifp.h"
 #include "ifp_internal.h"
@@ -39,8 +42,8 @@
  * from here, it'll go to the plugin-side strdup, in libc_proxy, wind up in
  * ifp_libc_intercept_strdup() after passing through the libc interface, and
  * guess what - ifp_libc_intercept_strdup() makes a call to the function
- * ifp_memory_malloc_add_address(), which calls ifp_trace(), which calls
- * ifp_trace_check_selector(), which calls strdup, and around we go...
+ * ifp_memory_malloc_add_address(), which calls ifp_trace(), which, if it
+ * called strdup to examine trace selectors, would send us around again...
  *
  * Of course, this shows up only when you turn tracing on, but it's unpleasant,
  * and renders the program useless.  Besides, tracing is allowed to be somewhat
@@ -48,130 +51,777 @@
  */
 
 /*
- * Trace selector set by the direct interface, and flag indicating if error
- * messages are enabled.  Fatal errors are always printed, but "ordinary" ones
- * may be turned off.
+ * Names of trace facilities, as given in trace selectors, in the order of
+ * enum ifp_trace_facility.
  */
-static const char *ifp_trace_selector = NULL;
+static const char *const TRACE_FACILITY_NAMES[IFP_TRACE_FACILITIES] = {
+  "blorb", "cache", "chain", "config", "elf", "file", "finalizer", "ftp",
+  "glkloader", "glkprofile", "glkrecord", "glkstream", "header", "http",
+  "index", "libc", "loader", "main", "manager", "memory", "plugin",
+  "preferences", "recognizer", "timing", "unarchive", "uncompress", "url",
+  "util"
+};
+
+/*
+ * Mask of facilities traced in any way, one bit per facility, and the masks
+ * of facilities printed and recorded in trace rings that make it up.  The
+ * main mask is all set until the IFP_TRACE environment variables have been
+ * read, so that the first trace call of any facility comes here to read
+ * them.
+ */
+unsigned int ifp_trace_mask = ~0u;
+static unsigned int ifp_trace_print_mask = 0,
+                    ifp_trace_ring_mask = 0;
+
+/*
+ * Trace selector set by the direct interface, the ones read from IFP_TRACE
+ * and IFP_TRACE_RING, and flag indicating if error messages are enabled.
+ * Fatal errors are always printed, but "ordinary" ones may be turned off.
+ * Unless IFP_TRACE_RING says otherwise, loader, manager, and URL activity
+ * is always recorded in trace rings.
+ */
+static const char *ifp_trace_selector = NULL,
+                  *ifp_trace_env_selector = NULL,
+                  *ifp_trace_ring_selector = "loader manager url";
+static int ifp_trace_initialized = FALSE;
+
+/*
+ * Trace rings.  Each thread that traces a ring facility claims a ring of
+ * its own, so that recording needs no locks, and releases it on exit for
+ * a later thread to reuse, keeping the records already in it; threads that
+ * find every ring claimed are not recorded.  A plugin's copy of this module
+ * never releases rings, since a thread exit handler would outlive the
+ * plugin's unloading.  A record holds a timestamp, the facility, the
+ * unformatted message and its arguments, with copies of any strings, and
+ * is formatted only when rings are dumped.  A record's sequence number is
+ * cleared while it is being written, so that a dump can skip records that
+ * change under it.  Rings are static, as this module may not malloc.
+ */
+enum { TRACE_RINGS = 8, TRACE_RING_RECORDS = 256,
+       TRACE_RECORD_ARGUMENTS = 8, TRACE_RECORD_STRINGS = 96 };
+
+union ifp_trace_argument
+{
+  long long integer;
+  unsigned long long unsigned_integer;
+  double real;
+  const void *pointer;
+  int string;
+};
+
+struct ifp_trace_record
+{
+  unsigned long sequence;
+  unsigned long long timestamp;
+  const char *format;
+  int facility, argument_count, is_truncated;
+  union ifp_trace_argument arguments[TRACE_RECORD_ARGUMENTS];
+  char strings[TRACE_RECORD_STRINGS];
+};
+typedef struct ifp_trace_record *ifp_trace_recordref_t;
+
+struct ifp_trace_ring
+{
+  unsigned long head;
+  int is_claimed;
+  struct ifp_trace_record records[TRACE_RING_RECORDS];
+};
+typedef struct ifp_trace_ring *ifp_trace_ringref_t;
+
+/*
+ * Rings, the count of rings ever claimed, the calling thread's ring, and the
+ * key whose destructor releases a thread's ring when the thread exits.
+ */
+static struct ifp_trace_ring ifp_trace_rings[TRACE_RINGS];
+static int ifp_trace_ring_count = 0;
+static __thread int ifp_trace_ring_index = -1;
+static pthread_key_t ifp_trace_ring_key;
+static pthread_once_t ifp_trace_ring_key_once = PTHREAD_ONCE_INIT;
+static int ifp_trace_ring_key_created = FALSE;
+
+/*
+ * Fatal signals on which to dump trace rings, the handlers they replaced,
+ * and a flag set when ifp_fatal() has already dumped rings ahead of its
+ * abort.
+ */
+static const int TRACE_DUMP_SIGNALS[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE,
+                                          SIGABRT, 0 };
+static struct sigaction ifp_trace_prior_actions[NSIG];
+static int ifp_trace_handlers_installed = FALSE,
+           ifp_trace_is_fatal_dumped = FALSE;
 static int ifp_error_messages = TRUE;
 
 
-/**
- * ifp_trace_select()
+/*
+ * ifp_trace_parse_selector()
  *
- * Set a tracing selector string.  This string augments any found in the
- * IFP_TRACE environment variable.
+ * Convert a trace selector, a space separated list of facility names, into
+ * a mask of facility bits.  NULL selects nothing, and "all" or "*" selects
+ * everything.  Parsing is done in place, without copying the selector.
  */
-void
-ifp_trace_select (const char *selector)
+static unsigned int
+ifp_trace_parse_selector (const char *selector)
 {
-  ifp_trace_selector = selector;
+  unsigned int mask;
+  const char *word;
+
+  if (!selector)
+    return 0;
+  else if (strcasecmp (selector, "all") == 0 || strcmp (selector, "*") == 0)
+    return ~0u;
+
+  mask = 0;
+  for (word = selector; *word; )
+    {
+      int length, facility;
+
+      /* Find the next word, and its length. */
+      while (*word == ' ')
+        word++;
+      length = strcspn (word, " ");
+      if (length == 0)
+        break;
+
+      /* Match it against the facility names. */
+      for (facility = 0; facility < IFP_TRACE_FACILITIES; facility++)
+        {
+          const char *name = TRACE_FACILITY_NAMES[facility];
+
+          if (strncmp (word, name, length) == 0 && name[length] == '\0')
+            {
+              mask |= 1u << facility;
+              break;
+            }
+        }
+      if (facility == IFP_TRACE_FACILITIES)
+        ifp_notice ("tracer: unknown trace facility '%.*s'", length, word);
+
+      word += length;
+    }
+
+  return mask;
 }
 
 
 /*
- * ifp_trace_check_selector()
+ * ifp_trace_parse_conversion()
  *
- * Given a format string, find the facility from it (the bit up to the first
- * ':').  Search for this in the trace selector, and if found, return TRUE.
+ * Parse the printf conversion specification that starts at the '%' given.
+ * Returns the address just past it, and sets the conversion character, the
+ * length modifier as one character ('H' for "hh" and 'q' for "ll", or NUL
+ * if none), and the count of '*' widths and precisions that it takes as
+ * arguments.
+ */
+static const char *
+ifp_trace_parse_conversion (const char *spec, char *conversion,
+                            char *modifier, int *stars)
+{
+  const char *cursor;
+
+  assert (*spec == '%');
+
+  *stars = 0;
+  for (cursor = spec + 1; strchr ("#0- +'", *cursor) && *cursor; cursor++)
+    ;
+  for (; (*cursor >= '0' && *cursor <= '9')
+         || *cursor == '.' || *cursor == '*'; cursor++)
+    {
+      if (*cursor == '*')
+        (*stars)++;
+    }
+
+  *modifier = '\0';
+  if (*cursor && strchr ("hlLjzt", *cursor))
+    {
+      *modifier = *cursor++;
+      if (*modifier == 'h' && *cursor == 'h')
+        {
+          *modifier = 'H';
+          cursor++;
+        }
+      else if (*modifier == 'l' && *cursor == 'l')
+        {
+          *modifier = 'q';
+          cursor++;
+        }
+    }
+
+  *conversion = *cursor;
+  return *cursor ? cursor + 1 : cursor;
+}
+
+
+/*
+ * ifp_trace_ring_capture()
+ *
+ * Fill a trace record with the arguments for its format.  Integers are
+ * widened, and strings are copied into the record, truncated if they do not
+ * fit.  Capture stops at any conversion not understood, or when the record
+ * has no room for more arguments, and the record is marked truncated.
+ */
+static void
+ifp_trace_ring_capture (ifp_trace_recordref_t record, va_list ap)
+{
+  const char *cursor;
+  int string_length;
+
+  record->argument_count = 0;
+  record->is_truncated = FALSE;
+  string_length = 0;
+
+  for (cursor = strchr (record->format, '%'); cursor;
+       cursor = strchr (cursor, '%'))
+    {
+      char conversion, modifier;
+      int stars;
+      union ifp_trace_argument *argument;
+
+      cursor = ifp_trace_parse_conversion (cursor, &conversion,
+                                           &modifier, &stars);
+      if (conversion == '%')
+        continue;
+
+      if (record->argument_count + stars + 1 > TRACE_RECORD_ARGUMENTS
+          || !strchr ("diouxXcspeEfFgGaA", conversion) || modifier == 'L')
+        {
+          record->is_truncated = TRUE;
+          return;
+        }
+
+      for (; stars > 0; stars--)
+        {
+          argument = record->arguments + record->argument_count++;
+          argument->integer = va_arg (ap, int);
+        }
+
+      argument = record->arguments + record->argument_count++;
+      switch (conversion)
+        {
+        case 'd': case 'i':
+          if (modifier == 'q' || modifier == 'j')
+            argument->integer = va_arg (ap, long long);
+          else if (modifier == 'l' || modifier == 'z' || modifier == 't')
+            argument->integer = va_arg (ap, long);
+          else if (modifier == 'h')
+            argument->integer = (short) va_arg (ap, int);
+          else if (modifier == 'H')
+            argument->integer = (signed char) va_arg (ap, int);
+          else
+            argument->integer = va_arg (ap, int);
+          break;
+
+        case 'o': case 'u': case 'x': case 'X':
+          if (modifier == 'q' || modifier == 'j')
+            argument->unsigned_integer = va_arg (ap, unsigned long long);
+          else if (modifier == 'l' || modifier == 'z' || modifier == 't')
+            argument->unsigned_integer = va_arg (ap, unsigned long);
+          else if (modifier == 'h')
+            argument->unsigned_integer = (unsigned short) va_arg (ap, int);
+          else if (modifier == 'H')
+            argument->unsigned_integer = (unsigned char) va_arg (ap, int);
+          else
+            argument->unsigned_integer = va_arg (ap, unsigned int);
+          break;
+
+        case 'c':
+          argument->integer = va_arg (ap, int);
+          break;
+
+        case 'p':
+          argument->pointer = va_arg (ap, const void *);
+          break;
+
+        case 's':
+          {
+            const char *string;
+            int length;
+
+            string = va_arg (ap, const char *);
+            if (!string)
+              {
+                argument->string = -1;
+                break;
+              }
+
+            length = strlen (string);
+            if (length > TRACE_RECORD_STRINGS - string_length - 1)
+              length = TRACE_RECORD_STRINGS - string_length - 1;
+            memcpy (record->strings + string_length, string, length);
+            record->strings[string_length + length] = '\0';
+            argument->string = string_length;
+            string_length += length + 1;
+            if (string_length >= TRACE_RECORD_STRINGS)
+              string_length = TRACE_RECORD_STRINGS - 1;
+            break;
+          }
+
+        default:
+          argument->real = va_arg (ap, double);
+          break;
+        }
+    }
+}
+
+
+/*
+ * ifp_trace_ring_release()
+ * ifp_trace_ring_create_key()
+ *
+ * Release a ring claimed by a thread that is exiting, and create the key
+ * that arranges this, except in a plugin's copy of this module.
+ */
+static void
+ifp_trace_ring_release (void *ring)
+{
+  __atomic_store_n (&((ifp_trace_ringref_t) ring)->is_claimed,
+                    FALSE, __ATOMIC_RELEASE);
+}
+
+static void
+ifp_trace_ring_create_key (void)
+{
+  if (!ifp_self_inside_plugin ())
+    {
+      ifp_trace_ring_key_created =
+          pthread_key_create (&ifp_trace_ring_key,
+                              ifp_trace_ring_release) == 0;
+    }
+}
+
+
+/*
+ * ifp_trace_ring_claim()
+ *
+ * Claim the first unclaimed ring for the calling thread, and arrange for
+ * its release when the thread exits.  Returns the ring's index, or -1 if
+ * every ring is claimed.
  */
 static int
-ifp_trace_check_selector (const char *selector, const char *format)
+ifp_trace_ring_claim (void)
 {
-  char facility[1024], *facility_end;
+  int index_;
 
-  /* Special cases: NULL traces nothing, and "all"/"*" traces everything. */
-  if (!selector)
-    return FALSE;
-  else if (strcasecmp (selector, "all") == 0 || strcmp (selector, "*") == 0)
-    return TRUE;
+  for (index_ = 0; index_ < TRACE_RINGS; index_++)
+    {
+      ifp_trace_ringref_t ring;
+      int is_claimed, count;
+
+      ring = ifp_trace_rings + index_;
+      is_claimed = __atomic_load_n (&ring->is_claimed, __ATOMIC_RELAXED);
+      if (is_claimed
+          || !__atomic_compare_exchange_n (&ring->is_claimed, &is_claimed,
+                                           TRUE, FALSE, __ATOMIC_ACQUIRE,
+                                           __ATOMIC_RELAXED))
+        continue;
+
+      /* Raise the count of rings ever claimed to cover this one. */
+      count = __atomic_load_n (&ifp_trace_ring_count, __ATOMIC_RELAXED);
+      while (count <= index_
+             && !__atomic_compare_exchange_n (&ifp_trace_ring_count, &count,
+                                              index_ + 1, FALSE,
+                                              __ATOMIC_RELAXED,
+                                              __ATOMIC_RELAXED))
+        ;
+
+      pthread_once (&ifp_trace_ring_key_once, ifp_trace_ring_create_key);
+      if (ifp_trace_ring_key_created)
+        pthread_setspecific (ifp_trace_ring_key, ring);
+
+      return index_;
+    }
+
+  return -1;
+}
+
+
+/*
+ * ifp_trace_ring_record()
+ *
+ * Record a trace message in the calling thread's trace ring, claiming a
+ * ring for the thread if it has none.
+ */
+static void
+ifp_trace_ring_record (int facility, const char *format, va_list ap)
+{
+  ifp_trace_ringref_t ring;
+  ifp_trace_recordref_t record;
+  struct timespec now;
+  unsigned long head;
+
+  if (ifp_trace_ring_index == -1)
+    {
+      ifp_trace_ring_index = ifp_trace_ring_claim ();
+      if (ifp_trace_ring_index == -1)
+        return;
+    }
+
+  ring = ifp_trace_rings + ifp_trace_ring_index;
+  head = ring->head;
+  record = ring->records + head % TRACE_RING_RECORDS;
+
+  __atomic_store_n (&record->sequence, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  record->timestamp = now.tv_sec * 1000000000ull + now.tv_nsec;
+  record->facility = facility;
+  record->format = format;
+  ifp_trace_ring_capture (record, ap);
+
+  __atomic_store_n (&record->sequence, head + 1, __ATOMIC_RELEASE);
+  __atomic_store_n (&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * ifp_trace_ring_format()
+ *
+ * Print a captured trace record's message, re-running each conversion in
+ * its format against the argument captured for it.
+ */
+static void
+ifp_trace_ring_format (ifp_trace_recordref_t record)
+{
+  const char *cursor, *percent;
+  int argument;
 
-  /* Take a local copy of the format string. */
-  memset (facility, 0, sizeof (facility));
-  strncpy (facility, format, sizeof (facility) - 1);
+  argument = 0;
+  for (cursor = record->format; *cursor; )
+    {
+      char spec[64], conversion, modifier;
+      const char *next, *copy;
+      int stars, length;
+      union ifp_trace_argument *value;
+
+      percent = strchr (cursor, '%');
+      if (!percent)
+        {
+          fputs (cursor, stderr);
+          break;
+        }
+      fwrite (cursor, 1, percent - cursor, stderr);
+
+      next = ifp_trace_parse_conversion (percent, &conversion,
+                                         &modifier, &stars);
+      if (conversion == '%')
+        {
+          fputc ('%', stderr);
+          cursor = next;
+          continue;
+        }
+      if (argument + stars + 1 > record->argument_count)
+        break;
+
+      /*
+       * Rebuild the conversion with '*'s replaced by their captured values,
+       * and integer length modifiers replaced by "ll".
+       */
+      length = 0;
+      for (copy = percent;
+           copy < next - 1 && length < (int) sizeof (spec) - 24; copy++)
+        {
+          if (*copy == '*')
+            length += sprintf (spec + length, "%d",
+                               (int) record->arguments[argument++].integer);
+          else if (!strchr ("hlLjzt", *copy))
+            spec[length++] = *copy;
+        }
+      if (strchr ("diouxX", conversion))
+        {
+          spec[length++] = 'l';
+          spec[length++] = 'l';
+        }
+      spec[length++] = conversion;
+      spec[length] = '\0';
+
+      value = record->arguments + argument++;
+      switch (conversion)
+        {
+        case 'd': case 'i':
+          fprintf (stderr, spec, value->integer);
+          break;
+        case 'c':
+          fprintf (stderr, spec, (int) value->integer);
+          break;
+        case 'o': case 'u': case 'x': case 'X':
+          fprintf (stderr, spec, value->unsigned_integer);
+          break;
+        case 'p':
+          fprintf (stderr, spec, value->pointer);
+          break;
+        case 's':
+          fprintf (stderr, spec, value->string == -1
+                                 ? "(null)" : record->strings + value->string);
+          break;
+        default:
+          fprintf (stderr, spec, value->real);
+          break;
+        }
+
+      cursor = next;
+    }
+}
+
+
+/**
+ * ifp_trace_dump()
+ *
+ * Print the contents of all trace rings to stderr, merged into timestamp
+ * order.  Rings are dumped automatically on fatal errors and fatal signals;
+ * this function dumps them on demand, and leaves them intact.
+ */
+void
+ifp_trace_dump (void)
+{
+  unsigned long cursors[TRACE_RINGS], ends[TRACE_RINGS];
+  unsigned long long first;
+  int rings, index_, count;
+
+  rings = __atomic_load_n (&ifp_trace_ring_count, __ATOMIC_RELAXED);
 
   /*
-   * Isolate the facility, all up to ':', then return TRUE if what remains
-   * is in the selector.
+   * Dump from each ring's oldest record up to its newest at the start of the
+   * dump, so that threads still tracing cannot keep the dump going.
    */
-  facility_end = strchr (facility, ':');
-  if (facility_end && facility_end != facility)
+  for (index_ = 0; index_ < rings; index_++)
     {
-      const char *match;
-      int length;
-
-      /* Search for exact word match in the selector. */
-      *facility_end = '\0';
-      length = strlen (facility);
-      match = strstr (selector, facility);
-      return match
-             && (match == selector || match[-1] == ' ')
-             && (match[length] == ' ' || match[length] == '\0');
+      ends[index_] = __atomic_load_n (&ifp_trace_rings[index_].head,
+                                      __ATOMIC_ACQUIRE);
+      cursors[index_] = ends[index_] > TRACE_RING_RECORDS
+                        ? ends[index_] - TRACE_RING_RECORDS : 0;
+    }
+
+  fprintf (stderr, "IFP trace ring dump, %d ring(s):\n", rings);
+
+  first = 0;
+  count = 0;
+  for (;;)
+    {
+      struct ifp_trace_record record;
+      int oldest;
+
+      /* Find the ring with the oldest undumped, intact record. */
+      oldest = -1;
+      for (index_ = 0; index_ < rings; index_++)
+        {
+          ifp_trace_ringref_t ring = ifp_trace_rings + index_;
+          ifp_trace_recordref_t candidate;
+          unsigned long sequence;
+
+          while (cursors[index_] < ends[index_])
+            {
+              candidate = ring->records + cursors[index_] % TRACE_RING_RECORDS;
+              sequence = __atomic_load_n (&candidate->sequence,
+                                          __ATOMIC_ACQUIRE);
+              if (sequence == cursors[index_] + 1)
+                break;
+              cursors[index_]++;
+            }
+          if (cursors[index_] == ends[index_])
+            continue;
+
+          candidate = ring->records + cursors[index_] % TRACE_RING_RECORDS;
+          if (oldest == -1
+              || candidate->timestamp < record.timestamp)
+            {
+              oldest = index_;
+              record = *candidate;
+            }
+        }
+      if (oldest == -1)
+        break;
+
+      /* Skip the record if overwritten while copying. */
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      if (__atomic_load_n (&ifp_trace_rings[oldest].records
+                               [cursors[oldest] % TRACE_RING_RECORDS].sequence,
+                           __ATOMIC_RELAXED) == cursors[oldest] + 1)
+        {
+          unsigned long long offset;
+
+          if (count++ == 0)
+            first = record.timestamp;
+          offset = record.timestamp - first;
+
+          fprintf (stderr, "%5llu.%06llu t%d ",
+                   offset / 1000000000ull, offset % 1000000000ull / 1000,
+                   oldest);
+          ifp_trace_ring_format (&record);
+          fprintf (stderr, "%s\n", record.is_truncated ? " ..." : "");
+        }
+      cursors[oldest]++;
     }
 
-  /* Either no ':' in the format passed in, or nothing precedes it. */
-  return FALSE;
+  fprintf (stderr, "IFP trace ring dump ends, %d record(s)\n", count);
+  fflush (stderr);
 }
 
 
 /*
- * ifp_trace()
+ * ifp_trace_signal_catcher()
  *
- * On the first call, this function looks for an environment variable
- * IFP_TRACE.  If set, then the value is taken as the trace selector.  Next,
- * the trace selector is searched for any occurrence of the name of the
- * calling module, and if found, the trace message is printed.
+ * Dump trace rings on a fatal signal, then reinstate the handler that this
+ * one replaced and raise the signal again for it.  It is delivered to that
+ * handler on return from here.
+ */
+static void
+ifp_trace_signal_catcher (int signum)
+{
+  assert (signum > 0 && signum < NSIG);
+
+  if (!(signum == SIGABRT && ifp_trace_is_fatal_dumped))
+    {
+      fprintf (stderr, "IFP caught signal %d\n", signum);
+      ifp_trace_dump ();
+    }
+
+  sigaction (signum, ifp_trace_prior_actions + signum, NULL);
+  raise (signum);
+}
+
+
+/*
+ * ifp_trace_install_handlers()
  *
- * Trace selection can also be set by the ifp_trace_select() function.  If
- * both ifp_trace_select() and IFP_TRACE are used, the message is printed if
- * the module is listed in either selector.
+ * Install signal handlers that dump trace rings on fatal signals.
  */
-void
-ifp_trace (const char *format, ...)
+static void
+ifp_trace_install_handlers (void)
 {
-  static int initialized = FALSE;
-  static const char *env_trace_selector = NULL;
-  assert (format);
+  struct sigaction action;
+  int index_;
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = ifp_trace_signal_catcher;
+  sigemptyset (&action.sa_mask);
+  action.sa_flags = 0;
 
-  /* Look for the environment variable to trigger tracing. */
-  if (!initialized)
+  for (index_ = 0; TRACE_DUMP_SIGNALS[index_] != 0; index_++)
     {
-      env_trace_selector = getenv ("IFP_TRACE");
-      if (env_trace_selector)
+      int signum = TRACE_DUMP_SIGNALS[index_];
+
+      if (sigaction (signum, &action, ifp_trace_prior_actions + signum) == -1)
+        ifp_error ("tracer: failed to install signal %d handler", signum);
+    }
+
+  ifp_trace_handlers_installed = TRUE;
+}
+
+
+/*
+ * ifp_trace_update_mask()
+ *
+ * Recompute the trace masks from the trace selectors.  On the first call,
+ * this function looks for environment variables IFP_TRACE and IFP_TRACE_RING,
+ * and if set, takes their values as the environment's trace selector and
+ * the trace ring selector.  If any facility is recorded in trace rings,
+ * it installs the handlers that dump them on fatal signals.
+ */
+static void
+ifp_trace_update_mask (void)
+{
+  if (!ifp_trace_initialized)
+    {
+      const char *ring_selector;
+
+      ifp_trace_env_selector = getenv ("IFP_TRACE");
+      if (ifp_trace_env_selector)
         {
           ifp_notice ("tracer:"
                       " %s initialized trace selector to '%s'",
-                      "IFP_TRACE", env_trace_selector);
+                      "IFP_TRACE", ifp_trace_env_selector);
+        }
+
+      ring_selector = getenv ("IFP_TRACE_RING");
+      if (ring_selector)
+        {
+          ifp_notice ("tracer:"
+                      " %s initialized trace ring selector to '%s'",
+                      "IFP_TRACE_RING", ring_selector);
+          ifp_trace_ring_selector = ring_selector;
         }
-      initialized = TRUE;
+
+      ifp_trace_initialized = TRUE;
     }
 
+  ifp_trace_print_mask = ifp_trace_parse_selector (ifp_trace_selector)
+                         | ifp_trace_parse_selector (ifp_trace_env_selector);
+  ifp_trace_ring_mask = ifp_trace_parse_selector (ifp_trace_ring_selector);
+  ifp_trace_mask = ifp_trace_print_mask | ifp_trace_ring_mask;
+
   /*
-   * If either tracing selector is set, and the caller module selected is in
-   * it, print out the message.  Prefix with the plugin name for chaining
-   * plugins.
+   * A plugin's copy of this module must not install handlers, since they
+   * would outlive the plugin's unloading.  Its rings are dumped only by
+   * its own fatal errors.
    */
-  if (ifp_trace_check_selector (ifp_trace_selector, format)
-      || ifp_trace_check_selector (env_trace_selector, format))
-    {
-      va_list ap;
+  if (ifp_trace_ring_mask && !ifp_trace_handlers_installed
+      && !ifp_self_inside_plugin ())
+    ifp_trace_install_handlers ();
+}
 
-      if (ifp_self_inside_plugin ())
-        {
-          ifp_pluginref_t self;
 
-          self = ifp_self ();
-          fprintf (stderr, "%s-%s: ",
-                   ifp_plugin_engine_name (self),
-                   ifp_plugin_engine_version (self));
-        }
+/**
+ * ifp_trace_select()
+ *
+ * Set a tracing selector string.  This string augments any found in the
+ * IFP_TRACE environment variable.
+ */
+void
+ifp_trace_select (const char *selector)
+{
+  ifp_trace_selector = selector;
+  ifp_trace_update_mask ();
+}
+
 
+/*
+ * ifp_trace_message()
+ *
+ * Record a trace message in the calling thread's trace ring if its facility
+ * is selected for recording, and print it if selected for printing.  Called
+ * through the ifp_trace() macro, only when the facility's bit is set in the
+ * overall trace mask.  The mask starts out all set, so the first call reads
+ * the environment and rechecks.
+ *
+ * Trace selection can also be set by the ifp_trace_select() function.  If
+ * both ifp_trace_select() and IFP_TRACE are used, the message is printed if
+ * the module is listed in either selector.
+ */
+void
+ifp_trace_message (int facility, const char *format, ...)
+{
+  va_list ap;
+  assert (facility >= 0 && facility < IFP_TRACE_FACILITIES && format);
+
+  if (!ifp_trace_initialized)
+    ifp_trace_update_mask ();
+
+  if (ifp_trace_ring_mask & (1u << facility))
+    {
       va_start (ap, format);
-      vfprintf (stderr, format, ap);
+      ifp_trace_ring_record (facility, format, ap);
       va_end (ap);
-      fprintf (stderr, "\n");
-      fflush (stderr);
     }
+
+  if (!(ifp_trace_print_mask & (1u << facility)))
+    return;
+
+  /* Prefix with the plugin name for chaining plugins. */
+  if (ifp_self_inside_plugin ())
+    {
+      ifp_pluginref_t self;
+
+      self = ifp_self ();
+      fprintf (stderr, "%s-%s: ",
+               ifp_plugin_engine_name (self),
+               ifp_plugin_engine_version (self));
+    }
+
+  va_start (ap, format);
+  vfprintf (stderr, format, ap);
+  va_end (ap);
+  fprintf (stderr, "\n");
+  fflush (stderr);
 }
 
 
@@ -281,6 +931,12 @@ ifp_fatal (const char *format, ...)
   ifp_trace_print ("IFP fatal error", format, ap);
   va_end (ap);
 
+  if (ifp_trace_ring_mask)
+    {
+      ifp_trace_dump ();
+      ifp_trace_is_fatal_dumped = TRUE;
+    }
+
   fprintf (stderr, "IFP dumping core...\n");
   abort ();
 }
@@ -32,6 +32,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_URL
+
 /* Temporary file template. */
 static const char *TMPFILE_TEMPLATE = "/tmp/ifp_url_XXXXXX";
 
@@ -70,10 +72,11 @@ struct ifp_url
   enum { URL_UNRESOLVED = 1, URL_RESOLVING, URL_RESOLVED } state;
 
   /*
-   * Progress for remote URLs, status, the path resolved, and file that
-   * contains the URL data.
+   * Progress for remote URLs, any limit on bytes that polls may read, status,
+   * the path resolved, and file that contains the URL data.
    */
   int progress;
+  int read_limit;
   int status;
   char *url_path;
   char *data_file;
@@ -168,6 +171,7 @@ ifp_url_new (void)
   url->magic = URL_MAGIC;
   url->type = URL_NONE;
   url->state = URL_UNRESOLVED;
+  url->read_limit = -1;
 
   ifp_trace ("url: returned url_%p", ifp_trace_pointer (url));
   return url;
@@ -345,8 +349,9 @@ ifp_url_is_remote (ifp_urlref_t url)
  * ifp_url_scrub()
  *
  * Decrement the reference count of any temporary file associated with
- * this URL in the URL cache, or if busy resolving, delete the temporary
- * file immediately, then empty the URL ready for destruction.
+ * this URL in the URL cache, or if busy resolving or the download failed,
+ * delete the temporary file immediately, then empty the URL ready for
+ * destruction.
  */
 void
 ifp_url_scrub (ifp_urlref_t url)
@@ -375,11 +380,12 @@ ifp_url_scrub (ifp_urlref_t url)
     }
 
   /*
-   * If busy resolving, remove any temporary file indicated by the URL state.
-   * Alternatively, if resolved, release the reference hold the URL has on
-   * the cache entry.
+   * If busy resolving, or if a download failed and so was not cached, remove
+   * any temporary file indicated by the URL state.  Alternatively, if
+   * resolved, release the reference hold the URL has on the cache entry.
    */
-  if (url->state == URL_RESOLVING)
+  if (url->state == URL_RESOLVING
+      || (url->state == URL_RESOLVED && url->status != 0))
     {
       ifp_url_tmpfile_delete (url->data_file);
       ifp_trace ("url: unlinking pending file '%s'", url->data_file);
@@ -401,6 +407,7 @@ ifp_url_scrub (ifp_urlref_t url)
   url->magic = URL_MAGIC;
   url->type = URL_NONE;
   url->state = URL_UNRESOLVED;
+  url->read_limit = -1;
 }
 
 
@@ -461,6 +468,57 @@ ifp_url_install_handler (void)
 }
 
 
+/**
+ * ifp_url_set_read_limit()
+ *
+ * Limit the bytes that later polls of an asynchronous download may read
+ * from the network, to throttle the download.  Reads use up the limit, and
+ * once it is used up, data waits in the network until the limit is raised.
+ * A negative limit removes any limit.
+ */
+void
+ifp_url_set_read_limit (ifp_urlref_t url, int limit)
+{
+  assert (ifp_url_is_valid (url));
+
+  ifp_trace ("url: ifp_url_set_read_limit <-"
+             " url_%p %d", ifp_trace_pointer (url), limit);
+
+  url->read_limit = limit < 0 ? -1 : limit;
+}
+
+
+/*
+ * ifp_url_poll_handlers()
+ *
+ * Nudge the asynchronous downloads, and call individual poll handlers,
+ * reading no more than the URL's read limit, then use up the limit by the
+ * bytes read.
+ */
+static void
+ifp_url_poll_handlers (ifp_urlref_t url)
+{
+  int progress;
+
+  if (raise (SIGIO) != 0)
+    {
+      ifp_error ("url: unable to generate IO signal");
+      return;
+    }
+
+  progress = url->progress;
+  ifp_http_poll_handler (url->read_limit);
+  ifp_ftp_poll_handler (url->read_limit);
+
+  if (url->read_limit > 0)
+    {
+      url->read_limit -= url->progress - progress;
+      if (url->read_limit < 0)
+        url->read_limit = 0;
+    }
+}
+
+
 /**
  * ifp_url_poll_resolved_async()
  *
@@ -475,30 +533,30 @@ ifp_url_poll_resolved_async (ifp_urlref_t url)
   if (url->state == URL_RESOLVED)
       return TRUE;
 
-  /* Nudge the asynchronous downloads, and call individual poll handlers. */
-  if (raise (SIGIO) != 0)
-    {
-      ifp_error ("url: unable to generate IO signal");
-      return FALSE;
-    }
-
-  ifp_http_poll_handler ();
-  ifp_ftp_poll_handler ();
+  ifp_url_poll_handlers (url);
 
   /*
    * If it's resolving, see if it has completed.  If it has, then set its
-   * state to resolved, add the downloaded file to the URL cache, and remove
-   * the temporary file from our list of things to remove on deletion, as
-   * control is now passed off to the cache.
+   * state to resolved.  If the download succeeded, add the downloaded file
+   * to the URL cache, and remove the temporary file from our list of things
+   * to remove on deletion, as control is now passed off to the cache.  A
+   * failed or truncated download is not cached; its temporary file stays
+   * with the URL, to be removed when the URL is scrubbed.
    */
   if (url->state == URL_RESOLVING && url->status != EAGAIN)
     {
       url->state = URL_RESOLVED;
 
-      ifp_trace ("url: pass to cache for '%s'", url->url_path);
-      ifp_cache_add_entry (url->url_path, url->data_file);
+      if (url->status == 0)
+        {
+          ifp_trace ("url: pass to cache for '%s'", url->url_path);
+          ifp_cache_add_entry (url->url_path, url->data_file);
 
-      ifp_url_tmpfile_delete (url->data_file);
+          ifp_url_tmpfile_delete (url->data_file);
+        }
+      else
+        ifp_trace ("url: not caching failed download for '%s'",
+                   url->url_path);
       return TRUE;
     }
 
@@ -517,16 +575,7 @@ ifp_url_poll_progress_async (ifp_urlref_t url)
 {
   assert (ifp_url_is_valid (url));
 
-  /* Nudge the asynchronous downloads, and call individual poll handlers. */
-  if (raise (SIGIO) != 0)
-    {
-      ifp_error ("url: unable to generate IO signal");
-      return url->progress;
-    }
-
-  ifp_http_poll_handler ();
-  ifp_ftp_poll_handler ();
-
+  ifp_url_poll_handlers (url);
   return url->progress;
 }
 
@@ -960,17 +1009,21 @@ int
 ifp_url_resolve (ifp_urlref_t url, const char *urlpath)
 {
   int url_status;
+  unsigned long long start;
   assert (ifp_url_is_valid (url) && urlpath);
 
   ifp_trace ("url: ifp_url_resolve <-"
              " url_%p '%s'", ifp_trace_pointer (url), urlpath);
 
+  start = ifp_timing_start ();
+
   /*
    * Resolve the URL the normal way, then wait for the URL to indicate that
    * it has completed.
    */
   if (!ifp_url_resolve_async (url, urlpath))
     {
+      ifp_timing_stop (IFP_TIMING_URL_RESOLVE, start);
       ifp_trace ("url: failed to resolve URL at all");
       return FALSE;
     }
@@ -981,6 +1034,8 @@ ifp_url_resolve (ifp_urlref_t url, const char *urlpath)
       ifp_url_pause_async (url);
     }
 
+  ifp_timing_stop (IFP_TIMING_URL_RESOLVE, start);
+
   url_status = ifp_url_get_status_async (url);
   if (url_status != 0)
     {
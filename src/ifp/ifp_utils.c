@@ -26,16 +26,20 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_UTIL
+
 
 /*
  * ifp_dlopen()
+ * ifp_dlopen_lazy()
  * ifp_dlsym()
  * ifp_dlerror()
  * ifp_dlclose()
  *
  * Wrappers for shared object loading functions.  These functions manage
  * loading shared objects, name lookups, shared object error reporting, and
- * closing shared objects.
+ * closing shared objects.  ifp_dlopen binds all of an object's functions
+ * on loading; ifp_dlopen_lazy leaves function binding to first call.
  */
 void *
 ifp_dlopen (const char *filename)
@@ -50,6 +54,19 @@ ifp_dlopen (const char *filename)
   return handle;
 }
 
+void *
+ifp_dlopen_lazy (const char *filename)
+{
+  void *handle;
+
+  ifp_trace ("util: ifp_dlopen_lazy <- '%s'", filename);
+
+  handle = dlopen (filename, RTLD_LAZY);
+  ifp_trace ("util: ifp_dlopen_lazy returned"
+             " handle_%p", ifp_trace_pointer (handle));
+  return handle;
+}
+
 const char *
 ifp_dlerror (void)
 {
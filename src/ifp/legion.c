@@ -566,7 +566,8 @@ resolve_url_from_path (const char *url_path, int *url_errno)
 static void
 override_main (int argc, char *argv[])
 {
-  char url_path[1024] = "";
+  char url_path[1024] = "", last_path[1024] = "";
+  ifp_pluginref_t last_plugin = NULL;
 
   main_window = glk_window_open (0, 0, 0, wintype_TextBuffer, 0);
   if (!main_window)
@@ -585,7 +586,8 @@ override_main (int argc, char *argv[])
       glk_set_style (style_Normal);
 
       snprintf (message, sizeof (message),
-                "Usage: %s [-glk <library>] [game_file or game URL]\n",
+                "Usage: %s [-timings] [-glk <library>]"
+                " [game_file or game URL]\n",
                 argv[0]);
       glk_c_put_string (message);
 
@@ -621,43 +623,71 @@ override_main (int argc, char *argv[])
   /*
    * Resolve the URL path into a real URL.  If it resolves, run the game
    * it contains, or at least try to, then request a new URL path.  Continue
-   * until the user enters an empty URL path.
+   * until the user enters an empty URL path.  Plugins are checkpointed after
+   * startup, so that if the user asks for the same game again, it can be
+   * restarted without reloading.
    */
+  ifp_manager_checkpoint_selected_plugins (TRUE);
   do
     {
-      ifp_urlref_t url;
-      int url_errno;
+      if (last_plugin && strcmp (url_path, last_path) == 0
+          && ifp_manager_restart_plugin (last_plugin))
+        {
+          /* As below, restarting closed all windows. */
+          main_window = NULL;
+          message_window = NULL;
 
-      url = resolve_url_from_path (url_path, &url_errno);
-      if (url)
+          ifp_manager_run_plugin (last_plugin);
+        }
+      else
         {
-          ifp_pluginref_t plugin;
+          ifp_urlref_t url;
+          int url_errno;
+
+          if (last_plugin)
+            {
+              ifp_loader_forget_plugin (last_plugin);
+              last_plugin = NULL;
+
+              /* Clearing plugins list preserves first-found ordering. */
+              ifp_loader_forget_all_plugins ();
+            }
 
-          plugin = ifp_manager_locate_plugin_url (url);
-          if (plugin)
+          url = resolve_url_from_path (url_path, &url_errno);
+          if (url)
             {
-              /*
-               * This looks dodgy, but it's not.  On success, the plugin
-               * location call will have fully reset Glk, including
-               * closing all windows.  So anything we hold is now invalid.
-               */
-              main_window = NULL;
-              message_window = NULL;
-
-              ifp_manager_run_plugin (plugin);
-              ifp_loader_forget_plugin (plugin);
+              ifp_pluginref_t plugin;
+
+              plugin = ifp_manager_locate_plugin_url (url);
+              if (plugin)
+                {
+                  /*
+                   * This looks dodgy, but it's not.  On success, the plugin
+                   * location call will have fully reset Glk, including
+                   * closing all windows.  So anything we hold is now invalid.
+                   */
+                  main_window = NULL;
+                  message_window = NULL;
+
+                  ifp_manager_run_plugin (plugin);
+
+                  /* Hold on to the plugin in case of a restart. */
+                  last_plugin = plugin;
+                  strcpy (last_path, url_path);
+                }
+              else
+                {
+                  message_write_line (FALSE, "No plugin"
+                                      " engine accepted the file or URL.");
+                  ifp_loader_forget_all_plugins ();
+                }
+
+              ifp_url_forget (url);
             }
           else
-              message_write_line (FALSE, "No plugin"
-                                  " engine accepted the file or URL.");
-
-          /* Clearing plugins list preserves first-found ordering. */
-          ifp_loader_forget_all_plugins ();
-          ifp_url_forget (url);
+            message_write_line (FALSE, "Invalid file path or URL [%s].",
+                                strerror (url_errno));
         }
-      else
-        message_write_line (FALSE, "Invalid file path or URL [%s].",
-                            strerror (url_errno));
 
       message_read_line ("Enter a file path or URL: ",
                          url_path, sizeof (url_path));
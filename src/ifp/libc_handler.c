@@ -23,6 +23,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_LIBC
+
 
 /*
  * Libc interface vector, created for passing to a loaded plugin library
@@ -36,10 +38,18 @@ static struct ifp_libc_interface libc_interface = {
   .calloc = ifp_libc_intercept_calloc,
   .realloc = ifp_libc_intercept_realloc,
   .strdup = ifp_libc_intercept_strdup,
+  .strndup = ifp_libc_intercept_strndup,
   .getcwd = ifp_libc_intercept_getcwd,
   .scandir = ifp_libc_intercept_scandir,
   .free = ifp_libc_intercept_free,
 
+  .posix_memalign = ifp_libc_intercept_posix_memalign,
+  .aligned_alloc = ifp_libc_intercept_aligned_alloc,
+  .memalign = ifp_libc_intercept_memalign,
+  .valloc = ifp_libc_intercept_valloc,
+  .mmap = ifp_libc_intercept_mmap,
+  .munmap = ifp_libc_intercept_munmap,
+
   .open_2 = ifp_libc_intercept_open_2,
   .open_3 = ifp_libc_intercept_open_3,
   .close = ifp_libc_intercept_close,
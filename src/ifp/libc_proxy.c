@@ -26,17 +26,22 @@
 #include <stdarg.h>
 #include <signal.h>
 #include <dirent.h>
+#include <malloc.h>
+#include <sys/mman.h>
 
 #include "ifp.h"
 #include "ifp_internal.h"
 
 
 /*
- * Function prototype, present only to silence compiler warnings.  Ordinarily
- * we'd include string.h to get this, but strdup is a macro definition, at
- * least in Linux, so that's not an option here.
+ * Function prototypes, present only to silence compiler warnings.  Ordinarily
+ * we'd include string.h to get these, but strdup and strndup are macro
+ * definitions, at least in Linux, so that's not an option here.  Also,
+ * aligned_alloc is declared by stdlib.h only for C11.
  */
 char *strdup (const char *s);
+char *strndup (const char *s, size_t n);
+void *aligned_alloc (size_t alignment, size_t size);
 
 /* Pointer to our interface table. */
 static ifp_libc_interfaceref_t libc_interface = NULL;
@@ -99,8 +104,9 @@ ifp_check_interface (void)
 
 
 /**
- * malloc(), calloc(), realloc(), strdup(), getcwd(), scandir(), free()
- * open(), close(), creat(), dup(), dup2()
+ * malloc(), calloc(), realloc(), strdup(), strndup(), getcwd(), scandir(),
+ * free(), posix_memalign(), aligned_alloc(), memalign(), valloc(), mmap(),
+ * munmap(), open(), close(), creat(), dup(), dup2()
  * fopen(), fdopen(), freopen(), fclose()
  *
  * Proxy Libc functions.  These functions handle the calls from the
@@ -146,6 +152,13 @@ strdup (const char *s)
   return libc_interface->strdup (s);
 }
 
+char *
+strndup (const char *s, size_t n)
+{
+  ifp_check_interface ();
+  return libc_interface->strndup (s, n);
+}
+
 char *
 getcwd (char *buf, size_t size)
 {
@@ -169,6 +182,48 @@ free (void *ptr)
   libc_interface->free (ptr);
 }
 
+int
+posix_memalign (void **memptr, size_t alignment, size_t size)
+{
+  ifp_check_interface ();
+  return libc_interface->posix_memalign (memptr, alignment, size);
+}
+
+void *
+aligned_alloc (size_t alignment, size_t size)
+{
+  ifp_check_interface ();
+  return libc_interface->aligned_alloc (alignment, size);
+}
+
+void *
+memalign (size_t alignment, size_t size)
+{
+  ifp_check_interface ();
+  return libc_interface->memalign (alignment, size);
+}
+
+void *
+valloc (size_t size)
+{
+  ifp_check_interface ();
+  return libc_interface->valloc (size);
+}
+
+void *
+mmap (void *start, size_t length, int prot, int flags, int fd, off_t offset)
+{
+  ifp_check_interface ();
+  return libc_interface->mmap (start, length, prot, flags, fd, offset);
+}
+
+int
+munmap (void *start, size_t length)
+{
+  ifp_check_interface ();
+  return libc_interface->munmap (start, length);
+}
+
 int
 open (const char *pathname, int flags, ...)
 {
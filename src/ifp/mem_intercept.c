@@ -18,39 +18,62 @@
  * USA
  */
 
+#define _ISOC11_SOURCE    /* For aligned_alloc(). */
+
 #include <assert.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sched.h>
 #include <stdio.h>
 #include <dirent.h>
 #include <string.h>
+#include <malloc.h>
+#include <sys/mman.h>
 
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_MEMORY
+
 
 /*
  * Malloc descriptor structure.  Each descriptor is placed on a list, and
- * gives the malloc'ed address it tracks, or NULL if on the free list.
+ * gives the malloc'ed address it tracks, or NULL if on the free list, the
+ * size requested for it, and the index of its checkpoint image, or -1 if
+ * the allocation is not part of any checkpoint.
  */
 struct ifp_malloc_info
 {
   void *address;
+  size_t size;
+  int image;
   struct ifp_malloc_info *next;
 };
 typedef struct ifp_malloc_info *ifp_malloc_inforef_t;
 
 /*
- * Malloc data structures.  This is a variable sized array of list heads
- * (hash buckets), a note of its size, a pre-created pool of descriptors
- * sized at list size times fill factor elements, and a free list that
- * gathers up all unused pool entries.
+ * Malloc data structures.  Addresses are spread over a fixed number of
+ * shards, each guarded by its own spinlock, so that plugin threads
+ * allocating at the same time rarely contend.  Each shard holds a variable
+ * sized array of list heads (hash buckets), a note of its size, a
+ * pre-created pool of descriptors sized at list size times fill factor
+ * elements, and a free list that gathers up all unused pool entries.
+ * Shards are aligned to a cache line so that locking one does not disturb
+ * its neighbours.
  */
-static int ifp_malloc_buckets = 0;
-static ifp_malloc_inforef_t *ifp_malloc_lists = NULL,
-                            ifp_malloc_pool = NULL,
-                            ifp_malloc_freelist = NULL;
+enum { MALLOC_SHARDS = 16, CACHE_LINE_SIZE = 64 };
+
+struct ifp_malloc_shard
+{
+  char lock;
+  int buckets;
+  ifp_malloc_inforef_t *lists, pool, freelist;
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+typedef struct ifp_malloc_shard *ifp_malloc_shardref_t;
+
+static struct ifp_malloc_shard ifp_malloc_shards[MALLOC_SHARDS];
 
 /*
  * List of prime numbers for hash buckets.  Rehash when table occupancy is
@@ -78,24 +101,135 @@ static const int HASH_FILL_FACTOR = 2;
  */
 static const glui32 HASH_MULTIPLIER = 2654435761u;
 
+/*
+ * Checkpoint image of the plugin heap.  Each element records an address
+ * that was allocated when the checkpoint was taken, its size, and a copy of
+ * its contents.  While a checkpoint is held, checkpointed addresses that
+ * the plugin frees are quarantined rather than released, so that restoring
+ * the checkpoint can reinstate them at the same address.
+ */
+struct ifp_malloc_image
+{
+  void *address;
+  size_t size;
+  void *contents;
+  int is_quarantined;
+};
+typedef struct ifp_malloc_image *ifp_malloc_imageref_t;
+
+static ifp_malloc_imageref_t ifp_malloc_images = NULL;
+static int ifp_malloc_image_count = 0,
+           ifp_malloc_has_checkpoint = FALSE;
+
+/*
+ * Bytes currently listed as malloc'ed, and the high water mark of this
+ * since the last garbage collection.  These, and the size class counts
+ * below, are shared by all shards, and updated atomically.
+ */
+static size_t ifp_malloc_current_bytes = 0,
+              ifp_malloc_peak_bytes = 0;
+
+/*
+ * Counts of intercepted allocations by size class, since the last garbage
+ * collection.  Class zero holds allocations of up to 16 bytes, and each
+ * following class doubles the upper bound, with the last class taking all
+ * larger allocations.
+ */
+enum { MALLOC_SIZE_CLASSES = 16, MALLOC_SMALLEST_CLASS_SHIFT = 4 };
+static unsigned long ifp_malloc_class_counts[MALLOC_SIZE_CLASSES];
+
+/*
+ * Memory mappings made by plugins.  These are few and large, so they are
+ * kept apart from malloc'ed addresses, in a simple variable sized array,
+ * with lengths rounded up to whole pages.  On garbage collection, any that
+ * remain are unmapped in one sweep.
+ */
+struct ifp_mmap_info
+{
+  void *address;
+  size_t length;
+};
+typedef struct ifp_mmap_info *ifp_mmap_inforef_t;
+
+static char ifp_mmap_lock = 0;
+static ifp_mmap_inforef_t ifp_mmap_list = NULL;
+static int ifp_mmap_count = 0,
+           ifp_mmap_allocation = 0;
+static size_t ifp_mmap_current_bytes = 0,
+              ifp_mmap_peak_bytes = 0;
+
+
+/*
+ * ifp_memory_lock()
+ * ifp_memory_unlock()
+ *
+ * Acquire and release a tracking spinlock.  Uncontended, acquiring costs
+ * one atomic exchange.  While contended, spin on a plain load so as not to
+ * bounce the cache line, and yield the processor between attempts.
+ */
+static void
+ifp_memory_lock (char *lock)
+{
+  while (__atomic_test_and_set (lock, __ATOMIC_ACQUIRE))
+    {
+      while (__atomic_load_n (lock, __ATOMIC_RELAXED))
+        sched_yield ();
+    }
+}
+
+static void
+ifp_memory_unlock (char *lock)
+{
+  __atomic_clear (lock, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * ifp_memory_malloc_lock_all()
+ * ifp_memory_malloc_unlock_all()
+ *
+ * Acquire and release every shard lock, always in shard order, for
+ * operations on the whole heap, such as checkpoint and garbage collection.
+ */
+static void
+ifp_memory_malloc_lock_all (void)
+{
+  int shard;
+
+  for (shard = 0; shard < MALLOC_SHARDS; shard++)
+    ifp_memory_lock (&ifp_malloc_shards[shard].lock);
+}
+
+static void
+ifp_memory_malloc_unlock_all (void)
+{
+  int shard;
+
+  for (shard = MALLOC_SHARDS - 1; shard >= 0; shard--)
+    ifp_memory_unlock (&ifp_malloc_shards[shard].lock);
+}
+
 
 /*
  * ifp_memory_malloc_hash()
+ * ifp_memory_malloc_shard()
  *
- * Hash an address of heap data, returned from malloc, to a hash bucket
- * index number.  Hash is the pointer cast to an unsigned integer, multiplied
- * by the "golden ratio", then modulo'ed to the number of hash buckets.
+ * Hash an address of heap data, returned from malloc, and return the
+ * shard that tracks it.  Hash is the pointer cast to an unsigned integer,
+ * multiplied by the "golden ratio".  The shard is chosen from the top bits
+ * of the low 32 bits of the hash, and the bucket within the shard by the
+ * hash modulo'ed to the shard's number of hash buckets.
  */
-static int
+static glui32
 ifp_memory_malloc_hash (const void *pointer)
 {
-  glui32 hash;
-
-  if (ifp_malloc_buckets == 0)
-    ifp_fatal ("memory: attempt to hash where no table exists");
+  return (glui32) pointer * HASH_MULTIPLIER;
+}
 
-  hash = (glui32) pointer * HASH_MULTIPLIER;
-  return (int) (hash % ifp_malloc_buckets);
+static ifp_malloc_shardref_t
+ifp_memory_malloc_shard (glui32 hash)
+{
+  return ifp_malloc_shards + ((hash >> 28) & (MALLOC_SHARDS - 1));
 }
 
 
@@ -138,34 +272,33 @@ ifp_memory_malloc_next_size (int current_buckets)
 /*
  * ifp_memory_malloc_rehash()
  *
- * Extend the malloc hash tables to the next bucket count increment, and
- * rehash all contained malloc addresses.  On first call, create an empty
- * hash table of the smallest size.
+ * Extend a shard's malloc hash tables to the next bucket count increment,
+ * and rehash all contained malloc addresses.  On first call, create an
+ * empty hash table of the smallest size.  The caller holds the shard lock.
  */
 static void
-ifp_memory_malloc_rehash (void)
+ifp_memory_malloc_rehash (ifp_malloc_shardref_t shard)
 {
-  int old_pool_size, pool_size, hash, bytes;
+  int old_pool_size, pool_size, bytes;
   ifp_malloc_inforef_t entry;
 
   /* Resize and reallocate the pool of malloc info entries. */
-  old_pool_size = ifp_malloc_buckets * HASH_FILL_FACTOR;
+  old_pool_size = shard->buckets * HASH_FILL_FACTOR;
 
-  ifp_malloc_buckets = ifp_memory_malloc_next_size (ifp_malloc_buckets);
-  pool_size = ifp_malloc_buckets * HASH_FILL_FACTOR;
+  shard->buckets = ifp_memory_malloc_next_size (shard->buckets);
+  pool_size = shard->buckets * HASH_FILL_FACTOR;
 
-  ifp_malloc_pool = ifp_realloc (ifp_malloc_pool,
-                                 sizeof (*ifp_malloc_pool) * pool_size);
+  shard->pool = ifp_realloc (shard->pool, sizeof (*shard->pool) * pool_size);
 
   /*
    * Create a clean set of hash buckets.  The old hash buckets are invalidated
    * by the pool realloc above.  Start a new free list.
    */
-  bytes = sizeof (*ifp_malloc_lists) * ifp_malloc_buckets;
-  ifp_malloc_lists = ifp_realloc (ifp_malloc_lists, bytes);
-  memset (ifp_malloc_lists, 0, bytes);
+  bytes = sizeof (*shard->lists) * shard->buckets;
+  shard->lists = ifp_realloc (shard->lists, bytes);
+  memset (shard->lists, 0, bytes);
 
-  ifp_malloc_freelist = NULL;
+  shard->freelist = NULL;
 
   /*
    * Rehash all occupied entries in the old hash pool into the new hash
@@ -173,8 +306,7 @@ ifp_memory_malloc_rehash (void)
    * the free list.  Only entries from zero to the old pool size considered;
    * ones beyond this are part of the new extension, dealt with later.
    */
-  for (entry = ifp_malloc_pool;
-       entry < ifp_malloc_pool + old_pool_size; entry++)
+  for (entry = shard->pool; entry < shard->pool + old_pool_size; entry++)
     {
       /*
        * If the entry is occupied, rehash and place it on the relevant list.
@@ -183,14 +315,16 @@ ifp_memory_malloc_rehash (void)
        */
       if (entry->address)
         {
-          hash = ifp_memory_malloc_hash (entry->address);
-          entry->next = ifp_malloc_lists[hash];
-          ifp_malloc_lists[hash] = entry;
+          int bucket;
+
+          bucket = ifp_memory_malloc_hash (entry->address) % shard->buckets;
+          entry->next = shard->lists[bucket];
+          shard->lists[bucket] = entry;
         }
       else
         {
-          entry->next = ifp_malloc_freelist;
-          ifp_malloc_freelist = entry;
+          entry->next = shard->freelist;
+          shard->freelist = entry;
         }
     }
 
@@ -198,72 +332,166 @@ ifp_memory_malloc_rehash (void)
    * Add all the new pool entries from the extension area to the free list.
    * New entries are all those from the old pool size onwards.
    */
-  for (entry = ifp_malloc_pool + old_pool_size;
-       entry < ifp_malloc_pool + pool_size; entry++)
+  for (entry = shard->pool + old_pool_size;
+       entry < shard->pool + pool_size; entry++)
     {
       entry->address = NULL;
-      entry->next = ifp_malloc_freelist;
-      ifp_malloc_freelist = entry;
+      entry->next = shard->freelist;
+      shard->freelist = entry;
     }
 
-  ifp_trace ("memory: rehashed table to %d entries", ifp_malloc_buckets);
+  ifp_trace ("memory: rehashed shard %d to %d entries",
+             (int) (shard - ifp_malloc_shards), shard->buckets);
 }
 
 
 /*
- * ifp_memory_malloc_add_address()
- * ifp_memory_malloc_remove_address()
+ * ifp_memory_malloc_count_bytes()
+ * ifp_memory_malloc_uncount_bytes()
  *
- * Add and remove addresses to/from the main malloc address list.  On
- * addition, the address must not be present, and on removal, it must be
- * present precisely once.
+ * Atomically add to and subtract from the count of bytes malloc'ed, noting
+ * any new peak.
  */
 static void
-ifp_memory_malloc_add_address (void *pointer)
+ifp_memory_malloc_count_bytes (size_t size)
+{
+  size_t current, peak;
+
+  current = __atomic_add_fetch (&ifp_malloc_current_bytes,
+                                size, __ATOMIC_RELAXED);
+
+  peak = __atomic_load_n (&ifp_malloc_peak_bytes, __ATOMIC_RELAXED);
+  while (current > peak
+         && !__atomic_compare_exchange_n (&ifp_malloc_peak_bytes,
+                                          &peak, current, TRUE,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+static void
+ifp_memory_malloc_uncount_bytes (size_t size)
+{
+  __atomic_sub_fetch (&ifp_malloc_current_bytes, size, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * ifp_memory_malloc_find_in_shard()
+ *
+ * Return the descriptor tracking a given address in a shard, or NULL if the
+ * address is not listed as malloc'ed.  The caller holds the shard lock.
+ */
+static ifp_malloc_inforef_t
+ifp_memory_malloc_find_in_shard (ifp_malloc_shardref_t shard,
+                                 const void *pointer, glui32 hash)
 {
-  int hash;
   ifp_malloc_inforef_t entry;
 
-  if (!ifp_malloc_freelist)
+  if (!shard->lists)
+    return NULL;
+
+  for (entry = shard->lists[hash % shard->buckets]; entry; entry = entry->next)
+    {
+      if (entry->address == pointer)
+        return entry;
+    }
+
+  return NULL;
+}
+
+
+/*
+ * ifp_memory_malloc_add_to_shard()
+ *
+ * Add an address to a shard's malloc address list, returning its new
+ * descriptor.  The address must not be present.  The caller holds the shard
+ * lock.
+ */
+static ifp_malloc_inforef_t
+ifp_memory_malloc_add_to_shard (ifp_malloc_shardref_t shard,
+                                void *pointer, glui32 hash, size_t size)
+{
+  int bucket;
+  ifp_malloc_inforef_t entry;
+
+  if (!shard->freelist)
     {
       ifp_trace ("memory: empty free list prompted rehash");
-      ifp_memory_malloc_rehash ();
+      ifp_memory_malloc_rehash (shard);
     }
 
-  hash = ifp_memory_malloc_hash (pointer);
+  bucket = hash % shard->buckets;
 
-  for (entry = ifp_malloc_lists[hash]; entry; entry = entry->next)
+  for (entry = shard->lists[bucket]; entry; entry = entry->next)
     {
       if (entry->address == pointer)
         ifp_fatal ("memory: address %p already listed as malloced", pointer);
     }
 
-  assert (ifp_malloc_freelist);
-  entry = ifp_malloc_freelist;
-  ifp_malloc_freelist = entry->next;
+  assert (shard->freelist);
+  entry = shard->freelist;
+  shard->freelist = entry->next;
 
   entry->address = pointer;
-  entry->next = ifp_malloc_lists[hash];
-  ifp_malloc_lists[hash] = entry;
+  entry->size = size;
+  entry->image = -1;
+  entry->next = shard->lists[bucket];
+  shard->lists[bucket] = entry;
+
+  ifp_memory_malloc_count_bytes (size);
+  return entry;
 }
 
+
+/*
+ * ifp_memory_malloc_add_address()
+ * ifp_memory_malloc_remove_address()
+ *
+ * Add and remove addresses to/from the main malloc address list.  On
+ * addition, the address must not be present, and on removal, it must be
+ * present precisely once.  Removal returns the checkpoint image index of
+ * the address removed, or -1 if it is not checkpointed.
+ */
 static void
+ifp_memory_malloc_add_address (void *pointer, size_t size)
+{
+  glui32 hash;
+  ifp_malloc_shardref_t shard;
+
+  hash = ifp_memory_malloc_hash (pointer);
+  shard = ifp_memory_malloc_shard (hash);
+
+  ifp_memory_lock (&shard->lock);
+  ifp_memory_malloc_add_to_shard (shard, pointer, hash, size);
+  ifp_memory_unlock (&shard->lock);
+}
+
+static int
 ifp_memory_malloc_remove_address (const void *pointer)
 {
-  int hash, found;
+  int bucket, found, image;
+  glui32 hash;
+  ifp_malloc_shardref_t shard;
   ifp_malloc_inforef_t entry, prior, next;
 
-  if (!ifp_malloc_lists)
+  hash = ifp_memory_malloc_hash (pointer);
+  shard = ifp_memory_malloc_shard (hash);
+
+  ifp_memory_lock (&shard->lock);
+
+  if (!shard->lists)
     {
+      ifp_memory_unlock (&shard->lock);
       ifp_error ("memory: no lists to remove address %p from", pointer);
-      return;
+      return -1;
     }
 
-  hash = ifp_memory_malloc_hash (pointer);
+  bucket = hash % shard->buckets;
 
   found = FALSE;
+  image = -1;
   prior = NULL;
-  for (entry = ifp_malloc_lists[hash]; entry; entry = next)
+  for (entry = shard->lists[bucket]; entry; entry = next)
     {
       next = entry->next;
 
@@ -276,22 +504,88 @@ ifp_memory_malloc_remove_address (const void *pointer)
 
           if (!prior)
             {
-              assert (entry == ifp_malloc_lists[hash]);
-              ifp_malloc_lists[hash] = next;
+              assert (entry == shard->lists[bucket]);
+              shard->lists[bucket] = next;
             }
           else
             prior->next = next;
 
+          image = entry->image;
+          ifp_memory_malloc_uncount_bytes (entry->size);
           entry->address = NULL;
-          entry->next = ifp_malloc_freelist;
-          ifp_malloc_freelist = entry;
+          entry->next = shard->freelist;
+          shard->freelist = entry;
         }
       else
         prior = entry;
     }
 
+  ifp_memory_unlock (&shard->lock);
+
   if (!found)
     ifp_error ("memory: address %p not listed as malloced", pointer);
+
+  return image;
+}
+
+
+/*
+ * ifp_memory_malloc_get_address()
+ *
+ * Look up a listed address, returning its checkpoint image index, or -1 if
+ * not checkpointed, and its size.  Returns FALSE if the address is not
+ * listed.
+ */
+static int
+ifp_memory_malloc_get_address (const void *pointer, int *image, size_t *size)
+{
+  glui32 hash;
+  ifp_malloc_shardref_t shard;
+  ifp_malloc_inforef_t entry;
+
+  hash = ifp_memory_malloc_hash (pointer);
+  shard = ifp_memory_malloc_shard (hash);
+
+  ifp_memory_lock (&shard->lock);
+  entry = ifp_memory_malloc_find_in_shard (shard, pointer, hash);
+  if (entry)
+    {
+      *image = entry->image;
+      *size = entry->size;
+    }
+  ifp_memory_unlock (&shard->lock);
+
+  return entry != NULL;
+}
+
+
+/*
+ * ifp_memory_malloc_count_allocation()
+ * ifp_memory_malloc_check_usage()
+ *
+ * Count an intercepted allocation in its size class, and check heap usage
+ * against any limits set on plugins.  The check may not return, so it is
+ * made only once tracking data is complete.
+ */
+static void
+ifp_memory_malloc_count_allocation (size_t size)
+{
+  int class_;
+
+  class_ = 0;
+  for (size = size > 0 ? (size - 1) >> MALLOC_SMALLEST_CLASS_SHIFT : 0;
+       size > 0 && class_ < MALLOC_SIZE_CLASSES - 1; size >>= 1)
+    class_++;
+
+  __atomic_add_fetch (&ifp_malloc_class_counts[class_], 1, __ATOMIC_RELAXED);
+}
+
+static void
+ifp_memory_malloc_check_usage (void)
+{
+  ifp_plugin_check_heap_usage
+      (__atomic_load_n (&ifp_malloc_current_bytes, __ATOMIC_RELAXED)
+       + __atomic_load_n (&ifp_mmap_current_bytes, __ATOMIC_RELAXED));
 }
 
 
@@ -311,7 +605,11 @@ ifp_libc_intercept_malloc (size_t size)
 
   pointer = malloc (size);
   if (pointer)
-    ifp_memory_malloc_add_address (pointer);
+    {
+      ifp_memory_malloc_add_address (pointer, size);
+      ifp_memory_malloc_count_allocation (size);
+      ifp_memory_malloc_check_usage ();
+    }
 
   return pointer;
 }
@@ -323,7 +621,11 @@ ifp_libc_intercept_calloc (size_t nmemb, size_t size)
 
   pointer = calloc (nmemb, size);
   if (pointer)
-    ifp_memory_malloc_add_address (pointer);
+    {
+      ifp_memory_malloc_add_address (pointer, nmemb * size);
+      ifp_memory_malloc_count_allocation (nmemb * size);
+      ifp_memory_malloc_check_usage ();
+    }
 
   return pointer;
 }
@@ -333,20 +635,55 @@ ifp_libc_intercept_calloc (size_t nmemb, size_t size)
  * ifp_libc_intercept_realloc()
  *
  * Interception for realloc() calls.  Updated the malloc addresses list
- * according to the result of the real realloc.
+ * according to the result of the real realloc.  A checkpointed address
+ * must keep its contents until the checkpoint is restored or discarded, so
+ * for these, realloc is emulated with a new allocation and a free.
  */
 void *
 ifp_libc_intercept_realloc (void *ptr, size_t size)
 {
   void *pointer;
+  int is_listed, image;
+  size_t old_size;
 
-  pointer = realloc (ptr, size);
-  if (pointer != ptr)
+  is_listed = ptr && ifp_memory_malloc_get_address (ptr, &image, &old_size);
+  if (is_listed && image != -1)
     {
-      if (ptr)
-        ifp_memory_malloc_remove_address (ptr);
+      if (size == 0)
+        {
+          ifp_libc_intercept_free (ptr);
+          return NULL;
+        }
+
+      pointer = ifp_libc_intercept_malloc (size);
       if (pointer)
-        ifp_memory_malloc_add_address (pointer);
+        {
+          memcpy (pointer, ptr, old_size < size ? old_size : size);
+          ifp_libc_intercept_free (ptr);
+        }
+
+      return pointer;
+    }
+
+  /*
+   * Unlist the address before the real realloc, since once it is released,
+   * another thread's malloc may return it, and relist whatever results.
+   */
+  if (ptr)
+    ifp_memory_malloc_remove_address (ptr);
+
+  pointer = realloc (ptr, size);
+  if (pointer)
+    {
+      ifp_memory_malloc_add_address (pointer, size);
+      if (pointer != ptr)
+        ifp_memory_malloc_count_allocation (size);
+      ifp_memory_malloc_check_usage ();
+    }
+  else if (is_listed && size > 0)
+    {
+      /* Failed, so the original allocation remains. */
+      ifp_memory_malloc_add_address (ptr, old_size);
     }
 
   return pointer;
@@ -366,7 +703,109 @@ ifp_libc_intercept_strdup (const char *s)
 
   pointer = strdup (s);
   if (pointer)
-    ifp_memory_malloc_add_address (pointer);
+    {
+      ifp_memory_malloc_add_address (pointer, strlen (s) + 1);
+      ifp_memory_malloc_count_allocation (strlen (s) + 1);
+      ifp_memory_malloc_check_usage ();
+    }
+
+  return pointer;
+}
+
+
+/*
+ * ifp_libc_intercept_strndup()
+ *
+ * Interception for strndup() calls.  As with strdup(), the returned
+ * address is malloc'ed, so it is tracked as malloc().
+ */
+char *
+ifp_libc_intercept_strndup (const char *s, size_t n)
+{
+  char *pointer;
+
+  pointer = strndup (s, n);
+  if (pointer)
+    {
+      ifp_memory_malloc_add_address (pointer, strlen (pointer) + 1);
+      ifp_memory_malloc_count_allocation (strlen (pointer) + 1);
+      ifp_memory_malloc_check_usage ();
+    }
+
+  return pointer;
+}
+
+
+/*
+ * ifp_libc_intercept_posix_memalign()
+ * ifp_libc_intercept_aligned_alloc()
+ * ifp_libc_intercept_memalign()
+ * ifp_libc_intercept_valloc()
+ *
+ * Interception for aligned allocations.  The real libc returns addresses
+ * that are released with free(), so these are tracked as malloc().
+ */
+int
+ifp_libc_intercept_posix_memalign (void **memptr,
+                                   size_t alignment, size_t size)
+{
+  int status;
+
+  status = posix_memalign (memptr, alignment, size);
+  if (status == 0 && *memptr)
+    {
+      ifp_memory_malloc_add_address (*memptr, size);
+      ifp_memory_malloc_count_allocation (size);
+      ifp_memory_malloc_check_usage ();
+    }
+
+  return status;
+}
+
+void *
+ifp_libc_intercept_aligned_alloc (size_t alignment, size_t size)
+{
+  void *pointer;
+
+  pointer = aligned_alloc (alignment, size);
+  if (pointer)
+    {
+      ifp_memory_malloc_add_address (pointer, size);
+      ifp_memory_malloc_count_allocation (size);
+      ifp_memory_malloc_check_usage ();
+    }
+
+  return pointer;
+}
+
+void *
+ifp_libc_intercept_memalign (size_t alignment, size_t size)
+{
+  void *pointer;
+
+  pointer = memalign (alignment, size);
+  if (pointer)
+    {
+      ifp_memory_malloc_add_address (pointer, size);
+      ifp_memory_malloc_count_allocation (size);
+      ifp_memory_malloc_check_usage ();
+    }
+
+  return pointer;
+}
+
+void *
+ifp_libc_intercept_valloc (size_t size)
+{
+  void *pointer;
+
+  pointer = valloc (size);
+  if (pointer)
+    {
+      ifp_memory_malloc_add_address (pointer, size);
+      ifp_memory_malloc_count_allocation (size);
+      ifp_memory_malloc_check_usage ();
+    }
 
   return pointer;
 }
@@ -387,10 +826,18 @@ ifp_libc_intercept_getcwd (char *buf, size_t size)
 
   /*
    * If buf is NULL, this was a request for a malloc'ed return.  If buffer
-   * is non-NULL, it was a successful call.
+   * is non-NULL, it was a successful call.  Where size is zero, the buffer
+   * is only as large as it needs to be.
    */
   if (!buf && buffer)
-    ifp_memory_malloc_add_address (buffer);
+    {
+      size_t length;
+
+      length = size > 0 ? size : strlen (buffer) + 1;
+      ifp_memory_malloc_add_address (buffer, length);
+      ifp_memory_malloc_count_allocation (length);
+      ifp_memory_malloc_check_usage ();
+    }
 
   return buffer;
 }
@@ -412,7 +859,8 @@ ifp_libc_intercept_scandir (const char *dir, struct dirent ***namelist,
 
   /*
    * If scandir() returned a non-error status, add each entry in namelist
-   * to the lists, then add namelist itself.
+   * to the lists, then add namelist itself.  Entry sizes are the minimum
+   * that will hold the name, which is all that scandir() guarantees.
    */
   if (count >= 0)
     {
@@ -422,11 +870,23 @@ ifp_libc_intercept_scandir (const char *dir, struct dirent ***namelist,
       for (index_ = 0; index_ < count; index_++)
         {
           if (entries[index_])
-            ifp_memory_malloc_add_address (entries[index_]);
+            {
+              struct dirent *entry = entries[index_];
+              size_t length;
+
+              length = offsetof (struct dirent, d_name)
+                       + strlen (entry->d_name) + 1;
+              ifp_memory_malloc_add_address (entry, length);
+              ifp_memory_malloc_count_allocation (length);
+            }
         }
 
       if (entries)
-        ifp_memory_malloc_add_address (entries);
+        {
+          ifp_memory_malloc_add_address (entries, count * sizeof (*entries));
+          ifp_memory_malloc_count_allocation (count * sizeof (*entries));
+        }
+      ifp_memory_malloc_check_usage ();
     }
 
   return count;
@@ -436,18 +896,476 @@ ifp_libc_intercept_scandir (const char *dir, struct dirent ***namelist,
 /*
  * ifp_libc_intercept_free()
  *
- * Intercept free(), and delete the free'd address from the list.
+ * Intercept free(), and delete the free'd address from the list.  If the
+ * address is part of a checkpoint, quarantine it instead of freeing it.
  */
 void
 ifp_libc_intercept_free (void *ptr)
 {
   if (ptr)
-    ifp_memory_malloc_remove_address (ptr);
+    {
+      int image;
+
+      image = ifp_memory_malloc_remove_address (ptr);
+      if (image != -1)
+        {
+          assert (ifp_malloc_images[image].address == ptr);
+          ifp_malloc_images[image].is_quarantined = TRUE;
+          return;
+        }
+    }
 
   free (ptr);
 }
 
 
+/*
+ * ifp_memory_mmap_page_round()
+ * ifp_memory_mmap_add_mapping()
+ * ifp_memory_mmap_remove_range()
+ *
+ * Round a mapping length up to whole pages, add a mapping to the mappings
+ * list, and remove an address range from the list.  The caller holds the
+ * mappings lock.  Mappings wholly inside the range are dropped,
+ * ones overlapping an end are trimmed, and one that spans the range is
+ * split in two.
+ */
+static size_t
+ifp_memory_mmap_page_round (size_t length)
+{
+  size_t page_size;
+
+  page_size = sysconf (_SC_PAGESIZE);
+  return (length + page_size - 1) & ~(page_size - 1);
+}
+
+static void
+ifp_memory_mmap_add_mapping (void *address, size_t length)
+{
+  ifp_mmap_inforef_t mapping;
+
+  if (ifp_mmap_count == ifp_mmap_allocation)
+    {
+      ifp_mmap_allocation = ifp_mmap_allocation > 0
+                            ? ifp_mmap_allocation * 2 : 8;
+      ifp_mmap_list = ifp_realloc (ifp_mmap_list,
+                                   ifp_mmap_allocation
+                                   * sizeof (*ifp_mmap_list));
+    }
+
+  mapping = ifp_mmap_list + ifp_mmap_count++;
+  mapping->address = address;
+  mapping->length = ifp_memory_mmap_page_round (length);
+
+  ifp_mmap_current_bytes += mapping->length;
+  if (ifp_mmap_current_bytes > ifp_mmap_peak_bytes)
+    ifp_mmap_peak_bytes = ifp_mmap_current_bytes;
+
+  ifp_trace ("memory: added %zu byte mapping %p", mapping->length, address);
+}
+
+static void
+ifp_memory_mmap_remove_range (void *address, size_t length)
+{
+  char *start, *end;
+  int index_;
+
+  start = address;
+  end = start + ifp_memory_mmap_page_round (length);
+
+  for (index_ = 0; index_ < ifp_mmap_count; index_++)
+    {
+      ifp_mmap_inforef_t mapping = ifp_mmap_list + index_;
+      char *map_start, *map_end;
+
+      map_start = mapping->address;
+      map_end = map_start + mapping->length;
+      if (map_end <= start || map_start >= end)
+        continue;
+
+      if (map_start >= start && map_end <= end)
+        {
+          ifp_mmap_current_bytes -= mapping->length;
+          ifp_trace ("memory: removed mapping %p", mapping->address);
+
+          *mapping = ifp_mmap_list[--ifp_mmap_count];
+          index_--;
+        }
+      else if (map_start < start && map_end > end)
+        {
+          /* Re-add the tail as a new mapping, so uncount it here. */
+          ifp_mmap_current_bytes -= map_end - start;
+
+          mapping->length = start - map_start;
+          ifp_memory_mmap_add_mapping (end, map_end - end);
+        }
+      else if (map_start < start)
+        {
+          ifp_mmap_current_bytes -= map_end - start;
+          mapping->length = start - map_start;
+        }
+      else
+        {
+          ifp_mmap_current_bytes -= end - map_start;
+          mapping->address = end;
+          mapping->length = map_end - end;
+        }
+    }
+}
+
+
+/*
+ * ifp_memory_mmap_unmap_all()
+ *
+ * Unmap every mapping remaining on the mappings list, and empty the list.
+ */
+static void
+ifp_memory_mmap_unmap_all (void)
+{
+  int index_;
+
+  ifp_memory_lock (&ifp_mmap_lock);
+
+  for (index_ = 0; index_ < ifp_mmap_count; index_++)
+    munmap (ifp_mmap_list[index_].address, ifp_mmap_list[index_].length);
+
+  if (ifp_mmap_count > 0)
+    ifp_trace ("memory: unmapped %d mapping(s)", ifp_mmap_count);
+
+  ifp_mmap_count = 0;
+  ifp_mmap_current_bytes = 0;
+
+  ifp_memory_unlock (&ifp_mmap_lock);
+}
+
+
+/*
+ * ifp_libc_intercept_mmap()
+ * ifp_libc_intercept_munmap()
+ *
+ * Interception for mmap() and munmap().  Successful mappings are noted on
+ * the mappings list, replacing any they overlay, and unmapped ranges are
+ * removed from it.
+ */
+void *
+ifp_libc_intercept_mmap (void *start, size_t length,
+                         int prot, int flags, int fd, off_t offset)
+{
+  void *address;
+
+  address = mmap (start, length, prot, flags, fd, offset);
+  if (address != MAP_FAILED)
+    {
+      ifp_memory_lock (&ifp_mmap_lock);
+      ifp_memory_mmap_remove_range (address, length);
+      ifp_memory_mmap_add_mapping (address, length);
+      ifp_memory_unlock (&ifp_mmap_lock);
+
+      ifp_memory_malloc_check_usage ();
+    }
+
+  return address;
+}
+
+int
+ifp_libc_intercept_munmap (void *start, size_t length)
+{
+  int status;
+
+  status = munmap (start, length);
+  if (status == 0)
+    {
+      ifp_memory_lock (&ifp_mmap_lock);
+      ifp_memory_mmap_remove_range (start, length);
+      ifp_memory_unlock (&ifp_mmap_lock);
+    }
+
+  return status;
+}
+
+
+/**
+ * ifp_memory_mmap_get_usage()
+ *
+ * Return the bytes currently mapped by plugins through the intercepted
+ * mmap(), and the peak value this has reached since the last garbage
+ * collection.  Either return pointer may be NULL.
+ */
+void
+ifp_memory_mmap_get_usage (size_t *current, size_t *peak)
+{
+  if (current)
+    *current = ifp_mmap_current_bytes;
+  if (peak)
+    *peak = ifp_mmap_peak_bytes;
+}
+
+
+/**
+ * ifp_memory_malloc_checkpoint()
+ *
+ * Take a checkpoint of all memory addresses currently on our lists, copying
+ * their contents.  Until the checkpoint is discarded, addresses in it that
+ * the plugin frees are held back from the real free(), so that a later call
+ * to ifp_memory_malloc_restore() can put the heap back exactly as it was.
+ * Any prior checkpoint is discarded.  Memory mappings are not copied, so
+ * no checkpoint is taken while the plugin holds any.  Returns TRUE if the
+ * checkpoint was taken.
+ */
+int
+ifp_memory_malloc_checkpoint (void)
+{
+  int shard, hash, count;
+  size_t bytes;
+  ifp_malloc_inforef_t entry;
+
+  ifp_trace ("memory: ifp_memory_malloc_checkpoint <- void");
+
+  ifp_memory_malloc_discard_checkpoint ();
+
+  if (ifp_mmap_count > 0)
+    {
+      ifp_trace ("memory: %d mapping(s) prevent checkpoint", ifp_mmap_count);
+      return FALSE;
+    }
+
+  ifp_memory_malloc_lock_all ();
+
+  count = 0;
+  for (shard = 0; shard < MALLOC_SHARDS; shard++)
+    {
+      ifp_malloc_shardref_t shard_ = ifp_malloc_shards + shard;
+
+      for (hash = 0; hash < shard_->buckets; hash++)
+        {
+          for (entry = shard_->lists[hash]; entry; entry = entry->next)
+            count++;
+        }
+    }
+
+  ifp_malloc_images = count > 0
+                      ? ifp_malloc (count * sizeof (*ifp_malloc_images)) : NULL;
+
+  ifp_malloc_image_count = 0;
+  bytes = 0;
+  for (shard = 0; shard < MALLOC_SHARDS; shard++)
+    {
+      ifp_malloc_shardref_t shard_ = ifp_malloc_shards + shard;
+
+      for (hash = 0; hash < shard_->buckets; hash++)
+        {
+          for (entry = shard_->lists[hash]; entry; entry = entry->next)
+            {
+              ifp_malloc_imageref_t image;
+
+              image = ifp_malloc_images + ifp_malloc_image_count;
+              image->address = entry->address;
+              image->size = entry->size;
+              image->contents = NULL;
+              if (entry->size > 0)
+                {
+                  image->contents = ifp_malloc (entry->size);
+                  memcpy (image->contents, entry->address, entry->size);
+                }
+              image->is_quarantined = FALSE;
+
+              entry->image = ifp_malloc_image_count++;
+              bytes += entry->size;
+            }
+        }
+    }
+
+  ifp_malloc_has_checkpoint = TRUE;
+
+  ifp_memory_malloc_unlock_all ();
+
+  ifp_trace ("memory: checkpointed %d allocation(s), %zu bytes", count, bytes);
+  return TRUE;
+}
+
+
+/*
+ * ifp_memory_malloc_clear_shard()
+ *
+ * Free a shard's hash buckets and pool, and reset it to its initial empty
+ * state.  The caller holds the shard lock.
+ */
+static void
+ifp_memory_malloc_clear_shard (ifp_malloc_shardref_t shard)
+{
+  ifp_free (shard->lists);
+  shard->lists = NULL;
+  shard->buckets = 0;
+
+  ifp_free (shard->pool);
+  shard->pool = NULL;
+  shard->freelist = NULL;
+}
+
+
+/**
+ * ifp_memory_malloc_restore()
+ *
+ * Restore the heap to its state at the last checkpoint.  Addresses
+ * allocated and memory mapped since the checkpoint are released, and
+ * checkpointed addresses, including any quarantined ones, are listed again
+ * with their contents put back.  The checkpoint remains held, so it may be
+ * restored again.  Returns FALSE if there is no checkpoint to restore.
+ */
+int
+ifp_memory_malloc_restore (void)
+{
+  int shard, hash, index_, count;
+  ifp_malloc_inforef_t entry;
+
+  ifp_trace ("memory: ifp_memory_malloc_restore <- void");
+
+  if (!ifp_malloc_has_checkpoint)
+    {
+      ifp_trace ("memory: no checkpoint to restore");
+      return FALSE;
+    }
+
+  ifp_memory_malloc_lock_all ();
+
+  /* Free everything allocated since the checkpoint. */
+  count = 0;
+  for (shard = 0; shard < MALLOC_SHARDS; shard++)
+    {
+      ifp_malloc_shardref_t shard_ = ifp_malloc_shards + shard;
+
+      for (hash = 0; hash < shard_->buckets; hash++)
+        {
+          for (entry = shard_->lists[hash]; entry; entry = entry->next)
+            {
+              if (entry->image == -1)
+                {
+                  free (entry->address);
+                  count++;
+                }
+            }
+        }
+
+      /* Clear the shard, for rebuilding from the checkpoint image. */
+      ifp_memory_malloc_clear_shard (shard_);
+    }
+
+  if (count > 0)
+    ifp_trace ("memory: recycled %d post-checkpoint allocation(s)", count);
+
+  ifp_memory_mmap_unmap_all ();
+
+  /* Rebuild the tracking tables from the checkpoint image. */
+  __atomic_store_n (&ifp_malloc_current_bytes, 0, __ATOMIC_RELAXED);
+
+  for (index_ = 0; index_ < ifp_malloc_image_count; index_++)
+    {
+      ifp_malloc_imageref_t image = ifp_malloc_images + index_;
+      glui32 hash_;
+
+      hash_ = ifp_memory_malloc_hash (image->address);
+      entry = ifp_memory_malloc_add_to_shard
+                  (ifp_memory_malloc_shard (hash_),
+                   image->address, hash_, image->size);
+      entry->image = index_;
+
+      if (image->size > 0)
+        memcpy (image->address, image->contents, image->size);
+      image->is_quarantined = FALSE;
+    }
+
+  ifp_memory_malloc_unlock_all ();
+
+  ifp_trace ("memory: restored %d allocation(s)", ifp_malloc_image_count);
+  return TRUE;
+}
+
+
+/**
+ * ifp_memory_malloc_discard_checkpoint()
+ *
+ * Discard any held checkpoint, releasing quarantined addresses for real.
+ */
+void
+ifp_memory_malloc_discard_checkpoint (void)
+{
+  int shard, hash, index_;
+  ifp_malloc_inforef_t entry;
+
+  if (!ifp_malloc_has_checkpoint)
+    return;
+
+  ifp_trace ("memory: ifp_memory_malloc_discard_checkpoint <- void");
+
+  ifp_memory_malloc_lock_all ();
+
+  for (index_ = 0; index_ < ifp_malloc_image_count; index_++)
+    {
+      ifp_malloc_imageref_t image = ifp_malloc_images + index_;
+
+      if (image->is_quarantined)
+        free (image->address);
+      ifp_free (image->contents);
+    }
+
+  for (shard = 0; shard < MALLOC_SHARDS; shard++)
+    {
+      ifp_malloc_shardref_t shard_ = ifp_malloc_shards + shard;
+
+      for (hash = 0; hash < shard_->buckets; hash++)
+        {
+          for (entry = shard_->lists[hash]; entry; entry = entry->next)
+            entry->image = -1;
+        }
+    }
+
+  ifp_free (ifp_malloc_images);
+  ifp_malloc_images = NULL;
+  ifp_malloc_image_count = 0;
+  ifp_malloc_has_checkpoint = FALSE;
+
+  ifp_memory_malloc_unlock_all ();
+}
+
+
+/**
+ * ifp_memory_malloc_get_usage()
+ *
+ * Return the bytes of heap currently allocated by plugins through the
+ * intercepted malloc family, and the peak value this has reached since the
+ * last garbage collection.  Either return pointer may be NULL.
+ */
+void
+ifp_memory_malloc_get_usage (size_t *current, size_t *peak)
+{
+  if (current)
+    *current = __atomic_load_n (&ifp_malloc_current_bytes, __ATOMIC_RELAXED);
+  if (peak)
+    *peak = __atomic_load_n (&ifp_malloc_peak_bytes, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * ifp_memory_malloc_get_class_counts()
+ *
+ * Copy up to length counts of intercepted allocations by size class into
+ * counts, and return the number of size classes.  Counts may be NULL, to
+ * find the number of classes.
+ */
+int
+ifp_memory_malloc_get_class_counts (unsigned long *counts, int length)
+{
+  int class_;
+
+  for (class_ = 0; counts && class_ < length
+                   && class_ < MALLOC_SIZE_CLASSES; class_++)
+    counts[class_] = __atomic_load_n (&ifp_malloc_class_counts[class_],
+                                      __ATOMIC_RELAXED);
+
+  return MALLOC_SIZE_CLASSES;
+}
+
+
 /**
  * ifp_memory_malloc_garbage_collect()
  *
@@ -457,33 +1375,50 @@ ifp_libc_intercept_free (void *ptr)
 void
 ifp_memory_malloc_garbage_collect (void)
 {
-  int hash, count;
+  int shard, hash, count;
   ifp_malloc_inforef_t entry;
 
   ifp_trace ("memory: ifp_memory_malloc_garbage_collect <- void");
 
+  /* Release any quarantined addresses held by a checkpoint. */
+  ifp_memory_malloc_discard_checkpoint ();
+
+  /*
+   * Free all listed addresses, then free each shard's hash buckets and
+   * pool, resetting all malloc tracking data structures back to their
+   * initial values.
+   */
+  ifp_memory_malloc_lock_all ();
+
   count = 0;
-  for (hash = 0; hash < ifp_malloc_buckets; hash++)
+  for (shard = 0; shard < MALLOC_SHARDS; shard++)
     {
-      for (entry = ifp_malloc_lists[hash]; entry; entry = entry->next)
+      ifp_malloc_shardref_t shard_ = ifp_malloc_shards + shard;
+
+      for (hash = 0; hash < shard_->buckets; hash++)
         {
-          free (entry->address);
-          count++;
+          for (entry = shard_->lists[hash]; entry; entry = entry->next)
+            {
+              free (entry->address);
+              count++;
+            }
         }
+
+      ifp_memory_malloc_clear_shard (shard_);
     }
 
   if (count > 0)
     ifp_trace ("memory: recycled %d allocation(s)", count);
 
-  /*
-   * Free the hash buckets and pool, and reset all malloc tracking data
-   * structures back to their initial values.
-   */
-  ifp_free (ifp_malloc_lists);
-  ifp_malloc_lists = NULL;
-  ifp_malloc_buckets = 0;
+  ifp_malloc_current_bytes = 0;
+  ifp_malloc_peak_bytes = 0;
+  memset (ifp_malloc_class_counts, 0, sizeof (ifp_malloc_class_counts));
+
+  ifp_memory_malloc_unlock_all ();
 
-  ifp_free (ifp_malloc_pool);
-  ifp_malloc_pool = NULL;
-  ifp_malloc_freelist = NULL;
+  ifp_memory_mmap_unmap_all ();
+  ifp_free (ifp_mmap_list);
+  ifp_mmap_list = NULL;
+  ifp_mmap_allocation = 0;
+  ifp_mmap_peak_bytes = 0;
 }
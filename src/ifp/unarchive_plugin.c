@@ -34,6 +34,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_UNARCHIVE
+
 
 /* Temporary file template. */
 static const char *TMPFILE_TEMPLATE = "/tmp/ifp_unarchive_XXXXXX";
@@ -32,6 +32,8 @@
 #include "ifp.h"
 #include "ifp_internal.h"
 
+#define IFP_TRACE_FACILITY IFP_TRACE_UNCOMPRESS
+
 
 /* Temporary file template. */
 static const char *TMPFILE_TEMPLATE = "/tmp/ifp_uncompress_XXXXXX";